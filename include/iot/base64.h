@@ -18,6 +18,21 @@
 extern "C" {
 #endif
 
+/** Incremental base64 encoder state */
+typedef struct iot_b64_encoder_t
+{
+  uint8_t pending[3];  /**< Bytes of an incomplete group, held for the next chunk */
+  uint8_t count;       /**< Number of pending bytes */
+} iot_b64_encoder_t;
+
+/** Incremental base64 decoder state */
+typedef struct iot_b64_decoder_t
+{
+  uint32_t buf;        /**< Bits of an incomplete group */
+  uint8_t count;       /**< Number of symbols in the incomplete group */
+  bool end;            /**< Whether padding, ending the data, has been decoded */
+} iot_b64_decoder_t;
+
 /**
  * @brief Get the base64 encode size of the specified binary data
  *
@@ -55,6 +70,71 @@ extern bool iot_b64_decode (const char * in, void * out, size_t * outLen);
  */
 extern bool iot_b64_encode (const void * in, size_t inLen, char * out, size_t outLen);
 
+/**
+ * @brief Initialise an incremental base64 encoder
+ *
+ * @param state Encoder state
+ */
+extern void iot_b64_encoder_init (iot_b64_encoder_t * state);
+
+/**
+ * @brief Encode a chunk of input, holding any incomplete group of bytes for the next chunk
+ *
+ * The output is not terminated. Concatenating the output of each update and the final call gives
+ * the same encoding as iot_b64_encode of the complete input.
+ *
+ * @param state Encoder state
+ * @param in    Pointer to input chunk
+ * @param inLen Size of input chunk
+ * @param out   Pointer to output, with space for at least ((inLen + 2) / 3) * 4 characters
+ * @return      Number of characters written
+ */
+extern size_t iot_b64_encode_update (iot_b64_encoder_t * state, const void * in, size_t inLen, char * out);
+
+/**
+ * @brief Complete an incremental encode, writing any held bytes as a padded group
+ *
+ * The output is not terminated and the encoder is reset for reuse.
+ *
+ * @param state Encoder state
+ * @param out   Pointer to output, with space for at least four characters
+ * @return      Number of characters written
+ */
+extern size_t iot_b64_encode_final (iot_b64_encoder_t * state, char * out);
+
+/**
+ * @brief Initialise an incremental base64 decoder
+ *
+ * @param state Decoder state
+ */
+extern void iot_b64_decoder_init (iot_b64_decoder_t * state);
+
+/**
+ * @brief Decode a chunk of base64 encoded input, holding any incomplete group for the next chunk
+ *
+ * Whitespace is skipped and input following padding is ignored.
+ *
+ * @param state  Decoder state
+ * @param in     Pointer to input chunk (need not be terminated)
+ * @param inLen  Length of input chunk
+ * @param out    General purpose pointer to the output
+ * @param outLen On entry the size of the output, on exit the number of bytes written
+ * @return       'true' if decode successful, 'false' if input is invalid or the output too small
+ */
+extern bool iot_b64_decode_update (iot_b64_decoder_t * state, const char * in, size_t inLen, void * out, size_t * outLen);
+
+/**
+ * @brief Complete an incremental decode, writing the bytes of any final unpadded group
+ *
+ * The decoder is reset for reuse.
+ *
+ * @param state  Decoder state
+ * @param out    General purpose pointer to the output
+ * @param outLen On entry the size of the output (at most two bytes are written), on exit the number of bytes written
+ * @return       'true' if decode successful, 'false' if the output is too small
+ */
+extern bool iot_b64_decode_final (iot_b64_decoder_t * state, void * out, size_t * outLen);
+
 #ifdef __cplusplus
 }
 #endif
@@ -72,6 +72,21 @@ typedef enum iot_data_tag_t
 /** Opaque iot data structure */
 typedef struct iot_data_t iot_data_t;
 
+/** Opaque type for incremental JSON decoder */
+typedef struct iot_data_json_stream_t iot_data_json_stream_t;
+
+/** Opaque type for incremental CBOR decoder */
+typedef struct iot_data_cbor_stream_t iot_data_cbor_stream_t;
+
+/** Opaque type for incremental XML decoder */
+typedef struct iot_data_xml_stream_t iot_data_xml_stream_t;
+
+/** Opaque type for precompiled JSON encoder plan */
+typedef struct iot_data_json_plan_t iot_data_json_plan_t;
+
+/** Opaque type for reusable encoder output buffer */
+typedef struct iot_data_buffer_t iot_data_buffer_t;
+
 /**
 * Type for data typecode structure
 */
@@ -170,6 +185,21 @@ typedef void (*iot_data_free_fn) (void * ptr);
 /** Type for data update function pointer */
 typedef iot_data_t * (*iot_data_update_fn) (const iot_data_t * data, void * arg);
 
+/** Type for JSON stream value callback function pointer, ownership of the value is passed to the function */
+typedef void (*iot_data_json_stream_fn) (iot_data_t * data, void * arg);
+
+/** Type for CBOR stream value callback function pointer, ownership of the value is passed to the function */
+typedef void (*iot_data_cbor_stream_fn) (iot_data_t * data, void * arg);
+
+/** Type for XML stream element callback function pointer, ownership of the element is passed to the function */
+typedef void (*iot_data_xml_stream_fn) (iot_data_t * data, void * arg);
+
+/** Type for YAML document callback function pointer, ownership of the document is passed to the function */
+typedef void (*iot_data_yaml_stream_fn) (iot_data_t * data, void * arg);
+
+/** Type for encoded output sink function pointer, returns false if the output could not be written */
+typedef bool (*iot_data_sink_fn) (void * ctx, const char * buff, size_t len);
+
 /** Function to compare string data with a string value */
 extern iot_data_cmp_fn iot_data_string_cmp;
 
@@ -999,6 +1029,19 @@ extern iot_data_t * iot_data_alloc_map (iot_data_type_t key_type);
  */
 extern iot_data_t * iot_data_alloc_typed_map (iot_data_type_t key_type, iot_data_type_t element_type);
 
+/**
+ * @brief  Allocate insertion ordered map data type
+ *
+ * The function to allocate a data map with a key type that also records the order in which
+ * keys are added. Map lookup and iteration are unchanged, but the map is output in insertion
+ * order when converted to JSON, and copies retain the order. Replacing the value of an existing
+ * key does not change its position. Removing a key is linear in the size of the map.
+ *
+ * @param key_type  Datatype of the map keys
+ * @return          Pointer to the allocated data map
+ */
+extern iot_data_t * iot_data_alloc_ordered_map (iot_data_type_t key_type);
+
 /**
  * @brief Find map element type
  *
@@ -1231,6 +1274,31 @@ extern const char * iot_data_string (const iot_data_t * data);
  */
 extern const void * iot_data_pointer (const iot_data_t * data);
 
+/**
+ * @brief Check whether data is a lazy value
+ *
+ * The function checks whether data is a lazily decoded JSON or CBOR container, as returned within
+ * the results of iot_data_from_json_lazy and iot_data_from_cbor_lazy. Lazy values are of type
+ * IOT_DATA_POINTER and hold the undecoded container text or bytes.
+ *
+ * @param data  Data to check
+ * @return      Whether data is a lazy value
+ */
+extern bool iot_data_is_lazy (const iot_data_t * data);
+
+/**
+ * @brief Get the decoded value of a lazy value
+ *
+ * The function decodes a lazy value on first access, caching the result for subsequent calls.
+ * The decoded value is owned by the lazy value and must not be modified, so that the original
+ * encoding is still valid when the lazy value is re-encoded. Containers that fail to decode
+ * are returned as null values.
+ *
+ * @param data  Lazy value to decode
+ * @return      Decoded value, or data itself if not a lazy value
+ */
+extern const iot_data_t * iot_data_lazy_value (const iot_data_t * data);
+
 /**
  * @brief Cast integer, float or boolean values
  *
@@ -1298,6 +1366,16 @@ extern bool iot_data_map_remove (iot_data_t * map, const iot_data_t * key);
  */
 extern uint32_t iot_data_map_size (const iot_data_t * map);
 
+/**
+ * @brief Check whether a map records insertion order
+ *
+ * The function to check whether a map was allocated with iot_data_alloc_ordered_map
+ *
+ * @param map Input map
+ * @return    Whether the map is insertion ordered
+ */
+extern bool iot_data_map_is_ordered (const iot_data_t * map);
+
 /**
  * @brief Empty a map of all elements
  *
@@ -2135,10 +2213,9 @@ extern const iot_data_t * iot_data_iter_value (const iot_data_iter_t * iter);
 /**
  * @brief  Convert data to json string
  *
- * The function to convert data to a json string. If metadata has been
- * added to a map in the format generated by iot_data_from_json_with_ordering
- * then the metadata string vectors will be used to determine which map entries
- * appear in the JSON and the order in which they appear.
+ * The function to convert data to a json string. Insertion ordered maps (see
+ * iot_data_alloc_ordered_map and iot_data_from_json_with_ordering) are output
+ * in the order in which keys were added, other maps in key order.
  *
  * @param  data  Input data
  * @return       json string
@@ -2172,6 +2249,144 @@ extern char * iot_data_to_json_with_size (const iot_data_t * data, uint32_t size
  */
 extern char * iot_data_to_json_with_buffer (const iot_data_t * data, char * buff, uint32_t size);
 
+/**
+ * @brief  Get the length of the json string for data
+ *
+ * The function measures, without generating, the json for data. A buffer of one more
+ * than the returned length (allowing for the string terminator) can be passed to
+ * iot_data_to_json_with_buffer or iot_data_to_json_with_size to generate the json
+ * without any buffer reallocation.
+ *
+ * @param  data  Input data
+ * @return       Length of the json string
+ */
+extern size_t iot_data_json_size (const iot_data_t * data);
+
+/**
+ * @brief  Convert data to json, writing the output to a sink
+ *
+ * The function converts data to json, accumulating output in the provided buffer and passing
+ * it to the sink function whenever the buffer is full and when the conversion completes.
+ * The output is not nul terminated. This allows large documents to be streamed to a socket
+ * or file without generating the complete json string in memory. If the sink function fails,
+ * no further output is passed to it.
+ *
+ * @param  data  Input data
+ * @param  sink  Output sink function
+ * @param  ctx   Context passed to the sink function
+ * @param  buff  Output buffer, if NULL an internal buffer is used
+ * @param  size  Output buffer size, minimum 64 bytes if a buffer is provided
+ * @return       Whether all output was accepted by the sink function
+ */
+extern bool iot_data_to_json_sink (const iot_data_t * data, iot_data_sink_fn sink, void * ctx, char * buff, size_t size);
+
+/**
+ * @brief  Convert data to json, writing the output to a file descriptor
+ *
+ * @param  data  Input data
+ * @param  fd    Output file descriptor
+ * @return       Whether all output was written
+ */
+extern bool iot_data_to_json_fd (const iot_data_t * data, int fd);
+
+/**
+ * @brief  Convert data to json, writing the output to a stream
+ *
+ * @param  data  Input data
+ * @param  fp    Output stream
+ * @return       Whether all output was written
+ */
+extern bool iot_data_to_json_file (const iot_data_t * data, FILE * fp);
+
+/**
+ * @brief  Compile a JSON encoder plan for data of a fixed shape
+ *
+ * The function to compile an encoder plan from example data. The plan records the
+ * map keys (pre-rendered as escaped JSON fragments), vector element shapes and value
+ * types of the example, for use with iot_data_to_json_with_plan.
+ *
+ * @param  example  Example data with the shape of the data to be encoded
+ * @return          Pointer to the encoder plan, which must be freed with iot_data_json_plan_free
+ */
+extern iot_data_json_plan_t * iot_data_json_plan_alloc (const iot_data_t * example);
+
+/**
+ * @brief  Free a JSON encoder plan
+ *
+ * @param  plan  Encoder plan to free, may be NULL
+ */
+extern void iot_data_json_plan_free (iot_data_json_plan_t * plan);
+
+/**
+ * @brief  Convert data to json string using a precompiled encoder plan
+ *
+ * The function to convert data to a json string, using an encoder plan to output map keys
+ * and values of known type without per value key escaping and type dispatch. Any part of the
+ * data that does not match the plan (different keys, key order or types) is converted as by
+ * iot_data_to_json, so the output is always the same as that of iot_data_to_json.
+ *
+ * @param  data  Input data
+ * @param  plan  Encoder plan
+ * @return       json string, which must be freed by the caller
+ */
+extern char * iot_data_to_json_with_plan (const iot_data_t * data, const iot_data_json_plan_t * plan);
+
+/**
+ * @brief  Allocate a reusable encoder output buffer
+ *
+ * The function to allocate an output buffer for the iot_data_to_json_buffer and
+ * iot_data_to_cbor_buffer functions. The buffer grows as required and retains its
+ * capacity across encodes, so that repeated encoding of similarly sized data does not
+ * allocate memory. A buffer is not thread safe, but may be allocated per thread.
+ *
+ * @param  size  Initial buffer capacity, if zero a default capacity is used
+ * @return       Pointer to the buffer, which must be freed with iot_data_buffer_free
+ */
+extern iot_data_buffer_t * iot_data_buffer_alloc (size_t size);
+
+/**
+ * @brief  Free a reusable encoder output buffer
+ *
+ * @param  buffer  Buffer to free, may be NULL
+ */
+extern void iot_data_buffer_free (iot_data_buffer_t * buffer);
+
+/**
+ * @brief  Get the output of the last encode to a buffer
+ *
+ * @param  buffer  Output buffer
+ * @return         Pointer to the encoded output, valid until the buffer is next used or freed
+ */
+extern const uint8_t * iot_data_buffer_data (const iot_data_buffer_t * buffer);
+
+/**
+ * @brief  Get the length of the output of the last encode to a buffer
+ *
+ * @param  buffer  Output buffer
+ * @return         Length of the encoded output in bytes, excluding any string terminator
+ */
+extern size_t iot_data_buffer_length (const iot_data_buffer_t * buffer);
+
+/**
+ * @brief  Get the capacity of a buffer
+ *
+ * @param  buffer  Output buffer
+ * @return         Current buffer capacity in bytes
+ */
+extern size_t iot_data_buffer_capacity (const iot_data_buffer_t * buffer);
+
+/**
+ * @brief  Convert data to json string in a reusable buffer
+ *
+ * The function to convert data to a json string written to a reusable buffer,
+ * growing the buffer if required.
+ *
+ * @param  data    Input data
+ * @param  buffer  Output buffer
+ * @return         Pointer to the nul terminated json string in the buffer, valid until the buffer is next used or freed
+ */
+extern const char * iot_data_to_json_buffer (const iot_data_t * data, iot_data_buffer_t * buffer);
+
 /**
  * @brief Convert json to iot_data_t type
  *
@@ -2183,14 +2398,12 @@ extern char * iot_data_to_json_with_buffer (const iot_data_t * data, char * buff
 extern iot_data_t * iot_data_from_json (const char * json);
 
 /**
- * @brief Convert json to iot_data_t type with optional object ordering metadata
+ * @brief Convert json to iot_data_t type with optional object ordering
  *
- * The function to convert input json string to iot_data and optionally adds
- * metadata to the result. The metadata is associated with each map
- * representing JSON objects. The metadata is in the form of a map which
- * contains the key string "ordering" with a vector of strings. The vector
- * consists of the JSON object keys in the order in which they appear in
- * the JSON. See also iot_data_to_json.
+ * The function to convert input json string to iot_data, optionally allocating
+ * the maps representing JSON objects as insertion ordered maps, so recording
+ * the order in which keys appear in the JSON. See also iot_data_to_json and
+ * iot_data_alloc_ordered_map.
  *
  * @param json    Input json string
  * @param ordered Whether returned map is ordered by position in json
@@ -2199,14 +2412,11 @@ extern iot_data_t * iot_data_from_json (const char * json);
 extern iot_data_t * iot_data_from_json_with_ordering (const char * json, bool ordered);
 
 /**
- * @brief Convert json to iot_data_t type with optional object ordering metadata and shared key map
+ * @brief Convert json to iot_data_t type with optional object ordering and shared key map
  *
- * The function to convert input json string to iot_data and optionally adds
- * metadata to the result. The metadata is associated with each map
- * representing JSON objects. The metadata is in the form of a map which
- * contains the key string "ordering" with a vector of strings. The vector
- * consists of the JSON object keys in the order in which they appear in
- * the JSON. See also iot_data_to_json and iot_data_from_json_with_ordering.
+ * The function to convert input json string to iot_data, optionally allocating
+ * the maps representing JSON objects as insertion ordered maps. See also
+ * iot_data_to_json and iot_data_from_json_with_ordering.
  *
  * @param json    Input json string
  * @param ordered Whether returned map is ordered by position in json
@@ -2215,17 +2425,191 @@ extern iot_data_t * iot_data_from_json_with_ordering (const char * json, bool or
  */
 extern iot_data_t * iot_data_from_json_with_cache (const char * json, bool ordered, iot_data_t * cache);
 
+/**
+ * @brief Convert selected parts of json to iot_data_t type
+ *
+ * The function converts only the parts of the input json selected by a set of paths, skipping over
+ * the text of all other values without decoding them. Each path is a list of map keys and vector
+ * indexes (unsigned 32 bit integers), as used by iot_data_get_at, in which a null value matches
+ * any key or index. The result contains the maps and vectors on the paths to the selected values,
+ * with maps containing only selected keys. Vector elements not selected are replaced by null
+ * values so that indexes are retained. For example the paths [ "deviceName" ] and
+ * [ "readings", null, "value" ] select the device name and the value of every reading.
+ *
+ * @param json    Input json string
+ * @param paths   Vector of up to 64 path lists, an empty path selects everything
+ * @param ordered Whether returned map is ordered by position in json
+ * @return        Pointer to data of type iot_data if input string is a json object, NULL otherwise
+ */
+extern iot_data_t * iot_data_from_json_select (const char * json, const iot_data_t * paths, bool ordered);
+
+/**
+ * @brief Convert json to iot_data_t type, decoding strings in place
+ *
+ * The function converts input json to iot_data, decoding strings in place in the json buffer, which is
+ * modified. Decoded strings reference the buffer rather than being copied, except short strings that
+ * are held within the string value. The buffer is released when no longer referenced by any string.
+ *
+ * @param json      Input json string, modified unless ownership is IOT_DATA_COPY
+ * @param ownership IOT_DATA_TAKE to pass ownership of the buffer (allocated with malloc), IOT_DATA_COPY
+ *                  to decode a copy of the buffer, or IOT_DATA_REF if the buffer will outlive the result
+ * @param ordered   Whether returned map is ordered by position in json
+ * @return          Pointer to data of type iot_data if input string is a json object, NULL otherwise
+ */
+extern iot_data_t * iot_data_from_json_in_situ (char * json, iot_data_ownership_t ownership, bool ordered);
+
+/**
+ * @brief Convert json to iot_data_t type, deferring decoding of nested containers
+ *
+ * The function converts input json to iot_data, decoding only the outer levels of nesting. Objects
+ * and arrays nested more deeply are checked for bracket and string structure only, and returned as
+ * lazy values holding a copy of their json text, which are decoded on first access with
+ * iot_data_lazy_value. When converted back to json, a lazy value is written as the original text
+ * without being decoded, so parts of a message passed through unchanged are never fully decoded.
+ *
+ * @param json    Input json string
+ * @param depth   Number of levels of nesting to decode, zero to decode all levels
+ * @param ordered Whether returned maps are ordered by position in json
+ * @return        Pointer to data of type iot_data if input string is a json object, NULL otherwise
+ */
+extern iot_data_t * iot_data_from_json_lazy (const char * json, uint32_t depth, bool ordered);
+
+/**
+ * @brief Allocate an incremental JSON decoder
+ *
+ * The function allocates a decoder that accepts JSON text in successive buffers of arbitrary
+ * size, such as received from a socket, and passes each complete top level value to a callback
+ * function. Streams of values separated by whitespace or commas, such as newline delimited JSON,
+ * are supported. String values are shared between decoded values via an internal cache.
+ *
+ * @param fn      Function called with each decoded value, which takes ownership of the value
+ * @param arg     Argument passed to the callback function
+ * @param ordered Whether decoded maps are ordered by position in json (see iot_data_from_json_with_ordering)
+ * @return        Pointer to the allocated decoder
+ */
+extern iot_data_json_stream_t * iot_data_json_stream_alloc (iot_data_json_stream_fn fn, void * arg, bool ordered);
+
+/**
+ * @brief Pass JSON text to an incremental JSON decoder
+ *
+ * The function scans the text for complete values, decoding and passing them to the
+ * decoder callback function. Text for an incomplete value is retained until completed
+ * by subsequent calls. The text need not be NUL terminated.
+ *
+ * @param stream  Incremental JSON decoder
+ * @param buff    JSON text
+ * @param len     Length of JSON text
+ * @return        Whether all complete values in the text were valid JSON
+ */
+extern bool iot_data_json_stream_write (iot_data_json_stream_t * stream, const char * buff, size_t len);
+
+/**
+ * @brief Signal the end of input to an incremental JSON decoder
+ *
+ * A pending top level number or literal is decoded and passed to the callback function.
+ * Any other incomplete value is discarded. The decoder can then be reused for new input.
+ *
+ * @param stream  Incremental JSON decoder
+ * @return        Whether the input ended at a value boundary
+ */
+extern bool iot_data_json_stream_end (iot_data_json_stream_t * stream);
+
+/**
+ * @brief Free an incremental JSON decoder
+ *
+ * @param stream  Incremental JSON decoder to free
+ */
+extern void iot_data_json_stream_free (iot_data_json_stream_t * stream);
+
+/**
+ * @brief  Serialise data to a native binary format
+ *
+ * The function serialises data to a compact, versioned, binary format preserving all data
+ * types, including typed and ordered maps, typed vectors and lists, and metadata, for
+ * persistence or IPC. Arrays are serialised as raw blocks and repeated short strings (such
+ * as map keys) are serialised once and subsequently referenced. Pointers are serialised as null.
+ *
+ * @param  data  Input data
+ * @return       Serialised data as an IOT_DATA_BINARY
+ */
+extern iot_data_t * iot_data_serialise (const iot_data_t * data);
+
+/**
+ * @brief  Serialise data to a native binary format in a reusable buffer
+ *
+ * The function serialises data, as by iot_data_serialise, to a reusable buffer, growing the
+ * buffer if required. The length of the output is given by iot_data_buffer_length.
+ *
+ * @param  data    Input data
+ * @param  buffer  Output buffer
+ * @return         Pointer to the serialised data in the buffer, valid until the buffer is next used or freed
+ */
+extern const uint8_t * iot_data_serialise_buffer (const iot_data_t * data, iot_data_buffer_t * buffer);
+
+/**
+ * @brief  Deserialise data from a native binary format
+ *
+ * The function deserialises data serialised by iot_data_serialise, by this or any earlier
+ * library version.
+ *
+ * @param  data  Serialised data
+ * @param  size  Size of the serialised data
+ * @return       Deserialised data, or NULL if the data is invalid or of an unsupported version
+ */
+extern iot_data_t * iot_data_deserialise (const uint8_t * data, size_t size);
+
+#if defined (IOT_HAS_FILE) && !defined (_AZURESPHERE_)
+/**
+ * @brief  Deserialise data from a memory mapped file
+ *
+ * The function memory maps, read only, a file holding data serialised by iot_data_serialise
+ * and deserialises it with strings referencing the mapped file rather than being copied, so
+ * that the file pages are shared between processes. The mapping is released when no strings
+ * reference it. The file must not be modified while mapped.
+ *
+ * @param  path  File path
+ * @return       Deserialised data, or NULL if the file cannot be read or is invalid
+ */
+extern iot_data_t * iot_data_deserialise_file (const char * path);
+#endif
+
 #ifdef IOT_HAS_CBOR
 /**
  * @brief  Convert data to CBOR block
  *
- * The function to convert data to cbor.
+ * The function to convert data to cbor, allocating an output buffer of the exact
+ * size required. Arrays of integers and floats are encoded as RFC 8746 typed arrays,
+ * in host byte order.
  *
  * @param  data  Input data
  * @return       CBOR in an IOT_DATA_BINARY
  */
 extern iot_data_t * iot_data_to_cbor (const iot_data_t * data);
 
+/**
+ * @brief  Convert data to CBOR block, selecting the array encoding
+ *
+ * The function to convert data to cbor, with arrays encoded either as RFC 8746 typed
+ * arrays (tagged byte strings) or, for decoders not supporting typed arrays, as generic
+ * CBOR arrays of individually encoded elements.
+ *
+ * @param  data   Input data
+ * @param  typed  Whether to encode arrays as typed arrays
+ * @return        CBOR in an IOT_DATA_BINARY
+ */
+extern iot_data_t * iot_data_to_cbor_with_typed_arrays (const iot_data_t * data, bool typed);
+
+/**
+ * @brief  Get the length of the CBOR for data
+ *
+ * The function measures, without generating, the CBOR for data as returned by iot_data_to_cbor,
+ * which allocates an output buffer of exactly this length.
+ *
+ * @param  data  Input data
+ * @return       Length of the CBOR
+ */
+extern size_t iot_data_cbor_size (const iot_data_t * data);
+
 /**
  * @brief  Convert data to CBOR block with initial buffer size
  *
@@ -2239,6 +2623,18 @@ extern iot_data_t * iot_data_to_cbor (const iot_data_t * data);
  */
 extern iot_data_t * iot_data_to_cbor_with_size (const iot_data_t * data, uint32_t size);
 
+/**
+ * @brief  Convert data to CBOR in a reusable buffer
+ *
+ * The function to convert data to cbor written to a reusable buffer, growing
+ * the buffer if required. The length of the output is given by iot_data_buffer_length.
+ *
+ * @param  data    Input data
+ * @param  buffer  Output buffer
+ * @return         Pointer to the CBOR in the buffer, valid until the buffer is next used or freed
+ */
+extern const uint8_t * iot_data_to_cbor_buffer (const iot_data_t * data, iot_data_buffer_t * buffer);
+
 /**
  * @bief Convert cbor data to iot_data_t structure
  *
@@ -2256,6 +2652,123 @@ extern iot_data_t * iot_data_from_cbor (const uint8_t *data, uint32_t size);
  */
 extern iot_data_t * iot_data_from_iot_cbor (const iot_data_t *data);
 
+/**
+ * @brief Convert cbor data to iot_data_t structure, deferring decoding of nested containers
+ *
+ * The function converts cbor data to iot_data, decoding only the outer levels of nesting. Arrays
+ * and maps nested more deeply are checked for structure only, and returned as lazy values holding
+ * a copy of their encoded bytes, which are decoded on first access with iot_data_lazy_value. When
+ * converted back to cbor, a lazy value is written as the original bytes without being decoded.
+ *
+ * @param data  Input data
+ * @param size  Size of input data
+ * @param depth Number of levels of nesting to decode, zero to decode all levels
+ * @return      iot_data struct, or NULL if the input is not valid cbor
+ */
+extern iot_data_t * iot_data_from_cbor_lazy (const uint8_t * data, uint32_t size, uint32_t depth);
+
+/**
+ * @brief Allocate an incremental CBOR decoder
+ *
+ * The function allocates a decoder that accepts a sequence of CBOR items in successive buffers
+ * of arbitrary size, such as received from a socket, and passes each complete top level item,
+ * decoded as by iot_data_from_cbor, to a callback function.
+ *
+ * @param fn   Function called with each decoded value, which takes ownership of the value
+ * @param arg  Argument passed to the callback function
+ * @return     Pointer to the allocated decoder
+ */
+extern iot_data_cbor_stream_t * iot_data_cbor_stream_alloc (iot_data_cbor_stream_fn fn, void * arg);
+
+/**
+ * @brief Pass CBOR data to an incremental CBOR decoder
+ *
+ * Complete items are decoded directly from the buffer, any trailing partial item is retained
+ * until completed by subsequent data. If malformed CBOR is found, any retained data and the
+ * remainder of the buffer are discarded.
+ *
+ * @param stream  Incremental CBOR decoder
+ * @param buff    CBOR data
+ * @param len     Length of the CBOR data
+ * @return        Whether the data was valid CBOR
+ */
+extern bool iot_data_cbor_stream_write (iot_data_cbor_stream_t * stream, const uint8_t * buff, size_t len);
+
+/**
+ * @brief Signal the end of input to an incremental CBOR decoder
+ *
+ * Any incomplete item is discarded. The decoder can then be reused for new input.
+ *
+ * @param stream  Incremental CBOR decoder
+ * @return        Whether the input ended at an item boundary
+ */
+extern bool iot_data_cbor_stream_end (iot_data_cbor_stream_t * stream);
+
+/**
+ * @brief Free an incremental CBOR decoder
+ *
+ * @param stream  Incremental CBOR decoder to free, may be NULL
+ */
+extern void iot_data_cbor_stream_free (iot_data_cbor_stream_t * stream);
+
+#endif
+#ifdef IOT_HAS_MSGPACK
+/**
+ * @brief  Convert data to MessagePack
+ *
+ * The function to convert data to MessagePack, allocating an output buffer of the exact size.
+ * Integers are encoded in the smallest format holding the value, vectors and lists as arrays and
+ * binary data as bin. Numeric and boolean arrays are encoded as ext values, of type 16 plus the
+ * array element type, holding the elements in little endian byte order. Pointers are encoded as nil.
+ *
+ * @param data  Data to convert
+ * @return      MessagePack in an IOT_DATA_BINARY
+ */
+extern iot_data_t * iot_data_to_msgpack (const iot_data_t * data);
+
+/**
+ * @brief  Get the length of the MessagePack for data
+ *
+ * The function measures, without generating, the MessagePack for data as returned by iot_data_to_msgpack.
+ *
+ * @param data  Data to measure
+ * @return      Length of the MessagePack
+ */
+extern size_t iot_data_msgpack_size (const iot_data_t * data);
+
+/**
+ * @brief  Convert data to MessagePack in a reusable buffer
+ *
+ * The function to convert data to MessagePack written to a reusable buffer, growing the buffer
+ * as required. The length of the output is given by iot_data_buffer_length.
+ *
+ * @param data     Data to convert
+ * @param buffer   Reusable buffer
+ * @return         Pointer to the MessagePack in the buffer, valid until the buffer is next used or freed
+ */
+extern const uint8_t * iot_data_to_msgpack_buffer (const iot_data_t * data, iot_data_buffer_t * buffer);
+
+/**
+ * @brief Convert MessagePack to iot_data_t structure
+ *
+ * The function decodes integers to the type of their encoded format, str as strings, bin as binary,
+ * arrays as vectors and maps as maps with key type IOT_DATA_MULTI. Array ext values, as written by
+ * iot_data_to_msgpack, are decoded as arrays and other ext values as binary holding the ext data.
+ *
+ * @param data  Input data
+ * @param size  Size of input data
+ * @return      iot_data struct, or NULL if the input is not valid MessagePack
+ */
+extern iot_data_t * iot_data_from_msgpack (const uint8_t * data, uint32_t size);
+
+/**
+ * @brief Convert iot binary MessagePack data to iot_data_t structure
+ *
+ * @param data  Input binary data, must be of type IOT_DATA_BINARY
+ * @return      iot_data struct, or NULL if the input is not valid MessagePack
+ */
+extern iot_data_t * iot_data_from_iot_msgpack (const iot_data_t * data);
+
 #endif
 #ifdef IOT_HAS_XML
 /**
@@ -2271,6 +2784,55 @@ extern iot_data_t * iot_data_from_iot_cbor (const iot_data_t *data);
  * @return       A iot_data map if input string is a XML string, NULL otherwise.
  */
 extern iot_data_t * iot_data_from_xml (const char * xml);
+
+/**
+ * @brief Allocate an incremental XML decoder
+ *
+ * The function allocates a decoder that accepts an XML document in successive buffers of arbitrary
+ * size, passing each element selected by a path to a callback function as soon as the element is
+ * complete. Elements are converted to maps as by iot_data_from_xml. Only selected elements are
+ * decoded and held, so large documents can be processed without building the complete tree. The
+ * path is a list of element names starting with the root element, in which a null value matches
+ * any name. For example the path [ "UANodeSet", "UAVariable" ] selects every UAVariable element
+ * of a UANodeSet document.
+ *
+ * @param fn    Function called with each selected element, which takes ownership of the element
+ * @param arg   Argument passed to the callback function
+ * @param path  List of element names, NULL or empty to select the root element
+ * @return      Pointer to the allocated decoder
+ */
+extern iot_data_xml_stream_t * iot_data_xml_stream_alloc (iot_data_xml_stream_fn fn, void * arg, const iot_data_t * path);
+
+/**
+ * @brief Pass XML text to an incremental XML decoder
+ *
+ * The function parses the text, passing selected elements completed by the text to the decoder
+ * callback function. The text need not be NUL terminated. Once invalid XML is found, further
+ * text is ignored until the end of input is signalled.
+ *
+ * @param stream  Incremental XML decoder
+ * @param buff    XML text
+ * @param len     Length of XML text
+ * @return        Whether the document is valid XML so far
+ */
+extern bool iot_data_xml_stream_write (iot_data_xml_stream_t * stream, const char * buff, size_t len);
+
+/**
+ * @brief Signal the end of input to an incremental XML decoder
+ *
+ * Any incomplete element is discarded. The decoder can then be reused for a new document.
+ *
+ * @param stream  Incremental XML decoder
+ * @return        Whether the input was a complete, valid XML document
+ */
+extern bool iot_data_xml_stream_end (iot_data_xml_stream_t * stream);
+
+/**
+ * @brief Free an incremental XML decoder
+ *
+ * @param stream  Incremental XML decoder to free, may be NULL
+ */
+extern void iot_data_xml_stream_free (iot_data_xml_stream_t * stream);
 #endif
 
 #ifdef IOT_HAS_YAML
@@ -2285,6 +2847,34 @@ extern iot_data_t * iot_data_from_xml (const char * xml);
  * @return            A iot_data element if input string is a YAML string, NULL otherwise.
  */
 extern iot_data_t * iot_data_from_yaml (const char * yaml, iot_data_t ** exception);
+
+/**
+ * @brief Convert each document of a multi-document YAML string to iot_data_t type
+ *
+ * The function parses the YAML documents in turn, passing each to the callback as soon as it is complete. Ownership
+ * of each document passes to the callback. Aliases share the anchored node of their document by reference.
+ *
+ * @param  yaml       Input YAML string
+ * @param  fn         Function called with each document
+ * @param  arg        Argument passed to the function
+ * @param  exception  If a parse error occurs, on exit this will hold a string describing the problem
+ * @return            'true' if all documents were parsed, 'false' otherwise
+ */
+extern bool iot_data_from_yaml_stream (const char * yaml, iot_data_yaml_stream_fn fn, void * arg, iot_data_t ** exception);
+
+/**
+ * @brief Convert each document of a YAML file to iot_data_t type
+ *
+ * As iot_data_from_yaml_stream, but with the YAML read incrementally from a file, so that the file
+ * content is not held in memory.
+ *
+ * @param  fp         Input file
+ * @param  fn         Function called with each document
+ * @param  arg        Argument passed to the function
+ * @param  exception  If a parse error occurs, on exit this will hold a string describing the problem
+ * @return            'true' if all documents were parsed, 'false' otherwise
+ */
+extern bool iot_data_from_yaml_file (FILE * fp, iot_data_yaml_stream_fn fn, void * arg, iot_data_t ** exception);
 #endif
 
 /**
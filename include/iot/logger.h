@@ -38,6 +38,24 @@ typedef enum iot_loglevel_t
   IOT_LOG_TRACE = 5u     /**< Trace, Debug, Information, Warning and Error logging */
 } iot_loglevel_t;
 
+/**
+ * Asynchronous logging overflow policy, applied when the log record ring buffer is full
+ */
+typedef enum iot_log_overflow_t
+{
+  IOT_LOG_OVERFLOW_DROP = 0u,  /**< Drop the record and increment the dropped record count */
+  IOT_LOG_OVERFLOW_BLOCK = 1u  /**< Block the logging thread until space is available */
+} iot_log_overflow_t;
+
+/**
+ * Log output format
+ */
+typedef enum iot_log_format_t
+{
+  IOT_LOG_FORMAT_TEXT = 0u,    /**< Text records "[thread:timestamp:name:level] message", followed by any fields as JSON */
+  IOT_LOG_FORMAT_JSON = 1u     /**< JSON object records, one per line, with keys "thread", "timestamp", "logger", "level", "message" and any fields not using these keys */
+} iot_log_format_t;
+
 /**
  * Public logger struct. Do not use directly or stack allocate.
  */
@@ -83,6 +101,49 @@ extern iot_logger_t * iot_logger_alloc (const char * name, iot_loglevel_t level,
  * @return            Pointer to the logger component created
  */
 extern iot_logger_t * iot_logger_alloc_file (const char * name, iot_loglevel_t level, bool self_start, iot_logger_t * next, const char *pathname);
+
+/**
+ * File logger sync policy, determines when log file data is synchronised to storage (fsync)
+ */
+typedef enum iot_log_fsync_t
+{
+  IOT_LOG_FSYNC_NONE = 0u,    /**< Never synchronise, leave to the operating system */
+  IOT_LOG_FSYNC_ROTATE = 1u,  /**< Synchronise when a log file is rotated or closed */
+  IOT_LOG_FSYNC_FLUSH = 2u    /**< Synchronise whenever the write buffer is flushed */
+} iot_log_fsync_t;
+
+/**
+ * File logger configuration. A zero initialised configuration gives a non rotating log file with default buffering.
+ */
+typedef struct iot_logger_file_config_t
+{
+  uint64_t max_size;          /**< Size in bytes at which the log file is rotated, zero for no size based rotation */
+  uint32_t interval;          /**< Interval in seconds after which the log file is rotated, zero for no time based rotation */
+  uint32_t max_files;         /**< Number of rotated log files retained, named with suffixes ".1" (newest) to ".max_files" */
+  uint32_t buffer_size;       /**< Write buffer size in bytes, zero for default buffering */
+  uint32_t flush_interval;    /**< Interval in milliseconds after which buffered log records are flushed, zero for no periodic flush */
+  bool compress;              /**< Whether rotated log files are compressed using gzip (adds ".gz" suffix) */
+  iot_log_fsync_t fsync;      /**< Sync policy */
+} iot_logger_file_config_t;
+
+/**
+ * @brief Allocate memory and initialize file logger component with rotation and buffering configuration
+ *
+ * The function to allocate memory and initialize file logger component. The logger component logs messages to a file,
+ * rotating the file when it exceeds a configured size or age. Periodic flushes are made when records are logged
+ * and, for an asynchronous logger, by the writer thread when idle. A synchronous logger only flushes when records
+ * are logged, so buffered records may remain unwritten during a quiet period. Rotation is deferred while a previously
+ * rotated file is still being compressed. A rotated file that could not be compressed is retained uncompressed.
+ *
+ * @param name        Identifier to use for logging
+ * @param level       Log level
+ * @param self_start  'true' will start the logger after initialization
+ * @param next        Another logger component, this logger component must be pre-initialized. May be NULL
+ * @param pathname    File and location of the logfile
+ * @param config      File logger configuration, NULL for defaults
+ * @return            Pointer to the logger component created
+ */
+extern iot_logger_t * iot_logger_alloc_file_with_config (const char * name, iot_loglevel_t level, bool self_start, iot_logger_t * next, const char *pathname, const iot_logger_file_config_t * config);
 #endif
 
 /**
@@ -173,6 +234,35 @@ extern void iot_log__log (iot_logger_t * logger, iot_loglevel_t level, const cha
  */
 extern void iot_log__va_log (iot_logger_t * logger, iot_loglevel_t level, const char* fmt, va_list args);
 
+/**
+ * @brief Log message with a specified log level and structured logging fields
+ *
+ * @param logger  Pointer to the logger component
+ * @param level   Log level for this entry
+ * @param fields  Map of string keys to field values, included in the log record. May be NULL. Must not be modified once logged.
+ * @param fmt     Formatted string for logging
+ * @param ...     Parameters for fmt
+ */
+extern void iot_log__log_fields (iot_logger_t * logger, iot_loglevel_t level, const iot_data_t * fields, const char *fmt, ...)  __attribute__ ((format (printf, 4, 5)));
+
+/**
+ * @brief Log message format string and arguments with a specified log level and structured logging fields
+ *
+ * @param logger  Pointer to the logger component
+ * @param level   Log level for this entry
+ * @param fields  Map of string keys to field values, included in the log record. May be NULL. Must not be modified once logged.
+ * @param fmt     Format string for logging
+ * @param args    va list arguments for logging
+ */
+extern void iot_log__va_log_fields (iot_logger_t * logger, iot_loglevel_t level, const iot_data_t * fields, const char* fmt, va_list args);
+
+/**
+ * @brief Get the structured logging fields of the record being logged. For use by custom log implementation functions.
+ *
+ * @return  Map of fields for the record being logged, NULL if none
+ */
+extern const iot_data_t * iot_logger_record_fields (void);
+
 /** Log trace macro */
 #define iot_log_trace(l,...) if ((l) && (l)->level >= IOT_LOG_TRACE) iot_log__log ((l), IOT_LOG_TRACE, __VA_ARGS__)
 /** Log info macro */
@@ -185,6 +275,8 @@ extern void iot_log__va_log (iot_logger_t * logger, iot_loglevel_t level, const
 #define iot_log_error(l,...) if ((l) && (l)->level >= IOT_LOG_ERROR) iot_log__log ((l), IOT_LOG_ERROR, __VA_ARGS__)
 /** Log macro */
 #define iot_log_log(l,lv,...) if ((l) && (l)->level >= (lv)) iot_log__log ((l), (lv), __VA_ARGS__)
+/** Log with fields macro */
+#define iot_log_fields(l,lv,f,...) if ((l) && (l)->level >= (lv)) iot_log__log_fields ((l), (lv), (f), __VA_ARGS__)
 
 /**
  * @brief  Set log level for the logger
@@ -194,6 +286,34 @@ extern void iot_log__va_log (iot_logger_t * logger, iot_loglevel_t level, const
  */
 extern void iot_logger_set_level (iot_logger_t *logger, iot_loglevel_t level);
 
+/**
+ * @brief  Set output format for the logger
+ *
+ * @param logger  Pointer to the logger
+ * @param format  Log output format
+ */
+extern void iot_logger_set_format (iot_logger_t *logger, iot_log_format_t format);
+
+/**
+ * @brief  Set rate limiting and repeat suppression for the logger
+ *
+ * Rate limiting restricts the number of records logged from each call site (identified by format string)
+ * per interval, the number of records dropped being logged once the call site next logs after the interval.
+ * Rate limited records are dropped before being formatted. Up to 256 active call sites are tracked, beyond
+ * which the least recently active site is evicted, logging its count of dropped records. Repeat suppression
+ * drops records whose message and level are the same as the last record logged within the interval, logging
+ * "Last message repeated N times" when a different message is next logged. An asynchronous logger also logs
+ * these counts from its writer thread when idle once the interval has expired, whereas a synchronous logger
+ * only logs them when a later record is logged. Limits may be changed while the logger is in use, any pending
+ * counts being discarded.
+ *
+ * @param logger    Pointer to the logger
+ * @param rate      Maximum number of records per call site per interval, zero for no rate limiting
+ * @param interval  Interval in milliseconds, zero for the default of one second
+ * @param suppress  Whether to suppress repeated messages
+ */
+extern void iot_logger_set_limits (iot_logger_t *logger, uint32_t rate, uint32_t interval, bool suppress);
+
 /**
  * @brief Parse string into log level
  * @param str level string
@@ -215,6 +335,31 @@ extern const char * iot_logger_level_to_string (iot_loglevel_t level);
  */
 extern void iot_logger_set_next (iot_logger_t * logger, iot_logger_t * next);
 
+/**
+ * @brief Set asynchronous logging mode for a logger
+ *
+ * In asynchronous mode log records are added to a ring buffer and written, in batches, by a dedicated
+ * writer thread, so logging threads do not wait on the logger lock or on I/O. Records are written using
+ * the logger implementation function in the order logged. On freeing the logger any queued records are
+ * written before the writer thread exits. Formatting may be deferred to the writer thread, in which case
+ * the format string and arguments (including string arguments) are copied into the record, so need not
+ * outlive the log call. Should be set before the logger is in use. If the ring buffer
+ * cannot be allocated the logger remains synchronous.
+ *
+ * @param logger    Pointer to the logger
+ * @param size      Maximum number of queued log records (rounded up to a power of two, at most 65536). Zero restores synchronous logging
+ * @param overflow  Policy to apply when the ring buffer is full
+ */
+extern void iot_logger_set_async (iot_logger_t * logger, uint32_t size, iot_log_overflow_t overflow);
+
+/**
+ * @brief Get the number of log records dropped by an asynchronous logger
+ *
+ * @param logger  Pointer to the logger
+ * @return        Number of records dropped due to a full ring buffer, zero if the logger is synchronous
+ */
+extern uint64_t iot_logger_dropped (const iot_logger_t * logger);
+
 /**
  * @brief Create Logger component factory
  *
@@ -73,37 +73,19 @@ case ${SYSTEM} in
     chmod 0644 /iotech-iot/scripts/apk.key
     printf '%s' "PACKAGER_PRIVKEY=/iotech-iot/scripts/apk.key" >> /etc/abuild.conf
     export DEV=
-    export DEPS="yaml libcbor"
+    export DEPS="yaml"
     build_apk "${BROOT}/release" "iotech-iot-${PKG_VER}-${VER}_${OS_ARCH}"
     export DEV=-dev
     export DEPS="iotech-iot-${PKG_VER}"
     build_apk "${BROOT}/release" "iotech-iot-${PKG_VER}-${VER}_${OS_ARCH}"
     export DEV=-dbg
-    export DEPS="yaml libcbor"
+    export DEPS="yaml"
     build_apk "${BROOT}/debug" "iotech-iot-dev-${PKG_VER}-${VER}_${OS_ARCH}"
     ;;
   debian*|ubuntu*)
     OS_ARCH=$(dpkg --print-architecture)
     cd ${ROOT}/${BARCH}/release
 
-    case ${SYSTEM} in
-      ubuntu-24.04)
-        CBOR=libcbor0.10
-      ;;
-      ubuntu-22.04|debian-12)
-        CBOR=libcbor0.8
-      ;;
-      ubuntu-20.04)
-        CBOR=libcbor0.6
-      ;;
-      ubuntu-18.04)
-        CBOR=libcbor0.5
-      ;;
-      debian-10|debian-11)
-        CBOR=libcbor0
-      ;;
-    esac
-
     ${FPM} -s dir -t deb -n iotech-iot-${PKG_VER} -v "${FULL_VER}" \
       --deb-no-default-config-files --deb-changelog ../../RELEASE_NOTES.md \
       -C _CPack_Packages/Linux/TGZ/iotech-iot-${PKG_VER}-${VER}_${OS_ARCH} \
@@ -111,7 +93,7 @@ case ${SYSTEM} in
       --description "${DESC_MAIN}" \
       --vendor "IOTech" --maintainer "${MAINT_EMAIL}" \
       --exclude include --exclude docs --exclude examples \
-      --depends libyaml-0-2 --depends ${CBOR}
+      --depends libyaml-0-2
 
     ${FPM} -s dir -t deb -n iotech-iot-${PKG_VER}-dev -v "${FULL_VER}" \
       --deb-no-default-config-files --deb-changelog ../../RELEASE_NOTES.md \
@@ -132,7 +114,7 @@ case ${SYSTEM} in
       --deb-priority "optional" --category "devel" --prefix /opt/iotech/iot/${PKG_VER} \
       --description "${DESC_DBG}" \
       --vendor "IOTech" --maintainer "${MAINT_EMAIL}" \
-      --depends libyaml-0-2 --depends ${CBOR} \
+      --depends libyaml-0-2 \
       --conflicts iotech-iot-${PKG_VER} --conflicts iotech-iot-${PKG_VER}-dev
 
     rm *.tar.gz
@@ -163,17 +145,14 @@ case ${SYSTEM} in
       fedora-40)
         RPM_DIST=fc40
         YAML_DEP="libyaml"
-        CBOR_DEP="libcbor"
       ;;
       oraclelinux-9)
         RPM_DIST=el9
         YAML_DEP="libyaml"
-        CBOR_DEP="libcbor"
       ;;
       opensuse-15.*)
         FPM=fpm.ruby2.5
         YAML_DEP="libyaml-0-2"
-        CBOR_DEP="libcbor0_10"
       ;;
     esac
 
@@ -186,7 +165,7 @@ case ${SYSTEM} in
       --description "${DESC_MAIN}" \
       --vendor "IOTech" --maintainer "${MAINT_EMAIL}" \
       --exclude include --exclude docs --exclude examples \
-      --depends ${YAML_DEP} --depends ${CBOR_DEP}
+      --depends ${YAML_DEP}
 
     ${FPM} -s dir -t rpm -n iotech-iot-${PKG_VER}-dev -v "${FULL_VER}" \
       -C _CPack_Packages/Linux/TGZ/iotech-iot-${PKG_VER}-${VER}_${OS_ARCH} \
@@ -207,7 +186,7 @@ case ${SYSTEM} in
       --prefix /opt/iotech/iot/${PKG_VER} \
       --description "${DESC_DBG}" \
       --vendor "IOTech" --maintainer "${MAINT_EMAIL}" \
-      --depends ${YAML_DEP} --depends libcbor \
+      --depends ${YAML_DEP} \
       --conflicts iotech-iot-${PKG_VER} --conflicts iotech-iot-${PKG_VER}-dev
 
     rm *.tar.gz
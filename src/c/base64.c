@@ -7,9 +7,20 @@
  */
 
 #include "iot/base64.h"
+#if defined (__x86_64__) && defined (__GNUC__)
+#include <immintrin.h>
+#define IOT_B64_X86
+#elif defined (__ARM_NEON) && defined (__aarch64__)
+#include <arm_neon.h>
+#define IOT_B64_NEON
+#endif
 
 /* BASE64 encode/decode functions based on public domain code at 
  * https://en.wikibooks.org/wiki/Algorithm_Implementation/Miscellaneous/Base64
+ *
+ * Whole groups (three bytes, four symbols) are encoded and decoded in bulk, using SSSE3 or AVX2 (selected
+ * at run time) or NEON where available. Bulk decoding stops at the first group containing whitespace,
+ * padding or invalid input, which is then handled a symbol at a time.
  */
 
 #define WHITESPACE 64
@@ -49,48 +60,361 @@ size_t iot_b64_maxdecodesize (const char *in)
   return (inLen % 4) ? inLen / 4 * 3 + 2 : inLen / 4 * 3;
 }
 
-bool iot_b64_decode (const char *in, void *outv, size_t *outLen)
+/* Encodes whole groups of three bytes, returning the number of bytes encoded */
+static size_t iot_b64_encode_scalar (const uint8_t *in, size_t inLen, char *out)
+{
+  size_t i = 0;
+  for (; i + 3 <= inLen; i += 3)
+  {
+    uint32_t n = ((uint32_t) in[i]) << 16 | ((uint32_t) in[i + 1]) << 8 | in[i + 2];
+    *(out++) = enc[n >> 18];
+    *(out++) = enc[(n >> 12) & 63];
+    *(out++) = enc[(n >> 6) & 63];
+    *(out++) = enc[n & 63];
+  }
+  return i;
+}
+
+/* Decodes whole groups of four symbols up to the first group containing whitespace, padding or
+ * invalid input, returning the number of characters decoded
+ */
+static size_t iot_b64_decode_scalar (const char *in, size_t inLen, uint8_t *out)
+{
+  size_t i = 0;
+  for (; i + 4 <= inLen; i += 4)
+  {
+    uint32_t a = dec[(unsigned char) in[i]];
+    uint32_t b = dec[(unsigned char) in[i + 1]];
+    uint32_t c = dec[(unsigned char) in[i + 2]];
+    uint32_t d = dec[(unsigned char) in[i + 3]];
+    if ((a | b | c | d) > 63) break;
+    uint32_t n = a << 18 | b << 12 | c << 6 | d;
+    *(out++) = (n >> 16) & 255;
+    *(out++) = (n >> 8) & 255;
+    *(out++) = n & 255;
+  }
+  return i;
+}
+
+#ifdef IOT_B64_X86
+/* Encoding and decoding follow W. Mula and D. Lemire, "Faster Base64 Encoding and Decoding Using AVX2 Instructions" */
+
+__attribute__((target ("ssse3"))) static size_t iot_b64_encode_ssse3 (const uint8_t *in, size_t inLen, char *out)
 {
+  const __m128i shuffle = _mm_set_epi8 (10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+  const __m128i offsets = _mm_setr_epi8 ('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+  size_t i = 0;
+  for (; i + 16 <= inLen; i += 12) // Loads sixteen bytes, encodes twelve
+  {
+    __m128i v = _mm_shuffle_epi8 (_mm_loadu_si128 ((const __m128i*) (in + i)), shuffle);
+    __m128i hi = _mm_mulhi_epu16 (_mm_and_si128 (v, _mm_set1_epi32 (0x0fc0fc00)), _mm_set1_epi32 (0x04000040));
+    __m128i lo = _mm_mullo_epi16 (_mm_and_si128 (v, _mm_set1_epi32 (0x003f03f0)), _mm_set1_epi32 (0x01000010));
+    __m128i idx = _mm_or_si128 (hi, lo); // Six bit values
+    __m128i r = _mm_subs_epu8 (idx, _mm_set1_epi8 (51));
+    r = _mm_or_si128 (r, _mm_and_si128 (_mm_cmpgt_epi8 (_mm_set1_epi8 (26), idx), _mm_set1_epi8 (13)));
+    _mm_storeu_si128 ((__m128i*) out, _mm_add_epi8 (idx, _mm_shuffle_epi8 (offsets, r)));
+    out += 16;
+  }
+  return i;
+}
+
+__attribute__((target ("ssse3"))) static size_t iot_b64_decode_ssse3 (const char *in, size_t inLen, uint8_t *out)
+{
+  const __m128i shuffle = _mm_setr_epi8 (2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+  size_t i = 0;
+  for (; i + 16 <= inLen; i += 16)
+  {
+    __m128i v = _mm_loadu_si128 ((const __m128i*) (in + i));
+    __m128i upper = _mm_and_si128 (_mm_cmpgt_epi8 (v, _mm_set1_epi8 ('A' - 1)), _mm_cmpgt_epi8 (_mm_set1_epi8 ('Z' + 1), v));
+    __m128i lower = _mm_and_si128 (_mm_cmpgt_epi8 (v, _mm_set1_epi8 ('a' - 1)), _mm_cmpgt_epi8 (_mm_set1_epi8 ('z' + 1), v));
+    __m128i digit = _mm_and_si128 (_mm_cmpgt_epi8 (v, _mm_set1_epi8 ('0' - 1)), _mm_cmpgt_epi8 (_mm_set1_epi8 ('9' + 1), v));
+    __m128i plus = _mm_cmpeq_epi8 (v, _mm_set1_epi8 ('+'));
+    __m128i slash = _mm_cmpeq_epi8 (v, _mm_set1_epi8 ('/'));
+    if (_mm_movemask_epi8 (_mm_or_si128 (_mm_or_si128 (_mm_or_si128 (upper, lower), digit), _mm_or_si128 (plus, slash))) != 0xffff) break;
+    __m128i shift = _mm_or_si128 (_mm_and_si128 (upper, _mm_set1_epi8 (-'A')), _mm_and_si128 (lower, _mm_set1_epi8 (26 - 'a')));
+    shift = _mm_or_si128 (shift, _mm_and_si128 (digit, _mm_set1_epi8 (52 - '0')));
+    shift = _mm_or_si128 (shift, _mm_or_si128 (_mm_and_si128 (plus, _mm_set1_epi8 (62 - '+')), _mm_and_si128 (slash, _mm_set1_epi8 (63 - '/'))));
+    v = _mm_maddubs_epi16 (_mm_add_epi8 (v, shift), _mm_set1_epi32 (0x01400140)); // Merge symbol pairs to twelve bits
+    v = _mm_shuffle_epi8 (_mm_madd_epi16 (v, _mm_set1_epi32 (0x00011000)), shuffle); // Merge to 24 bits and pack bytes
+    _mm_storel_epi64 ((__m128i*) out, v);
+    uint32_t last = (uint32_t) _mm_cvtsi128_si32 (_mm_srli_si128 (v, 8));
+    memcpy (out + 8, &last, sizeof (last));
+    out += 12;
+  }
+  return i;
+}
+
+__attribute__((target ("avx2"))) static size_t iot_b64_encode_avx2 (const uint8_t *in, size_t inLen, char *out)
+{
+  const __m256i shuffle = _mm256_broadcastsi128_si256 (_mm_set_epi8 (10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+  const __m256i offsets = _mm256_broadcastsi128_si256 (_mm_setr_epi8 ('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0));
+  size_t i = 0;
+  for (; i + 28 <= inLen; i += 24) // Twelve bytes encoded from each of two sixteen byte loads
+  {
+    __m256i v = _mm256_inserti128_si256 (_mm256_castsi128_si256 (_mm_loadu_si128 ((const __m128i*) (in + i))), _mm_loadu_si128 ((const __m128i*) (in + i + 12)), 1);
+    v = _mm256_shuffle_epi8 (v, shuffle);
+    __m256i hi = _mm256_mulhi_epu16 (_mm256_and_si256 (v, _mm256_set1_epi32 (0x0fc0fc00)), _mm256_set1_epi32 (0x04000040));
+    __m256i lo = _mm256_mullo_epi16 (_mm256_and_si256 (v, _mm256_set1_epi32 (0x003f03f0)), _mm256_set1_epi32 (0x01000010));
+    __m256i idx = _mm256_or_si256 (hi, lo);
+    __m256i r = _mm256_subs_epu8 (idx, _mm256_set1_epi8 (51));
+    r = _mm256_or_si256 (r, _mm256_and_si256 (_mm256_cmpgt_epi8 (_mm256_set1_epi8 (26), idx), _mm256_set1_epi8 (13)));
+    _mm256_storeu_si256 ((__m256i*) out, _mm256_add_epi8 (idx, _mm256_shuffle_epi8 (offsets, r)));
+    out += 32;
+  }
+  return i;
+}
+
+__attribute__((target ("avx2"))) static size_t iot_b64_decode_avx2 (const char *in, size_t inLen, uint8_t *out)
+{
+  const __m256i shuffle = _mm256_broadcastsi128_si256 (_mm_setr_epi8 (2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+  const __m256i pack = _mm256_setr_epi32 (0, 1, 2, 4, 5, 6, 3, 7);
+  size_t i = 0;
+  for (; i + 32 <= inLen; i += 32)
+  {
+    __m256i v = _mm256_loadu_si256 ((const __m256i*) (in + i));
+    __m256i upper = _mm256_and_si256 (_mm256_cmpgt_epi8 (v, _mm256_set1_epi8 ('A' - 1)), _mm256_cmpgt_epi8 (_mm256_set1_epi8 ('Z' + 1), v));
+    __m256i lower = _mm256_and_si256 (_mm256_cmpgt_epi8 (v, _mm256_set1_epi8 ('a' - 1)), _mm256_cmpgt_epi8 (_mm256_set1_epi8 ('z' + 1), v));
+    __m256i digit = _mm256_and_si256 (_mm256_cmpgt_epi8 (v, _mm256_set1_epi8 ('0' - 1)), _mm256_cmpgt_epi8 (_mm256_set1_epi8 ('9' + 1), v));
+    __m256i plus = _mm256_cmpeq_epi8 (v, _mm256_set1_epi8 ('+'));
+    __m256i slash = _mm256_cmpeq_epi8 (v, _mm256_set1_epi8 ('/'));
+    if ((uint32_t) _mm256_movemask_epi8 (_mm256_or_si256 (_mm256_or_si256 (_mm256_or_si256 (upper, lower), digit), _mm256_or_si256 (plus, slash))) != 0xffffffffu) break;
+    __m256i shift = _mm256_or_si256 (_mm256_and_si256 (upper, _mm256_set1_epi8 (-'A')), _mm256_and_si256 (lower, _mm256_set1_epi8 (26 - 'a')));
+    shift = _mm256_or_si256 (shift, _mm256_and_si256 (digit, _mm256_set1_epi8 (52 - '0')));
+    shift = _mm256_or_si256 (shift, _mm256_or_si256 (_mm256_and_si256 (plus, _mm256_set1_epi8 (62 - '+')), _mm256_and_si256 (slash, _mm256_set1_epi8 (63 - '/'))));
+    v = _mm256_maddubs_epi16 (_mm256_add_epi8 (v, shift), _mm256_set1_epi32 (0x01400140));
+    v = _mm256_shuffle_epi8 (_mm256_madd_epi16 (v, _mm256_set1_epi32 (0x00011000)), shuffle);
+    v = _mm256_permutevar8x32_epi32 (v, pack); // Twelve bytes from each lane, made contiguous
+    _mm_storeu_si128 ((__m128i*) out, _mm256_castsi256_si128 (v));
+    _mm_storel_epi64 ((__m128i*) (out + 16), _mm256_extracti128_si256 (v, 1));
+    out += 24;
+  }
+  return i;
+}
+#endif
+
+#ifdef IOT_B64_NEON
+static size_t iot_b64_encode_neon (const uint8_t *in, size_t inLen, char *out)
+{
+  const uint8x16x4_t table = {{ vld1q_u8 ((const uint8_t*) enc), vld1q_u8 ((const uint8_t*) enc + 16), vld1q_u8 ((const uint8_t*) enc + 32), vld1q_u8 ((const uint8_t*) enc + 48) }};
+  const uint8x16_t mask = vdupq_n_u8 (63);
+  size_t i = 0;
+  for (; i + 48 <= inLen; i += 48)
+  {
+    uint8x16x3_t v = vld3q_u8 (in + i); // Deinterleaved bytes of sixteen groups
+    uint8x16x4_t r;
+    r.val[0] = vqtbl4q_u8 (table, vshrq_n_u8 (v.val[0], 2));
+    r.val[1] = vqtbl4q_u8 (table, vandq_u8 (vorrq_u8 (vshlq_n_u8 (v.val[0], 4), vshrq_n_u8 (v.val[1], 4)), mask));
+    r.val[2] = vqtbl4q_u8 (table, vandq_u8 (vorrq_u8 (vshlq_n_u8 (v.val[1], 2), vshrq_n_u8 (v.val[2], 6)), mask));
+    r.val[3] = vqtbl4q_u8 (table, vandq_u8 (v.val[2], mask));
+    vst4q_u8 ((uint8_t*) out, r);
+    out += 64;
+  }
+  return i;
+}
+
+static size_t iot_b64_decode_neon (const char *in, size_t inLen, uint8_t *out)
+{
+  const uint8x16x4_t lower = {{ vld1q_u8 (dec), vld1q_u8 (dec + 16), vld1q_u8 (dec + 32), vld1q_u8 (dec + 48) }};
+  const uint8x16x4_t upper = {{ vld1q_u8 (dec + 64), vld1q_u8 (dec + 80), vld1q_u8 (dec + 96), vld1q_u8 (dec + 112) }};
+  const uint8x16_t offset = vdupq_n_u8 (64);
+  size_t i = 0;
+  for (; i + 64 <= inLen; i += 64)
+  {
+    uint8x16x4_t v = vld4q_u8 ((const uint8_t*) (in + i)); // Deinterleaved symbols of sixteen groups
+    uint8x16_t check = vorrq_u8 (vorrq_u8 (v.val[0], v.val[1]), vorrq_u8 (v.val[2], v.val[3]));
+    for (unsigned j = 0; j < 4; j++)
+    {
+      v.val[j] = vqtbx4q_u8 (vqtbl4q_u8 (lower, v.val[j]), upper, vsubq_u8 (v.val[j], offset));
+    }
+    uint8x16_t values = vorrq_u8 (vorrq_u8 (v.val[0], v.val[1]), vorrq_u8 (v.val[2], v.val[3]));
+    if (vmaxvq_u8 (check) > 127 || vmaxvq_u8 (values) > 63) break; // Non ASCII, whitespace, padding or invalid
+    uint8x16x3_t r;
+    r.val[0] = vorrq_u8 (vshlq_n_u8 (v.val[0], 2), vshrq_n_u8 (v.val[1], 4));
+    r.val[1] = vorrq_u8 (vshlq_n_u8 (v.val[1], 4), vshrq_n_u8 (v.val[2], 2));
+    r.val[2] = vorrq_u8 (vshlq_n_u8 (v.val[2], 6), v.val[3]);
+    vst3q_u8 (out, r);
+    out += 48;
+  }
+  return i;
+}
+
+static size_t (*iot_b64_encode_fn) (const uint8_t *in, size_t inLen, char *out) = iot_b64_encode_neon;
+static size_t (*iot_b64_decode_fn) (const char *in, size_t inLen, uint8_t *out) = iot_b64_decode_neon;
+#else
+static size_t (*iot_b64_encode_fn) (const uint8_t *in, size_t inLen, char *out) = iot_b64_encode_scalar;
+static size_t (*iot_b64_decode_fn) (const char *in, size_t inLen, uint8_t *out) = iot_b64_decode_scalar;
+#endif
+
+#ifdef IOT_B64_X86
+__attribute__((constructor)) static void iot_b64_init (void)
+{
+  __builtin_cpu_init ();
+  if (__builtin_cpu_supports ("avx2"))
+  {
+    iot_b64_encode_fn = iot_b64_encode_avx2;
+    iot_b64_decode_fn = iot_b64_decode_avx2;
+  }
+  else if (__builtin_cpu_supports ("ssse3"))
+  {
+    iot_b64_encode_fn = iot_b64_encode_ssse3;
+    iot_b64_decode_fn = iot_b64_decode_ssse3;
+  }
+}
+#endif
+
+static size_t iot_b64_encode_blocks (const uint8_t *in, size_t inLen, char *out)
+{
+  size_t n = iot_b64_encode_fn (in, inLen, out);
+  return n + iot_b64_encode_scalar (in + n, inLen - n, out + n / 3 * 4);
+}
+
+static size_t iot_b64_decode_blocks (const char *in, size_t inLen, uint8_t *out)
+{
+  size_t n = iot_b64_decode_fn (in, inLen, out);
+  return n + iot_b64_decode_scalar (in + n, inLen - n, out + n / 4 * 3);
+}
+
+void iot_b64_encoder_init (iot_b64_encoder_t *state)
+{
+  assert (state);
+  state->count = 0;
+}
+
+size_t iot_b64_encode_update (iot_b64_encoder_t *state, const void *in, size_t inLen, char *out)
+{
+  assert (state && (in || inLen == 0) && out);
+  const uint8_t *data = (const uint8_t *) in;
+  size_t len = 0;
+
+  /* Complete a group started by a previous chunk */
+
+  while (state->count && inLen)
+  {
+    state->pending[state->count++] = *(data++);
+    inLen--;
+    if (state->count == 3)
+    {
+      len += iot_b64_encode_scalar (state->pending, 3, out) / 3 * 4;
+      state->count = 0;
+    }
+  }
+  size_t n = iot_b64_encode_blocks (data, inLen, out + len);
+  len += n / 3 * 4;
+
+  /* Hold any trailing one or two bytes for the next chunk */
+
+  memcpy (state->pending + state->count, data + n, inLen - n);
+  state->count += (uint8_t) (inLen - n);
+  return len;
+}
+
+size_t iot_b64_encode_final (iot_b64_encoder_t *state, char *out)
+{
+  assert (state && out);
+  size_t len = 0;
+  if (state->count)
+  {
+    uint32_t n = ((uint32_t) state->pending[0]) << 16;
+    if (state->count == 2)
+    {
+      n += ((uint32_t) state->pending[1]) << 8;
+    }
+    out[len++] = enc[n >> 18];
+    out[len++] = enc[(n >> 12) & 63];
+    out[len++] = (state->count == 2) ? enc[(n >> 6) & 63] : '=';
+    out[len++] = '=';
+    state->count = 0;
+  }
+  return len;
+}
+
+void iot_b64_decoder_init (iot_b64_decoder_t *state)
+{
+  assert (state);
+  state->buf = 0;
+  state->count = 0;
+  state->end = false;
+}
+
+bool iot_b64_decode_update (iot_b64_decoder_t *state, const char *in, size_t inLen, void *outv, size_t *outLen)
+{
+  assert (state && (in || inLen == 0) && outv && outLen);
   uint8_t *out = (uint8_t *) outv;
-  int iter = 0;
-  uint32_t buf = 0;
+  const char *end = in + inLen;
   size_t len = 0;
+  bool bulk = true;
 
-  while (*in)
+  while (in < end && !state->end)
   {
+    /* Decode whole groups in bulk at the start of input or a group, and after whitespace */
+
+    if (bulk && state->count == 0)
+    {
+      size_t n = (size_t) (end - in);
+      size_t max = (*outLen - len) / 3 * 4;
+      n = iot_b64_decode_blocks (in, (n < max) ? n : max, out);
+      in += n;
+      out += n / 4 * 3;
+      len += n / 4 * 3;
+      bulk = false;
+      if (in == end) break;
+    }
+
     unsigned char c = dec[(unsigned char) (*in++)];
 
-    if (c == WHITESPACE) continue;   // skip whitespace
-    if (c == INVALID) return false;  // invalid input, return error
-    if (c == EQUALS) break;          // pad character, end of data
+    if (c == WHITESPACE) { bulk = true; continue; } // skip whitespace
+    if (c == INVALID) return false;                    // invalid input, return error
+    if (c == EQUALS) { state->end = true; break; }     // pad character, end of data
 
-    buf = buf << 6 | c;
+    state->buf = state->buf << 6 | c;
 
     /* Every four symbols we will have filled the buffer. Split it into bytes */
 
-    if (++iter == 4)
+    if (++state->count == 4)
     {
       if ((len += 3) > *outLen) { return false; } // buffer overflow
-      *(out++) = (buf >> 16) & 255;
-      *(out++) = (buf >> 8) & 255;
-      *(out++) = buf & 255;
-      buf = 0;
-      iter = 0;
+      *(out++) = (state->buf >> 16) & 255;
+      *(out++) = (state->buf >> 8) & 255;
+      *(out++) = state->buf & 255;
+      state->buf = 0;
+      state->count = 0;
     }
   }
-  if (iter == 3)
+  *outLen = len; // modify outLen to reflect the actual output size
+  return true;
+}
+
+bool iot_b64_decode_final (iot_b64_decoder_t *state, void *outv, size_t *outLen)
+{
+  assert (state && outv && outLen);
+  uint8_t *out = (uint8_t *) outv;
+  size_t len = 0;
+
+  if (state->count == 3)
   {
     if ((len += 2) > *outLen) { return false; } // buffer overflow
-    *(out++) = (buf >> 10) & 255;
-    *(out++) = (buf >> 2) & 255;
+    *(out++) = (state->buf >> 10) & 255;
+    *(out++) = (state->buf >> 2) & 255;
   }
-  else if (iter == 2)
+  else if (state->count == 2)
   {
     if (++len > *outLen) { return false; } // buffer overflow
-    *(out++) = (buf >> 4) & 255;
+    *(out++) = (state->buf >> 4) & 255;
   }
+  iot_b64_decoder_init (state);
+  *outLen = len;
+  return true;
+}
 
-  *outLen = len; // modify outLen to reflect the actual output size
+bool iot_b64_decode (const char *in, void *outv, size_t *outLen)
+{
+  iot_b64_decoder_t state;
+  size_t len = *outLen;
+  iot_b64_decoder_init (&state);
+  if (!iot_b64_decode_update (&state, in, strlen (in), outv, &len)) return false;
+  size_t tail = *outLen - len;
+  if (!iot_b64_decode_final (&state, (uint8_t *) outv + len, &tail)) return false;
+  *outLen = len + tail; // modify outLen to reflect the actual output size
   return true;
 }
 
@@ -99,54 +423,13 @@ bool iot_b64_encode (const void *in, size_t inLen, char *out, size_t outLen)
   bool ok = outLen >= iot_b64_encodesize (inLen);
   if (ok)
   {
-    const uint8_t *data = (const uint8_t *) in;
-    size_t resultIndex = 0;
-
-    /* iterate over the length of the string, three characters at a time */
-    for (size_t x = 0; x < inLen; x += 3)
-    {
-      /* combine up to three bytes into 24 bits */
-      uint32_t n = ((uint32_t) data[x]) << 16;
-      if ((x + 1) < inLen)
-      {
-        n += ((uint32_t) data[x + 1]) << 8;
-      }
-      if ((x + 2) < inLen)
-      {
-        n += data[x + 2];
-      }
-
-      /* split into four 6-bit numbers */
-      uint8_t n0 = (uint8_t) (n >> 18) & 63;
-      uint8_t n1 = (uint8_t) (n >> 12) & 63;
-      uint8_t n2 = (uint8_t) (n >> 6) & 63;
-      uint8_t n3 = (uint8_t) n & 63;
-
-      /* One byte -> two characters */
-      out[resultIndex++] = enc[n0];
-      out[resultIndex++] = enc[n1];
-
-      /* Two bytes -> three characters */
-      if ((x + 1) < inLen)
-      {
-        out[resultIndex++] = enc[n2];
-      }
-
-      /* Three bytes -> four characters */
-      if ((x + 2) < inLen)
-      {
-        out[resultIndex++] = enc[n3];
-      }
-    }
-
-    /* Pad to multiple of four characters */
-    while (resultIndex % 4)
-    {
-      out[resultIndex++] = '=';
-    }
+    iot_b64_encoder_t state;
+    iot_b64_encoder_init (&state);
+    size_t len = iot_b64_encode_update (&state, in, inLen, out);
+    len += iot_b64_encode_final (&state, out + len);
 
     /* Terminate string */
-    out[resultIndex] = 0;
+    out[len] = 0;
   }
   return ok;
 }
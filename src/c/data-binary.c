@@ -0,0 +1,667 @@
+//
+// Copyright (c) 2023 IOTech
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+#include "iot/data.h"
+#include "iot/hash.h"
+#include "data-impl.h"
+#if defined (IOT_HAS_FILE) && ! defined (_AZURESPHERE_)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/* Native binary serialisation of iot_data, preserving all data types. Layout (version 2):
+ *
+ * Header:  "IOTD" magic, version byte
+ * Value:   Tag byte (bits 0-4 data type, bit 5 metadata present, bit 6 ordered map), metadata map
+ *          value if present, then the type specific payload:
+ *
+ *   Integers, floats  Fixed width, little endian
+ *   Bool              One byte, 0 or 1
+ *   Null, pointer     None (pointers are serialised as null)
+ *   String            Varint (length << 1) followed by the characters and a terminating nul, or
+ *                     varint ((index << 1) | 1) referencing an earlier string in the string table
+ *   Binary            Varint length, bytes
+ *   Array             Element type byte, varint length, elements as a little endian block
+ *   Vector, list      Element type byte, varint length, values (list values head first)
+ *   Map               Key type byte, element type byte, varint size, key and value pairs
+ *
+ * Empty vector slots are serialised as an IOT_DATA_INVALID tag. Strings of up to 64 characters
+ * without metadata are added to the string table when first serialised, so repeated map keys
+ * and values are only serialised once. Varints are unsigned LEB128. As strings are nul terminated,
+ * a file image can be memory mapped and strings referenced in place rather than copied. Only data
+ * of the current version is deserialised.
+ */
+
+#define IOT_BINARY_VERSION 2u
+#define IOT_BINARY_HEADER_SIZE 5u
+#define IOT_BINARY_BUFF_SIZE 512u
+#define IOT_BINARY_TABLE_SIZE 64u
+#define IOT_BINARY_MAX_STRING 64u
+#define IOT_BINARY_MAX_DEPTH 512u
+#define IOT_BINARY_META 0x20u
+#define IOT_BINARY_ORDERED 0x40u
+#define IOT_BINARY_TYPE_MASK 0x1fu
+
+/* Conversion between host and (serialised) little endian byte order */
+#if defined (__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+#define IOT_BINARY_LE16(v) __builtin_bswap16 (v)
+#define IOT_BINARY_LE32(v) __builtin_bswap32 (v)
+#define IOT_BINARY_LE64(v) __builtin_bswap64 (v)
+#else
+#define IOT_BINARY_HOST_LE
+#define IOT_BINARY_LE16(v) (v)
+#define IOT_BINARY_LE32(v) (v)
+#define IOT_BINARY_LE64(v) (v)
+#endif
+
+static const uint8_t iot_binary_magic [4] = { 'I', 'O', 'T', 'D' };
+static const uint8_t iot_binary_sizes [] = { 1u, 1u, 2u, 2u, 4u, 4u, 8u, 8u, 4u, 8u, 1u };
+
+typedef struct iot_binary_string_t
+{
+  const char * str;                   // String (NULL if slot unused)
+  size_t len;                         // String length
+  uint32_t hash;                      // String hash
+  uint32_t index;                     // String table index
+} iot_binary_string_t;
+
+typedef struct iot_binary_writer_t
+{
+  uint8_t * data;                     // Output buffer
+  size_t size;                        // Output buffer size
+  size_t len;                         // Output length
+  iot_binary_string_t * table;        // String table, open addressed hash
+  uint32_t capacity;                  // String table capacity, a power of two
+  uint32_t count;                     // Number of strings in table
+} iot_binary_writer_t;
+
+static void iot_binary_grow (iot_binary_writer_t * writer, size_t required)
+{
+  while (writer->size < writer->len + required) writer->size *= 2u;
+  writer->data = realloc (writer->data, writer->size);
+}
+
+static inline uint8_t * iot_binary_reserve (iot_binary_writer_t * writer, size_t required)
+{
+  if (writer->size < writer->len + required) iot_binary_grow (writer, required);
+  return writer->data + writer->len;
+}
+
+static inline void iot_binary_write_byte (iot_binary_writer_t * writer, uint8_t val)
+{
+  *iot_binary_reserve (writer, 1u) = val;
+  writer->len++;
+}
+
+static void iot_binary_write_bytes (iot_binary_writer_t * writer, const void * data, size_t len)
+{
+  if (len)
+  {
+    memcpy (iot_binary_reserve (writer, len), data, len);
+    writer->len += len;
+  }
+}
+
+static void iot_binary_write_varint (iot_binary_writer_t * writer, uint64_t val)
+{
+  uint8_t * ptr = iot_binary_reserve (writer, 10u);
+  uint8_t * start = ptr;
+  while (val >= 0x80u)
+  {
+    *ptr++ = (uint8_t) (val | 0x80u);
+    val >>= 7;
+  }
+  *ptr++ = (uint8_t) val;
+  writer->len += (size_t) (ptr - start);
+}
+
+/* Writes a fixed width value of a basic type, little endian */
+static void iot_binary_write_scalar (iot_binary_writer_t * writer, const void * ptr, iot_data_type_t type)
+{
+  uint8_t * dst = iot_binary_reserve (writer, 8u);
+  switch (iot_binary_sizes[type])
+  {
+    case 1u: *dst = (type == IOT_DATA_BOOL) ? (*(const bool*) ptr ? 1u : 0u) : *(const uint8_t*) ptr; break;
+    case 2u: { uint16_t v; memcpy (&v, ptr, 2u); v = IOT_BINARY_LE16 (v); memcpy (dst, &v, 2u); break; }
+    case 4u: { uint32_t v; memcpy (&v, ptr, 4u); v = IOT_BINARY_LE32 (v); memcpy (dst, &v, 4u); break; }
+    default: { uint64_t v; memcpy (&v, ptr, 8u); v = IOT_BINARY_LE64 (v); memcpy (dst, &v, 8u); break; }
+  }
+  writer->len += iot_binary_sizes[type];
+}
+
+static void iot_binary_write_array (iot_binary_writer_t * writer, const void * data, uint32_t length, iot_data_type_t type)
+{
+  size_t width = iot_binary_sizes[type];
+#ifdef IOT_BINARY_HOST_LE
+  if (type != IOT_DATA_BOOL)
+  {
+    iot_binary_write_bytes (writer, data, width * length);
+    return;
+  }
+#endif
+  iot_binary_reserve (writer, width * length);
+  for (uint32_t i = 0; i < length; i++) iot_binary_write_scalar (writer, (const uint8_t*) data + i * width, type);
+}
+
+/* Returns the string table index of a string, or adds the string to the table and returns UINT32_MAX */
+static uint32_t iot_binary_intern (iot_binary_writer_t * writer, const char * str, size_t len)
+{
+  if (writer->count * 2u >= writer->capacity)
+  {
+    iot_binary_string_t * old = writer->table;
+    uint32_t capacity = writer->capacity;
+    writer->capacity = capacity ? capacity * 2u : IOT_BINARY_TABLE_SIZE;
+    writer->table = calloc (writer->capacity, sizeof (*writer->table));
+    for (uint32_t i = 0; i < capacity; i++)
+    {
+      if (old[i].str)
+      {
+        uint32_t slot = old[i].hash & (writer->capacity - 1u);
+        while (writer->table[slot].str) slot = (slot + 1u) & (writer->capacity - 1u);
+        writer->table[slot] = old[i];
+      }
+    }
+    free (old);
+  }
+  uint32_t hash = iot_hash_data ((const uint8_t*) str, len);
+  uint32_t slot = hash & (writer->capacity - 1u);
+  while (writer->table[slot].str)
+  {
+    const iot_binary_string_t * entry = &writer->table[slot];
+    if (entry->hash == hash && entry->len == len && memcmp (entry->str, str, len) == 0) return entry->index;
+    slot = (slot + 1u) & (writer->capacity - 1u);
+  }
+  writer->table[slot] = (iot_binary_string_t) { .str = str, .len = len, .hash = hash, .index = writer->count++ };
+  return UINT32_MAX;
+}
+
+static void iot_binary_write_value (iot_binary_writer_t * writer, const iot_data_t * data)
+{
+  data = iot_data_lazy_value (data); // Lazy values are decoded
+  iot_data_type_t type = (data->type == IOT_DATA_POINTER) ? IOT_DATA_NULL : data->type;
+  uint8_t tag = (uint8_t) type;
+  if (data->base.meta && ! data->constant) tag |= IOT_BINARY_META;
+  if (type == IOT_DATA_MAP && iot_data_map_is_ordered (data)) tag |= IOT_BINARY_ORDERED;
+  iot_binary_write_byte (writer, tag);
+  if (tag & IOT_BINARY_META) iot_binary_write_value (writer, data->base.meta);
+
+  switch (type)
+  {
+    case IOT_DATA_NULL: break;
+    case IOT_DATA_STRING:
+    {
+      const char * str = iot_data_string (data);
+      size_t len = strlen (str);
+      if (len <= IOT_BINARY_MAX_STRING && ! (tag & IOT_BINARY_META))
+      {
+        uint32_t index = iot_binary_intern (writer, str, len);
+        if (index != UINT32_MAX)
+        {
+          iot_binary_write_varint (writer, ((uint64_t) index << 1) | 1u);
+          break;
+        }
+      }
+      iot_binary_write_varint (writer, (uint64_t) len << 1);
+      iot_binary_write_bytes (writer, str, len + 1u); // Including terminator
+      break;
+    }
+    case IOT_DATA_BINARY:
+      iot_binary_write_varint (writer, iot_data_array_size (data));
+      iot_binary_write_bytes (writer, iot_data_address (data), iot_data_array_size (data));
+      break;
+    case IOT_DATA_ARRAY:
+      iot_binary_write_byte (writer, (uint8_t) iot_data_array_type (data));
+      iot_binary_write_varint (writer, iot_data_array_length (data));
+      iot_binary_write_array (writer, iot_data_address (data), iot_data_array_length (data), iot_data_array_type (data));
+      break;
+    case IOT_DATA_VECTOR:
+    {
+      uint32_t size = iot_data_vector_size (data);
+      iot_binary_write_byte (writer, (uint8_t) iot_data_vector_type (data));
+      iot_binary_write_varint (writer, size);
+      for (uint32_t i = 0; i < size; i++)
+      {
+        const iot_data_t * value = iot_data_vector_get (data, i);
+        if (value)
+        {
+          iot_binary_write_value (writer, value);
+        }
+        else
+        {
+          iot_binary_write_byte (writer, IOT_DATA_INVALID);
+        }
+      }
+      break;
+    }
+    case IOT_DATA_LIST:
+    {
+      iot_data_list_iter_t iter;
+      iot_binary_write_byte (writer, (uint8_t) iot_data_list_type (data));
+      iot_binary_write_varint (writer, iot_data_list_length (data));
+      iot_data_list_iter (data, &iter);
+      while (iot_data_list_iter_prev (&iter)) iot_binary_write_value (writer, iot_data_list_iter_value (&iter));
+      break;
+    }
+    case IOT_DATA_MAP:
+    {
+      uint32_t size = iot_data_map_size (data);
+      iot_binary_write_byte (writer, (uint8_t) iot_data_map_key_type (data));
+      iot_binary_write_byte (writer, (uint8_t) iot_data_map_type (data));
+      iot_binary_write_varint (writer, size);
+      if (tag & IOT_BINARY_ORDERED)
+      {
+        for (uint32_t i = 0; i < size; i++)
+        {
+          const iot_data_t * value;
+          iot_binary_write_value (writer, iot_data_map_ordered_key (data, i, &value));
+          iot_binary_write_value (writer, value);
+        }
+      }
+      else
+      {
+        iot_data_map_iter_t iter;
+        iot_data_map_iter (data, &iter);
+        while (iot_data_map_iter_next (&iter))
+        {
+          iot_binary_write_value (writer, iot_data_map_iter_key (&iter));
+          iot_binary_write_value (writer, iot_data_map_iter_value (&iter));
+        }
+      }
+      break;
+    }
+    case IOT_DATA_MULTI:
+    case IOT_DATA_INVALID:
+      assert (type != IOT_DATA_MULTI);
+      assert (type != IOT_DATA_INVALID);
+      break;
+    default: iot_binary_write_scalar (writer, iot_data_address (data), type); break;
+  }
+}
+
+static void iot_binary_serialise (iot_binary_writer_t * writer, const iot_data_t * data)
+{
+  iot_binary_write_bytes (writer, iot_binary_magic, sizeof (iot_binary_magic));
+  iot_binary_write_byte (writer, IOT_BINARY_VERSION);
+  iot_binary_write_value (writer, data);
+  free (writer->table);
+}
+
+iot_data_t * iot_data_serialise (const iot_data_t * data)
+{
+  assert (data);
+  iot_binary_writer_t writer = { .size = IOT_BINARY_BUFF_SIZE };
+  writer.data = malloc (writer.size);
+  iot_binary_serialise (&writer, data);
+  if (writer.len > UINT32_MAX)
+  {
+    free (writer.data);
+    return NULL;
+  }
+  return iot_data_alloc_binary (writer.data, (uint32_t) writer.len, IOT_DATA_TAKE);
+}
+
+const uint8_t * iot_data_serialise_buffer (const iot_data_t * data, iot_data_buffer_t * buffer)
+{
+  assert (data && buffer);
+  iot_binary_writer_t writer = { .data = buffer->data, .size = buffer->size };
+  iot_binary_serialise (&writer, data);
+  buffer->data = writer.data;
+  buffer->size = writer.size;
+  buffer->length = writer.len;
+  return writer.data;
+}
+
+typedef struct iot_binary_reader_t
+{
+  const uint8_t * data;               // Current position
+  const uint8_t * end;                // End of input
+  iot_data_t ** table;                // String table
+  uint32_t count;                     // Number of strings in table
+  uint32_t size;                      // String table size
+  uint32_t depth;                     // Current nesting depth
+  iot_data_t * backing;               // If set, data owning the input, referenced by strings
+} iot_binary_reader_t;
+
+static bool iot_binary_read_value (iot_binary_reader_t * reader, iot_data_t ** value);
+
+static bool iot_binary_read_varint (iot_binary_reader_t * reader, uint64_t * val)
+{
+  *val = 0u;
+  for (uint32_t shift = 0u; shift < 64u && reader->data < reader->end; shift += 7u)
+  {
+    uint8_t b = *reader->data++;
+    *val |= (uint64_t) (b & 0x7fu) << shift;
+    if (! (b & 0x80u)) return true;
+  }
+  return false;
+}
+
+/* Reads a length or count, each counted item occupying at least min bytes */
+static bool iot_binary_read_length (iot_binary_reader_t * reader, size_t min, uint32_t * len)
+{
+  uint64_t val;
+  if (! iot_binary_read_varint (reader, &val) || val > UINT32_MAX || val * min > (uint64_t) (reader->end - reader->data)) return false;
+  *len = (uint32_t) val;
+  return true;
+}
+
+static bool iot_binary_read_type (iot_binary_reader_t * reader, iot_data_type_t * type)
+{
+  if (reader->data >= reader->end || *reader->data > IOT_DATA_MULTI) return false;
+  *type = (iot_data_type_t) *reader->data++;
+  return true;
+}
+
+static void iot_binary_read_scalar (const uint8_t * src, void * dst, iot_data_type_t type)
+{
+  switch (iot_binary_sizes[type])
+  {
+    case 1u: if (type == IOT_DATA_BOOL) *(bool*) dst = (*src != 0u); else *(uint8_t*) dst = *src; break;
+    case 2u: { uint16_t v; memcpy (&v, src, 2u); v = IOT_BINARY_LE16 (v); memcpy (dst, &v, 2u); break; }
+    case 4u: { uint32_t v; memcpy (&v, src, 4u); v = IOT_BINARY_LE32 (v); memcpy (dst, &v, 4u); break; }
+    default: { uint64_t v; memcpy (&v, src, 8u); v = IOT_BINARY_LE64 (v); memcpy (dst, &v, 8u); break; }
+  }
+}
+
+static iot_data_t * iot_binary_alloc_scalar (const uint8_t * src, iot_data_type_t type)
+{
+  uint16_t v16;
+  uint32_t v32;
+  uint64_t v64;
+  switch (type)
+  {
+    case IOT_DATA_INT8: return iot_data_alloc_i8 ((int8_t) *src);
+    case IOT_DATA_UINT8: return iot_data_alloc_ui8 (*src);
+    case IOT_DATA_BOOL: return iot_data_alloc_bool (*src != 0u);
+    case IOT_DATA_INT16: memcpy (&v16, src, 2u); return iot_data_alloc_i16 ((int16_t) IOT_BINARY_LE16 (v16));
+    case IOT_DATA_UINT16: memcpy (&v16, src, 2u); return iot_data_alloc_ui16 (IOT_BINARY_LE16 (v16));
+    case IOT_DATA_INT32: memcpy (&v32, src, 4u); return iot_data_alloc_i32 ((int32_t) IOT_BINARY_LE32 (v32));
+    case IOT_DATA_UINT32: memcpy (&v32, src, 4u); return iot_data_alloc_ui32 (IOT_BINARY_LE32 (v32));
+    case IOT_DATA_INT64: memcpy (&v64, src, 8u); return iot_data_alloc_i64 ((int64_t) IOT_BINARY_LE64 (v64));
+    case IOT_DATA_UINT64: memcpy (&v64, src, 8u); return iot_data_alloc_ui64 (IOT_BINARY_LE64 (v64));
+    case IOT_DATA_FLOAT32:
+    {
+      float f;
+      memcpy (&v32, src, 4u);
+      v32 = IOT_BINARY_LE32 (v32);
+      memcpy (&f, &v32, 4u);
+      return iot_data_alloc_f32 (f);
+    }
+    default:
+    {
+      double d;
+      memcpy (&v64, src, 8u);
+      v64 = IOT_BINARY_LE64 (v64);
+      memcpy (&d, &v64, 8u);
+      return iot_data_alloc_f64 (d);
+    }
+  }
+}
+
+static bool iot_binary_read_string (iot_binary_reader_t * reader, bool meta, iot_data_t ** value)
+{
+  uint64_t val;
+  if (! iot_binary_read_varint (reader, &val)) return false;
+  if (val & 1u) // String table reference
+  {
+    if ((val >> 1) >= reader->count) return false;
+    iot_data_t * str = reader->table[val >> 1];
+    *value = meta ? iot_data_alloc_string (iot_data_string (str), IOT_DATA_COPY) : iot_data_add_ref (str);
+    return true;
+  }
+  val >>= 1;
+  if (val >= (uint64_t) (reader->end - reader->data) || reader->data[val] != '\0') return false;
+  const char * str = (const char*) reader->data; // Characters followed by terminator, so may be referenced in place
+  *value = reader->backing ? iot_data_alloc_string_view (str, (size_t) val, reader->backing) : iot_data_alloc_string_len (str, (size_t) val);
+  reader->data += val + 1u;
+  if (val <= IOT_BINARY_MAX_STRING && ! meta)
+  {
+    if (reader->count == reader->size)
+    {
+      reader->size = reader->size ? reader->size * 2u : IOT_BINARY_TABLE_SIZE;
+      reader->table = realloc (reader->table, reader->size * sizeof (*reader->table));
+    }
+    reader->table[reader->count++] = iot_data_add_ref (*value);
+  }
+  return true;
+}
+
+static bool iot_binary_read_array (iot_binary_reader_t * reader, iot_data_t ** value)
+{
+  iot_data_type_t type;
+  uint32_t length;
+  if (! iot_binary_read_type (reader, &type) || type > IOT_DATA_BOOL) return false;
+  size_t width = iot_binary_sizes[type];
+  if (! iot_binary_read_length (reader, width, &length)) return false;
+  if (length == 0u)
+  {
+    *value = iot_data_alloc_array (NULL, 0u, type, IOT_DATA_REF);
+    return true;
+  }
+  uint8_t * data = malloc (width * length);
+#ifdef IOT_BINARY_HOST_LE
+  if (type != IOT_DATA_BOOL)
+  {
+    memcpy (data, reader->data, width * length);
+  }
+  else
+#endif
+  {
+    for (uint32_t i = 0; i < length; i++) iot_binary_read_scalar (reader->data + i * width, data + i * width, type);
+  }
+  reader->data += width * length;
+  *value = iot_data_alloc_array (data, length, type, IOT_DATA_TAKE);
+  return true;
+}
+
+static bool iot_binary_read_vector (iot_binary_reader_t * reader, iot_data_t ** value)
+{
+  iot_data_type_t type;
+  uint32_t size;
+  if (! iot_binary_read_type (reader, &type) || ! iot_binary_read_length (reader, 1u, &size)) return false;
+  iot_data_t * vector = iot_data_alloc_typed_vector (size, type);
+  for (uint32_t i = 0; i < size; i++)
+  {
+    iot_data_t * elem;
+    if (reader->data < reader->end && *reader->data == IOT_DATA_INVALID)
+    {
+      reader->data++;
+      continue;
+    }
+    if (! iot_binary_read_value (reader, &elem)) goto error;
+    if (type != IOT_DATA_MULTI && elem->type != type)
+    {
+      iot_data_free (elem);
+      goto error;
+    }
+    iot_data_vector_add (vector, i, elem);
+  }
+  *value = vector;
+  return true;
+
+error:
+  iot_data_free (vector);
+  return false;
+}
+
+static bool iot_binary_read_list (iot_binary_reader_t * reader, iot_data_t ** value)
+{
+  iot_data_type_t type;
+  uint32_t length;
+  if (! iot_binary_read_type (reader, &type) || ! iot_binary_read_length (reader, 1u, &length)) return false;
+  iot_data_t * list = iot_data_alloc_typed_list (type);
+  for (uint32_t i = 0; i < length; i++)
+  {
+    iot_data_t * elem;
+    if (! iot_binary_read_value (reader, &elem)) goto error;
+    if (type != IOT_DATA_MULTI && elem->type != type)
+    {
+      iot_data_free (elem);
+      goto error;
+    }
+    iot_data_list_tail_push (list, elem);
+  }
+  *value = list;
+  return true;
+
+error:
+  iot_data_free (list);
+  return false;
+}
+
+static bool iot_binary_read_map (iot_binary_reader_t * reader, bool ordered, iot_data_t ** value)
+{
+  iot_data_type_t key_type;
+  iot_data_type_t type;
+  uint32_t size;
+  if (! iot_binary_read_type (reader, &key_type) || ! iot_binary_read_type (reader, &type) || ! iot_binary_read_length (reader, 2u, &size)) return false;
+  iot_data_t * map;
+  if (ordered)
+  {
+    map = iot_data_alloc_ordered_map (key_type);
+    map->element_type = type;
+  }
+  else
+  {
+    map = iot_data_alloc_typed_map (key_type, type);
+  }
+  for (uint32_t i = 0; i < size; i++)
+  {
+    iot_data_t * key;
+    iot_data_t * val;
+    if (! iot_binary_read_value (reader, &key)) goto error;
+    if (! iot_binary_read_value (reader, &val) || (key_type != IOT_DATA_MULTI && key->type != key_type) || (type != IOT_DATA_MULTI && val->type != type))
+    {
+      iot_data_free (key);
+      iot_data_free (val);
+      goto error;
+    }
+    iot_data_map_add (map, key, val);
+  }
+  *value = map;
+  return true;
+
+error:
+  iot_data_free (map);
+  return false;
+}
+
+static bool iot_binary_read_value (iot_binary_reader_t * reader, iot_data_t ** value)
+{
+  iot_data_t * meta = NULL;
+  iot_data_type_t type;
+  bool ok = true;
+  *value = NULL;
+  if (reader->data >= reader->end || ++reader->depth > IOT_BINARY_MAX_DEPTH) return false;
+  uint8_t tag = *reader->data++;
+  type = (iot_data_type_t) (tag & IOT_BINARY_TYPE_MASK);
+  if (type >= IOT_DATA_MULTI || (tag & 0x80u) || ((tag & IOT_BINARY_ORDERED) && type != IOT_DATA_MAP)) return false;
+  if (tag & IOT_BINARY_META)
+  {
+    if (! iot_binary_read_value (reader, &meta) || meta->type != IOT_DATA_MAP)
+    {
+      iot_data_free (meta);
+      return false;
+    }
+  }
+  switch (type)
+  {
+    case IOT_DATA_NULL: case IOT_DATA_POINTER: *value = iot_data_alloc_null (); break;
+    case IOT_DATA_STRING: ok = iot_binary_read_string (reader, meta != NULL, value); break;
+    case IOT_DATA_BINARY:
+    {
+      uint32_t len;
+      ok = iot_binary_read_length (reader, 1u, &len);
+      if (ok)
+      {
+        *value = iot_data_alloc_binary (len ? (uint8_t*) reader->data : NULL, len, IOT_DATA_COPY);
+        reader->data += len;
+      }
+      break;
+    }
+    case IOT_DATA_ARRAY: ok = iot_binary_read_array (reader, value); break;
+    case IOT_DATA_VECTOR: ok = iot_binary_read_vector (reader, value); break;
+    case IOT_DATA_LIST: ok = iot_binary_read_list (reader, value); break;
+    case IOT_DATA_MAP: ok = iot_binary_read_map (reader, (tag & IOT_BINARY_ORDERED) != 0u, value); break;
+    default:
+      ok = (size_t) (reader->end - reader->data) >= iot_binary_sizes[type];
+      if (ok)
+      {
+        *value = iot_binary_alloc_scalar (reader->data, type);
+        reader->data += iot_binary_sizes[type];
+      }
+      break;
+  }
+  if (ok && meta && ! (*value)->constant)
+  {
+    (*value)->base.meta = meta;
+    meta = NULL;
+  }
+  iot_data_free (meta);
+  reader->depth--;
+  return ok;
+}
+
+static iot_data_t * iot_binary_deserialise (const uint8_t * data, size_t size, iot_data_t * backing)
+{
+  iot_data_t * value = NULL;
+  if (size < IOT_BINARY_HEADER_SIZE || memcmp (data, iot_binary_magic, sizeof (iot_binary_magic)) || data[4] != IOT_BINARY_VERSION) return NULL;
+  iot_binary_reader_t reader = { .data = data + IOT_BINARY_HEADER_SIZE, .end = data + size, .backing = backing };
+  if (! iot_binary_read_value (&reader, &value))
+  {
+    iot_data_free (value);
+    value = NULL;
+  }
+  for (uint32_t i = 0; i < reader.count; i++) iot_data_free (reader.table[i]);
+  free (reader.table);
+  return value;
+}
+
+iot_data_t * iot_data_deserialise (const uint8_t * data, size_t size)
+{
+  assert (data || size == 0);
+  return iot_binary_deserialise (data, size, NULL);
+}
+
+#if defined (IOT_HAS_FILE) && ! defined (_AZURESPHERE_)
+typedef struct iot_binary_mapping_t
+{
+  void * addr;
+  size_t size;
+} iot_binary_mapping_t;
+
+static void iot_binary_unmap (void * ptr)
+{
+  iot_binary_mapping_t * mapping = ptr;
+  munmap (mapping->addr, mapping->size);
+  free (mapping);
+}
+
+iot_data_t * iot_data_deserialise_file (const char * path)
+{
+  iot_data_t * value = NULL;
+  struct stat st;
+  assert (path);
+  int fd = open (path, O_RDONLY);
+  if (fd == -1) return NULL;
+  if (fstat (fd, &st) == 0 && st.st_size > 0)
+  {
+    void * addr = mmap (NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (addr != MAP_FAILED)
+    {
+      iot_binary_mapping_t * mapping = malloc (sizeof (*mapping));
+      mapping->addr = addr;
+      mapping->size = (size_t) st.st_size;
+      iot_data_t * backing = iot_data_alloc_pointer (mapping, iot_binary_unmap);
+      value = iot_binary_deserialise (addr, mapping->size, backing);
+      iot_data_free (backing); // Mapping released when no longer referenced by any string
+    }
+  }
+  close (fd);
+  return value;
+}
+#endif
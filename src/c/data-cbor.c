@@ -6,36 +6,58 @@
 #include "iot/data.h"
 #include "data-impl.h"
 #include <endian.h>
-#include <cbor.h>
+#include <math.h>
 
 #define IOT_CBOR_BUFF_SIZE 512u
 #define IOT_CBOR_BUFF_DOUBLING_LIMIT 4096u
 #define IOT_CBOR_BUFF_INCREMENT 1024u
+#define IOT_CBOR_MAX_DEPTH 512u
 
 typedef struct iot_cbor_holder_t
 {
   uint8_t * data;
   size_t size;
   size_t index;
+  bool generic;           // Encode arrays as generic CBOR arrays rather than RFC 8746 typed arrays
 } iot_cbor_holder_t;
 
-static void iot_cbor_holder_check_size (iot_cbor_holder_t * holder, size_t required)
+/* RFC 8746 typed array tags for numeric array element types, with the little endian flag (4) set as
+ * required for the host byte order.
+ */
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+#define IOT_CBOR_TAG_ENDIAN 4u
+#else
+#define IOT_CBOR_TAG_ENDIAN 0u
+#endif
+
+static const uint8_t iot_cbor_array_tags [] =
+{
+  72u, 64u, 73u + IOT_CBOR_TAG_ENDIAN, 65u + IOT_CBOR_TAG_ENDIAN, 74u + IOT_CBOR_TAG_ENDIAN, 66u + IOT_CBOR_TAG_ENDIAN,
+  75u + IOT_CBOR_TAG_ENDIAN, 67u + IOT_CBOR_TAG_ENDIAN, 81u + IOT_CBOR_TAG_ENDIAN, 82u + IOT_CBOR_TAG_ENDIAN
+};
+
+static void iot_cbor_holder_grow (iot_cbor_holder_t * holder, size_t required)
 {
   size_t total = holder->index + required;
-  if (holder->size < total)
-  {
-    size_t inc = holder->size > IOT_CBOR_BUFF_DOUBLING_LIMIT ? IOT_CBOR_BUFF_INCREMENT : holder->size;
-    if (holder->size + inc < total) inc = required;
-    holder->size += inc;
-    holder->data = realloc (holder->data, holder->size);
-  }
+  size_t inc = holder->size > IOT_CBOR_BUFF_DOUBLING_LIMIT ? IOT_CBOR_BUFF_INCREMENT : holder->size;
+  if (holder->size + inc < total) inc = required;
+  holder->size += inc;
+  holder->data = realloc (holder->data, holder->size);
+}
+
+static inline void iot_cbor_holder_check_size (iot_cbor_holder_t * holder, size_t required)
+{
+  if (holder->size < holder->index + required) iot_cbor_holder_grow (holder, required);
 }
 
 static void iot_data_cbor_write_bytes (iot_cbor_holder_t * holder, const void *data, size_t length)
 {
-  iot_cbor_holder_check_size (holder, length);
-  memcpy (holder->data + holder->index, data, length);
-  holder->index += length;
+  if (length)
+  {
+    iot_cbor_holder_check_size (holder, length);
+    memcpy (holder->data + holder->index, data, length);
+    holder->index += length;
+  }
 }
 
 static void iot_data_cbor_write_uint (iot_cbor_holder_t * holder, uint64_t value, uint8_t tag)
@@ -55,21 +77,24 @@ static void iot_data_cbor_write_uint (iot_cbor_holder_t * holder, uint64_t value
   {
     iot_cbor_holder_check_size (holder, 3);
     holder->data[holder->index++] = 0x19 + tag;
-    *(uint16_t *)(holder->data + holder->index) = htobe16 (value);
+    uint16_t v = htobe16 (value);
+    memcpy (holder->data + holder->index, &v, sizeof (v));
     holder->index += 2;
   }
   else if (value <= UINT32_MAX)
   {
     iot_cbor_holder_check_size (holder, 5);
     holder->data[holder->index++] = 0x1a + tag;
-    *(uint32_t *)(holder->data + holder->index) = htobe32 (value);
+    uint32_t v = htobe32 (value);
+    memcpy (holder->data + holder->index, &v, sizeof (v));
     holder->index += 4;
   }
   else
   {
     iot_cbor_holder_check_size (holder, 9);
     holder->data[holder->index++] = 0x1b + tag;
-    *(uint64_t *)(holder->data + holder->index) = htobe64 (value);
+    uint64_t v = htobe64 (value);
+    memcpy (holder->data + holder->index, &v, sizeof (v));
     holder->index += 8;
   }
 }
@@ -79,6 +104,29 @@ static void iot_data_cbor_write_int (iot_cbor_holder_t * holder, int64_t value)
   iot_data_cbor_write_uint (holder, value < 0 ? -1 - value : value, value < 0 ? 0x20 : 0);
 }
 
+/* Floats are always written at full width, as the head width determines the float type */
+static void iot_data_cbor_write_f32 (iot_cbor_holder_t * holder, const void * ptr)
+{
+  uint32_t v;
+  memcpy (&v, ptr, sizeof (v));
+  iot_cbor_holder_check_size (holder, 5);
+  holder->data[holder->index++] = 0xfa;
+  v = htobe32 (v);
+  memcpy (holder->data + holder->index, &v, sizeof (v));
+  holder->index += 4;
+}
+
+static void iot_data_cbor_write_f64 (iot_cbor_holder_t * holder, const void * ptr)
+{
+  uint64_t v;
+  memcpy (&v, ptr, sizeof (v));
+  iot_cbor_holder_check_size (holder, 9);
+  holder->data[holder->index++] = 0xfb;
+  v = htobe64 (v);
+  memcpy (holder->data + holder->index, &v, sizeof (v));
+  holder->index += 8;
+}
+
 static void iot_data_dump_cbor_ptr (iot_cbor_holder_t * holder, const void * ptr, const iot_data_type_t type)
 {
   switch (type)
@@ -91,8 +139,8 @@ static void iot_data_dump_cbor_ptr (iot_cbor_holder_t * holder, const void * ptr
     case IOT_DATA_UINT32: iot_data_cbor_write_uint (holder, *(const uint32_t *) ptr, 0); break;
     case IOT_DATA_INT64: iot_data_cbor_write_int (holder, *(const int64_t *) ptr); break;
     case IOT_DATA_UINT64: iot_data_cbor_write_uint (holder, *(const uint64_t *) ptr, 0); break;
-    case IOT_DATA_FLOAT32: iot_data_cbor_write_uint (holder, *(const uint32_t *) ptr, 0xe0); break;
-    case IOT_DATA_FLOAT64: iot_data_cbor_write_uint (holder, *(const uint64_t *) ptr, 0xe0); break;
+    case IOT_DATA_FLOAT32: iot_data_cbor_write_f32 (holder, ptr); break;
+    case IOT_DATA_FLOAT64: iot_data_cbor_write_f64 (holder, ptr); break;
     case IOT_DATA_NULL:
       iot_cbor_holder_check_size (holder, 1); holder->data[holder->index++] = 0xf6; break;
     default:
@@ -129,27 +177,24 @@ static void iot_data_dump_cbor (iot_cbor_holder_t * holder, const iot_data_t * d
       iot_data_cbor_write_int (holder, iot_data_i64 (data));
       break;
     case IOT_DATA_FLOAT32:
-    {
-      uint32_t v;
-      float f = iot_data_f32 (data);
-      memcpy (&v, &f, sizeof (v));
-      iot_data_cbor_write_uint (holder, v, 0xe0);
+      iot_data_cbor_write_f32 (holder, iot_data_address (data));
       break;
-    }
     case IOT_DATA_FLOAT64:
-    {
-      uint64_t v;
-      double d = iot_data_f64 (data);
-      memcpy (&v, &d, sizeof (v));
-      iot_data_cbor_write_uint (holder, v, 0xe0);
+      iot_data_cbor_write_f64 (holder, iot_data_address (data));
       break;
-    }
     case IOT_DATA_BOOL:
       iot_cbor_holder_check_size (holder, 1);
       holder->data[holder->index++] = iot_data_bool (data) ? 0xf5 : 0xf4;
       break;
     case IOT_DATA_POINTER:
+    {
+      if (data->lazy) // Written verbatim unless decoded from another encoding
+      {
+        const iot_data_lazy_t * lazy = iot_data_lazy (data);
+        lazy->cbor ? iot_data_cbor_write_bytes (holder, lazy->bytes, lazy->len) : iot_data_dump_cbor (holder, iot_data_lazy_value (data));
+      }
       break;
+    }
     case IOT_DATA_STRING:
     {
       const char *str = iot_data_string (data);
@@ -170,6 +215,13 @@ static void iot_data_dump_cbor (iot_cbor_holder_t * holder, const iot_data_t * d
     {
       iot_data_array_iter_t iter;
       iot_data_type_t type = iot_data_array_type (data);
+      if (! holder->generic && type < IOT_DATA_BOOL)
+      {
+        iot_data_cbor_write_uint (holder, iot_cbor_array_tags[type], 0xc0);
+        iot_data_cbor_write_uint (holder, iot_data_array_size (data), 0x40);
+        iot_data_cbor_write_bytes (holder, iot_data_address (data), iot_data_array_size (data));
+        break;
+      }
       iot_data_cbor_write_uint (holder, iot_data_array_length (data), 0x80);
       iot_data_array_iter (data, &iter);
       while (iot_data_array_iter_next (&iter))
@@ -230,18 +282,117 @@ static void iot_data_dump_cbor (iot_cbor_holder_t * holder, const iot_data_t * d
   }
 }
 
-iot_data_t * iot_data_to_cbor (const iot_data_t * data)
+/* Measuring pass, returning the exact length of the CBOR written by iot_data_dump_cbor */
+
+static inline size_t iot_cbor_head_size (uint64_t value)
 {
-  return iot_data_to_cbor_with_size (data, IOT_CBOR_BUFF_SIZE);
+  return (value < 0x18) ? 1u : (value <= UINT8_MAX) ? 2u : (value <= UINT16_MAX) ? 3u : (value <= UINT32_MAX) ? 5u : 9u;
 }
 
-iot_data_t * iot_data_to_cbor_with_size (const iot_data_t * data, uint32_t size)
+static inline size_t iot_cbor_int_size (int64_t value)
+{
+  return iot_cbor_head_size ((uint64_t) (value < 0 ? -1 - value : value));
+}
+
+static size_t iot_cbor_ptr_size (const void * ptr, const iot_data_type_t type)
+{
+  switch (type)
+  {
+    case IOT_DATA_INT8: return iot_cbor_int_size (*(const int8_t *) ptr);
+    case IOT_DATA_UINT8: return iot_cbor_head_size (*(const uint8_t *) ptr);
+    case IOT_DATA_INT16: return iot_cbor_int_size (*(const int16_t *) ptr);
+    case IOT_DATA_UINT16: return iot_cbor_head_size (*(const uint16_t *) ptr);
+    case IOT_DATA_INT32: return iot_cbor_int_size (*(const int32_t *) ptr);
+    case IOT_DATA_UINT32: return iot_cbor_head_size (*(const uint32_t *) ptr);
+    case IOT_DATA_INT64: return iot_cbor_int_size (*(const int64_t *) ptr);
+    case IOT_DATA_UINT64: return iot_cbor_head_size (*(const uint64_t *) ptr);
+    case IOT_DATA_FLOAT32: return 5u;
+    case IOT_DATA_FLOAT64: return 9u;
+    default: return 1u;
+  }
+}
+
+static size_t iot_cbor_size (const iot_data_t * data, bool generic)
+{
+  size_t size;
+  switch (data->type)
+  {
+    case IOT_DATA_POINTER:
+      size = 0u;
+      if (data->lazy) size = iot_data_lazy (data)->cbor ? iot_data_lazy (data)->len : iot_cbor_size (iot_data_lazy_value (data), generic);
+      break;
+    case IOT_DATA_STRING:
+    {
+      size_t len = strlen (iot_data_string (data));
+      size = iot_cbor_head_size (len) + len;
+      break;
+    }
+    case IOT_DATA_BINARY:
+      size = iot_cbor_head_size (iot_data_array_size (data)) + iot_data_array_size (data);
+      break;
+    case IOT_DATA_ARRAY:
+    {
+      iot_data_array_iter_t iter;
+      iot_data_type_t type = iot_data_array_type (data);
+      if (! generic && type < IOT_DATA_BOOL)
+      {
+        size = iot_cbor_head_size (iot_cbor_array_tags[type]) + iot_cbor_head_size (iot_data_array_size (data)) + iot_data_array_size (data);
+        break;
+      }
+      size = iot_cbor_head_size (iot_data_array_length (data));
+      iot_data_array_iter (data, &iter);
+      while (iot_data_array_iter_next (&iter)) size += iot_cbor_ptr_size (iot_data_array_iter_value (&iter), type);
+      break;
+    }
+    case IOT_DATA_VECTOR:
+    {
+      iot_data_vector_iter_t iter;
+      size = iot_cbor_head_size (iot_data_vector_size (data));
+      iot_data_vector_iter (data, &iter);
+      while (iot_data_vector_iter_next (&iter)) size += iot_cbor_size (iot_data_vector_iter_value (&iter), generic);
+      break;
+    }
+    case IOT_DATA_LIST:
+    {
+      iot_data_list_iter_t iter;
+      size = iot_cbor_head_size (iot_data_list_length (data));
+      iot_data_list_iter (data, &iter);
+      while (iot_data_list_iter_next (&iter)) size += iot_cbor_size (iot_data_list_iter_value (&iter), generic);
+      break;
+    }
+    case IOT_DATA_MAP:
+    {
+      iot_data_map_iter_t iter;
+      size = iot_cbor_head_size (iot_data_map_size (data));
+      iot_data_map_iter (data, &iter);
+      while (iot_data_map_iter_next (&iter))
+      {
+        const iot_data_t * value = iot_data_map_iter_value (&iter);
+        size += iot_cbor_size (iot_data_map_iter_key (&iter), generic) + (value ? iot_cbor_size (value, generic) : 1u);
+      }
+      break;
+    }
+    default:
+      size = iot_cbor_ptr_size (iot_data_address (data), data->type);
+      break;
+  }
+  return size;
+}
+
+size_t iot_data_cbor_size (const iot_data_t * data)
+{
+  assert (data);
+  return iot_cbor_size (data, false);
+}
+
+static iot_data_t * iot_data_to_cbor_holder (const iot_data_t * data, uint32_t size, bool generic)
 {
   iot_cbor_holder_t holder;
   assert (data && size > 0);
   holder.data = malloc (size);
   holder.size = size;
   holder.index = 0;
+  holder.generic = generic;
   iot_data_dump_cbor (&holder, data);
   if (holder.index <= UINT32_MAX)
   {
@@ -254,290 +405,640 @@ iot_data_t * iot_data_to_cbor_with_size (const iot_data_t * data, uint32_t size)
   }
 }
 
-static iot_data_t *cbor_to_iot_data (const cbor_item_t *item);
+iot_data_t * iot_data_to_cbor (const iot_data_t * data)
+{
+  assert (data);
+  size_t size = iot_cbor_size (data, false); // Measure, so allocating the exact output size
+  return (size <= UINT32_MAX) ? iot_data_to_cbor_holder (data, size ? (uint32_t) size : 1u, false) : NULL;
+}
+
+iot_data_t * iot_data_to_cbor_with_typed_arrays (const iot_data_t * data, bool typed)
+{
+  assert (data);
+  size_t size = iot_cbor_size (data, ! typed);
+  return (size <= UINT32_MAX) ? iot_data_to_cbor_holder (data, size ? (uint32_t) size : 1u, ! typed) : NULL;
+}
 
-static iot_data_t *cbor_uint_to_iot_data (const cbor_item_t *item)
+const uint8_t * iot_data_to_cbor_buffer (const iot_data_t * data, iot_data_buffer_t * buffer)
 {
-  assert (cbor_is_int (item));
-  switch (cbor_int_get_width (item))
+  assert (data && buffer);
+  iot_cbor_holder_t holder = { .data = buffer->data, .size = buffer->size, .index = 0, .generic = false };
+  iot_data_dump_cbor (&holder, data);
+  buffer->data = holder.data;
+  buffer->size = holder.size;
+  buffer->length = holder.index;
+  return holder.data;
+}
+
+iot_data_t * iot_data_to_cbor_with_size (const iot_data_t * data, uint32_t size)
+{
+  return iot_data_to_cbor_holder (data, size, false);
+}
+
+/* Single pass CBOR decoder, building values directly from the encoded bytes. Unsigned and negative
+ * integers are decoded to the smallest type holding the encoded width, half precision floats as
+ * Float32, undefined as null, RFC 8746 typed arrays as arrays and other tags are ignored.
+ */
+
+typedef struct iot_cbor_decoder_t
+{
+  const uint8_t * data;               // Current decode position
+  const uint8_t * end;                // End of input
+  uint32_t depth;                     // Current nesting depth
+  uint32_t lazy;                      // Levels of nesting decoded before containers are kept lazy, zero if all decoded
+} iot_cbor_decoder_t;
+
+static bool iot_cbor_decode_value (iot_cbor_decoder_t * dec, iot_data_t ** value);
+
+/* Decodes an item head, returning false if truncated or reserved. Argument set to UINT64_MAX for indefinite length. */
+static bool iot_cbor_decode_head (iot_cbor_decoder_t * dec, uint8_t * major, uint8_t * info, uint64_t * arg)
+{
+  if (dec->data >= dec->end) return false;
+  *major = *dec->data >> 5;
+  *info = *dec->data++ & 0x1f;
+  if (*info < 24u)
+  {
+    *arg = *info;
+    return true;
+  }
+  if (*info == 31u)
+  {
+    *arg = UINT64_MAX;
+    return true;
+  }
+  if (*info > 27u) return false;
+  size_t len = (size_t) 1u << (*info - 24u);
+  if ((size_t) (dec->end - dec->data) < len) return false;
+  *arg = 0u;
+  for (size_t i = 0; i < len; i++) *arg = (*arg << 8) | *dec->data++;
+  return (*arg != UINT64_MAX || *major < 2u || *major > 5u); // Length can never be satisfied, and is reserved for indefinite
+}
+
+static inline bool iot_cbor_decode_break (iot_cbor_decoder_t * dec)
+{
+  if (dec->data < dec->end && *dec->data == 0xff)
   {
-    case CBOR_INT_8:
-      return iot_data_alloc_ui8 (cbor_get_uint8 (item));
-    case CBOR_INT_16:
-      return iot_data_alloc_ui16 (cbor_get_uint16 (item));
-    case CBOR_INT_32:
-      return iot_data_alloc_ui32 (cbor_get_uint32 (item));
-    case CBOR_INT_64:
-      return iot_data_alloc_ui64 (cbor_get_uint64 (item));
+    dec->data++;
+    return true;
   }
-  assert (false);
-  return NULL;
+  return false;
 }
 
-static iot_data_t *cbor_negint_to_iot_data (const cbor_item_t *item)
+/* Decodes a definite or indefinite (chunked) length byte or text string */
+static bool iot_cbor_decode_bytes (iot_cbor_decoder_t * dec, uint8_t major, uint64_t len, iot_data_t ** value)
 {
-  assert (cbor_is_int (item));
-  switch (cbor_int_get_width (item))
+  uint8_t * buff = NULL;
+  size_t size = 0;
+  if (len == UINT64_MAX)
   {
-    case CBOR_INT_8:
+    while (! iot_cbor_decode_break (dec))
+    {
+      uint8_t chunk_major;
+      uint8_t info;
+      uint64_t chunk;
+      if (! iot_cbor_decode_head (dec, &chunk_major, &info, &chunk) || chunk_major != major || chunk == UINT64_MAX || chunk > (uint64_t) (dec->end - dec->data))
       {
-        uint8_t raw = cbor_get_uint8 (item);
-        return (raw <= INT8_MAX) ? iot_data_alloc_i8 (-1 - (int8_t) raw) : iot_data_alloc_i16 (-1 - (int16_t) raw);
+        free (buff);
+        return false;
       }
-    case CBOR_INT_16:
-    {
-      uint16_t raw = cbor_get_uint16 (item);
-      return (raw <= INT16_MAX) ? iot_data_alloc_i16 (-1 - (int16_t) raw) : iot_data_alloc_i32 (-1 - (int32_t) raw);
+      buff = realloc (buff, size + (size_t) chunk + 1u);
+      memcpy (buff + size, dec->data, (size_t) chunk);
+      size += (size_t) chunk;
+      dec->data += chunk;
     }
-    case CBOR_INT_32:
+    if (major == 3u)
     {
-      uint32_t raw = cbor_get_uint32 (item);
-      return (raw <= INT32_MAX) ? iot_data_alloc_i32 (-1 - (int32_t) raw) : iot_data_alloc_i64 (-1 - (int64_t) raw);
+      if (buff == NULL) buff = malloc (1u);
+      buff[size] = '\0';
+      *value = iot_data_alloc_string ((char*) buff, IOT_DATA_TAKE);
     }
-    case CBOR_INT_64:
+    else
     {
-      uint64_t raw = cbor_get_uint64 (item);
-      return (raw <= INT64_MAX) ? iot_data_alloc_i64 (-1 - (int64_t) raw) : iot_data_alloc_null ();
+      if (size == 0u)
+      {
+        free (buff);
+        buff = NULL;
+      }
+      *value = iot_data_alloc_binary (buff, (uint32_t) size, IOT_DATA_TAKE);
     }
+    return true;
   }
-  assert (false);
-  return NULL;
+  if (len > (uint64_t) (dec->end - dec->data) || len > UINT32_MAX) return false;
+  *value = (major == 3u) ? iot_data_alloc_string_len ((const char*) dec->data, (size_t) len) : iot_data_alloc_binary ((uint8_t*) dec->data, (uint32_t) len, IOT_DATA_COPY);
+  dec->data += len;
+  return true;
 }
 
-static iot_data_t *cbor_definite_bytestring_to_iot_data (const cbor_item_t *item)
+static bool iot_cbor_decode_array (iot_cbor_decoder_t * dec, uint64_t len, iot_data_t ** value)
 {
-  assert (cbor_bytestring_is_definite (item));
-  size_t length = cbor_bytestring_length (item);
-  cbor_mutable_data data = cbor_bytestring_handle (item);
-  if (!data)
+  iot_data_t * vector;
+  if (len == UINT64_MAX) // Indefinite length, collect elements in a list
   {
-    assert (false);
-    return NULL;
+    iot_data_t * list = iot_data_alloc_list ();
+    while (! iot_cbor_decode_break (dec))
+    {
+      iot_data_t * elem;
+      if (! iot_cbor_decode_value (dec, &elem))
+      {
+        iot_data_free (list);
+        return false;
+      }
+      iot_data_list_tail_push (list, elem);
+    }
+    uint32_t i = 0;
+    vector = iot_data_alloc_vector (iot_data_list_length (list));
+    while (iot_data_list_length (list)) iot_data_vector_add (vector, i++, iot_data_list_head_pop (list));
+    iot_data_free (list);
   }
-  return iot_data_alloc_binary (data, (uint32_t) length, IOT_DATA_COPY);
+  else
+  {
+    if (len > (uint64_t) (dec->end - dec->data)) return false; // Each element at least one byte
+    vector = iot_data_alloc_vector ((uint32_t) len);
+    for (uint32_t i = 0; i < (uint32_t) len; i++)
+    {
+      iot_data_t * elem;
+      if (! iot_cbor_decode_value (dec, &elem))
+      {
+        iot_data_free (vector);
+        return false;
+      }
+      iot_data_vector_add (vector, i, elem);
+    }
+  }
+  *value = vector;
+  return true;
 }
 
-static iot_data_t *cbor_indefinite_bytestring_to_iot_data (const cbor_item_t *item)
+static bool iot_cbor_decode_map (iot_cbor_decoder_t * dec, uint64_t len, iot_data_t ** value)
 {
-  assert (cbor_bytestring_is_indefinite (item));
-  size_t chunk_count = cbor_bytestring_chunk_count (item);
-  char * data = NULL;
-  size_t data_size = 0;
-  size_t write_offset = 0;
-  cbor_item_t **chunks = cbor_bytestring_chunks_handle (item);
-  for (size_t i=0; i<chunk_count;i++)
+  iot_data_t * map = iot_data_alloc_map (IOT_DATA_MULTI);
+  for (uint64_t i = 0; (len == UINT64_MAX) ? ! iot_cbor_decode_break (dec) : (i < len); i++)
   {
-    const cbor_item_t *chunk = chunks[i];
-    if (!cbor_isa_bytestring (chunk))
+    iot_data_t * key;
+    iot_data_t * val;
+    if (! iot_cbor_decode_value (dec, &key)) goto error;
+    if (! iot_cbor_decode_value (dec, &val))
     {
-      assert (false);
+      iot_data_free (key);
       goto error;
     }
-    size_t chunk_size = cbor_bytestring_length (chunk);
-    const cbor_mutable_data chunk_data = cbor_bytestring_handle (chunk);
-    data_size += chunk_size;
-    data = realloc (data, data_size);
-    memcpy (data + write_offset, chunk_data, chunk_size);
-    write_offset += chunk_size;
+    iot_data_map_add (map, key, val);
   }
-  return iot_data_alloc_binary (data, (uint32_t) data_size, IOT_DATA_TAKE);
+  *value = map;
+  return true;
+
 error:
-  free (data);
-  return NULL;
+  iot_data_free (map);
+  return false;
 }
 
-static iot_data_t *cbor_bytestring_to_iot_data (const cbor_item_t *item)
+static float iot_cbor_half_to_float (uint16_t half)
 {
-  assert (cbor_isa_bytestring (item));
-  return cbor_bytestring_is_definite (item) ? cbor_definite_bytestring_to_iot_data (item) : cbor_indefinite_bytestring_to_iot_data (item);
+  uint32_t exp = (half >> 10) & 0x1fu;
+  uint32_t mant = half & 0x3ffu;
+  float val;
+  if (exp == 0u) val = ldexpf ((float) mant, -24);
+  else if (exp != 31u) val = ldexpf ((float) (mant + 1024u), (int) exp - 25);
+  else val = (mant == 0u) ? INFINITY : NAN;
+  return (half & 0x8000u) ? -val : val;
 }
 
-static iot_data_t *cbor_definite_string_to_iot_data (const cbor_item_t *item)
+static bool iot_cbor_decode_simple (uint8_t info, uint64_t arg, iot_data_t ** value)
 {
-  assert (cbor_string_is_definite (item));
-  size_t length = cbor_string_length (item);
-  const cbor_mutable_data data = cbor_string_handle (item);
-  if (!data)
+  switch (info)
   {
-    assert (false);
-    return NULL;
-  }
-  char *str = malloc (length + 1);
-  memcpy (str, data, length);
-  str[length] = '\0';
-  return iot_data_alloc_string (str, IOT_DATA_TAKE);
-}
-
-static iot_data_t *cbor_indefinite_string_to_iot_data (const cbor_item_t *item)
-{
-  assert (cbor_string_is_indefinite (item));
-  size_t chunk_count = cbor_string_chunk_count (item);
-  if (chunk_count == 0) return iot_data_alloc_string ("", IOT_DATA_REF);
-  char * data = NULL;
-  size_t data_size = 1; // For null terminator
-  size_t write_offset = 0;
-  cbor_item_t **chunks = cbor_string_chunks_handle (item);
-  for (size_t i=0; i<chunk_count;i++)
-  {
-    const cbor_item_t *chunk = chunks[i];
-    if (!cbor_isa_string (chunk))
+    case 20u: *value = iot_data_alloc_bool (false); break;
+    case 21u: *value = iot_data_alloc_bool (true); break;
+    case 22u: case 23u: *value = iot_data_alloc_null (); break; // null, undefined
+    case 25u: *value = iot_data_alloc_f32 (iot_cbor_half_to_float ((uint16_t) arg)); break;
+    case 26u:
     {
-      assert (false);
-      goto error;
+      uint32_t v = (uint32_t) arg;
+      float f;
+      memcpy (&f, &v, sizeof (f));
+      *value = iot_data_alloc_f32 (f);
+      break;
     }
-    size_t chunk_size = cbor_string_length (chunk);
-    const cbor_mutable_data chunk_data = cbor_string_handle (chunk);
-    data_size += chunk_size;
-    data = realloc (data, data_size);
-    memcpy (data + write_offset, chunk_data, chunk_size);
-    write_offset += chunk_size;
+    case 27u:
+    {
+      double d;
+      memcpy (&d, &arg, sizeof (d));
+      *value = iot_data_alloc_f64 (d);
+      break;
+    }
+    default: return false; // Other simple values and unexpected break
   }
-  data[data_size-1] = '\0';
-  return iot_data_alloc_string (data, IOT_DATA_TAKE);
-error:
-  free (data);
-  return NULL;
+  return true;
 }
 
-static iot_data_t *cbor_string_to_iot_data (const cbor_item_t *item)
+/* Array element types for RFC 8746 typed array tags 64 to 87, with float16 decoded as Float32.
+ * Invalid for the reserved and float128 tags, which are ignored.
+ */
+static const iot_data_type_t iot_cbor_typed_array_types [] =
 {
-  assert (cbor_isa_string (item));
-  return cbor_string_is_definite (item) ? cbor_definite_string_to_iot_data (item) : cbor_indefinite_string_to_iot_data (item);
-}
+  IOT_DATA_UINT8, IOT_DATA_UINT16, IOT_DATA_UINT32, IOT_DATA_UINT64, IOT_DATA_UINT8, IOT_DATA_UINT16, IOT_DATA_UINT32, IOT_DATA_UINT64,
+  IOT_DATA_INT8, IOT_DATA_INT16, IOT_DATA_INT32, IOT_DATA_INT64, IOT_DATA_INVALID, IOT_DATA_INT16, IOT_DATA_INT32, IOT_DATA_INT64,
+  IOT_DATA_FLOAT32, IOT_DATA_FLOAT32, IOT_DATA_FLOAT64, IOT_DATA_INVALID, IOT_DATA_FLOAT32, IOT_DATA_FLOAT32, IOT_DATA_FLOAT64, IOT_DATA_INVALID
+};
 
-static iot_data_t *cbor_array_to_iot_data (const cbor_item_t *item)
+/* Decodes an RFC 8746 typed array byte string to an array. Host byte order arrays are copied directly. */
+static bool iot_cbor_decode_typed_array (iot_cbor_decoder_t * dec, uint8_t tag, iot_data_t ** value)
 {
-  assert (cbor_isa_array (item));
-  size_t size = cbor_array_size (item);
-  iot_data_t *iot_array = iot_data_alloc_vector ((uint32_t) size);
-  for (size_t i=0; i<size; i++)
+  iot_data_type_t type = iot_cbor_typed_array_types[tag - 64u];
+  if (type == IOT_DATA_INVALID || dec->data >= dec->end || (*dec->data >> 5) != 2u) return iot_cbor_decode_value (dec, value);
+
+  bool half = (tag & 0x13u) == 0x10u;
+  bool little = (tag & 4u) != 0u;
+  size_t width = (tag & 0x10u) ? (2u << (tag & 3u)) : (1u << (tag & 3u));
+  iot_data_t * chunked = NULL;
+  const uint8_t * bytes;
+  uint8_t major;
+  uint8_t info;
+  uint64_t len;
+
+  (void) iot_cbor_decode_head (dec, &major, &info, &len);
+  if (len == UINT64_MAX) // Indefinite length, collect chunks
   {
-    cbor_item_t *element_item = cbor_array_get (item, i);
-    assert (element_item);
-    iot_data_t *element_data = cbor_to_iot_data (element_item);
-    cbor_decref (&element_item);
-    if (!element_data)
+    if (! iot_cbor_decode_bytes (dec, major, len, &chunked)) return false;
+    bytes = iot_data_address (chunked);
+    len = iot_data_array_size (chunked);
+  }
+  else
+  {
+    if (len > (uint64_t) (dec->end - dec->data)) return false;
+    bytes = dec->data;
+    dec->data += len;
+  }
+  if ((len % width) || (len / width) > UINT32_MAX)
+  {
+    iot_data_free (chunked);
+    return false;
+  }
+  uint32_t length = (uint32_t) (len / width);
+  if (length == 0u || width == 1u || (! half && (tag & 4u) == IOT_CBOR_TAG_ENDIAN))
+  {
+    *value = iot_data_alloc_array (length ? (void*) bytes : NULL, length, type, IOT_DATA_COPY);
+  }
+  else
+  {
+    uint8_t * data = malloc (length * (half ? sizeof (float) : width));
+    for (uint32_t i = 0; i < length; i++, bytes += width)
     {
-      assert (false);
-      element_data = iot_data_alloc_null();
+      switch (width)
+      {
+        case 2u:
+        {
+          uint16_t v;
+          memcpy (&v, bytes, sizeof (v));
+          v = little ? le16toh (v) : be16toh (v);
+          if (half)
+          {
+            float f = iot_cbor_half_to_float (v);
+            memcpy (data + i * sizeof (f), &f, sizeof (f));
+          }
+          else
+          {
+            memcpy (data + i * sizeof (v), &v, sizeof (v));
+          }
+          break;
+        }
+        case 4u:
+        {
+          uint32_t v;
+          memcpy (&v, bytes, sizeof (v));
+          v = little ? le32toh (v) : be32toh (v);
+          memcpy (data + i * sizeof (v), &v, sizeof (v));
+          break;
+        }
+        default:
+        {
+          uint64_t v;
+          memcpy (&v, bytes, sizeof (v));
+          v = little ? le64toh (v) : be64toh (v);
+          memcpy (data + i * sizeof (v), &v, sizeof (v));
+          break;
+        }
+      }
     }
-    iot_data_vector_add (iot_array, i , element_data);
+    *value = iot_data_alloc_array (data, length, type, IOT_DATA_TAKE);
   }
-  return iot_array;
+  iot_data_free (chunked);
+  return true;
 }
 
-static iot_data_t *cbor_map_to_iot_data (const cbor_item_t *item)
+static bool iot_cbor_skip_value (iot_cbor_decoder_t * dec);
+
+/* Skips the content of an item following its head, checking only its structure */
+static bool iot_cbor_skip_item (iot_cbor_decoder_t * dec, uint8_t major, uint64_t arg)
 {
-  assert (cbor_isa_map(item));
-  size_t size = cbor_map_size (item);
-  iot_data_t *iot_map = iot_data_alloc_map (IOT_DATA_MULTI);
-  for (size_t i=0; i<size; i++)
+  bool ok = true;
+  switch (major)
   {
-    struct cbor_pair pair = cbor_map_handle (item)[i];
-    iot_data_t *key = cbor_to_iot_data (pair.key);
-    if (!key)
-    {
-      assert (false);
-      continue;
-    }
-    iot_data_t *value = cbor_to_iot_data (pair.value);
-    if (!value)
-    {
-      assert (false);
-      continue;
-    }
-    iot_data_map_add (iot_map, key, value);
+    case 2u: case 3u:
+      if (arg == UINT64_MAX) // Indefinite length, skip chunks
+      {
+        while (ok && ! iot_cbor_decode_break (dec))
+        {
+          uint8_t chunk_major;
+          uint8_t info;
+          uint64_t chunk;
+          ok = iot_cbor_decode_head (dec, &chunk_major, &info, &chunk) && chunk_major == major && chunk <= (uint64_t) (dec->end - dec->data);
+          if (ok) dec->data += chunk;
+        }
+      }
+      else
+      {
+        ok = (arg <= (uint64_t) (dec->end - dec->data));
+        if (ok) dec->data += arg;
+      }
+      break;
+    case 4u: case 5u:
+      if (arg != UINT64_MAX)
+      {
+        if (major == 5u && arg > UINT64_MAX / 4u) return false;
+        if (major == 5u) arg *= 2u;
+        if (arg > (uint64_t) (dec->end - dec->data)) return false; // Each item at least one byte
+      }
+      for (uint64_t i = 0; ok && ((arg == UINT64_MAX) ? ! iot_cbor_decode_break (dec) : (i < arg)); i++) ok = iot_cbor_skip_value (dec);
+      break;
+    case 6u: ok = iot_cbor_skip_value (dec); break;
+    default: break; // Integers, simple values and floats are complete following the head
   }
-  return iot_map;
+  return ok;
 }
 
-static iot_data_t *cbor_tag_to_iot_data (const cbor_item_t *item)
+/* Skips an item without decoding it */
+static bool iot_cbor_skip_value (iot_cbor_decoder_t * dec)
 {
-  assert (cbor_isa_tag(item));
-  cbor_item_t *tagged = cbor_tag_item(item);
-  iot_data_t *result = cbor_to_iot_data (tagged);
-  cbor_decref (&tagged);
-  return result;
+  uint8_t major;
+  uint8_t info;
+  uint64_t arg;
+  bool ok;
+  if (! iot_cbor_decode_head (dec, &major, &info, &arg)) return false;
+  if (info == 31u && (major < 2u || major > 5u)) return false; // Indefinite length not valid, or unexpected break
+  if (++dec->depth > IOT_CBOR_MAX_DEPTH) return false;
+  ok = iot_cbor_skip_item (dec, major, arg);
+  dec->depth--;
+  return ok;
 }
 
-#if (CBOR_MAJOR_VERSION == 0 && CBOR_MINOR_VERSION < 7)
-/*
- * libcbor versions <0.7 do not have a "cbor_get_bool" function
- */
-static bool cbor_get_bool (const cbor_item_t *item)
+static iot_data_t * iot_cbor_lazy_decode (const iot_data_lazy_t * lazy)
 {
-  assert (cbor_is_bool (item));
-  return item->metadata.float_ctrl_metadata.ctrl == CBOR_CTRL_TRUE;
+  return iot_data_from_cbor ((const uint8_t*) lazy->bytes, (uint32_t) lazy->len);
 }
-#endif
 
-static iot_data_t *cbor_float_ctrl_to_iot_data (const cbor_item_t *item)
+/* Skips a container, keeping a copy of its bytes (from the head at start) to be decoded on first access */
+static bool iot_cbor_decode_lazy (iot_cbor_decoder_t * dec, const uint8_t * start, uint8_t major, uint64_t arg, iot_data_t ** value)
 {
-  assert (cbor_isa_float_ctrl (item));
-  if (cbor_float_ctrl_is_ctrl (item))
+  if (! iot_cbor_skip_item (dec, major, arg)) return false;
+  *value = iot_data_alloc_lazy (start, (size_t) (dec->data - start), true, false, iot_cbor_lazy_decode);
+  return true;
+}
+
+static bool iot_cbor_decode_value (iot_cbor_decoder_t * dec, iot_data_t ** value)
+{
+  const uint8_t * start = dec->data;
+  uint8_t major;
+  uint8_t info;
+  uint64_t arg;
+  bool ok = true;
+  if (! iot_cbor_decode_head (dec, &major, &info, &arg)) return false;
+  if (info == 31u && (major < 2u || major == 6u)) return false; // Indefinite length not valid
+  if (++dec->depth > IOT_CBOR_MAX_DEPTH) return false;
+  switch (major)
   {
-    if (cbor_is_bool (item)) return iot_data_alloc_bool (cbor_get_bool (item));
-    if (cbor_is_null (item)) return iot_data_alloc_null ();
-    assert (false);
-    return NULL;
+    case 0u: // Unsigned integer
+      if (info <= 24u) *value = iot_data_alloc_ui8 ((uint8_t) arg);
+      else if (info == 25u) *value = iot_data_alloc_ui16 ((uint16_t) arg);
+      else if (info == 26u) *value = iot_data_alloc_ui32 ((uint32_t) arg);
+      else *value = iot_data_alloc_ui64 (arg);
+      break;
+    case 1u: // Negative integer, -1 - arg
+      if (info <= 24u) *value = (arg <= INT8_MAX) ? iot_data_alloc_i8 ((int8_t) (-1 - (int8_t) arg)) : iot_data_alloc_i16 ((int16_t) (-1 - (int16_t) arg));
+      else if (info == 25u) *value = (arg <= INT16_MAX) ? iot_data_alloc_i16 ((int16_t) (-1 - (int16_t) arg)) : iot_data_alloc_i32 (-1 - (int32_t) arg);
+      else if (info == 26u) *value = (arg <= INT32_MAX) ? iot_data_alloc_i32 (-1 - (int32_t) arg) : iot_data_alloc_i64 (-1 - (int64_t) arg);
+      else *value = (arg <= INT64_MAX) ? iot_data_alloc_i64 (-1 - (int64_t) arg) : iot_data_alloc_null ();
+      break;
+    case 2u: case 3u: ok = iot_cbor_decode_bytes (dec, major, arg, value); break;
+    case 4u: case 5u:
+      if (dec->lazy && dec->depth > dec->lazy) ok = iot_cbor_decode_lazy (dec, start, major, arg, value);
+      else ok = (major == 4u) ? iot_cbor_decode_array (dec, arg, value) : iot_cbor_decode_map (dec, arg, value);
+      break;
+    case 6u: // Tag, decode RFC 8746 typed arrays otherwise ignore the tag and decode the tagged item
+      ok = (arg >= 64u && arg <= 87u) ? iot_cbor_decode_typed_array (dec, (uint8_t) arg, value) : iot_cbor_decode_value (dec, value);
+      break;
+    default: ok = iot_cbor_decode_simple (info, arg, value); break;
   }
+  dec->depth--;
+  return ok;
+}
+
+iot_data_t * iot_data_from_cbor (const uint8_t *data, uint32_t size)
+{
+  iot_data_t * out = NULL;
+  iot_cbor_decoder_t dec = { .data = data, .end = data + size };
+  assert (data || size == 0);
+  return iot_cbor_decode_value (&dec, &out) ? out : NULL;
+}
+
+iot_data_t * iot_data_from_cbor_lazy (const uint8_t * data, uint32_t size, uint32_t depth)
+{
+  iot_data_t * out = NULL;
+  iot_cbor_decoder_t dec = { .data = data, .end = data + size, .lazy = depth };
+  assert (data || size == 0);
+  return iot_cbor_decode_value (&dec, &out) ? out : NULL;
+}
+
+iot_data_t * iot_data_from_iot_cbor (const iot_data_t *data)
+{
+  return iot_data_from_cbor (iot_data_address (data),iot_data_array_size (data));
+}
+
+/* Incremental CBOR decoder. Input is scanned item head by item head, tracking the number of items
+ * remaining in each open container, until a complete top level item is available, which is then
+ * decoded in a single pass. Complete items are decoded directly from the input buffer, only partial
+ * items are copied and accumulated.
+ */
+
+#define IOT_CBOR_INDEFINITE UINT64_MAX
+
+struct iot_data_cbor_stream_t
+{
+  iot_data_cbor_stream_fn fn;                 // Value callback
+  void * arg;                                 // Value callback argument
+  uint64_t remain[IOT_CBOR_MAX_DEPTH];        // Items remaining in each open container
+  uint32_t depth;                             // Open container depth
+  size_t pos;                                 // Scan position in the current item
+  uint8_t * buff;                             // Accumulated partial item
+  size_t len;                                 // Accumulated length
+  size_t size;                                // Accumulation buffer size
+};
+
+iot_data_cbor_stream_t * iot_data_cbor_stream_alloc (iot_data_cbor_stream_fn fn, void * arg)
+{
+  assert (fn);
+  iot_data_cbor_stream_t * stream = calloc (1, sizeof (*stream));
+  stream->fn = fn;
+  stream->arg = arg;
+  stream->size = IOT_CBOR_BUFF_SIZE;
+  stream->buff = malloc (stream->size);
+  return stream;
+}
 
-  switch (cbor_float_get_width (item))
+void iot_data_cbor_stream_free (iot_data_cbor_stream_t * stream)
+{
+  if (stream)
   {
-    case CBOR_FLOAT_16:
-      return iot_data_alloc_f32 (cbor_float_get_float2 (item));
-    case CBOR_FLOAT_32:
-      return iot_data_alloc_f32 (cbor_float_get_float4 (item));
-    case CBOR_FLOAT_64:
-      return iot_data_alloc_f64 (cbor_float_get_float8 (item));
-    default:
-      break;
+    free (stream->buff);
+    free (stream);
   }
-  assert (false);
-  return NULL;
 }
 
-static iot_data_t *cbor_to_iot_data (const cbor_item_t *item)
+static inline void iot_cbor_stream_reset (iot_data_cbor_stream_t * stream)
+{
+  stream->depth = 0;
+  stream->pos = 0;
+  stream->len = 0;
+}
+
+/* Continues the scan of an item starting at data, returning 1 when complete, 0 if more input is needed or -1 if invalid */
+static int iot_cbor_stream_scan (iot_data_cbor_stream_t * stream, const uint8_t * data, size_t len)
 {
-  switch (cbor_typeof (item))
+  while (stream->pos < len)
   {
-    case CBOR_TYPE_UINT:
-      return cbor_uint_to_iot_data (item);
-    case CBOR_TYPE_NEGINT:
-      return cbor_negint_to_iot_data (item);
-    case CBOR_TYPE_BYTESTRING:
-      return cbor_bytestring_to_iot_data (item);
-    case CBOR_TYPE_STRING:
-      return cbor_string_to_iot_data (item);
-    case CBOR_TYPE_ARRAY:
-      return cbor_array_to_iot_data (item);
-    case CBOR_TYPE_MAP:
-      return cbor_map_to_iot_data (item);
-    case CBOR_TYPE_TAG:
-      return cbor_tag_to_iot_data (item);
-    case CBOR_TYPE_FLOAT_CTRL:
-      return cbor_float_ctrl_to_iot_data (item);
-    default:
-      break;
+    uint8_t ib = data[stream->pos];
+    uint8_t major = ib >> 5;
+    uint8_t info = ib & 0x1f;
+    size_t size = (info < 24u || info == 31u) ? 1u : ((size_t) 1u << (info - 24u)) + 1u;
+    uint64_t arg = info;
+    bool open = false;
+    if (info > 27u && info < 31u) return -1;
+    if (len - stream->pos < size) return 0;
+    if (size > 1u)
+    {
+      arg = 0u;
+      for (size_t i = 1; i < size; i++) arg = (arg << 8) | data[stream->pos + i];
+    }
+    if (info == 31u)
+    {
+      if (major == 7u) // Break, closes indefinite length container
+      {
+        if (stream->depth == 0 || stream->remain[stream->depth - 1] != IOT_CBOR_INDEFINITE) return -1;
+        stream->depth--;
+      }
+      else if (major < 2u || major == 6u)
+      {
+        return -1;
+      }
+      else
+      {
+        arg = IOT_CBOR_INDEFINITE;
+        open = true;
+      }
+    }
+    else
+    {
+      switch (major)
+      {
+        case 2u: case 3u:
+          if (arg > len - stream->pos - size) return 0; // Wait for complete string
+          size += (size_t) arg;
+          break;
+        case 4u: open = (arg != 0u); break;
+        case 5u:
+          if (arg > UINT64_MAX / 4u) return -1;
+          arg *= 2u;
+          open = (arg != 0u);
+          break;
+        case 6u: arg = 1u; open = true; break;
+        default: break;
+      }
+    }
+    stream->pos += size;
+    if (open)
+    {
+      if (stream->depth == IOT_CBOR_MAX_DEPTH) return -1;
+      stream->remain[stream->depth++] = arg;
+      continue;
+    }
+    while (true) // Item complete, account for it in enclosing containers
+    {
+      if (stream->depth == 0) return 1;
+      uint64_t * remain = &stream->remain[stream->depth - 1];
+      if (*remain == IOT_CBOR_INDEFINITE || --(*remain)) break;
+      stream->depth--;
+    }
   }
-  assert (false);
-  return NULL;
+  return 0;
 }
 
-iot_data_t * iot_data_from_cbor (const uint8_t *data, uint32_t size)
+static bool iot_cbor_stream_emit (iot_data_cbor_stream_t * stream, const uint8_t * data)
 {
-  iot_data_t *out = NULL;
-  struct cbor_load_result result;
-  cbor_item_t *item = cbor_load (data, size, &result);
-  if (result.error.code != CBOR_ERR_NONE) goto done;
-  out = cbor_to_iot_data (item);
-done:
-  if (item) cbor_decref (&item);
-  return out;
+  iot_data_t * value = NULL;
+  iot_cbor_decoder_t dec = { .data = data, .end = data + stream->pos };
+  bool ok = iot_cbor_decode_value (&dec, &value);
+  if (ok) stream->fn (value, stream->arg);
+  stream->pos = 0;
+  return ok;
 }
 
-iot_data_t * iot_data_from_iot_cbor (const iot_data_t *data)
+bool iot_data_cbor_stream_write (iot_data_cbor_stream_t * stream, const uint8_t * buff, size_t len)
 {
-  return iot_data_from_cbor (iot_data_address (data),iot_data_array_size (data));
+  assert (stream && (buff || len == 0));
+  bool ok = true;
+  if (stream->len) // Continue partial item
+  {
+    if (stream->len + len > stream->size)
+    {
+      while (stream->len + len > stream->size) stream->size *= 2u;
+      stream->buff = realloc (stream->buff, stream->size);
+    }
+    memcpy (stream->buff + stream->len, buff, len);
+    stream->len += len;
+    int ret = iot_cbor_stream_scan (stream, stream->buff, stream->len);
+    if (ret <= 0)
+    {
+      if (ret < 0) iot_cbor_stream_reset (stream);
+      return ret == 0;
+    }
+    size_t used = stream->pos - (stream->len - len); // Input consumed by the completed item
+    ok = iot_cbor_stream_emit (stream, stream->buff);
+    stream->len = 0;
+    buff += used;
+    len -= used;
+  }
+  while (len) // Decode complete items in place
+  {
+    int ret = iot_cbor_stream_scan (stream, buff, len);
+    if (ret < 0)
+    {
+      iot_cbor_stream_reset (stream);
+      return false;
+    }
+    if (ret == 0) // Keep partial item
+    {
+      if (len > stream->size)
+      {
+        stream->size = len;
+        stream->buff = realloc (stream->buff, stream->size);
+      }
+      memcpy (stream->buff, buff, len);
+      stream->len = len;
+      break;
+    }
+    size_t used = stream->pos;
+    ok = iot_cbor_stream_emit (stream, buff) && ok;
+    buff += used;
+    len -= used;
+  }
+  return ok;
+}
+
+bool iot_data_cbor_stream_end (iot_data_cbor_stream_t * stream)
+{
+  assert (stream);
+  bool ok = (stream->len == 0);
+  iot_cbor_stream_reset (stream);
+  return ok;
 }
 
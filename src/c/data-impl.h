@@ -36,6 +36,8 @@ struct iot_data_t
   bool rehash : 1;
   bool tag1 : 1;
   bool tag2 : 1;
+  bool backed : 1;
+  bool lazy : 1;
 };
 
 typedef struct iot_string_holder_t
@@ -43,12 +45,74 @@ typedef struct iot_string_holder_t
   char * str;
   size_t size;
   size_t free;
+  iot_data_sink_fn sink;  // If set, buffer contents are passed to the sink when full rather than the buffer grown
+  void * ctx;
+  bool failed;
 } iot_string_holder_t;
 
+struct iot_data_buffer_t
+{
+  uint8_t * data;         // Buffer, retained and grown across encodes
+  size_t size;            // Buffer capacity
+  size_t length;          // Length of last encoded output
+};
+
 void iot_data_holder_realloc (iot_string_holder_t * holder, size_t required);
 
+void iot_data_holder_flush (iot_string_holder_t * holder);
+
+/* Returns the offset of the first quote, backslash or control character in str, or len if none present */
+size_t iot_data_json_scan (const char * str, size_t len);
+
+/* Returns the length of str when escaped for JSON */
+size_t iot_data_json_escaped_size (const char * str);
+
 void iot_data_strcat_escape (iot_string_holder_t * holder, const char * add, bool escape);
 
-extern iot_data_static_t iot_data_order;
+void iot_data_dump_json (iot_string_holder_t * holder, const iot_data_t * data);
+
+/* Allocates a string copying len characters of str, which need not be nul terminated */
+iot_data_t * iot_data_alloc_string_len (const char * str, size_t len);
+
+/* Allocates a string referencing str, holding a reference to the backing data that owns it. Short strings are copied. */
+iot_data_t * iot_data_alloc_string_view (const char * str, size_t len, iot_data_t * backing);
+
+/* Undecoded JSON or CBOR container, held by a lazy pointer value and decoded on first access */
+typedef struct iot_data_lazy_t iot_data_lazy_t;
+
+typedef iot_data_t * (*iot_data_lazy_decode_fn) (const iot_data_lazy_t * lazy);
+
+struct iot_data_lazy_t
+{
+  iot_data_lazy_decode_fn decode;     // Decoder for the encoding
+  _Atomic (iot_data_t *) value;       // Decoded value, NULL until first accessed
+  size_t len;                         // Encoded length
+  bool cbor;                          // Whether encoded as CBOR, otherwise JSON
+  bool ordered;                       // Whether decoded maps are ordered
+  char bytes[];                       // Encoded container, nul terminated
+};
+
+/* Allocates a lazy value holding a copy of len encoded bytes */
+iot_data_t * iot_data_alloc_lazy (const void * bytes, size_t len, bool cbor, bool ordered, iot_data_lazy_decode_fn decode);
+
+/* Returns the lazy container held by a lazy value */
+static inline const iot_data_lazy_t * iot_data_lazy (const iot_data_t * data)
+{
+  return (const iot_data_lazy_t *) iot_data_address (data);
+}
+
+/* Number formatting, writing a nul terminated string (at most 26 bytes) and returning a pointer to the terminator */
+char * iot_data_u64_to_chars (char * buff, uint64_t val);
+char * iot_data_i64_to_chars (char * buff, int64_t val);
+char * iot_data_f64_to_chars (char * buff, double val);
+char * iot_data_f32_to_chars (char * buff, float val);
+
+/* Number parsing, returning a pointer to the first character after the number or NULL if no valid number present */
+const char * iot_data_parse_int (const char * str, uint64_t * mag, bool * neg);
+const char * iot_data_parse_f64 (const char * str, double * val);
+const char * iot_data_parse_f32 (const char * str, float * val);
+
+/* Returns the key, and sets the value, of the entry at an index in the insertion order of an ordered map */
+const iot_data_t * iot_data_map_ordered_key (const iot_data_t * map, uint32_t index, const iot_data_t ** value);
 
 #endif
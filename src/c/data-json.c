@@ -4,17 +4,20 @@
 // SPDX-License-Identifier: Apache-2.0
 //
 #include "iot/data.h"
-#include "iot/json.h"
 #include "iot/base64.h"
 #include "data-impl.h"
 #include <math.h>
-#include <uchar.h>
 #include <errno.h>
+#include <unistd.h>
 
 #define IOT_JSON_BUFF_SIZE 512u
+#define IOT_JSON_SINK_BUFF_SIZE 4096u
+#define IOT_JSON_SINK_MIN_SIZE 64u
 #define IOT_VAL_BUFF_SIZE 31u
-
-static iot_data_t * iot_data_value_from_json (iot_json_tok_t ** tokens, const char * json, bool ordered, iot_data_t * cache);
+#define IOT_JSON_STACK_SIZE 64u
+#define IOT_JSON_MAX_DEPTH 512u
+#define IOT_JSON_MAX_PATHS 64u
+#define IOT_JSON_STREAM_CACHE_MAX 1024u
 
 static inline void iot_data_strcat (iot_string_holder_t * holder, const char * add)
 {
@@ -28,54 +31,59 @@ static inline void iot_data_add_quote (iot_string_holder_t * holder)
 
 static void iot_data_base64_encode (iot_string_holder_t * holder, const iot_data_t * array)
 {
-  uint32_t inLen = iot_data_array_size (array);
-  if (inLen)
+  size_t inLen = iot_data_array_size (array);
+  const uint8_t * data = iot_data_address (array);
+  while (inLen)
   {
-    const uint8_t *data = iot_data_address (array);
     assert (strlen (holder->str) == (holder->size - holder->free - 1));
-    size_t len = iot_b64_encodesize (inLen) - 1; /* Allow for string terminator */
-    char *out;
-
-    if (holder->free < len)
+    if (holder->free < 4u)
     {
-      iot_data_holder_realloc (holder, len);
+      iot_data_holder_realloc (holder, iot_b64_encodesize (inLen) - 1); /* Allow for string terminator */
     }
-
-    out = holder->str + holder->size - holder->free - 1;
-    iot_b64_encode (data, inLen, out, holder->free + 1);
+    size_t chunk = (holder->free / 4u) * 3u; // Encode in whole groups of three bytes to fit available space
+    if (chunk > inLen) chunk = inLen;
+    size_t len = iot_b64_encodesize (chunk) - 1;
+    iot_b64_encode (data, chunk, holder->str + holder->size - holder->free - 1, holder->free + 1);
     holder->free -= len;
-    assert (strlen (holder->str) == (holder->size - holder->free - 1));
+    data += chunk;
+    inLen -= chunk;
   }
 }
 
-static void iot_data_dump_json_ptr (iot_string_holder_t * holder, const void * ptr, const iot_data_type_t type)
+/* Formats a scalar value, writing at most IOT_VAL_BUFF_SIZE characters and returning a pointer to the end */
+static char * iot_data_json_format (char * buff, const void * ptr, const iot_data_type_t type)
 {
-  if (holder->free < IOT_VAL_BUFF_SIZE)
+  switch (type)
   {
-    iot_data_holder_realloc (holder, IOT_VAL_BUFF_SIZE);
+    case IOT_DATA_INT8: return iot_data_i64_to_chars (buff, *(const int8_t *) ptr);
+    case IOT_DATA_UINT8: return iot_data_u64_to_chars (buff, *(const uint8_t *) ptr);
+    case IOT_DATA_INT16: return iot_data_i64_to_chars (buff, *(const int16_t *) ptr);
+    case IOT_DATA_UINT16: return iot_data_u64_to_chars (buff, *(const uint16_t *) ptr);
+    case IOT_DATA_INT32: return iot_data_i64_to_chars (buff, *(const int32_t *) ptr);
+    case IOT_DATA_UINT32: return iot_data_u64_to_chars (buff, *(const uint32_t *) ptr);
+    case IOT_DATA_INT64: return iot_data_i64_to_chars (buff, *(const int64_t *) ptr);
+    case IOT_DATA_UINT64: return iot_data_u64_to_chars (buff, *(const uint64_t *) ptr);
+    case IOT_DATA_FLOAT32: return iot_data_f32_to_chars (buff, *(const float*) ptr);
+    case IOT_DATA_FLOAT64: return iot_data_f64_to_chars (buff, *(const double*) ptr);
+    case IOT_DATA_NULL: strcpy (buff, "null"); return buff + 4;
+    default: strcpy (buff, (*(const bool*) ptr) ? "true" : "false"); return buff + strlen (buff);
   }
-  char * buff = holder->str + holder->size - holder->free - 1;
-  switch (type)
+}
+
+static void iot_data_dump_json_ptr (iot_string_holder_t * holder, const void * ptr, const iot_data_type_t type)
+{
+  if (holder->free < IOT_VAL_BUFF_SIZE) // Format locally, so an exactly sized buffer is not grown
   {
-    case IOT_DATA_INT8: snprintf (buff, IOT_VAL_BUFF_SIZE, "%" PRId8 , *(const int8_t *) ptr); break;
-    case IOT_DATA_UINT8: snprintf (buff, IOT_VAL_BUFF_SIZE, "%" PRIu8, *(const uint8_t *) ptr); break;
-    case IOT_DATA_INT16: snprintf (buff, IOT_VAL_BUFF_SIZE, "%" PRId16, *(const int16_t *) ptr); break;
-    case IOT_DATA_UINT16: snprintf (buff, IOT_VAL_BUFF_SIZE, "%" PRIu16, *(const uint16_t *) ptr); break;
-    case IOT_DATA_INT32: snprintf (buff, IOT_VAL_BUFF_SIZE, "%" PRId32, *(const int32_t *) ptr); break;
-    case IOT_DATA_UINT32: snprintf (buff, IOT_VAL_BUFF_SIZE, "%" PRIu32, *(const uint32_t *) ptr); break;
-    case IOT_DATA_INT64: snprintf (buff, IOT_VAL_BUFF_SIZE, "%" PRId64, *(const int64_t *) ptr); break;
-    case IOT_DATA_UINT64: snprintf (buff, IOT_VAL_BUFF_SIZE, "%" PRIu64, *(const uint64_t *) ptr); break;
-    case IOT_DATA_FLOAT32:
-      (fpclassify (*(const float*) ptr) == FP_INFINITE) ? snprintf (buff, IOT_VAL_BUFF_SIZE, "1e400") : snprintf (buff, IOT_VAL_BUFF_SIZE, "%.8e", *(const float*) ptr); break;
-    case IOT_DATA_FLOAT64:
-      (fpclassify (*(const double*) ptr) == FP_INFINITE) ? snprintf (buff, IOT_VAL_BUFF_SIZE, "1e800") : snprintf (buff, IOT_VAL_BUFF_SIZE, "%.16e", *(const double*) ptr); break;
-    case IOT_DATA_NULL: strncpy (buff, "null", IOT_VAL_BUFF_SIZE); break;
-    default: strncpy (buff, (*(const bool*) ptr) ? "true" : "false", IOT_VAL_BUFF_SIZE); break;
+    char buff[IOT_VAL_BUFF_SIZE + 1];
+    iot_data_json_format (buff, ptr, type);
+    iot_data_strcat_escape (holder, buff, false);
+    return;
   }
-  holder->free -= strlen (buff);
+  char * buff = holder->str + holder->size - holder->free - 1;
+  holder->free -= (size_t) (iot_data_json_format (buff, ptr, type) - buff);
 }
 
-static void iot_data_dump_json (iot_string_holder_t * holder, const iot_data_t * data)
+void iot_data_dump_json (iot_string_holder_t * holder, const iot_data_t * data)
 {
   switch (data->type)
   {
@@ -105,37 +113,31 @@ static void iot_data_dump_json (iot_string_holder_t * holder, const iot_data_t *
     }
     case IOT_DATA_MAP:
     {
-      const iot_data_t * ordering = iot_data_get_metadata (data, IOT_DATA_STATIC (&iot_data_order));
+      bool ordered = iot_data_map_is_ordered (data);
+      uint32_t size = iot_data_map_size (data);
       iot_data_map_iter_t iter;
-      iot_data_vector_iter_t vec_iter = { 0 };
-      bool first = true;
-      if (ordering) iot_data_vector_iter (ordering, &vec_iter);
       iot_data_map_iter (data, &iter);
       iot_data_strcat (holder, "{");
-      while (ordering ? iot_data_vector_iter_next (&vec_iter) : iot_data_map_iter_next (&iter))
+      for (uint32_t i = 0; i < size; i++)
       {
         const iot_data_t * key;
         const iot_data_t * value;
-        if (ordering)
+        if (ordered)
         {
-          key = iot_data_vector_iter_value (&vec_iter);
-          value = iot_data_map_get (data, key);
+          key = iot_data_map_ordered_key (data, i, &value);
         }
         else
         {
+          iot_data_map_iter_next (&iter);
           key = iot_data_map_iter_key (&iter);
           value = iot_data_map_iter_value (&iter);
         }
-        if (value)
-        {
-          if (! first) iot_data_strcat (holder, ",");
-          if (iot_data_type (key) != IOT_DATA_STRING) iot_data_add_quote (holder);
-          iot_data_dump_json (holder, key);
-          if (iot_data_type (key) != IOT_DATA_STRING) iot_data_add_quote (holder);
-          iot_data_strcat (holder, ":");
-          iot_data_dump_json (holder, value);
-          first = false;
-        }
+        if (i) iot_data_strcat (holder, ",");
+        if (iot_data_type (key) != IOT_DATA_STRING) iot_data_add_quote (holder);
+        iot_data_dump_json (holder, key);
+        if (iot_data_type (key) != IOT_DATA_STRING) iot_data_add_quote (holder);
+        iot_data_strcat (holder, ":");
+        iot_data_dump_json (holder, value);
       }
       iot_data_strcat (holder, "}");
       break;
@@ -166,11 +168,90 @@ static void iot_data_dump_json (iot_string_holder_t * holder, const iot_data_t *
       iot_data_strcat (holder, "]");
       break;
     }
-    case IOT_DATA_POINTER: break;
+    case IOT_DATA_POINTER:
+    {
+      if (data->lazy) // Written verbatim unless decoded from another encoding
+      {
+        const iot_data_lazy_t * lazy = iot_data_lazy (data);
+        lazy->cbor ? iot_data_dump_json (holder, iot_data_lazy_value (data)) : iot_data_strcat_escape (holder, lazy->bytes, false);
+      }
+      break;
+    }
     default: iot_data_dump_json_ptr (holder, iot_data_address (data), data->type); break;
   }
 }
 
+static size_t iot_data_json_ptr_size (const void * ptr, const iot_data_type_t type)
+{
+  char buff[IOT_VAL_BUFF_SIZE + 1];
+  return (size_t) (iot_data_json_format (buff, ptr, type) - buff);
+}
+
+/* Measuring pass, returning the exact length of the JSON written by iot_data_dump_json */
+static size_t iot_data_json_measure (const iot_data_t * data)
+{
+  size_t size = 2u; // Quotes or brackets
+  switch (data->type)
+  {
+    case IOT_DATA_STRING:
+      size += iot_data_json_escaped_size (iot_data_string (data));
+      break;
+    case IOT_DATA_BINARY:
+      size += iot_b64_encodesize (iot_data_array_size (data)) - 1u;
+      break;
+    case IOT_DATA_ARRAY:
+    {
+      iot_data_type_t type = iot_data_array_type (data);
+      iot_data_array_iter_t iter;
+      iot_data_array_iter (data, &iter);
+      while (iot_data_array_iter_next (&iter)) size += iot_data_json_ptr_size (iot_data_array_iter_value (&iter), type) + 1u;
+      if (iot_data_array_length (data)) size--;
+      break;
+    }
+    case IOT_DATA_MAP:
+    {
+      iot_data_map_iter_t iter;
+      iot_data_map_iter (data, &iter);
+      while (iot_data_map_iter_next (&iter))
+      {
+        const iot_data_t * key = iot_data_map_iter_key (&iter);
+        size += iot_data_json_measure (key) + iot_data_json_measure (iot_data_map_iter_value (&iter)) + 2u; // Colon and comma
+        if (iot_data_type (key) != IOT_DATA_STRING) size += 2u;
+      }
+      if (iot_data_map_size (data)) size--;
+      break;
+    }
+    case IOT_DATA_VECTOR:
+    {
+      iot_data_vector_iter_t iter;
+      iot_data_vector_iter (data, &iter);
+      while (iot_data_vector_iter_next (&iter)) size += iot_data_json_measure (iot_data_vector_iter_value (&iter)) + 1u;
+      if (iot_data_vector_size (data)) size--;
+      break;
+    }
+    case IOT_DATA_LIST:
+    {
+      iot_data_list_iter_t iter;
+      iot_data_list_iter (data, &iter);
+      while (iot_data_list_iter_next (&iter)) size += iot_data_json_measure (iot_data_list_iter_value (&iter)) + 1u;
+      if (iot_data_list_length (data)) size--;
+      break;
+    }
+    case IOT_DATA_POINTER:
+      size = 0u;
+      if (data->lazy) size = iot_data_lazy (data)->cbor ? iot_data_json_measure (iot_data_lazy_value (data)) : iot_data_lazy (data)->len;
+      break;
+    default: size = iot_data_json_ptr_size (iot_data_address (data), data->type); break;
+  }
+  return size;
+}
+
+extern size_t iot_data_json_size (const iot_data_t * data)
+{
+  assert (data);
+  return iot_data_json_measure (data);
+}
+
 extern char * iot_data_to_json (const iot_data_t * data)
 {
   return iot_data_to_json_with_size (data, IOT_JSON_BUFF_SIZE);
@@ -184,166 +265,741 @@ extern char * iot_data_to_json_with_size (const iot_data_t * data, uint32_t size
 
 extern char * iot_data_to_json_with_buffer (const iot_data_t * data, char * buff, uint32_t size)
 {
-  iot_string_holder_t holder;
+  iot_string_holder_t holder = { .str = buff, .size = size, .free = size - 1 }; // Allowing for string terminator
   assert (data && buff && size > 0);
-  holder.str = buff;
-  holder.size = size;
-  holder.free = size - 1; // Allowing for string terminator
   *buff = 0;
   iot_data_dump_json (&holder, data);
   return holder.str;
 }
 
-static char * iot_data_string_from_json_token (const char * json, const iot_json_tok_t * token)
+extern const char * iot_data_to_json_buffer (const iot_data_t * data, iot_data_buffer_t * buffer)
+{
+  assert (data && buffer);
+  iot_string_holder_t holder = { .str = (char*) buffer->data, .size = buffer->size, .free = buffer->size - 1 };
+  holder.str[0] = '\0';
+  iot_data_dump_json (&holder, data);
+  buffer->data = (uint8_t*) holder.str;
+  buffer->size = holder.size;
+  buffer->length = holder.size - holder.free - 1;
+  return holder.str;
+}
+
+extern bool iot_data_to_json_sink (const iot_data_t * data, iot_data_sink_fn sink, void * ctx, char * buff, size_t size)
+{
+  char local[IOT_JSON_SINK_BUFF_SIZE];
+  assert (data && sink && (buff == NULL || size >= IOT_JSON_SINK_MIN_SIZE));
+  iot_string_holder_t holder = { .str = buff ? buff : local, .size = buff ? size : sizeof (local), .sink = sink, .ctx = ctx };
+  holder.free = holder.size - 1;
+  holder.str[0] = '\0';
+  iot_data_dump_json (&holder, data);
+  iot_data_holder_flush (&holder);
+  return ! holder.failed;
+}
+
+static bool iot_data_fd_sink (void * ctx, const char * buff, size_t len)
 {
-  size_t len = (size_t) (token->end - token->start);
-  char * str = calloc (1u, len + 1u);
-  if (token->type == IOT_JSON_STRING_ESC)
+  int fd = *(int*) ctx;
+  while (len)
   {
-    const char *src = json + token->start;
-    char *dst = str;
-    while (src < json + token->start + len)
+    ssize_t ret = write (fd, buff, len);
+    if (ret < 0)
     {
-      if (*src == '\\')
+      if (errno == EINTR) continue;
+      return false;
+    }
+    buff += ret;
+    len -= (size_t) ret;
+  }
+  return true;
+}
+
+extern bool iot_data_to_json_fd (const iot_data_t * data, int fd)
+{
+  return iot_data_to_json_sink (data, iot_data_fd_sink, &fd, NULL, 0);
+}
+
+static bool iot_data_file_sink (void * ctx, const char * buff, size_t len)
+{
+  return fwrite (buff, 1u, len, (FILE*) ctx) == len;
+}
+
+extern bool iot_data_to_json_file (const iot_data_t * data, FILE * fp)
+{
+  assert (fp);
+  return iot_data_to_json_sink (data, iot_data_file_sink, fp, NULL, 0);
+}
+
+/* Precompiled encoder plan. Map plans hold the keys of the example map in output order, each with
+ * a pre-rendered fragment of the opening brace or separating comma and the quoted, escaped key.
+ * Vector plans hold a single element plan, and other plans only the expected data type.
+ */
+
+struct iot_data_json_plan_t
+{
+  iot_data_type_t type;                       // Expected data type
+  uint32_t count;                             // Number of map keys, or one for a vector element plan
+  const iot_data_t ** keys;                   // Map keys in output order
+  char ** fragments;                          // Map key fragments ('{' or ',' followed by "key":)
+  struct iot_data_json_plan_t * children;     // Map value plans or vector element plan
+};
+
+static void iot_data_json_plan_init (iot_data_json_plan_t * plan, const iot_data_t * example)
+{
+  plan->type = iot_data_type (example);
+  if (plan->type == IOT_DATA_MAP && iot_data_map_size (example))
+  {
+    bool ordered = iot_data_map_is_ordered (example);
+    iot_data_map_iter_t iter;
+    plan->count = iot_data_map_size (example);
+    plan->keys = malloc (sizeof (*plan->keys) * plan->count);
+    plan->fragments = malloc (sizeof (*plan->fragments) * plan->count);
+    plan->children = calloc (plan->count, sizeof (*plan->children));
+    iot_data_map_iter (example, &iter);
+    for (uint32_t i = 0; i < plan->count; i++)
+    {
+      const iot_data_t * value;
+      const iot_data_t * key;
+      if (ordered)
       {
-        switch (*++src)
-        {
-          case 'b': *dst++ = '\b'; break;
-          case 'f': *dst++ = '\f'; break;
-          case 'r': *dst++ = '\r'; break;
-          case 'n': *dst++ = '\n'; break;
-          case 't': *dst++ = '\t'; break;
-          case 'u':
-            if (src + 4 < json + token->start + len)
-            {
-              char32_t wc;
-              mbstate_t ps = { 0 };
-              sscanf (++src, "%4" SCNx32, &wc);
-              size_t charsz = c32rtomb (dst, wc, &ps);
-              if (charsz > 0) dst += charsz;
-              src += 3;
-            }
-            break;
-          default:
-            *dst++ = *src;
-        }
-        src++;
+        key = iot_data_map_ordered_key (example, i, &value);
       }
       else
       {
-        *dst++ = *src++;
+        iot_data_map_iter_next (&iter);
+        key = iot_data_map_iter_key (&iter);
+        value = iot_data_map_iter_value (&iter);
       }
+      char * json = iot_data_to_json (key);
+      bool quote = (iot_data_type (key) != IOT_DATA_STRING);
+      size_t len = strlen (json) + (quote ? 5u : 3u);
+      plan->fragments[i] = malloc (len);
+      snprintf (plan->fragments[i], len, quote ? "%c\"%s\":" : "%c%s:", i ? ',' : '{', json);
+      free (json);
+      plan->keys[i] = iot_data_add_ref (key);
+      iot_data_json_plan_init (&plan->children[i], value);
     }
   }
-  else
+  else if (plan->type == IOT_DATA_VECTOR && iot_data_vector_size (example))
   {
-    memcpy (str, json + token->start, len);
+    plan->count = 1u;
+    plan->children = calloc (1u, sizeof (*plan->children));
+    iot_data_json_plan_init (plan->children, iot_data_vector_get (example, 0u));
   }
-  return str;
 }
 
-static iot_data_t * iot_data_string_from_json (iot_json_tok_t ** tokens, const char * json, iot_data_t * cache)
+static void iot_data_json_plan_fini (iot_data_json_plan_t * plan)
+{
+  if (plan->type == IOT_DATA_MAP)
+  {
+    for (uint32_t i = 0; i < plan->count; i++)
+    {
+      iot_data_free ((iot_data_t*) plan->keys[i]);
+      free (plan->fragments[i]);
+      iot_data_json_plan_fini (&plan->children[i]);
+    }
+    free (plan->keys);
+    free (plan->fragments);
+  }
+  else if (plan->count)
+  {
+    iot_data_json_plan_fini (plan->children);
+  }
+  free (plan->children);
+}
+
+extern iot_data_json_plan_t * iot_data_json_plan_alloc (const iot_data_t * example)
+{
+  assert (example);
+  iot_data_json_plan_t * plan = calloc (1, sizeof (*plan));
+  iot_data_json_plan_init (plan, example);
+  return plan;
+}
+
+extern void iot_data_json_plan_free (iot_data_json_plan_t * plan)
+{
+  if (plan)
+  {
+    iot_data_json_plan_fini (plan);
+    free (plan);
+  }
+}
+
+/* Returns the key, and sets the value, of the next map entry in JSON output order */
+static inline const iot_data_t * iot_data_json_map_next (const iot_data_t * map, bool ordered, uint32_t index, iot_data_map_iter_t * iter, const iot_data_t ** value)
+{
+  if (ordered) return iot_data_map_ordered_key (map, index, value);
+  iot_data_map_iter_next (iter);
+  *value = iot_data_map_iter_value (iter);
+  return iot_data_map_iter_key (iter);
+}
+
+/* Checks that a map has the same keys in the same output order as a map plan */
+static bool iot_data_json_plan_match (const iot_data_json_plan_t * plan, const iot_data_t * map)
+{
+  if (iot_data_map_size (map) != plan->count) return false;
+  bool ordered = iot_data_map_is_ordered (map);
+  iot_data_map_iter_t iter;
+  iot_data_map_iter (map, &iter);
+  for (uint32_t i = 0; i < plan->count; i++)
+  {
+    const iot_data_t * value;
+    const iot_data_t * key = iot_data_json_map_next (map, ordered, i, &iter, &value);
+    if (key != plan->keys[i] && ! iot_data_equal (key, plan->keys[i])) return false;
+  }
+  return true;
+}
+
+static void iot_data_dump_json_plan (iot_string_holder_t * holder, const iot_data_json_plan_t * plan, const iot_data_t * data)
+{
+  switch ((data->type == plan->type) ? plan->type : IOT_DATA_INVALID)
+  {
+    case IOT_DATA_INT8: case IOT_DATA_UINT8: case IOT_DATA_INT16: case IOT_DATA_UINT16:
+    case IOT_DATA_INT32: case IOT_DATA_UINT32: case IOT_DATA_INT64: case IOT_DATA_UINT64:
+    case IOT_DATA_FLOAT32: case IOT_DATA_FLOAT64: case IOT_DATA_BOOL: case IOT_DATA_NULL:
+      iot_data_dump_json_ptr (holder, iot_data_address (data), plan->type);
+      break;
+    case IOT_DATA_STRING:
+      iot_data_add_quote (holder);
+      iot_data_strcat (holder, iot_data_string (data));
+      iot_data_add_quote (holder);
+      break;
+    case IOT_DATA_MAP:
+    {
+      if (plan->count == 0u || ! iot_data_json_plan_match (plan, data))
+      {
+        iot_data_dump_json (holder, data);
+        break;
+      }
+      bool ordered = iot_data_map_is_ordered (data);
+      iot_data_map_iter_t iter;
+      iot_data_map_iter (data, &iter);
+      for (uint32_t i = 0; i < plan->count; i++)
+      {
+        const iot_data_t * value;
+        iot_data_json_map_next (data, ordered, i, &iter, &value);
+        iot_data_strcat_escape (holder, plan->fragments[i], false);
+        iot_data_dump_json_plan (holder, &plan->children[i], value);
+      }
+      iot_data_strcat_escape (holder, "}", false);
+      break;
+    }
+    case IOT_DATA_VECTOR:
+    {
+      if (plan->count == 0u)
+      {
+        iot_data_dump_json (holder, data);
+        break;
+      }
+      uint32_t size = iot_data_vector_size (data);
+      iot_data_strcat_escape (holder, "[", false);
+      for (uint32_t i = 0; i < size; i++)
+      {
+        if (i) iot_data_strcat_escape (holder, ",", false);
+        iot_data_dump_json_plan (holder, plan->children, iot_data_vector_get (data, i));
+      }
+      iot_data_strcat_escape (holder, "]", false);
+      break;
+    }
+    default: iot_data_dump_json (holder, data); break;
+  }
+}
+
+extern char * iot_data_to_json_with_plan (const iot_data_t * data, const iot_data_json_plan_t * plan)
+{
+  assert (data && plan);
+  iot_string_holder_t holder = { .str = malloc (IOT_JSON_BUFF_SIZE), .size = IOT_JSON_BUFF_SIZE, .free = IOT_JSON_BUFF_SIZE - 1 };
+  holder.str[0] = '\0';
+  iot_data_dump_json_plan (&holder, plan, data);
+  return holder.str;
+}
+
+/* Single pass recursive descent JSON decoder. Values are built directly from the JSON text, with
+ * vector elements held on a scratch stack until the enclosing container is complete.
+ * Strings are decoded into a scratch buffer and looked up in the string cache before being allocated.
+ * As with the tokenizer, any unquoted value is treated as a primitive.
+ */
+
+typedef struct iot_json_path_t
+{
+  const iot_data_t ** elements;       // Path keys and indexes, null value matches any
+  uint32_t length;                    // Path length
+} iot_json_path_t;
+
+typedef struct iot_json_decoder_t
+{
+  const char * json;                  // Current decode position
+  const char * end;                   // End of input (terminating nul)
+  iot_data_t * cache;                 // String cache
+  bool ordered;                       // Whether maps record key ordering
+  uint32_t depth;                     // Current nesting depth
+  iot_data_t ** stack;                // Scratch stack of vector elements
+  uint32_t top;                       // Stack top
+  uint32_t capacity;                  // Stack capacity
+  char * buff;                        // Scratch string buffer
+  size_t size;                        // Scratch string buffer size
+  char * str;                         // Last decoded string
+  size_t len;                         // Last decoded string length
+  bool in_situ;                       // Whether strings are decoded in place in the input
+  iot_data_t * backing;               // Owner of the input when decoding in situ, NULL if not owned
+  const iot_json_path_t * paths;      // Selected paths when decoding selectively, NULL otherwise
+  uint64_t select;                    // Paths matching the current value, zero if the complete value is selected
+  uint32_t lazy;                      // Levels of nesting decoded before containers are kept lazy, zero if all decoded
+} iot_json_decoder_t;
+
+static bool iot_json_decode_value (iot_json_decoder_t * dec, iot_data_t ** value);
+
+static inline void iot_json_skip_ws (iot_json_decoder_t * dec)
+{
+  while (*dec->json == ' ' || *dec->json == '\n' || *dec->json == '\r' || *dec->json == '\t') dec->json++;
+}
+
+static inline void iot_json_push (iot_json_decoder_t * dec, iot_data_t * data)
+{
+  if (dec->top == dec->capacity)
+  {
+    dec->capacity = dec->capacity ? dec->capacity * 2u : IOT_JSON_STACK_SIZE;
+    dec->stack = realloc (dec->stack, dec->capacity * sizeof (iot_data_t*));
+  }
+  dec->stack[dec->top++] = data;
+}
+
+static void iot_json_pop (iot_json_decoder_t * dec, uint32_t base)
+{
+  while (dec->top > base) iot_data_free (dec->stack[--dec->top]);
+}
+
+static inline char * iot_json_reserve (iot_json_decoder_t * dec, size_t len)
+{
+  if (len >= dec->size)
+  {
+    dec->size = len + IOT_JSON_BUFF_SIZE;
+    dec->buff = realloc (dec->buff, dec->size);
+  }
+  return dec->buff;
+}
+
+/* Skips a value without decoding it, checking only string and bracket structure */
+static bool iot_json_skip_value (iot_json_decoder_t * dec)
+{
+  uint32_t depth = 0;
+  const char * ptr = dec->json;
+  do
+  {
+    switch (*ptr)
+    {
+      case '\0': return false;
+      case '"':
+        ptr++;
+        while (true)
+        {
+          ptr += iot_data_json_scan (ptr, (size_t) (dec->end - ptr));
+          if (*ptr == '"') break;
+          if (*ptr == '\0' || (*ptr == '\\' && *++ptr == '\0')) return false;
+          ptr++;
+        }
+        ptr++;
+        break;
+      case '{': case '[': depth++; ptr++; break;
+      case '}': case ']':
+        if (depth == 0) return false;
+        depth--;
+        ptr++;
+        break;
+      default:
+        if (depth == 0) // Top level primitive
+        {
+          while (*ptr && *ptr != ',' && *ptr != '}' && *ptr != ']' && *ptr != ' ' && *ptr != '\t' && *ptr != '\r' && *ptr != '\n') ptr++;
+        }
+        else
+        {
+          ptr++;
+        }
+        break;
+    }
+  } while (depth);
+  dec->json = ptr;
+  return true;
+}
+
+/* Determines which selected paths match a map key or vector index at the current depth. Returns false if
+ * none match, otherwise sets the matching paths, or zero if a path ends here so the value is fully selected.
+ */
+static bool iot_json_select (const iot_json_decoder_t * dec, const iot_data_t * key, uint32_t index, uint64_t * select)
+{
+  uint64_t matched = 0u;
+  uint32_t pos = dec->depth - 1u;
+  for (uint64_t paths = dec->select; paths; paths &= paths - 1u)
+  {
+    uint32_t i = (uint32_t) __builtin_ctzll (paths);
+    const iot_json_path_t * path = &dec->paths[i];
+    const iot_data_t * elem = path->elements[pos];
+    bool match = (elem->type == IOT_DATA_NULL) || (key ? iot_data_equal (elem, key) : (elem->type == IOT_DATA_UINT32 && iot_data_ui32 (elem) == index));
+    if (match)
+    {
+      if (path->length == pos + 1u)
+      {
+        *select = 0u;
+        return true;
+      }
+      matched |= (uint64_t) 1u << i;
+    }
+  }
+  *select = matched;
+  return matched != 0u;
+}
+
+static inline int iot_json_hex (char c)
+{
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+static bool iot_json_decode_u16 (const char * src, uint32_t * val)
 {
-  iot_data_t * str = iot_data_alloc_string (iot_data_string_from_json_token (json, *tokens), IOT_DATA_TAKE);
-  (*tokens)++;
-  const iot_data_t * cached = iot_data_map_get (cache, str);
-  if (cached)
+  *val = 0u;
+  for (int i = 0; i < 4; i++)
   {
-    iot_data_free (str);
-    str = (iot_data_t*) cached;
+    int h = iot_json_hex (src[i]);
+    if (h < 0) return false;
+    *val = (*val << 4) | (uint32_t) h;
+  }
+  return true;
+}
+
+static char * iot_json_encode_utf8 (char * dst, uint32_t cp)
+{
+  if (cp < 0x80u)
+  {
+    *dst++ = (char) cp;
+  }
+  else if (cp < 0x800u)
+  {
+    *dst++ = (char) (0xc0u | (cp >> 6));
+    *dst++ = (char) (0x80u | (cp & 0x3fu));
+  }
+  else if (cp < 0x10000u)
+  {
+    *dst++ = (char) (0xe0u | (cp >> 12));
+    *dst++ = (char) (0x80u | ((cp >> 6) & 0x3fu));
+    *dst++ = (char) (0x80u | (cp & 0x3fu));
   }
   else
   {
-    iot_data_map_add (cache, str, iot_data_add_ref (str));
+    *dst++ = (char) (0xf0u | (cp >> 18));
+    *dst++ = (char) (0x80u | ((cp >> 12) & 0x3fu));
+    *dst++ = (char) (0x80u | ((cp >> 6) & 0x3fu));
+    *dst++ = (char) (0x80u | (cp & 0x3fu));
   }
-  return iot_data_add_ref (str);
+  return dst;
 }
 
-static iot_data_t * iot_data_primitive_from_json (iot_json_tok_t ** tokens, const char * json)
+/* Decodes string starting after opening quote into scratch buffer, or in place if decoding in situ,
+ * setting the decoded string and length. Returns length or -1 on error. */
+static ssize_t iot_json_decode_chars (iot_json_decoder_t * dec)
 {
-  iot_data_t * ret = NULL;
-  char * str = iot_data_string_from_json_token (json, *tokens);
-  (*tokens)++;
-  switch (str[0])
+  const char * src = dec->json;
+  const char * end = src;
+  while (true)
   {
-    case 't': case 'f': ret = iot_data_alloc_bool (str[0] == 't'); break; // true/false
-    case 'n': ret = iot_data_alloc_null (); break; // null
-    default: // Handle all floating point numbers as doubles, all integers as int64_t unless to big in which case as uint64_t
+    end += iot_data_json_scan (end, (size_t) (dec->end - end));
+    if (*end == '"' || *end == '\\' || *end == '\0') break;
+    end++; // Unescaped control character
+  }
+  size_t len = (size_t) (end - src);
+  if (*end == '"') // Unescaped
+  {
+    char * dst = dec->in_situ ? (char*) src : iot_json_reserve (dec, len);
+    if (! dec->in_situ) memcpy (dst, src, len);
+    dst[len] = '\0';
+    dec->str = dst;
+    dec->len = len;
+    dec->json = end + 1;
+    return (ssize_t) len;
+  }
+  while (*end != '"')
+  {
+    if (*end == '\0') return -1;
+    if (*end++ == '\\' && *end++ == '\0') return -1;
+    end += iot_data_json_scan (end, (size_t) (dec->end - end));
+  }
+  char * dst = dec->in_situ ? (char*) src : iot_json_reserve (dec, (size_t) (end - src)); // Decoded string never longer than escaped
+  char * start = dst;
+  while (src < end)
+  {
+    if (*src != '\\')
     {
-      if (strchr (str, '.') || strchr (str, 'e') || strchr (str, 'E'))
+      size_t run = iot_data_json_scan (src, (size_t) (end - src));
+      if (run == 0) run = 1; // Unescaped control character
+      memmove (dst, src, run);
+      dst += run;
+      src += run;
+      continue;
+    }
+    switch (*++src)
+    {
+      case '"': case '/': case '\\': *dst++ = *src; break;
+      case 'b': *dst++ = '\b'; break;
+      case 'f': *dst++ = '\f'; break;
+      case 'r': *dst++ = '\r'; break;
+      case 'n': *dst++ = '\n'; break;
+      case 't': *dst++ = '\t'; break;
+      case 'u':
       {
-        ret = iot_data_alloc_f64 (strtod (str, NULL));
+        uint32_t cp;
+        if ((end - src) < 5 || !iot_json_decode_u16 (src + 1, &cp)) return -1;
+        src += 4;
+        if (cp >= 0xd800u && cp < 0xdc00u && (end - src) >= 7 && src[1] == '\\' && src[2] == 'u') // Surrogate pair
+        {
+          uint32_t low;
+          if (iot_json_decode_u16 (src + 3, &low) && low >= 0xdc00u && low < 0xe000u)
+          {
+            cp = 0x10000u + ((cp - 0xd800u) << 10) + (low - 0xdc00u);
+            src += 6;
+          }
+        }
+        dst = iot_json_encode_utf8 (dst, cp);
+        break;
       }
-      else if (strchr (str, '-'))
+      default: return -1;
+    }
+    src++;
+  }
+  *dst = '\0';
+  dec->str = start;
+  dec->len = (size_t) (dst - start);
+  dec->json = end + 1;
+  return dst - start;
+}
+
+static iot_data_t * iot_json_cached_string (iot_json_decoder_t * dec)
+{
+  iot_data_static_t lookup;
+  const iot_data_t * cached = iot_data_map_get (dec->cache, iot_data_alloc_const_string (&lookup, dec->str));
+  if (cached) return iot_data_add_ref (cached);
+  bool view = dec->in_situ && (dec->str != dec->buff); // Unquoted keys are always decoded into the scratch buffer
+  iot_data_t * str = view ? iot_data_alloc_string_view (dec->str, dec->len, dec->backing) : iot_data_alloc_string (dec->str, IOT_DATA_COPY);
+  iot_data_map_add (dec->cache, iot_data_add_ref (str), iot_data_add_ref (str));
+  return str;
+}
+
+static bool iot_json_decode_string (iot_json_decoder_t * dec, iot_data_t ** value)
+{
+  dec->json++; // Skip quote
+  if (iot_json_decode_chars (dec) < 0) return false;
+  *value = iot_json_cached_string (dec);
+  return true;
+}
+
+/* Decodes an unquoted value, either as a string (map key) or as a primitive */
+static bool iot_json_decode_primitive (iot_json_decoder_t * dec, iot_data_t ** value, bool key)
+{
+  const char * start = dec->json;
+  const char * end = start;
+  while (true)
+  {
+    char c = *end;
+    if (c == '\0' || c == ':' || c == ',' || c == ']' || c == '}' || c == ' ' || c == '\t' || c == '\r' || c == '\n') break;
+    if (c < 32 || c >= 127) return false;
+    end++;
+  }
+  if (end == start) return false;
+  dec->json = end;
+  if (key)
+  {
+    size_t len = (size_t) (end - start);
+    char * str = iot_json_reserve (dec, len);
+    memcpy (str, start, len);
+    str[len] = '\0';
+    dec->str = str;
+    dec->len = len;
+    *value = iot_json_cached_string (dec);
+    return true;
+  }
+  switch (start[0]) // Numbers are parsed in place, the token is delimited by a non numeric character
+  {
+    case 't': case 'f': *value = iot_data_alloc_bool (start[0] == 't'); break; // true/false
+    case 'n': *value = iot_data_alloc_null (); break; // null
+    default: // Handle all floating point numbers as doubles, all integers as int64_t unless to big in which case as uint64_t
+    {
+      const char * ptr = start;
+      while (ptr < end && *ptr != '.' && *ptr != 'e' && *ptr != 'E') ptr++;
+      if (ptr < end)
       {
-        errno = 0;
-        unsigned long long int temp = strtoull (str + 1, NULL, 10); // Skip '-' for strtoull
-        if (errno == ERANGE || temp > (unsigned long long) INT64_MAX + 1) ret = NULL;
-        else ret = iot_data_alloc_i64 (-(int64_t)temp); // add the '-' back
+        double d;
+        iot_data_parse_f64 (start, &d);
+        *value = iot_data_alloc_f64 (d);
       }
       else
       {
-        errno = 0;
-        unsigned long long int temp = strtoull (str, NULL, 10);
-        if (errno == ERANGE || temp > (unsigned long long) UINT64_MAX) ret = NULL;
+        uint64_t mag = 0u;
+        bool neg = false;
+        if (iot_data_parse_int (start, &mag, &neg) == NULL)
+        {
+          ptr = start + ((*start == '-' || *start == '+') ? 1 : 0);
+          *value = (*ptr >= '0' && *ptr <= '9') ? NULL : iot_data_alloc_i64 (0); // Out of range or not a number
+        }
+        else if (neg)
+        {
+          *value = (mag > (uint64_t) INT64_MAX + 1u) ? NULL : iot_data_alloc_i64 ((int64_t) (0u - mag));
+        }
         else
         {
-          uint64_t ui64 = (uint64_t) temp;
-          ret = (ui64 <= INT64_MAX) ? iot_data_alloc_i64 ((int64_t) ui64) : iot_data_alloc_ui64 (ui64);
+          *value = (mag <= INT64_MAX) ? iot_data_alloc_i64 ((int64_t) mag) : iot_data_alloc_ui64 (mag);
         }
       }
       break;
     }
   }
-  free (str);
-  return ret;
+  return true;
 }
 
-static iot_data_t * iot_data_map_from_json (iot_json_tok_t ** tokens, const char * json, bool ordered, iot_data_t * cache)
+static bool iot_json_decode_map (iot_json_decoder_t * dec, iot_data_t ** value)
 {
-  uint32_t elements = (*tokens)->size;
-  iot_data_t * map = iot_data_alloc_map (IOT_DATA_STRING);
-  iot_data_t * ordering = ordered ? iot_data_alloc_vector (elements) : NULL;
-  uint32_t i = 0;
-
-  (*tokens)++;
-  while  (elements--)
+  iot_data_t * map = dec->ordered ? iot_data_alloc_ordered_map (IOT_DATA_STRING) : iot_data_alloc_map (IOT_DATA_STRING);
+  dec->json++; // Skip '{'
+  while (true)
   {
-    iot_data_t * key = iot_data_string_from_json (tokens, json, cache);
-    if (ordered) iot_data_vector_add (ordering, i++, iot_data_add_ref (key));
-    iot_data_t * val = iot_data_value_from_json (tokens, json, ordered, cache);
-    if (val) iot_data_map_add (map, key, val);
+    iot_data_t * key;
+    iot_data_t * val = NULL;
+    bool ok;
+    iot_json_skip_ws (dec);
+    if (*dec->json == '}') break;
+    if (! ((*dec->json == '"') ? iot_json_decode_string (dec, &key) : iot_json_decode_primitive (dec, &key, true))) goto error;
+    iot_json_skip_ws (dec);
+    if (*dec->json++ != ':')
+    {
+      iot_data_free (key);
+      goto error;
+    }
+    uint64_t select = dec->select;
+    if (select && ! iot_json_select (dec, key, 0u, &dec->select)) // Not selected
+    {
+      iot_json_skip_ws (dec);
+      ok = iot_json_skip_value (dec);
+      iot_data_free (key);
+      key = NULL;
+    }
+    else
+    {
+      ok = iot_json_decode_value (dec, &val);
+    }
+    dec->select = select;
+    if (! ok)
+    {
+      iot_data_free (key);
+      goto error;
+    }
+    if (key == NULL) goto next;
+    if (val)
+    {
+      iot_data_map_add (map, key, val);
+    }
+    else
+    {
+      iot_data_free (key);
+    }
+next:
+    iot_json_skip_ws (dec);
+    if (*dec->json == ',')
+    {
+      dec->json++;
+    }
+    else if (*dec->json != '}')
+    {
+      goto error;
+    }
   }
-  if (ordered) iot_data_set_metadata (map, ordering,IOT_DATA_STATIC (&iot_data_order));
-  return map;
+  dec->json++; // Skip '}'
+  *value = map;
+  return true;
+
+error:
+  iot_data_free (map);
+  return false;
 }
 
-static iot_data_t * iot_data_vector_from_json (iot_json_tok_t ** tokens, const char * json, bool ordered, iot_data_t * cache)
+static bool iot_json_decode_vector (iot_json_decoder_t * dec, iot_data_t ** value)
 {
-  uint32_t elements = (*tokens)->size;
-  uint32_t index = 0;
-  iot_data_t * vector = iot_data_alloc_vector (elements);
-
-  (*tokens)++;
-  while (elements--)
+  uint32_t base = dec->top;
+  uint32_t index = 0u;
+  dec->json++; // Skip '['
+  while (true)
   {
-    iot_data_t * val = iot_data_value_from_json (tokens, json, ordered, cache);
-    if (val) iot_data_vector_add (vector, index++, val);
+    iot_data_t * val = NULL;
+    iot_json_skip_ws (dec);
+    if (*dec->json == ']') break;
+    uint64_t select = dec->select;
+    if (select && ! iot_json_select (dec, NULL, index, &dec->select)) // Not selected, replace with null to retain indexes
+    {
+      if (! iot_json_skip_value (dec)) goto error;
+      val = iot_data_alloc_null ();
+    }
+    else if (! iot_json_decode_value (dec, &val))
+    {
+      dec->select = select;
+      goto error;
+    }
+    dec->select = select;
+    index++;
+    if (val) iot_json_push (dec, val);
+    iot_json_skip_ws (dec);
+    if (*dec->json == ',')
+    {
+      dec->json++;
+    }
+    else if (*dec->json != ']')
+    {
+      goto error;
+    }
   }
-  return vector;
+  dec->json++; // Skip ']'
+  iot_data_t * vector = iot_data_alloc_vector (dec->top - base);
+  for (uint32_t i = base; i < dec->top; i++) iot_data_vector_add (vector, i - base, dec->stack[i]);
+  dec->top = base;
+  *value = vector;
+  return true;
+
+error:
+  iot_json_pop (dec, base);
+  return false;
 }
 
-static iot_data_t * iot_data_value_from_json (iot_json_tok_t ** tokens, const char * json, bool ordered, iot_data_t * cache)
+static iot_data_t * iot_json_lazy_decode (const iot_data_lazy_t * lazy)
 {
-  iot_data_t * data = NULL;
-  switch ((*tokens)->type)
+  return iot_data_from_json_with_ordering (lazy->bytes, lazy->ordered);
+}
+
+/* Skips a container, keeping a copy of its text to be decoded on first access */
+static bool iot_json_decode_lazy (iot_json_decoder_t * dec, iot_data_t ** value)
+{
+  const char * start = dec->json;
+  if (! iot_json_skip_value (dec)) return false;
+  *value = iot_data_alloc_lazy (start, (size_t) (dec->json - start), false, dec->ordered, iot_json_lazy_decode);
+  return true;
+}
+
+/* Decodes a value, returning false on syntax error. Value is set NULL for unrepresentable numbers. */
+static bool iot_json_decode_value (iot_json_decoder_t * dec, iot_data_t ** value)
+{
+  bool ok;
+  iot_json_skip_ws (dec);
+  if (++dec->depth > IOT_JSON_MAX_DEPTH) return false;
+  if (dec->lazy && dec->depth > dec->lazy && (*dec->json == '{' || *dec->json == '['))
+  {
+    ok = iot_json_decode_lazy (dec, value);
+  }
+  else switch (*dec->json)
   {
-    case IOT_JSON_PRIMITIVE: data = iot_data_primitive_from_json (tokens, json); break;
-    case IOT_JSON_OBJECT: data = iot_data_map_from_json (tokens, json, ordered, cache); break;
-    case IOT_JSON_ARRAY: data = iot_data_vector_from_json (tokens, json, ordered, cache); break;
-    default: data = iot_data_string_from_json (tokens, json, cache); break;
+    case '{': ok = iot_json_decode_map (dec, value); break;
+    case '[': ok = iot_json_decode_vector (dec, value); break;
+    case '"': ok = iot_json_decode_string (dec, value); break;
+    case '\0': case '}': case ']': case ',': case ':': ok = false; break;
+    default: ok = iot_json_decode_primitive (dec, value, false); break;
   }
-  return data;
+  dec->depth--;
+  return ok;
 }
 
 extern iot_data_t * iot_data_from_json (const char * json)
@@ -359,39 +1015,286 @@ extern iot_data_t * iot_data_from_json_with_ordering (const char * json, bool or
 extern iot_data_t * iot_data_from_json_with_cache (const char * json, bool ordered, iot_data_t * cache)
 {
   iot_data_t * data = NULL;
-  const char * ptr = json;
 
   assert ((cache == NULL) || iot_data_map_key_is_of_type (cache, IOT_DATA_STRING));
 
-  if (ptr && *ptr)
+  if (json && *json)
   {
-    iot_json_parser parser;
-    int32_t used;
-    uint32_t count = 1;
+    iot_json_decoder_t dec = { .json = json, .end = json + strlen (json), .ordered = ordered };
+    dec.cache = cache ? cache : iot_data_alloc_map (IOT_DATA_STRING);
+    if (! iot_json_decode_value (&dec, &data)) data = NULL;
+    if (cache == NULL) iot_data_free (dec.cache);
+    free (dec.stack);
+    free (dec.buff);
+  }
+  return data ? data : iot_data_alloc_null ();
+}
 
-    // Approximate token count
-    while (*ptr != '\0')
+extern iot_data_t * iot_data_from_json_select (const char * json, const iot_data_t * paths, bool ordered)
+{
+  iot_data_t * data = NULL;
+  uint32_t npaths = iot_data_vector_size (paths);
+  assert (json && paths && npaths <= IOT_JSON_MAX_PATHS);
+  if (*json && npaths)
+  {
+    iot_json_path_t selected[IOT_JSON_MAX_PATHS];
+    iot_json_decoder_t dec = { .json = json, .end = json + strlen (json), .ordered = ordered, .paths = selected };
+    dec.select = (npaths == IOT_JSON_MAX_PATHS) ? UINT64_MAX : (((uint64_t) 1u << npaths) - 1u);
+    for (uint32_t i = 0; i < npaths; i++)
     {
-      switch (*ptr)
-      {
-        case ',': case '{': count++; break;
-        case ':': case '[': count += 2; break;
-        default: break;
-      }
-      ptr++;
+      const iot_data_t * path = iot_data_vector_get (paths, i);
+      iot_data_list_iter_t iter;
+      uint32_t len = 0;
+      selected[i].length = iot_data_list_length (path);
+      selected[i].elements = malloc (sizeof (iot_data_t*) * (selected[i].length + 1u));
+      iot_data_list_iter (path, &iter);
+      while (iot_data_list_iter_prev (&iter)) selected[i].elements[len++] = iot_data_list_iter_value (&iter); // Head first, as iot_data_get_at
+      if (len == 0u) dec.select = 0u; // Empty path selects everything
     }
-    iot_json_tok_t *tokens = calloc (1, sizeof (*tokens) * count);
-    iot_json_tok_t *tptr = tokens;
+    dec.cache = iot_data_alloc_map (IOT_DATA_STRING);
+    if (! iot_json_decode_value (&dec, &data)) data = NULL;
+    for (uint32_t i = 0; i < npaths; i++) free (selected[i].elements);
+    iot_data_free (dec.cache);
+    free (dec.stack);
+    free (dec.buff);
+  }
+  return data ? data : iot_data_alloc_null ();
+}
+
+extern iot_data_t * iot_data_from_json_lazy (const char * json, uint32_t depth, bool ordered)
+{
+  iot_data_t * data = NULL;
+  assert (json);
+  if (*json)
+  {
+    iot_json_decoder_t dec = { .json = json, .end = json + strlen (json), .ordered = ordered, .lazy = depth };
+    dec.cache = iot_data_alloc_map (IOT_DATA_STRING);
+    if (! iot_json_decode_value (&dec, &data)) data = NULL;
+    iot_data_free (dec.cache);
+    free (dec.stack);
+    free (dec.buff);
+  }
+  return data ? data : iot_data_alloc_null ();
+}
+
+extern iot_data_t * iot_data_from_json_in_situ (char * json, iot_data_ownership_t ownership, bool ordered)
+{
+  iot_data_t * data = NULL;
+  assert (json);
+  if (*json)
+  {
+    iot_json_decoder_t dec = { .ordered = ordered, .in_situ = true };
+    if (ownership == IOT_DATA_COPY) json = strdup (json);
+    if (ownership != IOT_DATA_REF) dec.backing = iot_data_alloc_pointer (json, free);
+    dec.json = json;
+    dec.end = json + strlen (json);
+    dec.cache = iot_data_alloc_map (IOT_DATA_STRING);
+    if (! iot_json_decode_value (&dec, &data)) data = NULL;
+    iot_data_free (dec.cache);
+    iot_data_free (dec.backing); // Released with last referencing string
+    free (dec.stack);
+    free (dec.buff);
+  }
+  else if (ownership == IOT_DATA_TAKE)
+  {
+    free (json);
+  }
+  return data ? data : iot_data_alloc_null ();
+}
+
+/* Incremental JSON stream. Input is scanned once for top level value boundaries, tracking string and nesting
+ * state across buffers, and copied into an accumulation buffer. Each complete value is decoded in a single
+ * pass, reusing the decoder scratch buffers and string cache, and passed to the stream callback. The string
+ * cache is emptied once it exceeds a fixed number of entries, so that memory use does not grow with the
+ * number of distinct strings streamed while keys repeated across values remain shared.
+ */
+
+typedef enum iot_json_stream_state_t
+{
+  IOT_JSON_STREAM_IDLE,       // Between values
+  IOT_JSON_STREAM_CONTAINER,  // In object or array
+  IOT_JSON_STREAM_STRING,     // In string
+  IOT_JSON_STREAM_ESCAPE,     // In string following backslash
+  IOT_JSON_STREAM_PRIMITIVE   // In top level unquoted value
+} iot_json_stream_state_t;
+
+struct iot_data_json_stream_t
+{
+  iot_data_json_stream_fn fn;         // Value callback
+  void * arg;                         // Value callback argument
+  iot_json_decoder_t dec;             // Decoder with scratch buffers and string cache
+  iot_json_stream_state_t state;      // Scan state
+  uint32_t depth;                     // Container nesting depth
+  char * buff;                        // Accumulated value text
+  size_t len;                         // Accumulated value length
+  size_t size;                        // Accumulation buffer size
+};
+
+iot_data_json_stream_t * iot_data_json_stream_alloc (iot_data_json_stream_fn fn, void * arg, bool ordered)
+{
+  assert (fn);
+  iot_data_json_stream_t * stream = calloc (1, sizeof (*stream));
+  stream->fn = fn;
+  stream->arg = arg;
+  stream->dec.ordered = ordered;
+  stream->dec.cache = iot_data_alloc_map (IOT_DATA_STRING);
+  stream->size = IOT_JSON_BUFF_SIZE;
+  stream->buff = malloc (stream->size);
+  return stream;
+}
+
+void iot_data_json_stream_free (iot_data_json_stream_t * stream)
+{
+  if (stream)
+  {
+    iot_data_free (stream->dec.cache);
+    free (stream->dec.stack);
+    free (stream->dec.buff);
+    free (stream->buff);
+    free (stream);
+  }
+}
+
+static void iot_json_stream_append (iot_data_json_stream_t * stream, const char * str, size_t len)
+{
+  if (stream->len + len >= stream->size)
+  {
+    while (stream->len + len >= stream->size) stream->size *= 2u;
+    stream->buff = realloc (stream->buff, stream->size);
+  }
+  memcpy (stream->buff + stream->len, str, len);
+  stream->len += len;
+}
+
+static bool iot_json_stream_emit (iot_data_json_stream_t * stream)
+{
+  iot_data_t * data = NULL;
+  stream->buff[stream->len] = '\0';
+  stream->dec.json = stream->buff;
+  stream->dec.end = stream->buff + stream->len;
+  stream->dec.depth = 0;
+  stream->dec.top = 0;
+  bool ok = iot_json_decode_value (&stream->dec, &data);
+  stream->len = 0;
+  stream->depth = 0;
+  stream->state = IOT_JSON_STREAM_IDLE;
+  if (iot_data_map_size (stream->dec.cache) > IOT_JSON_STREAM_CACHE_MAX) iot_data_map_empty (stream->dec.cache);
+  if (ok) stream->fn (data ? data : iot_data_alloc_null (), stream->arg);
+  return ok;
+}
 
-    iot_json_init (&parser);
-    used = iot_json_parse (&parser, json, strlen (json), tptr, count);
-    if (used && (used <= count))
+bool iot_data_json_stream_write (iot_data_json_stream_t * stream, const char * buff, size_t len)
+{
+  assert (stream && (buff || len == 0));
+  bool ok = true;
+  const char * end = buff + len;
+  const char * mark = buff; // Start of input not yet appended
+  const char * ptr = buff;
+  while (ptr < end)
+  {
+    char c = *ptr;
+    switch (stream->state)
     {
-      iot_data_t * km = cache ? cache : iot_data_alloc_map (IOT_DATA_STRING);
-      data = iot_data_value_from_json (&tptr, json, ordered, km);
-      if (cache == NULL) iot_data_free (km);
+      case IOT_JSON_STREAM_IDLE:
+        mark = ptr;
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == ',') // Values separated by whitespace or commas
+        {
+          mark = ++ptr;
+          continue;
+        }
+        if (c == '{' || c == '[')
+        {
+          stream->depth = 1;
+          stream->state = IOT_JSON_STREAM_CONTAINER;
+        }
+        else if (c == '"')
+        {
+          stream->state = IOT_JSON_STREAM_STRING;
+        }
+        else if (c == '}' || c == ']' || c == ':' || c == '\0')
+        {
+          mark = ++ptr; // Skip invalid character
+          ok = false;
+          continue;
+        }
+        else
+        {
+          stream->state = IOT_JSON_STREAM_PRIMITIVE;
+        }
+        ptr++;
+        break;
+      case IOT_JSON_STREAM_CONTAINER:
+        ptr++;
+        switch (c)
+        {
+          case '"': stream->state = IOT_JSON_STREAM_STRING; break;
+          case '{': case '[': stream->depth++; break;
+          case '}': case ']':
+            if (--stream->depth == 0)
+            {
+              iot_json_stream_append (stream, mark, (size_t) (ptr - mark));
+              mark = ptr;
+              ok = iot_json_stream_emit (stream) && ok;
+            }
+            break;
+          default: break;
+        }
+        break;
+      case IOT_JSON_STREAM_STRING:
+        ptr += iot_data_json_scan (ptr, (size_t) (end - ptr)); // Skip plain string content
+        if (ptr == end) break;
+        c = *ptr++;
+        if (c == '\\')
+        {
+          stream->state = IOT_JSON_STREAM_ESCAPE;
+        }
+        else if (c == '"')
+        {
+          stream->state = stream->depth ? IOT_JSON_STREAM_CONTAINER : IOT_JSON_STREAM_IDLE;
+          if (stream->depth == 0)
+          {
+            iot_json_stream_append (stream, mark, (size_t) (ptr - mark));
+            mark = ptr;
+            ok = iot_json_stream_emit (stream) && ok;
+          }
+        }
+        break;
+      case IOT_JSON_STREAM_ESCAPE:
+        ptr++;
+        stream->state = IOT_JSON_STREAM_STRING;
+        break;
+      default: // IOT_JSON_STREAM_PRIMITIVE
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == ',')
+        {
+          iot_json_stream_append (stream, mark, (size_t) (ptr - mark));
+          mark = ++ptr;
+          ok = iot_json_stream_emit (stream) && ok;
+        }
+        else
+        {
+          ptr++;
+        }
+        break;
     }
-    free (tokens);
   }
-  return data ? data : iot_data_alloc_null ();
+  if (stream->state != IOT_JSON_STREAM_IDLE) iot_json_stream_append (stream, mark, (size_t) (end - mark)); // Partial value
+  return ok;
+}
+
+bool iot_data_json_stream_end (iot_data_json_stream_t * stream)
+{
+  assert (stream);
+  bool ok = true;
+  if (stream->state == IOT_JSON_STREAM_PRIMITIVE)
+  {
+    ok = iot_json_stream_emit (stream);
+  }
+  else if (stream->state != IOT_JSON_STREAM_IDLE) // Discard incomplete value
+  {
+    stream->len = 0;
+    stream->depth = 0;
+    stream->state = IOT_JSON_STREAM_IDLE;
+    ok = false;
+  }
+  return ok;
 }
@@ -0,0 +1,525 @@
+//
+// Copyright (c) 2023 IOTech
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+#include "iot/data.h"
+#include "data-impl.h"
+
+/* MessagePack encoding and decoding of iot_data. Integers are encoded in the smallest format holding
+ * the value, floats at full width, vectors and lists as arrays and binary data as bin. Numeric and
+ * boolean arrays are encoded as ext values, of type IOT_MSGPACK_EXT_ARRAY plus the element type,
+ * holding the elements as a little endian block. Pointers are encoded as nil.
+ */
+
+#define IOT_MSGPACK_BUFF_DOUBLING_LIMIT 4096u
+#define IOT_MSGPACK_BUFF_INCREMENT 1024u
+#define IOT_MSGPACK_MAX_DEPTH 512u
+#define IOT_MSGPACK_EXT_ARRAY 16u
+
+typedef struct iot_msgpack_holder_t
+{
+  uint8_t * data;
+  size_t size;
+  size_t index;
+} iot_msgpack_holder_t;
+
+/* Formats of a family of length prefixed values (str, bin, array, map, ext) */
+typedef struct iot_msgpack_fmt_t
+{
+  uint8_t fix;            // Fix format, holding the length in its low bits, zero if none
+  uint8_t fix_max;        // Maximum length of the fix format
+  uint8_t fmt8;           // Format with 8 bit length, zero if none
+  uint8_t fmt16;          // Format with 16 bit length, followed by the format with 32 bit length
+} iot_msgpack_fmt_t;
+
+static const iot_msgpack_fmt_t iot_msgpack_str = { 0xa0, 31u, 0xd9, 0xda };
+static const iot_msgpack_fmt_t iot_msgpack_bin = { 0u, 0u, 0xc4, 0xc5 };
+static const iot_msgpack_fmt_t iot_msgpack_array = { 0x90, 15u, 0u, 0xdc };
+static const iot_msgpack_fmt_t iot_msgpack_map = { 0x80, 15u, 0u, 0xde };
+static const iot_msgpack_fmt_t iot_msgpack_ext = { 0u, 0u, 0xc7, 0xc8 };
+
+/* Copies array elements between host and little endian byte order */
+static void iot_msgpack_copy_le (uint8_t * dst, const uint8_t * src, size_t len, uint32_t width)
+{
+#if defined (__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+  for (size_t i = 0; i < len; i += width)
+  {
+    for (uint32_t j = 0; j < width; j++) dst[i + j] = src[i + width - 1u - j];
+  }
+#else
+  (void) width;
+  memcpy (dst, src, len);
+#endif
+}
+
+static void iot_msgpack_holder_grow (iot_msgpack_holder_t * holder, size_t required)
+{
+  size_t total = holder->index + required;
+  size_t inc = holder->size > IOT_MSGPACK_BUFF_DOUBLING_LIMIT ? IOT_MSGPACK_BUFF_INCREMENT : holder->size;
+  if (holder->size + inc < total) inc = required;
+  holder->size += inc;
+  holder->data = realloc (holder->data, holder->size);
+}
+
+static inline void iot_msgpack_holder_check_size (iot_msgpack_holder_t * holder, size_t required)
+{
+  if (holder->size < holder->index + required) iot_msgpack_holder_grow (holder, required);
+}
+
+/* Writes a format byte followed by a big endian argument of width bytes */
+static void iot_msgpack_write_fmt (iot_msgpack_holder_t * holder, uint8_t fmt, uint64_t arg, uint32_t width)
+{
+  iot_msgpack_holder_check_size (holder, width + 1u);
+  uint8_t * dst = holder->data + holder->index;
+  *dst++ = fmt;
+  for (uint32_t i = width; i > 0; i--) *dst++ = (uint8_t) (arg >> ((i - 1u) * 8u));
+  holder->index += width + 1u;
+}
+
+static void iot_msgpack_write_bytes (iot_msgpack_holder_t * holder, const void * data, size_t length)
+{
+  if (length)
+  {
+    iot_msgpack_holder_check_size (holder, length);
+    memcpy (holder->data + holder->index, data, length);
+    holder->index += length;
+  }
+}
+
+static void iot_msgpack_write_uint (iot_msgpack_holder_t * holder, uint64_t value)
+{
+  if (value < 0x80) iot_msgpack_write_fmt (holder, (uint8_t) value, 0u, 0u);
+  else if (value <= UINT8_MAX) iot_msgpack_write_fmt (holder, 0xcc, value, 1u);
+  else if (value <= UINT16_MAX) iot_msgpack_write_fmt (holder, 0xcd, value, 2u);
+  else if (value <= UINT32_MAX) iot_msgpack_write_fmt (holder, 0xce, value, 4u);
+  else iot_msgpack_write_fmt (holder, 0xcf, value, 8u);
+}
+
+static void iot_msgpack_write_int (iot_msgpack_holder_t * holder, int64_t value)
+{
+  if (value >= 0) iot_msgpack_write_uint (holder, (uint64_t) value);
+  else if (value >= -32) iot_msgpack_write_fmt (holder, (uint8_t) value, 0u, 0u);
+  else if (value >= INT8_MIN) iot_msgpack_write_fmt (holder, 0xd0, (uint64_t) value, 1u);
+  else if (value >= INT16_MIN) iot_msgpack_write_fmt (holder, 0xd1, (uint64_t) value, 2u);
+  else if (value >= INT32_MIN) iot_msgpack_write_fmt (holder, 0xd2, (uint64_t) value, 4u);
+  else iot_msgpack_write_fmt (holder, 0xd3, (uint64_t) value, 8u);
+}
+
+static void iot_msgpack_write_len (iot_msgpack_holder_t * holder, const iot_msgpack_fmt_t * fmt, uint32_t len)
+{
+  if (fmt->fix && len <= fmt->fix_max) iot_msgpack_write_fmt (holder, fmt->fix | (uint8_t) len, 0u, 0u);
+  else if (fmt->fmt8 && len <= UINT8_MAX) iot_msgpack_write_fmt (holder, fmt->fmt8, len, 1u);
+  else if (len <= UINT16_MAX) iot_msgpack_write_fmt (holder, fmt->fmt16, len, 2u);
+  else iot_msgpack_write_fmt (holder, fmt->fmt16 + 1u, len, 4u);
+}
+
+static inline size_t iot_msgpack_len_size (const iot_msgpack_fmt_t * fmt, uint32_t len)
+{
+  return (fmt->fix && len <= fmt->fix_max) ? 1u : (fmt->fmt8 && len <= UINT8_MAX) ? 2u : (len <= UINT16_MAX) ? 3u : 5u;
+}
+
+static inline size_t iot_msgpack_ext_head_size (uint32_t len)
+{
+  return (len == 1u || len == 2u || len == 4u || len == 8u || len == 16u) ? 2u : iot_msgpack_len_size (&iot_msgpack_ext, len) + 1u;
+}
+
+static void iot_msgpack_write_array (iot_msgpack_holder_t * holder, const iot_data_t * array)
+{
+  uint32_t size = iot_data_array_size (array);
+  iot_data_type_t type = iot_data_array_type (array);
+  switch (size)
+  {
+    case 1u: iot_msgpack_write_fmt (holder, 0xd4, 0u, 0u); break;
+    case 2u: iot_msgpack_write_fmt (holder, 0xd5, 0u, 0u); break;
+    case 4u: iot_msgpack_write_fmt (holder, 0xd6, 0u, 0u); break;
+    case 8u: iot_msgpack_write_fmt (holder, 0xd7, 0u, 0u); break;
+    case 16u: iot_msgpack_write_fmt (holder, 0xd8, 0u, 0u); break;
+    default: iot_msgpack_write_len (holder, &iot_msgpack_ext, size); break;
+  }
+  iot_msgpack_holder_check_size (holder, size + 1u);
+  holder->data[holder->index++] = (uint8_t) (IOT_MSGPACK_EXT_ARRAY + type);
+  if (size) iot_msgpack_copy_le (holder->data + holder->index, iot_data_address (array), size, iot_data_type_size (type));
+  holder->index += size;
+}
+
+static void iot_data_dump_msgpack (iot_msgpack_holder_t * holder, const iot_data_t * data)
+{
+  switch (data->type)
+  {
+    case IOT_DATA_UINT8: iot_msgpack_write_uint (holder, iot_data_ui8 (data)); break;
+    case IOT_DATA_UINT16: iot_msgpack_write_uint (holder, iot_data_ui16 (data)); break;
+    case IOT_DATA_UINT32: iot_msgpack_write_uint (holder, iot_data_ui32 (data)); break;
+    case IOT_DATA_UINT64: iot_msgpack_write_uint (holder, iot_data_ui64 (data)); break;
+    case IOT_DATA_INT8: iot_msgpack_write_int (holder, iot_data_i8 (data)); break;
+    case IOT_DATA_INT16: iot_msgpack_write_int (holder, iot_data_i16 (data)); break;
+    case IOT_DATA_INT32: iot_msgpack_write_int (holder, iot_data_i32 (data)); break;
+    case IOT_DATA_INT64: iot_msgpack_write_int (holder, iot_data_i64 (data)); break;
+    case IOT_DATA_FLOAT32:
+    {
+      uint32_t v;
+      memcpy (&v, iot_data_address (data), sizeof (v));
+      iot_msgpack_write_fmt (holder, 0xca, v, 4u);
+      break;
+    }
+    case IOT_DATA_FLOAT64:
+    {
+      uint64_t v;
+      memcpy (&v, iot_data_address (data), sizeof (v));
+      iot_msgpack_write_fmt (holder, 0xcb, v, 8u);
+      break;
+    }
+    case IOT_DATA_BOOL: iot_msgpack_write_fmt (holder, iot_data_bool (data) ? 0xc3 : 0xc2, 0u, 0u); break;
+    case IOT_DATA_POINTER:
+      if (data->lazy)
+      {
+        iot_data_dump_msgpack (holder, iot_data_lazy_value (data));
+      }
+      else
+      {
+        iot_msgpack_write_fmt (holder, 0xc0, 0u, 0u);
+      }
+      break;
+    case IOT_DATA_STRING:
+    {
+      const char * str = iot_data_string (data);
+      size_t len = strlen (str);
+      iot_msgpack_write_len (holder, &iot_msgpack_str, (uint32_t) len);
+      iot_msgpack_write_bytes (holder, str, len);
+      break;
+    }
+    case IOT_DATA_NULL: iot_msgpack_write_fmt (holder, 0xc0, 0u, 0u); break;
+    case IOT_DATA_BINARY:
+      iot_msgpack_write_len (holder, &iot_msgpack_bin, iot_data_array_size (data));
+      iot_msgpack_write_bytes (holder, iot_data_address (data), iot_data_array_size (data));
+      break;
+    case IOT_DATA_ARRAY: iot_msgpack_write_array (holder, data); break;
+    case IOT_DATA_VECTOR:
+    {
+      iot_data_vector_iter_t iter;
+      iot_msgpack_write_len (holder, &iot_msgpack_array, iot_data_vector_size (data));
+      iot_data_vector_iter (data, &iter);
+      while (iot_data_vector_iter_next (&iter)) iot_data_dump_msgpack (holder, iot_data_vector_iter_value (&iter));
+      break;
+    }
+    case IOT_DATA_LIST:
+    {
+      iot_data_list_iter_t iter;
+      iot_msgpack_write_len (holder, &iot_msgpack_array, iot_data_list_length (data));
+      iot_data_list_iter (data, &iter);
+      while (iot_data_list_iter_next (&iter)) iot_data_dump_msgpack (holder, iot_data_list_iter_value (&iter));
+      break;
+    }
+    case IOT_DATA_MAP:
+    {
+      iot_data_map_iter_t iter;
+      iot_msgpack_write_len (holder, &iot_msgpack_map, iot_data_map_size (data));
+      iot_data_map_iter (data, &iter);
+      while (iot_data_map_iter_next (&iter))
+      {
+        const iot_data_t * value = iot_data_map_iter_value (&iter);
+        iot_data_dump_msgpack (holder, iot_data_map_iter_key (&iter));
+        if (value)
+        {
+          iot_data_dump_msgpack (holder, value);
+        }
+        else
+        {
+          iot_msgpack_write_fmt (holder, 0xc0, 0u, 0u); // nil
+        }
+      }
+      break;
+    }
+    case IOT_DATA_MULTI:
+    case IOT_DATA_INVALID:
+      assert (data->type != IOT_DATA_MULTI);
+      assert (data->type != IOT_DATA_INVALID);
+      break;
+  }
+}
+
+/* Measuring pass, returning the exact length of the MessagePack written by iot_data_dump_msgpack */
+
+static inline size_t iot_msgpack_uint_size (uint64_t value)
+{
+  return (value < 0x80) ? 1u : (value <= UINT8_MAX) ? 2u : (value <= UINT16_MAX) ? 3u : (value <= UINT32_MAX) ? 5u : 9u;
+}
+
+static inline size_t iot_msgpack_int_size (int64_t value)
+{
+  if (value >= 0) return iot_msgpack_uint_size ((uint64_t) value);
+  return (value >= -32) ? 1u : (value >= INT8_MIN) ? 2u : (value >= INT16_MIN) ? 3u : (value >= INT32_MIN) ? 5u : 9u;
+}
+
+static size_t iot_msgpack_size (const iot_data_t * data)
+{
+  size_t size;
+  switch (data->type)
+  {
+    case IOT_DATA_UINT8: size = iot_msgpack_uint_size (iot_data_ui8 (data)); break;
+    case IOT_DATA_UINT16: size = iot_msgpack_uint_size (iot_data_ui16 (data)); break;
+    case IOT_DATA_UINT32: size = iot_msgpack_uint_size (iot_data_ui32 (data)); break;
+    case IOT_DATA_UINT64: size = iot_msgpack_uint_size (iot_data_ui64 (data)); break;
+    case IOT_DATA_INT8: size = iot_msgpack_int_size (iot_data_i8 (data)); break;
+    case IOT_DATA_INT16: size = iot_msgpack_int_size (iot_data_i16 (data)); break;
+    case IOT_DATA_INT32: size = iot_msgpack_int_size (iot_data_i32 (data)); break;
+    case IOT_DATA_INT64: size = iot_msgpack_int_size (iot_data_i64 (data)); break;
+    case IOT_DATA_FLOAT32: size = 5u; break;
+    case IOT_DATA_FLOAT64: size = 9u; break;
+    case IOT_DATA_POINTER: size = data->lazy ? iot_msgpack_size (iot_data_lazy_value (data)) : 1u; break;
+    case IOT_DATA_STRING:
+    {
+      size_t len = strlen (iot_data_string (data));
+      size = iot_msgpack_len_size (&iot_msgpack_str, (uint32_t) len) + len;
+      break;
+    }
+    case IOT_DATA_BINARY: size = iot_msgpack_len_size (&iot_msgpack_bin, iot_data_array_size (data)) + iot_data_array_size (data); break;
+    case IOT_DATA_ARRAY: size = iot_msgpack_ext_head_size (iot_data_array_size (data)) + iot_data_array_size (data); break;
+    case IOT_DATA_VECTOR:
+    {
+      iot_data_vector_iter_t iter;
+      size = iot_msgpack_len_size (&iot_msgpack_array, iot_data_vector_size (data));
+      iot_data_vector_iter (data, &iter);
+      while (iot_data_vector_iter_next (&iter)) size += iot_msgpack_size (iot_data_vector_iter_value (&iter));
+      break;
+    }
+    case IOT_DATA_LIST:
+    {
+      iot_data_list_iter_t iter;
+      size = iot_msgpack_len_size (&iot_msgpack_array, iot_data_list_length (data));
+      iot_data_list_iter (data, &iter);
+      while (iot_data_list_iter_next (&iter)) size += iot_msgpack_size (iot_data_list_iter_value (&iter));
+      break;
+    }
+    case IOT_DATA_MAP:
+    {
+      iot_data_map_iter_t iter;
+      size = iot_msgpack_len_size (&iot_msgpack_map, iot_data_map_size (data));
+      iot_data_map_iter (data, &iter);
+      while (iot_data_map_iter_next (&iter))
+      {
+        const iot_data_t * value = iot_data_map_iter_value (&iter);
+        size += iot_msgpack_size (iot_data_map_iter_key (&iter)) + (value ? iot_msgpack_size (value) : 1u);
+      }
+      break;
+    }
+    default: size = 1u; break; // Null and bool
+  }
+  return size;
+}
+
+size_t iot_data_msgpack_size (const iot_data_t * data)
+{
+  assert (data);
+  return iot_msgpack_size (data);
+}
+
+iot_data_t * iot_data_to_msgpack (const iot_data_t * data)
+{
+  assert (data);
+  size_t size = iot_msgpack_size (data); // Measure, so allocating the exact output size
+  if (size > UINT32_MAX) return NULL;
+  iot_msgpack_holder_t holder = { .data = malloc (size), .size = size, .index = 0 };
+  iot_data_dump_msgpack (&holder, data);
+  return iot_data_alloc_binary (holder.data, (uint32_t) holder.index, IOT_DATA_TAKE);
+}
+
+const uint8_t * iot_data_to_msgpack_buffer (const iot_data_t * data, iot_data_buffer_t * buffer)
+{
+  assert (data && buffer);
+  iot_msgpack_holder_t holder = { .data = buffer->data, .size = buffer->size, .index = 0 };
+  iot_data_dump_msgpack (&holder, data);
+  buffer->data = holder.data;
+  buffer->size = holder.size;
+  buffer->length = holder.index;
+  return holder.data;
+}
+
+/* Single pass MessagePack decoder, building values directly from the encoded bytes. Integers are
+ * decoded to the type of their encoded format (fixints as UInt8 or Int8), str as strings, bin as
+ * binary, array ext values as arrays and other ext values as binary holding the ext data.
+ */
+
+typedef struct iot_msgpack_decoder_t
+{
+  const uint8_t * data;               // Current decode position
+  const uint8_t * end;                // End of input
+  uint32_t depth;                     // Current nesting depth
+} iot_msgpack_decoder_t;
+
+static bool iot_msgpack_decode_value (iot_msgpack_decoder_t * dec, iot_data_t ** value);
+
+/* Reads a big endian argument of width bytes, returning false if truncated */
+static bool iot_msgpack_read (iot_msgpack_decoder_t * dec, uint32_t width, uint64_t * arg)
+{
+  if ((size_t) (dec->end - dec->data) < width) return false;
+  *arg = 0u;
+  for (uint32_t i = 0; i < width; i++) *arg = (*arg << 8) | *dec->data++;
+  return true;
+}
+
+static bool iot_msgpack_decode_bytes (iot_msgpack_decoder_t * dec, bool str, uint64_t len, iot_data_t ** value)
+{
+  if (len > (uint64_t) (dec->end - dec->data)) return false;
+  *value = str ? iot_data_alloc_string_len ((const char*) dec->data, (size_t) len) :
+    iot_data_alloc_binary (len ? (uint8_t*) dec->data : NULL, (uint32_t) len, IOT_DATA_COPY);
+  dec->data += len;
+  return true;
+}
+
+static bool iot_msgpack_decode_ext (iot_msgpack_decoder_t * dec, uint64_t len, iot_data_t ** value)
+{
+  if (len >= (uint64_t) (dec->end - dec->data)) return false; // Type byte and data
+  uint8_t type = *dec->data++;
+  if (type < IOT_MSGPACK_EXT_ARRAY || type > IOT_MSGPACK_EXT_ARRAY + IOT_DATA_BOOL) return iot_msgpack_decode_bytes (dec, false, len, value);
+
+  iot_data_type_t element_type = (iot_data_type_t) (type - IOT_MSGPACK_EXT_ARRAY);
+  uint32_t width = iot_data_type_size (element_type);
+  if (len % width) return false;
+  uint8_t * elements = NULL;
+  if (len)
+  {
+    elements = malloc ((size_t) len);
+    iot_msgpack_copy_le (elements, dec->data, (size_t) len, width);
+  }
+  *value = iot_data_alloc_array (elements, (uint32_t) (len / width), element_type, IOT_DATA_TAKE);
+  dec->data += len;
+  return true;
+}
+
+static bool iot_msgpack_decode_array (iot_msgpack_decoder_t * dec, uint64_t len, iot_data_t ** value)
+{
+  if (len > (uint64_t) (dec->end - dec->data)) return false; // Each element at least one byte
+  iot_data_t * vector = iot_data_alloc_vector ((uint32_t) len);
+  for (uint32_t i = 0; i < (uint32_t) len; i++)
+  {
+    iot_data_t * elem;
+    if (! iot_msgpack_decode_value (dec, &elem))
+    {
+      iot_data_free (vector);
+      return false;
+    }
+    iot_data_vector_add (vector, i, elem);
+  }
+  *value = vector;
+  return true;
+}
+
+static bool iot_msgpack_decode_map (iot_msgpack_decoder_t * dec, uint64_t len, iot_data_t ** value)
+{
+  if (len > (uint64_t) (dec->end - dec->data) / 2u) return false; // Each key and value at least one byte
+  iot_data_t * map = iot_data_alloc_map (IOT_DATA_MULTI);
+  for (uint64_t i = 0; i < len; i++)
+  {
+    iot_data_t * key;
+    iot_data_t * val;
+    if (! iot_msgpack_decode_value (dec, &key)) goto error;
+    if (! iot_msgpack_decode_value (dec, &val))
+    {
+      iot_data_free (key);
+      goto error;
+    }
+    iot_data_map_add (map, key, val);
+  }
+  *value = map;
+  return true;
+
+error:
+  iot_data_free (map);
+  return false;
+}
+
+static bool iot_msgpack_decode_value (iot_msgpack_decoder_t * dec, iot_data_t ** value)
+{
+  uint64_t arg = 0u;
+  bool ok = true;
+  if (dec->data >= dec->end || ++dec->depth > IOT_MSGPACK_MAX_DEPTH) return false;
+  uint8_t fmt = *dec->data++;
+  if (fmt < 0x80) *value = iot_data_alloc_ui8 (fmt);
+  else if (fmt < 0x90) ok = iot_msgpack_decode_map (dec, fmt & 0x0f, value);
+  else if (fmt < 0xa0) ok = iot_msgpack_decode_array (dec, fmt & 0x0f, value);
+  else if (fmt < 0xc0) ok = iot_msgpack_decode_bytes (dec, true, fmt & 0x1f, value);
+  else if (fmt >= 0xe0) *value = iot_data_alloc_i8 ((int8_t) fmt);
+  else switch (fmt)
+  {
+    case 0xc0: *value = iot_data_alloc_null (); break;
+    case 0xc2: case 0xc3: *value = iot_data_alloc_bool (fmt == 0xc3); break;
+    case 0xc4: case 0xc5: case 0xc6: // bin 8, 16, 32
+      ok = iot_msgpack_read (dec, 1u << (fmt - 0xc4), &arg) && iot_msgpack_decode_bytes (dec, false, arg, value);
+      break;
+    case 0xc7: case 0xc8: case 0xc9: // ext 8, 16, 32
+      ok = iot_msgpack_read (dec, 1u << (fmt - 0xc7), &arg) && iot_msgpack_decode_ext (dec, arg, value);
+      break;
+    case 0xca: // float 32
+    {
+      ok = iot_msgpack_read (dec, 4u, &arg);
+      if (ok)
+      {
+        float f;
+        uint32_t v = (uint32_t) arg;
+        memcpy (&f, &v, sizeof (f));
+        *value = iot_data_alloc_f32 (f);
+      }
+      break;
+    }
+    case 0xcb: // float 64
+    {
+      ok = iot_msgpack_read (dec, 8u, &arg);
+      if (ok)
+      {
+        double d;
+        memcpy (&d, &arg, sizeof (d));
+        *value = iot_data_alloc_f64 (d);
+      }
+      break;
+    }
+    case 0xcc: case 0xcd: case 0xce: case 0xcf: // uint 8, 16, 32, 64
+      ok = iot_msgpack_read (dec, 1u << (fmt - 0xcc), &arg);
+      if (ok)
+      {
+        if (fmt == 0xcc) *value = iot_data_alloc_ui8 ((uint8_t) arg);
+        else if (fmt == 0xcd) *value = iot_data_alloc_ui16 ((uint16_t) arg);
+        else if (fmt == 0xce) *value = iot_data_alloc_ui32 ((uint32_t) arg);
+        else *value = iot_data_alloc_ui64 (arg);
+      }
+      break;
+    case 0xd0: case 0xd1: case 0xd2: case 0xd3: // int 8, 16, 32, 64
+      ok = iot_msgpack_read (dec, 1u << (fmt - 0xd0), &arg);
+      if (ok)
+      {
+        if (fmt == 0xd0) *value = iot_data_alloc_i8 ((int8_t) arg);
+        else if (fmt == 0xd1) *value = iot_data_alloc_i16 ((int16_t) arg);
+        else if (fmt == 0xd2) *value = iot_data_alloc_i32 ((int32_t) arg);
+        else *value = iot_data_alloc_i64 ((int64_t) arg);
+      }
+      break;
+    case 0xd4: case 0xd5: case 0xd6: case 0xd7: case 0xd8: // fixext 1, 2, 4, 8, 16
+      ok = iot_msgpack_decode_ext (dec, 1u << (fmt - 0xd4), value);
+      break;
+    case 0xd9: case 0xda: case 0xdb: // str 8, 16, 32
+      ok = iot_msgpack_read (dec, 1u << (fmt - 0xd9), &arg) && iot_msgpack_decode_bytes (dec, true, arg, value);
+      break;
+    case 0xdc: case 0xdd: // array 16, 32
+      ok = iot_msgpack_read (dec, 2u << (fmt - 0xdc), &arg) && iot_msgpack_decode_array (dec, arg, value);
+      break;
+    case 0xde: case 0xdf: // map 16, 32
+      ok = iot_msgpack_read (dec, 2u << (fmt - 0xde), &arg) && iot_msgpack_decode_map (dec, arg, value);
+      break;
+    default: ok = false; break; // 0xc1 is never used
+  }
+  dec->depth--;
+  return ok;
+}
+
+iot_data_t * iot_data_from_msgpack (const uint8_t * data, uint32_t size)
+{
+  iot_data_t * out = NULL;
+  iot_msgpack_decoder_t dec = { .data = data, .end = data + size };
+  assert (data || size == 0);
+  return iot_msgpack_decode_value (&dec, &out) ? out : NULL;
+}
+
+iot_data_t * iot_data_from_iot_msgpack (const iot_data_t * data)
+{
+  return iot_data_from_msgpack (iot_data_address (data), iot_data_array_size (data));
+}
@@ -0,0 +1,442 @@
+//
+// Copyright (c) 2024 IOTech Ltd
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Number to string conversion and string to number parsing. Floating point
+// formatting uses the Grisu2 algorithm (Florian Loitsch, "Printing
+// Floating-Point Numbers Quickly and Accurately with Integers", PLDI 2010),
+// which generates the shortest, or very close to shortest, digit string that
+// round trips to the same value.
+//
+#include "data-impl.h"
+#include <math.h>
+#include <float.h>
+
+/* Fast path parsing needs floating point operations without excess precision */
+#if FLT_EVAL_METHOD == 0
+#define IOT_FAST_FLOAT true
+#else
+#define IOT_FAST_FLOAT false
+#endif
+
+typedef struct iot_diy_fp_t
+{
+  uint64_t f;
+  int e;
+} iot_diy_fp_t;
+
+static const char iot_digit_pairs[] = "00010203040506070809101112131415161718192021222324252627282930313233343536373839404142434445464748495051525354555657585960616263646566676869707172737475767778798081828384858687888990919293949596979899";
+
+/* Normalized cached powers of ten, 10^k for k = -348, -340, ... 340 */
+
+static const uint64_t iot_cached_powers_f[] =
+{
+  0xfa8fd5a0081c0288u, 0xbaaee17fa23ebf76u, 0x8b16fb203055ac76u, 0xcf42894a5dce35eau,
+  0x9a6bb0aa55653b2du, 0xe61acf033d1a45dfu, 0xab70fe17c79ac6cau, 0xff77b1fcbebcdc4fu,
+  0xbe5691ef416bd60cu, 0x8dd01fad907ffc3cu, 0xd3515c2831559a83u, 0x9d71ac8fada6c9b5u,
+  0xea9c227723ee8bcbu, 0xaecc49914078536du, 0x823c12795db6ce57u, 0xc21094364dfb5637u,
+  0x9096ea6f3848984fu, 0xd77485cb25823ac7u, 0xa086cfcd97bf97f4u, 0xef340a98172aace5u,
+  0xb23867fb2a35b28eu, 0x84c8d4dfd2c63f3bu, 0xc5dd44271ad3cdbau, 0x936b9fcebb25c996u,
+  0xdbac6c247d62a584u, 0xa3ab66580d5fdaf6u, 0xf3e2f893dec3f126u, 0xb5b5ada8aaff80b8u,
+  0x87625f056c7c4a8bu, 0xc9bcff6034c13053u, 0x964e858c91ba2655u, 0xdff9772470297ebdu,
+  0xa6dfbd9fb8e5b88fu, 0xf8a95fcf88747d94u, 0xb94470938fa89bcfu, 0x8a08f0f8bf0f156bu,
+  0xcdb02555653131b6u, 0x993fe2c6d07b7facu, 0xe45c10c42a2b3b06u, 0xaa242499697392d3u,
+  0xfd87b5f28300ca0eu, 0xbce5086492111aebu, 0x8cbccc096f5088ccu, 0xd1b71758e219652cu,
+  0x9c40000000000000u, 0xe8d4a51000000000u, 0xad78ebc5ac620000u, 0x813f3978f8940984u,
+  0xc097ce7bc90715b3u, 0x8f7e32ce7bea5c70u, 0xd5d238a4abe98068u, 0x9f4f2726179a2245u,
+  0xed63a231d4c4fb27u, 0xb0de65388cc8ada8u, 0x83c7088e1aab65dbu, 0xc45d1df942711d9au,
+  0x924d692ca61be758u, 0xda01ee641a708deau, 0xa26da3999aef774au, 0xf209787bb47d6b85u,
+  0xb454e4a179dd1877u, 0x865b86925b9bc5c2u, 0xc83553c5c8965d3du, 0x952ab45cfa97a0b3u,
+  0xde469fbd99a05fe3u, 0xa59bc234db398c25u, 0xf6c69a72a3989f5cu, 0xb7dcbf5354e9beceu,
+  0x88fcf317f22241e2u, 0xcc20ce9bd35c78a5u, 0x98165af37b2153dfu, 0xe2a0b5dc971f303au,
+  0xa8d9d1535ce3b396u, 0xfb9b7cd9a4a7443cu, 0xbb764c4ca7a44410u, 0x8bab8eefb6409c1au,
+  0xd01fef10a657842cu, 0x9b10a4e5e9913129u, 0xe7109bfba19c0c9du, 0xac2820d9623bf429u,
+  0x80444b5e7aa7cf85u, 0xbf21e44003acdd2du, 0x8e679c2f5e44ff8fu, 0xd433179d9c8cb841u,
+  0x9e19db92b4e31ba9u, 0xeb96bf6ebadf77d9u, 0xaf87023b9bf0ee6bu
+};
+
+static const int16_t iot_cached_powers_e[] =
+{
+  -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980, -954, -927, -901, -874, -847, -821,
+  -794, -768, -741, -715, -688, -661, -635, -608, -582, -555, -529, -502, -475, -449, -422, -396,
+  -369, -343, -316, -289, -263, -236, -210, -183, -157, -130, -103, -77, -50, -24, 3, 30,
+  56, 83, 109, 136, 162, 189, 216, 242, 269, 295, 322, 348, 375, 402, 428, 455,
+  481, 508, 534, 561, 588, 614, 641, 667, 694, 720, 747, 774, 800, 827, 853, 880,
+  907, 933, 960, 986, 1013, 1039, 1066
+};
+
+static const uint64_t iot_pow10_u64[] =
+{
+  1u, 10u, 100u, 1000u, 10000u, 100000u, 1000000u, 10000000u, 100000000u, 1000000000u, 10000000000u,
+  100000000000u, 1000000000000u, 10000000000000u, 100000000000000u, 1000000000000000u, 10000000000000000u,
+  100000000000000000u, 1000000000000000000u, 10000000000000000000u
+};
+
+static const double iot_pow10_f64[] =
+{
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static const float iot_pow10_f32[] = { 1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f };
+
+static inline iot_diy_fp_t iot_diy_fp_mul (iot_diy_fp_t x, iot_diy_fp_t y)
+{
+  const uint64_t m32 = 0xffffffffu;
+  uint64_t a = x.f >> 32;
+  uint64_t b = x.f & m32;
+  uint64_t c = y.f >> 32;
+  uint64_t d = y.f & m32;
+  uint64_t ac = a * c;
+  uint64_t bc = b * c;
+  uint64_t ad = a * d;
+  uint64_t bd = b * d;
+  uint64_t tmp = (bd >> 32) + (ad & m32) + (bc & m32) + (1u << 31); // Round
+  iot_diy_fp_t r = { ac + (ad >> 32) + (bc >> 32) + (tmp >> 32), x.e + y.e + 64 };
+  return r;
+}
+
+static inline iot_diy_fp_t iot_diy_fp_normalize (iot_diy_fp_t x)
+{
+  int shift = __builtin_clzll (x.f);
+  x.f <<= shift;
+  x.e -= shift;
+  return x;
+}
+
+static iot_diy_fp_t iot_cached_power (int e, int * k)
+{
+  double dk = (-61 - e) * 0.30102999566398114 + 347; // log10 (2)
+  int ik = (int) dk;
+  if (dk - ik > 0.0) ik++;
+  unsigned index = (unsigned) ((ik >> 3) + 1);
+  *k = -(-348 + (int) (index << 3));
+  iot_diy_fp_t r = { iot_cached_powers_f[index], iot_cached_powers_e[index] };
+  return r;
+}
+
+static inline void iot_grisu_round (char * buff, int len, uint64_t delta, uint64_t rest, uint64_t ten_kappa, uint64_t wp_w)
+{
+  while (rest < wp_w && delta - rest >= ten_kappa && (rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w))
+  {
+    buff[len - 1]--;
+    rest += ten_kappa;
+  }
+}
+
+static int iot_grisu_digits (iot_diy_fp_t w, iot_diy_fp_t mp, uint64_t delta, char * buff, int * k)
+{
+  const iot_diy_fp_t one = { (uint64_t) 1u << -mp.e, mp.e };
+  const uint64_t wp_w = mp.f - w.f;
+  uint32_t p1 = (uint32_t) (mp.f >> -one.e);
+  uint64_t p2 = mp.f & (one.f - 1u);
+  int kappa = 1;
+  int len = 0;
+  while (kappa < 10 && p1 >= iot_pow10_u64[kappa]) kappa++;
+  while (kappa > 0)
+  {
+    uint32_t div = (uint32_t) iot_pow10_u64[kappa - 1];
+    uint32_t d = p1 / div;
+    p1 %= div;
+    if (d || len) buff[len++] = (char) ('0' + d);
+    kappa--;
+    uint64_t tmp = ((uint64_t) p1 << -one.e) + p2;
+    if (tmp <= delta)
+    {
+      *k += kappa;
+      iot_grisu_round (buff, len, delta, tmp, iot_pow10_u64[kappa] << -one.e, wp_w);
+      return len;
+    }
+  }
+  while (true)
+  {
+    p2 *= 10u;
+    delta *= 10u;
+    char d = (char) (p2 >> -one.e);
+    if (d || len) buff[len++] = (char) ('0' + d);
+    p2 &= one.f - 1u;
+    kappa--;
+    if (p2 < delta)
+    {
+      *k += kappa;
+      iot_grisu_round (buff, len, delta, p2, one.f, (-kappa < 20) ? wp_w * iot_pow10_u64[-kappa] : 0u);
+      return len;
+    }
+  }
+}
+
+/* Generates shortest digits for the positive value f * 2^e with the given number of explicit significand bits */
+static int iot_grisu2 (uint64_t f, int e, unsigned bits, char * buff, int * k)
+{
+  const uint64_t hidden = (uint64_t) 1u << bits;
+  iot_diy_fp_t v = { f, e };
+  iot_diy_fp_t mp = { (f << 1) + 1u, e - 1 };
+  iot_diy_fp_t mm = (f == hidden) ? (iot_diy_fp_t) { (f << 2) - 1u, e - 2 } : (iot_diy_fp_t) { (f << 1) - 1u, e - 1 };
+  mp = iot_diy_fp_normalize (mp);
+  mm.f <<= mm.e - mp.e;
+  mm.e = mp.e;
+  iot_diy_fp_t c_mk = iot_cached_power (mp.e, k);
+  iot_diy_fp_t w = iot_diy_fp_mul (iot_diy_fp_normalize (v), c_mk);
+  iot_diy_fp_t wp = iot_diy_fp_mul (mp, c_mk);
+  iot_diy_fp_t wm = iot_diy_fp_mul (mm, c_mk);
+  wm.f++;
+  wp.f--;
+  return iot_grisu_digits (w, wp, wp.f - wm.f, buff, k);
+}
+
+static char * iot_write_exponent (char * buff, int k)
+{
+  if (k < 0)
+  {
+    *buff++ = '-';
+    k = -k;
+  }
+  if (k >= 100)
+  {
+    *buff++ = (char) ('0' + k / 100);
+    k %= 100;
+    memcpy (buff, iot_digit_pairs + k * 2, 2);
+    buff += 2;
+  }
+  else if (k >= 10)
+  {
+    memcpy (buff, iot_digit_pairs + k * 2, 2);
+    buff += 2;
+  }
+  else
+  {
+    *buff++ = (char) ('0' + k);
+  }
+  *buff = '\0';
+  return buff;
+}
+
+/* Lays out len digits with decimal exponent k, always including a '.' or exponent so the value parses as floating point */
+static char * iot_prettify (char * buff, int len, int k)
+{
+  const int kk = len + k; // 10^(kk-1) <= v < 10^kk
+  if (k >= 0 && kk <= 21) // 1234e7 -> 12340000000.0
+  {
+    memset (buff + len, '0', (size_t) (kk - len));
+    buff[kk] = '.';
+    buff[kk + 1] = '0';
+    buff[kk + 2] = '\0';
+    return buff + kk + 2;
+  }
+  if (kk > 0 && kk <= 21) // 1234e-2 -> 12.34
+  {
+    memmove (buff + kk + 1, buff + kk, (size_t) (len - kk));
+    buff[kk] = '.';
+    buff[len + 1] = '\0';
+    return buff + len + 1;
+  }
+  if (kk > -6 && kk <= 0) // 1234e-6 -> 0.001234
+  {
+    const int offset = 2 - kk;
+    memmove (buff + offset, buff, (size_t) len);
+    buff[0] = '0';
+    buff[1] = '.';
+    memset (buff + 2, '0', (size_t) (offset - 2));
+    buff[len + offset] = '\0';
+    return buff + len + offset;
+  }
+  if (len == 1) // 1e30
+  {
+    buff[1] = 'e';
+    return iot_write_exponent (buff + 2, kk - 1);
+  }
+  memmove (buff + 2, buff + 1, (size_t) (len - 1)); // 1234e30 -> 1.234e33
+  buff[1] = '.';
+  buff[len + 1] = 'e';
+  return iot_write_exponent (buff + len + 2, kk - 1);
+}
+
+static char * iot_special_to_chars (char * buff, bool neg, const char * str)
+{
+  if (neg) *buff++ = '-';
+  strcpy (buff, str);
+  return buff + strlen (buff);
+}
+
+char * iot_data_u64_to_chars (char * buff, uint64_t val)
+{
+  char tmp[20];
+  char * ptr = tmp + sizeof (tmp);
+  while (val >= 100u)
+  {
+    ptr -= 2;
+    memcpy (ptr, iot_digit_pairs + (val % 100u) * 2u, 2);
+    val /= 100u;
+  }
+  if (val >= 10u)
+  {
+    ptr -= 2;
+    memcpy (ptr, iot_digit_pairs + val * 2u, 2);
+  }
+  else
+  {
+    *--ptr = (char) ('0' + val);
+  }
+  size_t len = (size_t) (tmp + sizeof (tmp) - ptr);
+  memcpy (buff, ptr, len);
+  buff[len] = '\0';
+  return buff + len;
+}
+
+char * iot_data_i64_to_chars (char * buff, int64_t val)
+{
+  uint64_t mag = (uint64_t) val;
+  if (val < 0)
+  {
+    *buff++ = '-';
+    mag = 0u - mag;
+  }
+  return iot_data_u64_to_chars (buff, mag);
+}
+
+char * iot_data_f64_to_chars (char * buff, double val)
+{
+  uint64_t bits;
+  memcpy (&bits, &val, sizeof (bits));
+  bool neg = (bits >> 63) != 0u;
+  unsigned biased = (unsigned) ((bits >> 52) & 0x7ffu);
+  uint64_t frac = bits & 0xfffffffffffffu;
+  if (biased == 0x7ffu) return iot_special_to_chars (buff, neg, frac ? "nan" : "1e800"); // Infinity out of range of double
+  if (neg) *buff++ = '-';
+  if (biased == 0u && frac == 0u)
+  {
+    strcpy (buff, "0.0");
+    return buff + 3;
+  }
+  int k;
+  uint64_t f = biased ? (frac | ((uint64_t) 1u << 52)) : frac;
+  int len = iot_grisu2 (f, biased ? (int) biased - 1075 : -1074, 52u, buff, &k);
+  return iot_prettify (buff, len, k);
+}
+
+char * iot_data_f32_to_chars (char * buff, float val)
+{
+  uint32_t bits;
+  memcpy (&bits, &val, sizeof (bits));
+  bool neg = (bits >> 31) != 0u;
+  unsigned biased = (bits >> 23) & 0xffu;
+  uint32_t frac = bits & 0x7fffffu;
+  if (biased == 0xffu) return iot_special_to_chars (buff, neg, frac ? "nan" : "1e400");
+  if (neg) *buff++ = '-';
+  if (biased == 0u && frac == 0u)
+  {
+    strcpy (buff, "0.0");
+    return buff + 3;
+  }
+  int k;
+  uint64_t f = biased ? (frac | (1u << 23)) : frac;
+  int len = iot_grisu2 (f, biased ? (int) biased - 150 : -149, 23u, buff, &k);
+  return iot_prettify (buff, len, k);
+}
+
+static inline bool iot_is_space (char c)
+{
+  return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+const char * iot_data_parse_int (const char * str, uint64_t * mag, bool * neg)
+{
+  uint64_t val = 0u;
+  while (iot_is_space (*str)) str++;
+  *neg = (*str == '-');
+  if (*str == '-' || *str == '+') str++;
+  if (*str < '0' || *str > '9') return NULL;
+  while (*str >= '0' && *str <= '9')
+  {
+    unsigned d = (unsigned) (*str++ - '0');
+    if (val > (UINT64_MAX - d) / 10u) return NULL; // Overflow
+    val = val * 10u + d;
+  }
+  *mag = val;
+  return str;
+}
+
+/* Scans a decimal number, accumulating up to 19 significant digits. Returns false if too many digits or an exponent out of range for the fast path */
+static bool iot_scan_decimal (const char * str, const char ** end, uint64_t * mant, int * exp, bool * neg)
+{
+  uint64_t m = 0u;
+  int digits = 0;
+  int e = 0;
+  while (iot_is_space (*str)) str++;
+  *neg = (*str == '-');
+  if (*str == '-' || *str == '+') str++;
+  const char * start = str;
+  while (*str >= '0' && *str <= '9')
+  {
+    if (m || *str != '0') digits++;
+    m = m * 10u + (uint64_t) (*str++ - '0');
+    if (digits > 19) return false;
+  }
+  if (*str == '.')
+  {
+    str++;
+    while (*str >= '0' && *str <= '9')
+    {
+      if (m || *str != '0') digits++;
+      m = m * 10u + (uint64_t) (*str++ - '0');
+      e--;
+      if (digits > 19) return false;
+    }
+  }
+  if (str == start || (str == start + 1 && *start == '.')) return false;
+  if (*str == 'e' || *str == 'E')
+  {
+    int sign = 1;
+    int x = 0;
+    str++;
+    if (*str == '-' || *str == '+') sign = (*str++ == '-') ? -1 : 1;
+    if (*str < '0' || *str > '9') return false;
+    while (*str >= '0' && *str <= '9')
+    {
+      x = x * 10 + (*str++ - '0');
+      if (x > 1000) return false;
+    }
+    e += sign * x;
+  }
+  if (*str == 'x' || *str == 'X' || *str == 'n' || *str == 'N' || *str == 'i' || *str == 'I' || *str == 'p' || *str == 'P') return false; // Hex, nan and inf
+  *end = str;
+  *mant = m;
+  *exp = e;
+  return true;
+}
+
+const char * iot_data_parse_f64 (const char * str, double * val)
+{
+  const char * end;
+  uint64_t m;
+  int e;
+  bool neg;
+  if (IOT_FAST_FLOAT && iot_scan_decimal (str, &end, &m, &e, &neg) && m <= ((uint64_t) 1u << 53) && e >= -22 && e <= 22)
+  {
+    double d = (double) m; // Exact, as is the power of ten so a single correctly rounded operation
+    d = (e < 0) ? d / iot_pow10_f64[-e] : d * iot_pow10_f64[e];
+    *val = neg ? -d : d;
+    return end;
+  }
+  char * eptr;
+  *val = strtod (str, &eptr);
+  return (eptr == str) ? NULL : eptr;
+}
+
+const char * iot_data_parse_f32 (const char * str, float * val)
+{
+  const char * end;
+  uint64_t m;
+  int e;
+  bool neg;
+  if (IOT_FAST_FLOAT && iot_scan_decimal (str, &end, &m, &e, &neg) && m <= ((uint64_t) 1u << 24) && e >= -10 && e <= 10)
+  {
+    float f = (float) m;
+    f = (e < 0) ? f / iot_pow10_f32[-e] : f * iot_pow10_f32[e];
+    *val = neg ? -f : f;
+    return end;
+  }
+  char * eptr;
+  *val = strtof (str, &eptr);
+  return (eptr == str) ? NULL : eptr;
+}
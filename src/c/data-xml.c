@@ -10,110 +10,217 @@
 
 #define YXML_PARSER_BUFF_SIZE 4096
 #define YXML_BUFF_SIZE 512
+#define YXML_STACK_SIZE 16u
 
-static iot_data_t * iot_data_map_from_xml (bool root, yxml_t * x, iot_string_holder_t * holder, const char ** str)
+/* Event driven XML decoder. Input is passed to the parser a character at a time, across any number
+ * of buffers, with parser events tracked against an element path. Only the selected elements and
+ * their descendants are decoded, using an explicit stack of the elements being built, and each
+ * selected element is passed to the stream callback as soon as it is complete.
+ */
+
+typedef struct iot_xml_elem_t
+{
+  iot_data_t * map;                   // Element map
+  iot_data_t * attrs;                 // Attributes map
+  iot_data_t * children;              // Child elements, NULL until first child
+} iot_xml_elem_t;
+
+struct iot_data_xml_stream_t
+{
+  iot_data_xml_stream_fn fn;          // Element callback
+  void * arg;                         // Element callback argument
+  yxml_t * parser;                    // Parser, followed by its buffer
+  iot_data_t * path;                  // Selected element path list, NULL to select the root element
+  const iot_data_t ** names;          // Path element names, root first, null matches any name
+  uint32_t length;                    // Path length
+  uint32_t depth;                     // Current element depth
+  uint32_t matched;                   // Depth to which the current element and its ancestors match the path
+  iot_xml_elem_t * stack;             // Selected element and descendants being decoded
+  uint32_t top;                       // Stack top
+  uint32_t capacity;                  // Stack capacity
+  iot_string_holder_t holder;         // Attribute value or element content
+  bool failed;                        // Whether invalid XML has been written
+};
+
+static inline void iot_xml_holder_reset (iot_string_holder_t * holder)
 {
-  iot_data_t * elem = iot_data_alloc_map (IOT_DATA_STRING);
-  iot_data_t * children = NULL;
-  iot_data_t * attrs = iot_data_alloc_map (IOT_DATA_STRING);
-  const char * elem_name = x->elem;
-  bool more = true;
   holder->str[0] = '\0';
-  holder->free = holder->size - 1;
-  iot_data_string_map_add (elem, "name", iot_data_alloc_string (elem_name, IOT_DATA_COPY));
-  iot_data_string_map_add (elem, "attributes", attrs);
-  while (more && **str)
+  holder->free = holder->size - 1; // Allowing for string terminator
+}
+
+iot_data_xml_stream_t * iot_data_xml_stream_alloc (iot_data_xml_stream_fn fn, void * arg, const iot_data_t * path)
+{
+  assert (fn && (path == NULL || iot_data_type (path) == IOT_DATA_LIST));
+  iot_data_xml_stream_t * stream = calloc (1, sizeof (*stream));
+  stream->fn = fn;
+  stream->arg = arg;
+  stream->parser = malloc (sizeof (yxml_t) + YXML_PARSER_BUFF_SIZE);
+  yxml_init (stream->parser, stream->parser + 1, YXML_PARSER_BUFF_SIZE);
+  stream->holder.str = calloc (1, YXML_BUFF_SIZE);
+  stream->holder.size = YXML_BUFF_SIZE;
+  stream->holder.free = YXML_BUFF_SIZE - 1;
+  if (path && iot_data_list_length (path))
   {
-    switch (yxml_parse (x, *(*str)++))
+    iot_data_list_iter_t iter;
+    stream->path = iot_data_add_ref (path);
+    stream->names = malloc (sizeof (iot_data_t*) * iot_data_list_length (path));
+    iot_data_list_iter (path, &iter);
+    while (iot_data_list_iter_prev (&iter)) // Head first, as iot_data_get_at
     {
-      case YXML_ELEMSTART:
-      {
-        iot_data_t * child = iot_data_map_from_xml (false, x, holder, str);
-        if (child)
-        {
-          if (root)
-          {
-            iot_data_free (elem);
-            elem = child;
-            more = false;
-          }
-          else
-          {
-            uint32_t size = 0u;
-            if (!children)
-            {
-              children = iot_data_alloc_vector (1u);
-              iot_data_string_map_add (elem, "children", children);
-            }
-            else
-            {
-              size = iot_data_vector_size (children);
-              iot_data_vector_resize (children, size + 1u);
-            }
-            iot_data_vector_add (children, size, child);
-          }
-        }
-        else
-        {
-          iot_data_free (elem);
-          elem = NULL;
-          more = false;
-        }
-        break;
-      }
-      case YXML_ELEMEND:
-      {
-        if (holder->str[0] != '\0')
-        {
-          iot_data_string_map_add (elem, "content", iot_data_alloc_string (holder->str, IOT_DATA_COPY));
-          holder->str[0] = '\0';
-          holder->free = holder->size - 1;
-        }
-        more = false;
-        break;
-      }
-      case YXML_ATTRVAL:
-      case YXML_CONTENT:
-      {
-        iot_data_strcat_escape (holder, x->data, false);
-        break;
-      }
-      case YXML_ATTREND:
-      {
-        iot_data_map_add (attrs, iot_data_alloc_string (x->attr, IOT_DATA_COPY), iot_data_alloc_string (holder->str, IOT_DATA_COPY));
-        holder->str[0] = '\0';
-        holder->free = holder->size - 1;
-        break;
-      }
-      case YXML_EEOF:
-      case YXML_EREF:
-      case YXML_ECLOSE:
-      case YXML_ESTACK:
-      case YXML_ESYN:
+      const iot_data_t * name = iot_data_list_iter_value (&iter);
+      assert (iot_data_type (name) == IOT_DATA_STRING || iot_data_type (name) == IOT_DATA_NULL);
+      stream->names[stream->length++] = (iot_data_type (name) == IOT_DATA_STRING) ? name : NULL;
+    }
+  }
+  return stream;
+}
+
+static void iot_xml_stream_reset (iot_data_xml_stream_t * stream)
+{
+  while (stream->top) iot_data_free (stream->stack[--stream->top].map);
+  stream->depth = 0;
+  stream->matched = 0;
+  stream->failed = false;
+  iot_xml_holder_reset (&stream->holder);
+  yxml_init (stream->parser, stream->parser + 1, YXML_PARSER_BUFF_SIZE);
+}
+
+void iot_data_xml_stream_free (iot_data_xml_stream_t * stream)
+{
+  if (stream)
+  {
+    iot_xml_stream_reset (stream);
+    iot_data_free (stream->path);
+    free (stream->names);
+    free (stream->stack);
+    free (stream->holder.str);
+    free (stream->parser);
+    free (stream);
+  }
+}
+
+/* Determines whether an element starting outside any selected element is selected, tracking the path match */
+static bool iot_xml_stream_select (iot_data_xml_stream_t * stream, const char * name)
+{
+  if (stream->length == 0u) return stream->depth == 1u; // Root element
+  if (stream->matched + 1u != stream->depth || stream->depth > stream->length) return false;
+  const iot_data_t * match = stream->names[stream->depth - 1u];
+  if (match && strcmp (iot_data_string (match), name) != 0) return false;
+  stream->matched = stream->depth;
+  return stream->depth == stream->length;
+}
+
+static void iot_xml_stream_push (iot_data_xml_stream_t * stream, const char * name)
+{
+  if (stream->top == stream->capacity)
+  {
+    stream->capacity = stream->capacity ? stream->capacity * 2u : YXML_STACK_SIZE;
+    stream->stack = realloc (stream->stack, stream->capacity * sizeof (iot_xml_elem_t));
+  }
+  iot_xml_elem_t * elem = &stream->stack[stream->top++];
+  elem->map = iot_data_alloc_map (IOT_DATA_STRING);
+  elem->attrs = iot_data_alloc_map (IOT_DATA_STRING);
+  elem->children = NULL;
+  iot_data_string_map_add (elem->map, "name", iot_data_alloc_string (name, IOT_DATA_COPY));
+  iot_data_string_map_add (elem->map, "attributes", elem->attrs);
+  iot_xml_holder_reset (&stream->holder); // Content preceding a child element is discarded
+}
+
+static void iot_xml_stream_pop (iot_data_xml_stream_t * stream)
+{
+  iot_xml_elem_t * elem = &stream->stack[--stream->top];
+  if (stream->holder.str[0] != '\0')
+  {
+    iot_data_string_map_add (elem->map, "content", iot_data_alloc_string (stream->holder.str, IOT_DATA_COPY));
+    iot_xml_holder_reset (&stream->holder);
+  }
+  if (stream->top) // Add to parent
+  {
+    iot_xml_elem_t * parent = &stream->stack[stream->top - 1u];
+    uint32_t size = 0u;
+    if (parent->children == NULL)
+    {
+      parent->children = iot_data_alloc_vector (1u);
+      iot_data_string_map_add (parent->map, "children", parent->children);
+    }
+    else
+    {
+      size = iot_data_vector_size (parent->children);
+      iot_data_vector_resize (parent->children, size + 1u);
+    }
+    iot_data_vector_add (parent->children, size, elem->map);
+  }
+  else // Selected element complete
+  {
+    stream->fn (elem->map, stream->arg);
+  }
+}
+
+static bool iot_xml_stream_parse (iot_data_xml_stream_t * stream, char c)
+{
+  yxml_t * x = stream->parser;
+  switch (yxml_parse (x, c))
+  {
+    case YXML_ELEMSTART:
+      stream->depth++;
+      if (stream->top || iot_xml_stream_select (stream, x->elem)) iot_xml_stream_push (stream, x->elem);
+      break;
+    case YXML_ELEMEND:
+      stream->depth--;
+      if (stream->matched > stream->depth) stream->matched = stream->depth;
+      if (stream->top) iot_xml_stream_pop (stream);
+      break;
+    case YXML_ATTRVAL:
+    case YXML_CONTENT:
+      if (stream->top) iot_data_strcat_escape (&stream->holder, x->data, false);
+      break;
+    case YXML_ATTREND:
+      if (stream->top)
       {
-        // Error
-        iot_data_free (elem);
-        elem = NULL;
-        more = false;
-        break;
+        iot_data_map_add (stream->stack[stream->top - 1u].attrs, iot_data_alloc_string (x->attr, IOT_DATA_COPY), iot_data_alloc_string (stream->holder.str, IOT_DATA_COPY));
+        iot_xml_holder_reset (&stream->holder);
       }
-      default: break;
-    }
+      break;
+    case YXML_EEOF:
+    case YXML_EREF:
+    case YXML_ECLOSE:
+    case YXML_ESTACK:
+    case YXML_ESYN:
+      stream->failed = true;
+      return false;
+    default: break;
   }
-  return elem;
+  return true;
+}
+
+bool iot_data_xml_stream_write (iot_data_xml_stream_t * stream, const char * buff, size_t len)
+{
+  assert (stream && (buff || len == 0));
+  for (size_t i = 0; i < len && ! stream->failed; i++) iot_xml_stream_parse (stream, buff[i]);
+  return ! stream->failed;
+}
+
+bool iot_data_xml_stream_end (iot_data_xml_stream_t * stream)
+{
+  assert (stream);
+  bool ok = ! stream->failed && yxml_eof (stream->parser) == YXML_OK;
+  iot_xml_stream_reset (stream);
+  return ok;
+}
+
+static void iot_xml_root (iot_data_t * data, void * arg)
+{
+  *(iot_data_t**) arg = data;
 }
 
 iot_data_t * iot_data_from_xml (const char * xml)
 {
-  iot_data_t * result;
-  yxml_t * x = malloc (sizeof (yxml_t) + YXML_PARSER_BUFF_SIZE);
-  iot_string_holder_t holder;
-  holder.str = calloc (1, YXML_BUFF_SIZE);
-  holder.size = YXML_BUFF_SIZE;
-  holder.free = YXML_BUFF_SIZE - 1; // Allowing for string terminator
-  yxml_init (x, x+1, YXML_PARSER_BUFF_SIZE);
-  result = iot_data_map_from_xml (true, x, &holder, &xml);
-  free (x);
-  free (holder.str);
+  iot_data_t * result = NULL;
+  iot_data_xml_stream_t * stream = iot_data_xml_stream_alloc (iot_xml_root, &result, NULL);
+  while (*xml && result == NULL) // Until the root element is complete
+  {
+    if (! iot_xml_stream_parse (stream, *xml++)) break;
+  }
+  iot_data_xml_stream_free (stream);
   return result;
 }
@@ -8,7 +8,18 @@
 #include <math.h>
 #include <yaml.h>
 
-static iot_data_t * iot_data_map_from_yaml (yaml_parser_t *parser, iot_data_t **exception);
+/* Parser state. Anchored nodes are recorded per document so that aliases share the anchored node,
+ * by reference, rather than duplicating it.
+ */
+
+typedef struct iot_yaml_loader_t
+{
+  yaml_parser_t parser;
+  iot_data_t * anchors;     // Anchored nodes of the current document, NULL until the first anchor
+  iot_data_t ** exception;  // Set to describe the first error
+} iot_yaml_loader_t;
+
+static iot_data_t * iot_data_node_from_yaml (iot_yaml_loader_t *loader, const yaml_event_t *event);
 
 static iot_data_t * iot_data_string_from_yaml (const yaml_event_t *event)
 {
@@ -69,7 +80,17 @@ static iot_data_t * iot_data_value_from_yaml (const yaml_event_t *event)
   return ret;
 }
 
-static iot_data_t * iot_data_vector_from_yaml (yaml_parser_t *parser, iot_data_t **exception)
+static bool iot_yaml_parse (iot_yaml_loader_t *loader, yaml_event_t *event)
+{
+  if (!yaml_parser_parse (&loader->parser, event))
+  {
+    *loader->exception = iot_data_alloc_string_fmt ("%s at line %zu", loader->parser.problem, loader->parser.problem_mark.line);
+    return false;
+  }
+  return true;
+}
+
+static iot_data_t * iot_data_vector_from_yaml (iot_yaml_loader_t *loader)
 {
   yaml_event_t event;
   bool done = false;
@@ -78,37 +99,26 @@ static iot_data_t * iot_data_vector_from_yaml (yaml_parser_t *parser, iot_data_t
   iot_data_t * vec = iot_data_alloc_vector (size);
   do
   {
-    elem = NULL;
-    if (!yaml_parser_parse (parser, &event))
+    if (!iot_yaml_parse (loader, &event))
     {
-      *exception = iot_data_alloc_string_fmt ("%s at line %zu", parser->problem, parser->problem_mark.line);
       break;
     }
-    switch (event.type)
-    {
-      case YAML_SCALAR_EVENT:
-        elem = iot_data_value_from_yaml (&event);
-        break;
-      case YAML_MAPPING_START_EVENT:
-        elem = iot_data_map_from_yaml (parser, exception);
-        break;
-      case YAML_SEQUENCE_START_EVENT:
-        elem = iot_data_vector_from_yaml (parser, exception);
-        break;
-      case YAML_SEQUENCE_END_EVENT:
-        done = true;
-        break;
-      default:
-        break;
+    if (event.type == YAML_SEQUENCE_END_EVENT)
+    {
+      done = true;
     }
-    if (elem)
+    else
     {
-      iot_data_vector_resize (vec, size + 1);
-      iot_data_vector_add (vec, size++, elem);
+      elem = iot_data_node_from_yaml (loader, &event);
+      if (elem)
+      {
+        iot_data_vector_resize (vec, size + 1);
+        iot_data_vector_add (vec, size++, elem);
+      }
     }
     yaml_event_delete (&event);
-  } while (!done && *exception == NULL);
-  if (*exception)
+  } while (!done && *loader->exception == NULL);
+  if (*loader->exception)
   {
     iot_data_free (vec);
     return NULL;
@@ -119,62 +129,90 @@ static iot_data_t * iot_data_vector_from_yaml (yaml_parser_t *parser, iot_data_t
   }
 }
 
-static iot_data_t * iot_data_map_from_yaml (yaml_parser_t *parser, iot_data_t **exception)
+/* Adds the entries of a merge key ("<<") value, a map or sequence of maps, that are not already present */
+static bool iot_yaml_merge (iot_data_t *map, const iot_data_t *value)
+{
+  if (iot_data_type (value) == IOT_DATA_MAP)
+  {
+    iot_data_map_iter_t iter;
+    iot_data_map_iter (value, &iter);
+    while (iot_data_map_iter_next (&iter))
+    {
+      if (iot_data_map_get (map, iot_data_map_iter_key (&iter)) == NULL)
+      {
+        iot_data_map_add (map, iot_data_add_ref (iot_data_map_iter_key (&iter)), iot_data_add_ref (iot_data_map_iter_value (&iter)));
+      }
+    }
+    return true;
+  }
+  if (iot_data_type (value) == IOT_DATA_VECTOR)
+  {
+    iot_data_vector_iter_t iter;
+    iot_data_vector_iter (value, &iter);
+    while (iot_data_vector_iter_next (&iter))
+    {
+      if (iot_data_type (iot_data_vector_iter_value (&iter)) != IOT_DATA_MAP) return false;
+    }
+    iot_data_vector_iter (value, &iter);
+    while (iot_data_vector_iter_next (&iter)) // Earlier maps take precedence
+    {
+      iot_yaml_merge (map, iot_data_vector_iter_value (&iter));
+    }
+    return true;
+  }
+  return false;
+}
+
+static iot_data_t * iot_data_map_from_yaml (iot_yaml_loader_t *loader)
 {
   yaml_event_t event;
   bool done = false;
+  bool merge = false;
   iot_data_t * name = NULL;
   iot_data_t * elem = NULL;
   iot_data_t * map = iot_data_alloc_map (IOT_DATA_STRING);
   do
   {
-    if (!yaml_parser_parse (parser, &event))
+    if (!iot_yaml_parse (loader, &event))
     {
-      *exception = iot_data_alloc_string_fmt ("%s at line %zu", parser->problem, parser->problem_mark.line);
       break;
     }
-    switch (event.type)
+    if (event.type == YAML_MAPPING_END_EVENT)
     {
-      case YAML_SCALAR_EVENT:
-        if (name)
-        {
-          elem = iot_data_value_from_yaml (&event);
-        }
-        else
-        {
-          name = iot_data_string_from_yaml (&event);
-        }
-        break;
-      case YAML_MAPPING_START_EVENT:
-        elem = iot_data_map_from_yaml (parser, exception);
-        break;
-      case YAML_SEQUENCE_START_EVENT:
-        elem = iot_data_vector_from_yaml (parser, exception);
-        break;
-      case YAML_MAPPING_END_EVENT:
-        done = true;
-        break;
-      default:
-        break;
+      done = true;
+    }
+    else if (event.type == YAML_SCALAR_EVENT && name == NULL)
+    {
+      name = iot_data_string_from_yaml (&event);
+      merge = event.data.scalar.style == YAML_PLAIN_SCALAR_STYLE && strcmp (iot_data_string (name), "<<") == 0;
+    }
+    else
+    {
+      elem = iot_data_node_from_yaml (loader, &event);
     }
     if (elem)
     {
-      if (name)
+      if (name == NULL)
       {
-        iot_data_map_add (map, name, elem);
+        *loader->exception = iot_data_alloc_string_fmt ("Unexpected (anonymous) %s in map at line %zu", event.type == YAML_MAPPING_START_EVENT ? "map" : (event.type == YAML_SEQUENCE_START_EVENT ? "sequence" : "alias"), loader->parser.mark.line);
+        iot_data_free (elem);
       }
-      else
+      else if (merge && iot_yaml_merge (map, elem))
       {
-        *exception = iot_data_alloc_string_fmt ("Unexpected (anonymous) %s in map at line %zu", event.type == YAML_MAPPING_START_EVENT ? "map" : "sequence", parser->mark.line);
+        iot_data_free (name);
         iot_data_free (elem);
       }
+      else
+      {
+        iot_data_map_add (map, name, elem);
+      }
       name = NULL;
       elem = NULL;
     }
     yaml_event_delete (&event);
-  } while (!done && *exception == NULL);
+  } while (!done && *loader->exception == NULL);
   iot_data_free (name);
-  if (*exception)
+  if (*loader->exception)
   {
     iot_data_free (map);
     return NULL;
@@ -185,46 +223,122 @@ static iot_data_t * iot_data_map_from_yaml (yaml_parser_t *parser, iot_data_t **
   }
 }
 
-iot_data_t * iot_data_from_yaml (const char * yaml, iot_data_t **exception)
+/* Returns the node started by an event, recording it if anchored, or a reference to the node for an alias */
+static iot_data_t * iot_data_node_from_yaml (iot_yaml_loader_t *loader, const yaml_event_t *event)
+{
+  iot_data_t *node = NULL;
+  const yaml_char_t *anchor = NULL;
+  switch (event->type)
+  {
+    case YAML_SCALAR_EVENT:
+      node = iot_data_value_from_yaml (event);
+      anchor = event->data.scalar.anchor;
+      break;
+    case YAML_MAPPING_START_EVENT:
+      node = iot_data_map_from_yaml (loader);
+      anchor = event->data.mapping_start.anchor;
+      break;
+    case YAML_SEQUENCE_START_EVENT:
+      node = iot_data_vector_from_yaml (loader);
+      anchor = event->data.sequence_start.anchor;
+      break;
+    case YAML_ALIAS_EVENT:
+      node = loader->anchors ? iot_data_add_ref (iot_data_string_map_get (loader->anchors, (const char *)event->data.alias.anchor)) : NULL;
+      if (node == NULL)
+      {
+        *loader->exception = iot_data_alloc_string_fmt ("Undefined alias %s at line %zu", event->data.alias.anchor, event->start_mark.line);
+      }
+      break;
+    default:
+      break;
+  }
+  if (node && anchor)
+  {
+    if (loader->anchors == NULL)
+    {
+      loader->anchors = iot_data_alloc_map (IOT_DATA_STRING);
+    }
+    iot_data_map_add (loader->anchors, iot_data_alloc_string ((const char *)anchor, IOT_DATA_COPY), iot_data_add_ref (node));
+  }
+  return node;
+}
+
+/* Passes each document of the stream to a callback, stopping after the first if single is set */
+static bool iot_yaml_load (iot_yaml_loader_t *loader, iot_data_yaml_stream_fn fn, void *arg, bool single)
 {
-  assert (yaml);
-  iot_data_t *result = NULL;
-  yaml_parser_t parser;
   yaml_event_t event;
   bool done = false;
-  *exception = NULL;
-  yaml_parser_initialize (&parser);
-  yaml_parser_set_input_string (&parser, (const yaml_char_t *)yaml, strlen (yaml));
+  iot_data_t *doc;
   do
   {
-    if (!yaml_parser_parse (&parser, &event))
+    if (!iot_yaml_parse (loader, &event))
     {
-      *exception = iot_data_alloc_string_fmt ("%s at line %zu", parser.problem, parser.problem_mark.line);
       break;
     }
-    switch (event.type)
-    {
-      case YAML_SCALAR_EVENT:
-        result = iot_data_value_from_yaml (&event);
-        done = true;
-        break;
-      case YAML_MAPPING_START_EVENT:
-        result = iot_data_map_from_yaml (&parser, exception);
-        done = true;
-        break;
-      case YAML_SEQUENCE_START_EVENT:
-        result = iot_data_vector_from_yaml (&parser, exception);
-        done = true;
-        break;
-      case YAML_STREAM_END_EVENT:
-        done = true;
-        break;
-      default:
-        break;
+    if (event.type == YAML_STREAM_END_EVENT)
+    {
+      done = true;
+    }
+    else if (event.type == YAML_DOCUMENT_END_EVENT) // Anchors are scoped to their document
+    {
+      iot_data_free (loader->anchors);
+      loader->anchors = NULL;
+    }
+    else
+    {
+      doc = iot_data_node_from_yaml (loader, &event);
+      if (doc)
+      {
+        fn (doc, arg);
+        done = single;
+      }
     }
     yaml_event_delete (&event);
-  } while (!done);
+  } while (!done && *loader->exception == NULL);
+  iot_data_free (loader->anchors);
+  yaml_parser_delete (&loader->parser);
+  return *loader->exception == NULL;
+}
+
+static void iot_yaml_loader_init (iot_yaml_loader_t *loader, iot_data_t **exception)
+{
+  assert (exception);
+  *exception = NULL;
+  loader->anchors = NULL;
+  loader->exception = exception;
+  yaml_parser_initialize (&loader->parser);
+}
+
+bool iot_data_from_yaml_stream (const char * yaml, iot_data_yaml_stream_fn fn, void * arg, iot_data_t ** exception)
+{
+  assert (yaml && fn);
+  iot_yaml_loader_t loader;
+  iot_yaml_loader_init (&loader, exception);
+  yaml_parser_set_input_string (&loader.parser, (const yaml_char_t *)yaml, strlen (yaml));
+  return iot_yaml_load (&loader, fn, arg, false);
+}
+
+bool iot_data_from_yaml_file (FILE * fp, iot_data_yaml_stream_fn fn, void * arg, iot_data_t ** exception)
+{
+  assert (fp && fn);
+  iot_yaml_loader_t loader;
+  iot_yaml_loader_init (&loader, exception);
+  yaml_parser_set_input_file (&loader.parser, fp);
+  return iot_yaml_load (&loader, fn, arg, false);
+}
 
-  yaml_parser_delete (&parser);
+static void iot_yaml_first (iot_data_t *data, void *arg)
+{
+  *(iot_data_t **)arg = data;
+}
+
+iot_data_t * iot_data_from_yaml (const char * yaml, iot_data_t **exception)
+{
+  assert (yaml);
+  iot_data_t *result = NULL;
+  iot_yaml_loader_t loader;
+  iot_yaml_loader_init (&loader, exception);
+  yaml_parser_set_input_string (&loader.parser, (const yaml_char_t *)yaml, strlen (yaml));
+  iot_yaml_load (&loader, iot_yaml_first, &result, true);
   return result;
 }
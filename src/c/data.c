@@ -10,6 +10,11 @@
 #include "iot/uuid.h"
 #include <stdarg.h>
 #include <float.h>
+#if defined (__SSE2__)
+#include <immintrin.h>
+#elif defined (__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 #define IOT_DATA_IS_COMPOSED_TYPE(t) ((t) >= IOT_DATA_VECTOR && (t) <= IOT_DATA_MAP)
 #define IOT_DATA_IS_FLOAT_TYPE(t) ((t) == IOT_DATA_FLOAT32 || (t) == IOT_DATA_FLOAT64)
@@ -25,11 +30,11 @@
 #define IOT_VAL_BUFF_SIZE 31u
 #define IOT_STR_BUFF_DOUBLING_LIMIT 4096u
 #define IOT_STR_BUFF_INCREMENT 1024u
+#define IOT_DATA_BUFFER_SIZE 512u
 
 static const char * iot_data_type_names [IOT_DATA_TYPES] = {"Int8","UInt8","Int16","UInt16","Int32","UInt32","Int64","UInt64","Float32","Float64","Bool","Pointer","String","Null","Binary","Array","Vector","List","Map","Multi", "Invalid"};
 static const uint8_t iot_data_type_sizes [IOT_DATA_BINARY + 1] = {1u, 1u, 2u, 2u, 4u, 4u, 8u, 8u, 4u, 8u, sizeof (bool), sizeof (void*), sizeof (char*), 0u, 1u };
 static _Thread_local bool iot_data_alloc_from_heap = false; /* Thread specific memory allocation policy */
-iot_data_static_t iot_data_order = { 0 };
 static const char * iot_data_const_strings [] = { "category","config","name","state","type",NULL };
 
 iot_data_consts_t iot_data_consts = { 0 };
@@ -91,7 +96,9 @@ typedef struct iot_data_map_t
 {
   iot_data_t base;
   uint32_t size;
+  uint32_t capacity;                  // Capacity of order
   iot_node_t * tree;
+  iot_node_t ** order;                // Nodes in insertion order, if an ordered map
 } iot_data_map_t;
 
 typedef struct iot_element_t
@@ -152,6 +159,7 @@ typedef struct iot_data_struct_dummy_t
 
 _Static_assert ((IOT_DATA_BLOCK_SIZE % 8) == 0, "IOT_DATA_BLOCK_SIZE not 8 byte multiple");
 _Static_assert (sizeof (iot_data_value_t) == IOT_DATA_BLOCK_SIZE, "size of iot_data_value not equal to IOT_DATA_BLOCK_SIZE");
+_Static_assert (IOT_DATA_VALUE_BUFF_SIZE >= sizeof (iot_data_t*), "iot_data_value buffer cannot hold string backing");
 _Static_assert (sizeof (iot_data_map_t) <= IOT_DATA_BLOCK_SIZE, "iot_data_map bigger than IOT_DATA_BLOCK_SIZE");
 _Static_assert (sizeof (iot_data_pointer_t) <= IOT_DATA_BLOCK_SIZE, "iot_data_pointer bigger than IOT_DATA_BLOCK_SIZE");
 _Static_assert (sizeof (iot_data_vector_t) <= IOT_DATA_BLOCK_SIZE, "iot_data_vector bigger than IOT_DATA_BLOCK_SIZE");
@@ -410,7 +418,6 @@ static void iot_data_init (void)
 #ifdef IOT_DATA_CACHE
   iot_data_block_free (iot_data_alloc_block ());  // Initialize data cache
 #endif
-  iot_data_alloc_const_pointer (&iot_data_order, &iot_data_order);
   const char ** str = iot_data_const_strings;
   iot_data_static_t * ptr = (iot_data_static_t*) &iot_data_consts;
   while (*str) iot_data_alloc_const_string (ptr++, *str++);
@@ -767,6 +774,30 @@ iot_data_t * iot_data_alloc_typed_map (iot_data_type_t key_type, iot_data_type_t
   return map;
 }
 
+iot_data_t * iot_data_alloc_ordered_map (iot_data_type_t key_type)
+{
+  iot_data_map_t * map = (iot_data_map_t*) iot_data_alloc_map (key_type);
+  map->capacity = 4u;
+  map->order = malloc (sizeof (iot_node_t*) * map->capacity);
+  return (iot_data_t*) map;
+}
+
+/* Allocates an empty map of the same type and ordering as map */
+static iot_data_t * iot_data_map_alloc_as (const iot_data_t * map)
+{
+  iot_data_t * ret = (((const iot_data_map_t*) map)->order) ? iot_data_alloc_ordered_map (map->key_type) : iot_data_alloc_map (map->key_type);
+  ret->element_type = map->element_type;
+  return ret;
+}
+
+const iot_data_t * iot_data_map_ordered_key (const iot_data_t * map, uint32_t index, const iot_data_t ** value)
+{
+  const iot_data_map_t * mp = (const iot_data_map_t*) map;
+  assert (mp->order && index < mp->size);
+  *value = mp->order[index]->value;
+  return mp->order[index]->key;
+}
+
 iot_data_type_t iot_data_map_type (const iot_data_t * map)
 {
   assert (map);
@@ -806,6 +837,28 @@ iot_data_t * iot_data_alloc_pointer (void * ptr, iot_data_free_fn free_fn)
   return (iot_data_t*) pointer;
 }
 
+static void iot_data_lazy_free (void * ptr)
+{
+  iot_data_lazy_t * lazy = (iot_data_lazy_t*) ptr;
+  iot_data_free (atomic_load (&lazy->value));
+  free (lazy);
+}
+
+iot_data_t * iot_data_alloc_lazy (const void * bytes, size_t len, bool cbor, bool ordered, iot_data_lazy_decode_fn decode)
+{
+  iot_data_lazy_t * lazy = malloc (sizeof (*lazy) + len + 1u);
+  lazy->decode = decode;
+  atomic_init (&lazy->value, NULL);
+  lazy->len = len;
+  lazy->cbor = cbor;
+  lazy->ordered = ordered;
+  memcpy (lazy->bytes, bytes, len);
+  lazy->bytes[len] = '\0';
+  iot_data_t * data = iot_data_alloc_pointer (lazy, iot_data_lazy_free);
+  data->lazy = true;
+  return data;
+}
+
 iot_data_t * iot_data_alloc_list (void)
 {
   return (iot_data_t*) iot_data_block_alloc_data (IOT_DATA_LIST);
@@ -1157,7 +1210,11 @@ void iot_data_free (iot_data_t * data)
       case IOT_DATA_STRING:
       {
         iot_data_value_t * val = (iot_data_value_t*) data;
-        if (data->release && (val->value.str != val->buff))
+        if (data->backed)
+        {
+          iot_data_free (*(iot_data_t**) val->buff);
+        }
+        else if (data->release && (val->value.str != val->buff))
         {
           data->release_block ? iot_data_block_free (val->value.str) : free (val->value.str);
         }
@@ -1172,6 +1229,7 @@ void iot_data_free (iot_data_t * data)
       case IOT_DATA_MAP:
       {
         iot_node_free ((iot_data_map_t*) data, ((iot_data_map_t*) data)->tree);
+        free (((iot_data_map_t*) data)->order);
         break;
       }
       case IOT_DATA_VECTOR:
@@ -1211,27 +1269,39 @@ void iot_data_free (iot_data_t * data)
 
 iot_data_t * iot_data_alloc_from_string (iot_data_type_t type, const char * value)
 {
-  static const char * fmt [] =  { "%"SCNd8,"%"SCNu8,"%"SCNd16,"%"SCNu16,"%"SCNd32,"%"SCNu32,"%"SCNd64,"%"SCNu64,"%f","%lf" };
   assert (value && ((type == IOT_DATA_STRING) || strlen (value)));
 
-  if (type < IOT_DATA_BOOL)
+  switch (type)
+  {
+    case IOT_DATA_FLOAT32:
+    {
+      float f32;
+      return iot_data_parse_f32 (value, &f32) ? iot_data_alloc_f32 (f32) : NULL;
+    }
+    case IOT_DATA_FLOAT64:
+    {
+      double f64;
+      return iot_data_parse_f64 (value, &f64) ? iot_data_alloc_f64 (f64) : NULL;
+    }
+    default: break;
+  }
+  if (type < IOT_DATA_FLOAT32)
   {
-    iot_data_union_t un = { 0 };
-    if (sscanf (value, fmt[type], &un) == 1)
+    uint64_t mag;
+    bool neg;
+    if (iot_data_parse_int (value, &mag, &neg))
     {
+      uint64_t val = neg ? (0u - mag) : mag; // Two's complement, truncated as required by type
       switch (type)
       {
-        case IOT_DATA_INT8: return iot_data_alloc_i8 (un.i8);
-        case IOT_DATA_UINT8: return iot_data_alloc_ui8 (un.ui8);
-        case IOT_DATA_INT16: return iot_data_alloc_i16 (un.i16);
-        case IOT_DATA_UINT16: return iot_data_alloc_ui16 (un.ui16);
-        case IOT_DATA_INT32: return iot_data_alloc_i32 (un.i32);
-        case IOT_DATA_UINT32: return iot_data_alloc_ui32 (un.ui32);
-        case IOT_DATA_INT64: return iot_data_alloc_i64 (un.i64);
-        case IOT_DATA_UINT64: return iot_data_alloc_ui64 (un.ui64);
-        case IOT_DATA_FLOAT32: return iot_data_alloc_f32 (un.f32);
-        case IOT_DATA_FLOAT64: return iot_data_alloc_f64 (un.f64);
-        default: assert (0);
+        case IOT_DATA_INT8: return iot_data_alloc_i8 ((int8_t) val);
+        case IOT_DATA_UINT8: return iot_data_alloc_ui8 ((uint8_t) val);
+        case IOT_DATA_INT16: return iot_data_alloc_i16 ((int16_t) val);
+        case IOT_DATA_UINT16: return iot_data_alloc_ui16 ((uint16_t) val);
+        case IOT_DATA_INT32: return iot_data_alloc_i32 ((int32_t) val);
+        case IOT_DATA_UINT32: return iot_data_alloc_ui32 ((uint32_t) val);
+        case IOT_DATA_INT64: return iot_data_alloc_i64 ((int64_t) val);
+        default: return iot_data_alloc_ui64 (val);
       }
     }
   }
@@ -1521,6 +1591,41 @@ iot_data_t * iot_data_alloc_string (const char * val, iot_data_ownership_t owner
   return (iot_data_t*) data;
 }
 
+iot_data_t * iot_data_alloc_string_len (const char * str, size_t len)
+{
+  assert (str || len == 0);
+  iot_data_value_t * data = iot_data_value_alloc (IOT_DATA_STRING, IOT_DATA_COPY);
+  if (len < IOT_DATA_VALUE_BUFF_SIZE)
+  {
+    data->value.str = data->buff;
+  }
+  else if (len < IOT_DATA_BLOCK_SIZE)
+  {
+    data->value.str = iot_data_alloc_block ();
+    data->base.release_block = true;
+  }
+  else
+  {
+    data->value.str = malloc (len + 1u);
+  }
+  if (len) memcpy (data->value.str, str, len);
+  data->value.str[len] = '\0';
+  data->base.hash = iot_hash (data->value.str);
+  return (iot_data_t*) data;
+}
+
+iot_data_t * iot_data_alloc_string_view (const char * str, size_t len, iot_data_t * backing)
+{
+  assert (str);
+  if (backing == NULL || len < IOT_DATA_VALUE_BUFF_SIZE) return iot_data_alloc_string (str, backing ? IOT_DATA_COPY : IOT_DATA_REF);
+  iot_data_value_t * data = iot_data_value_alloc (IOT_DATA_STRING, IOT_DATA_REF);
+  data->value.str = (char*) str;
+  data->base.hash = iot_hash (str);
+  data->base.backed = true;
+  *(iot_data_t**) data->buff = iot_data_add_ref (backing);
+  return (iot_data_t*) data;
+}
+
 iot_data_t * iot_data_alloc_string_fmt (const char *format, ...)
 {
   va_list args;
@@ -1739,6 +1844,30 @@ const void * iot_data_pointer (const iot_data_t * data)
   return (data->type == IOT_DATA_POINTER) ? ((const iot_data_pointer_t*) data)->value : NULL;
 }
 
+bool iot_data_is_lazy (const iot_data_t * data)
+{
+  return data && data->lazy;
+}
+
+const iot_data_t * iot_data_lazy_value (const iot_data_t * data)
+{
+  if (! iot_data_is_lazy (data)) return data;
+  iot_data_lazy_t * lazy = ((const iot_data_pointer_t*) data)->value;
+  iot_data_t * value = atomic_load (&lazy->value);
+  if (value == NULL) // Decode on first access, keeping the first result if decoded concurrently
+  {
+    iot_data_t * expected = NULL;
+    value = lazy->decode (lazy);
+    if (value == NULL) value = iot_data_alloc_null ();
+    if (! atomic_compare_exchange_strong (&lazy->value, &expected, value))
+    {
+      iot_data_free (value);
+      value = expected;
+    }
+  }
+  return value;
+}
+
 bool iot_data_map_remove (iot_data_t * map, const iot_data_t * key)
 {
   bool ret = false;
@@ -1822,6 +1951,12 @@ uint32_t iot_data_map_size (const iot_data_t * map)
   return ((const iot_data_map_t*) map)->size;
 }
 
+bool iot_data_map_is_ordered (const iot_data_t * map)
+{
+  assert (map && (map->type == IOT_DATA_MAP));
+  return ((const iot_data_map_t*) map)->order != NULL;
+}
+
 bool iot_data_map_base64_to_array (const iot_data_t * map, const iot_data_t * key)
 {
   assert (map && (map->type == IOT_DATA_MAP));
@@ -2551,8 +2686,56 @@ static size_t iot_data_repr_size (char c)
   return size_map[(uint8_t) c];
 }
 
+void iot_data_holder_flush (iot_string_holder_t * holder)
+{
+  size_t len = holder->size - holder->free - 1;
+  if (len && ! holder->failed && ! holder->sink (holder->ctx, holder->str, len)) holder->failed = true;
+  holder->free = holder->size - 1;
+  holder->str[0] = '\0';
+}
+
+iot_data_buffer_t * iot_data_buffer_alloc (size_t size)
+{
+  iot_data_buffer_t * buffer = calloc (1, sizeof (*buffer));
+  buffer->size = size ? size : IOT_DATA_BUFFER_SIZE;
+  buffer->data = malloc (buffer->size);
+  return buffer;
+}
+
+void iot_data_buffer_free (iot_data_buffer_t * buffer)
+{
+  if (buffer)
+  {
+    free (buffer->data);
+    free (buffer);
+  }
+}
+
+const uint8_t * iot_data_buffer_data (const iot_data_buffer_t * buffer)
+{
+  assert (buffer);
+  return buffer->data;
+}
+
+size_t iot_data_buffer_length (const iot_data_buffer_t * buffer)
+{
+  assert (buffer);
+  return buffer->length;
+}
+
+size_t iot_data_buffer_capacity (const iot_data_buffer_t * buffer)
+{
+  assert (buffer);
+  return buffer->size;
+}
+
 void iot_data_holder_realloc (iot_string_holder_t * holder, size_t required)
 {
+  if (holder->sink)
+  {
+    iot_data_holder_flush (holder); // Sink buffers are never grown, large values are written in chunks
+    return;
+  }
   size_t inc = holder->size > IOT_STR_BUFF_DOUBLING_LIMIT ? IOT_STR_BUFF_INCREMENT : holder->size;
   if (inc < required) inc = required;
   holder->size += inc;
@@ -2560,67 +2743,162 @@ void iot_data_holder_realloc (iot_string_holder_t * holder, size_t required)
   holder->str = realloc (holder->str, holder->size);
 }
 
-void iot_data_strcat_escape (iot_string_holder_t * holder, const char * add, bool escape)
+static void iot_data_holder_append (iot_string_holder_t * holder, const char * add, size_t len)
 {
-  size_t len = strlen (add);
-  size_t adj_len = len;
-  size_t i;
-  if (escape)
+  while (len)
   {
-    adj_len = 0;
-    for (i = 0; i < len; i++)
-    {
-      adj_len += iot_data_repr_size (add[i]);
-    }
+    if (holder->free == 0) iot_data_holder_realloc (holder, len);
+    size_t n = (len < holder->free) ? len : holder->free;
+    memcpy (holder->str + holder->size - holder->free - 1, add, n);
+    holder->free -= n;
+    add += n;
+    len -= n;
   }
-  if (holder->free < adj_len)
+}
+
+static size_t iot_data_json_scan_scalar (const char * str, size_t len)
+{
+  size_t i = 0;
+  while (i < len && iot_data_repr_size (str[i]) == 1) i++;
+  return i;
+}
+
+#if defined (__SSE2__)
+static size_t iot_data_json_scan_sse2 (const char * str, size_t len)
+{
+  const __m128i quote = _mm_set1_epi8 ('"');
+  const __m128i slash = _mm_set1_epi8 ('\\');
+  const __m128i ctrl = _mm_set1_epi8 (0x1f);
+  size_t i = 0;
+  for (; i + 16u <= len; i += 16u)
   {
-    iot_data_holder_realloc (holder, adj_len);
+    __m128i v = _mm_loadu_si128 ((const __m128i*) (str + i));
+    __m128i m = _mm_or_si128 (_mm_cmpeq_epi8 (v, quote), _mm_cmpeq_epi8 (v, slash));
+    m = _mm_or_si128 (m, _mm_cmpeq_epi8 (_mm_min_epu8 (v, ctrl), v)); // v <= 0x1f
+    uint32_t mask = (uint32_t) _mm_movemask_epi8 (m);
+    if (mask) return i + (size_t) __builtin_ctz (mask);
   }
-  if (len == adj_len)
+  return i + iot_data_json_scan_scalar (str + i, len - i);
+}
+
+#if defined (__x86_64__) && defined (__GNUC__)
+#define IOT_DATA_SCAN_AVX2
+__attribute__((target ("avx2"))) static size_t iot_data_json_scan_avx2 (const char * str, size_t len)
+{
+  const __m256i quote = _mm256_set1_epi8 ('"');
+  const __m256i slash = _mm256_set1_epi8 ('\\');
+  const __m256i ctrl = _mm256_set1_epi8 (0x1f);
+  size_t i = 0;
+  for (; i + 32u <= len; i += 32u)
   {
-    strcpy (holder->str + holder->size - holder->free - 1, add);
+    __m256i v = _mm256_loadu_si256 ((const __m256i*) (str + i));
+    __m256i m = _mm256_or_si256 (_mm256_cmpeq_epi8 (v, quote), _mm256_cmpeq_epi8 (v, slash));
+    m = _mm256_or_si256 (m, _mm256_cmpeq_epi8 (_mm256_min_epu8 (v, ctrl), v));
+    uint32_t mask = (uint32_t) _mm256_movemask_epi8 (m);
+    if (mask) return i + (size_t) __builtin_ctz (mask);
   }
-  else
+  return i + iot_data_json_scan_sse2 (str + i, len - i);
+}
+#endif
+#elif defined (__ARM_NEON)
+static size_t iot_data_json_scan_neon (const char * str, size_t len)
+{
+  const uint8x16_t quote = vdupq_n_u8 ('"');
+  const uint8x16_t slash = vdupq_n_u8 ('\\');
+  const uint8x16_t ctrl = vdupq_n_u8 (0x1f);
+  size_t i = 0;
+  for (; i + 16u <= len; i += 16u)
+  {
+    uint8x16_t v = vld1q_u8 ((const uint8_t*) (str + i));
+    uint8x16_t m = vorrq_u8 (vorrq_u8 (vceqq_u8 (v, quote), vceqq_u8 (v, slash)), vcleq_u8 (v, ctrl));
+    uint64_t mask = vget_lane_u64 (vreinterpret_u64_u8 (vshrn_n_u16 (vreinterpretq_u16_u8 (m), 4)), 0); // 4 bits per byte
+    if (mask) return i + (size_t) (__builtin_ctzll (mask) >> 2);
+  }
+  return i + iot_data_json_scan_scalar (str + i, len - i);
+}
+#endif
+
+#if defined (__SSE2__)
+static size_t (*iot_data_json_scan_fn) (const char * str, size_t len) = iot_data_json_scan_sse2;
+#elif defined (__ARM_NEON)
+static size_t (*iot_data_json_scan_fn) (const char * str, size_t len) = iot_data_json_scan_neon;
+#else
+static size_t (*iot_data_json_scan_fn) (const char * str, size_t len) = iot_data_json_scan_scalar;
+#endif
+
+#ifdef IOT_DATA_SCAN_AVX2
+__attribute__((constructor)) static void iot_data_json_scan_init (void)
+{
+  __builtin_cpu_init ();
+  if (__builtin_cpu_supports ("avx2")) iot_data_json_scan_fn = iot_data_json_scan_avx2;
+}
+#endif
+
+size_t iot_data_json_scan (const char * str, size_t len)
+{
+  return (len < 16u) ? iot_data_json_scan_scalar (str, len) : iot_data_json_scan_fn (str, len);
+}
+
+size_t iot_data_json_escaped_size (const char * str)
+{
+  size_t len = strlen (str);
+  const char * end = str + len;
+  while (true)
+  {
+    size_t run = iot_data_json_scan (str, (size_t) (end - str));
+    str += run;
+    if (str == end) break;
+    len += iot_data_repr_size (*str++) - 1u;
+  }
+  return len;
+}
+
+void iot_data_strcat_escape (iot_string_holder_t * holder, const char * add, bool escape)
+{
+  size_t len = strlen (add);
+  if (escape)
   {
     static const char * hex = "0123456789abcdef";
-    assert (strlen (holder->str) == (holder->size - holder->free - 1));
-    uint8_t * ptr = (uint8_t*) holder->str + holder->size - holder->free - 1;
-    for (i = 0; i < len; i++)
-    {
-      uint8_t c = add[i];
-      switch (iot_data_repr_size (c))
+    const char * end = add + len;
+    while (true)
+    {
+      size_t run = iot_data_json_scan (add, (size_t) (end - add));
+      iot_data_holder_append (holder, add, run);
+      add += run;
+      if (add == end) break;
+      if (holder->free < iot_data_repr_size (*add))
       {
-        case 1:
-          *ptr++ = c;
-          break;
-        case 2:
-          *ptr++ = '\\';
-          switch (c)
-          {
-            case '\b': *ptr++ = 'b'; break;
-            case '\f': *ptr++ = 'f'; break;
-            case '\n': *ptr++ = 'n'; break;
-            case '\r': *ptr++ = 'r'; break;
-            case '\t': *ptr++ = 't'; break;
-            case '\"': *ptr++ = '\"'; break;
-            case '\\': *ptr++ = '\\'; break;
-            default: break;
-          }
-          break;
-        default: // 6
-          *ptr++ = '\\';
+        iot_data_holder_realloc (holder, (size_t) (end - add) + 5u); // Worst case for escaped character plus rest of string
+      }
+      char * ptr = holder->str + holder->size - holder->free - 1;
+      uint8_t c = (uint8_t) *add++;
+      *ptr++ = '\\';
+      switch (c)
+      {
+        case '\b': *ptr++ = 'b'; break;
+        case '\f': *ptr++ = 'f'; break;
+        case '\n': *ptr++ = 'n'; break;
+        case '\r': *ptr++ = 'r'; break;
+        case '\t': *ptr++ = 't'; break;
+        case '\"': *ptr++ = '\"'; break;
+        case '\\': *ptr++ = '\\'; break;
+        default:
           *ptr++ = 'u';
           *ptr++ = '0';
           *ptr++ = '0';
           *ptr++ = (c & 0x10u) ? '1' : '0';
           *ptr++ = hex[c & 0x0fu];
+          holder->free -= 4u;
           break;
       }
+      holder->free -= 2u;
     }
-    *ptr = '\0';
   }
-  holder->free -= adj_len;
+  else
+  {
+    iot_data_holder_append (holder, add, len);
+  }
+  holder->str[holder->size - holder->free - 1] = '\0';
 }
 
 static inline void iot_data_strcat (iot_string_holder_t * holder, const char * add)
@@ -2645,7 +2923,7 @@ iot_data_t * iot_data_copy (const iot_data_t * data)
     case IOT_DATA_STRING:
     {
       const iot_data_value_t * val = (const iot_data_value_t *) data;
-      ret = iot_data_alloc_string (val->value.str, val->base.release ? IOT_DATA_COPY : IOT_DATA_REF);
+      ret = iot_data_alloc_string (val->value.str, (val->base.release || val->base.backed) ? IOT_DATA_COPY : IOT_DATA_REF);
       break;
     }
     case IOT_DATA_BINARY:
@@ -2658,14 +2936,25 @@ iot_data_t * iot_data_copy (const iot_data_t * data)
     }
     case IOT_DATA_MAP:
     {
-      iot_data_map_iter_t iter;
-      ret = iot_data_alloc_typed_map (data->key_type, data->element_type);
-      iot_data_map_iter (data, &iter);
-      while (iot_data_map_iter_next (&iter))
+      const iot_data_map_t * map = (const iot_data_map_t*) data;
+      ret = iot_data_map_alloc_as (data);
+      if (map->order)
       {
-        iot_data_t * key = iot_data_copy (iot_data_map_iter_key (&iter));
-        iot_data_t * value = iot_data_copy (iot_data_map_iter_value (&iter));
-        iot_data_map_add (ret, key, value);
+        for (uint32_t i = 0; i < map->size; i++)
+        {
+          iot_data_map_add (ret, iot_data_copy (map->order[i]->key), iot_data_copy (map->order[i]->value));
+        }
+      }
+      else
+      {
+        iot_data_map_iter_t iter;
+        iot_data_map_iter (data, &iter);
+        while (iot_data_map_iter_next (&iter))
+        {
+          iot_data_t * key = iot_data_copy (iot_data_map_iter_key (&iter));
+          iot_data_t * value = iot_data_copy (iot_data_map_iter_value (&iter));
+          iot_data_map_add (ret, key, value);
+        }
       }
       break;
     }
@@ -2744,12 +3033,23 @@ extern iot_data_t * iot_data_shallow_copy (const iot_data_t * src)
   {
     case IOT_DATA_MAP:
     {
-      result = iot_data_alloc_typed_map (src->key_type, src->element_type);
-      iot_data_map_iter_t iter;
-      iot_data_map_iter (src, &iter);
-      while (iot_data_map_iter_next (&iter))
+      const iot_data_map_t * map = (const iot_data_map_t*) src;
+      result = iot_data_map_alloc_as (src);
+      if (map->order)
       {
-        iot_data_map_add (result, iot_data_add_ref (iot_data_map_iter_key (&iter)), iot_data_add_ref (iot_data_map_iter_value (&iter)));
+        for (uint32_t i = 0; i < map->size; i++)
+        {
+          iot_data_map_add (result, iot_data_add_ref (map->order[i]->key), iot_data_add_ref (map->order[i]->value));
+        }
+      }
+      else
+      {
+        iot_data_map_iter_t iter;
+        iot_data_map_iter (src, &iter);
+        while (iot_data_map_iter_next (&iter))
+        {
+          iot_data_map_add (result, iot_data_add_ref (iot_data_map_iter_key (&iter)), iot_data_add_ref (iot_data_map_iter_value (&iter)));
+        }
       }
       break;
     }
@@ -3160,7 +3460,7 @@ static inline iot_node_t * iot_node_find (const iot_node_t * node, const iot_dat
   return (iot_node_t*) node;
 }
 
-static void iot_node_insert (iot_data_map_t * map, iot_data_t * key, iot_data_t * value)
+static iot_node_t * iot_node_insert (iot_data_map_t * map, iot_data_t * key, iot_data_t * value)
 {
   iot_node_t * node = iot_node_alloc (NULL, key, value);
   iot_node_t * y = NULL;
@@ -3183,6 +3483,7 @@ static void iot_node_insert (iot_data_map_t * map, iot_data_t * key, iot_data_t
   {
     node->colour = IOT_NODE_BLACK;
   }
+  return node;
 }
 
 static void iot_node_transplant (iot_data_map_t * map, iot_node_t * u, iot_node_t * v)
@@ -3232,6 +3533,12 @@ static bool iot_node_remove (iot_data_map_t * map, const iot_data_t * key)
       y->colour = z->colour;
     }
     if (x && (col == IOT_NODE_BLACK)) iot_node_remove_balance (map, x);
+    if (map->order)
+    {
+      uint32_t i = 0;
+      while (map->order[i] != z) i++;
+      memmove (&map->order[i], &map->order[i + 1u], sizeof (iot_node_t*) * (map->size - i - 1u));
+    }
     iot_node_delete (z);
   }
   return (z != NULL);
@@ -3249,7 +3556,16 @@ static bool iot_node_add (iot_data_map_t * map, iot_data_t * key, iot_data_t * v
   }
   else
   {
-    iot_node_insert (map, key, value);
+    iot_node_t * added = iot_node_insert (map, key, value);
+    if (map->order) // Append to insertion order, size not yet incremented
+    {
+      if (map->size == map->capacity)
+      {
+        map->capacity *= 2u;
+        map->order = realloc (map->order, sizeof (iot_node_t*) * map->capacity);
+      }
+      map->order[map->size] = added;
+    }
     iot_data_map_hash (&map->base, key, value);
   }
   return (node == NULL);
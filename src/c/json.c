@@ -9,6 +9,7 @@
 //   Copyright (c) 2010 Serge A. Zaitsev SPDX-License-Identifier: MIT
 //
 #include "iot/json.h"
+#include "data-impl.h"
 /**
  * Allocates a fresh unused token from the token pool.
  */
@@ -104,6 +105,8 @@ static int iot_json_parse_string (iot_json_parser *parser, const char *js, size_
   /* Skip starting quote */
   for (; parser->pos < len && js[parser->pos] != '\0'; parser->pos++)
   {
+    parser->pos += (uint32_t) iot_data_json_scan (js + parser->pos, len - parser->pos); // Skip plain characters
+    if (parser->pos >= len || js[parser->pos] == '\0') break;
     char c = js[parser->pos];
 
     /* Quote: end of string */
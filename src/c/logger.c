@@ -7,6 +7,9 @@
 #include "iot/logger.h"
 #include "iot/container.h"
 #include "iot/time.h"
+#include "iot/thread.h"
+#include "iot/hash.h"
+#include "data-impl.h"
 #include <stdarg.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
@@ -15,6 +18,11 @@
 #ifdef IOT_HAS_PRCTL
 #include <sys/prctl.h>
 #endif
+#if defined (IOT_HAS_FILE) && !defined (_AZURESPHERE_)
+#include <spawn.h>
+#include <sys/wait.h>
+extern char ** environ;
+#endif
 
 #ifdef __ZEPHYR__
 static time_t time (time_t *t)
@@ -28,6 +36,15 @@ static time_t time (time_t *t)
 
 #define IOT_PRCTL_NAME_MAX 16
 #define IOT_LOG_LEVELS 6
+#define IOT_LOG_ASYNC_IDLE_NS 100000000u  // Async writer idle wait (100ms)
+#define IOT_LOG_ASYNC_BLOCK_NS 10000000u  // Async producer wait when ring full (10ms)
+#define IOT_LOG_ASYNC_SIZE 256u           // Default async ring size
+#define IOT_LOG_ASYNC_MAX (1u << 16)      // Maximum async ring size
+#define IOT_LOG_ROTATE_COUNT 5u           // Default number of rotated log files retained
+#define IOT_LOG_LIMIT_SITES 256u          // Number of rate limited call sites tracked
+#define IOT_LOG_LIMIT_PROBES 8u           // Number of call site slots probed before evicting a site
+#define IOT_LOG_LIMIT_NAME 64u            // Length of call site format string copy logged in summaries
+#define IOT_LOG_LIMIT_INTERVAL 1000u      // Default rate limit and repeat suppression interval (ms)
 
 #ifdef IOT_BUILD_COMPONENTS
 #define IOT_LOGGER_FACTORY iot_logger_factory ()
@@ -35,6 +52,60 @@ static time_t time (time_t *t)
 #define IOT_LOGGER_FACTORY NULL
 #endif
 
+typedef struct iot_log_record_t
+{
+  atomic_uint_fast32_t seq;           // Ring slot sequence number
+  iot_loglevel_t level;               // Log level
+  uint64_t timestamp;                 // Time of log call
+  bool deferred;                      // Whether formatting is deferred to the writer thread
+  iot_data_t * fields;                // Structured logging fields
+  char tname[IOT_PRCTL_NAME_MAX];     // Name of logging thread
+  char message[IOT_LOG_MSG_MAX];      // Log message, or copy of format string followed by captured arguments if deferred
+} iot_log_record_t;
+
+typedef struct iot_log_ring_t
+{
+  iot_log_record_t * records;         // Ring of log records, size is a power of two
+  uint_fast32_t mask;                 // Ring size - 1
+  atomic_uint_fast32_t head;          // Next slot to be claimed by a logging thread
+  uint_fast32_t tail;                 // Next slot to be written by writer thread
+  iot_log_overflow_t overflow;        // Policy when ring is full
+  atomic_uint_fast64_t dropped;       // Count of dropped records
+  atomic_uint_fast32_t waiting;       // Count of logging threads blocked on a full ring
+  atomic_bool sleeping;               // Whether writer thread is idle
+  bool running;                       // Cleared to stop writer thread
+  pthread_t writer;                    // Writer thread, joined when stopped
+  pthread_mutex_t mutex;              // Mutex for idle and blocking waits
+  pthread_cond_t added;               // Signalled when records added to an idle ring
+  pthread_cond_t removed;             // Signalled when records removed from a full ring
+  char buff[IOT_LOG_MSG_MAX];         // Writer thread buffer for deferred formatting
+} iot_log_ring_t;
+
+typedef struct iot_log_site_t
+{
+  const char * fmt;                   // Call site format string address, used only as key
+  char name[IOT_LOG_LIMIT_NAME];      // Truncated copy of format string for summaries
+  iot_loglevel_t level;               // Level logged by call site
+  uint64_t start;                     // Start time of current rate limit interval
+  uint32_t count;                     // Records logged in current interval
+  uint32_t dropped;                   // Records dropped in current interval
+} iot_log_site_t;
+
+typedef struct iot_log_limiter_t
+{
+  pthread_mutex_t mutex;              // Limiter mutex
+  _Atomic uint32_t rate;              // Maximum records per call site per interval, zero for no limit
+  uint64_t interval;                  // Rate limit and repeat suppression interval (usecs)
+  _Atomic bool suppress;              // Whether repeated messages are suppressed
+  uint32_t hash;                      // Hash of last message logged
+  iot_loglevel_t level;               // Level of last message logged
+  uint64_t last;                      // Time last message logged
+  uint32_t repeats;                   // Number of times last message suppressed
+  iot_log_site_t sites[IOT_LOG_LIMIT_SITES]; // Call sites, open addressed by format string address
+} iot_log_limiter_t;
+
+typedef void (*iot_log_idle_fn_t) (iot_logger_t * logger, void * ctx);
+
 typedef struct iot_logger_impl_t
 {
   iot_logger_t base;                  // Public part of logger
@@ -42,17 +113,29 @@ typedef struct iot_logger_impl_t
   char * name;                        // Name of logger
   iot_log_function_t impl;            // Log implementation function
   iot_log_free_fn_t freectx;          // Function to free log context
+  iot_log_idle_fn_t idle;             // Function called by asynchronous writer thread when idle
   void *ctx;                          // Context for custom loggers
   struct iot_logger_impl_t * next;    // Pointer to next logger (can be chained in config)
-  char buff [IOT_LOG_MSG_MAX];        // Log format buffer
+  iot_string_holder_t out;            // Log format buffer
+  iot_log_format_t format;            // Log output format
   bool no_stderr;                     // If set, console logs go to stdout only
+  iot_log_ring_t * ring;              // Ring buffer for asynchronous logging
+  _Atomic (iot_log_limiter_t *) limiter; // Rate limiting and repeat suppression, retained until logger freed
+  const iot_log_record_t * record;    // Record being written by asynchronous writer thread
 }
 iot_logger_impl_t;
 
 static const char * iot_log_levels[IOT_LOG_LEVELS] = {"", "ERROR", "WARN", "Info", "Debug", "Trace"};
 static iot_logger_impl_t iot_logger_dfl;
+static _Thread_local const iot_data_t * iot_log_current_fields = NULL; // Fields of record being written
 
 static void iot_log_console (iot_logger_t * logger, iot_loglevel_t level, uint64_t timestamp, const char * message, const void *ctx);
+static void iot_logger_async_add (iot_log_ring_t * ring, iot_loglevel_t level, uint64_t timestamp, const iot_data_t * fields, const char * message, const char * fmt, va_list args);
+static void iot_logger_async_stop (iot_logger_impl_t * logger);
+static bool iot_logger_rate_limit (iot_logger_impl_t * logger, iot_log_limiter_t * limiter, iot_loglevel_t level, uint64_t timestamp, const char * fmt, va_list args);
+static bool iot_logger_repeat_limit (iot_logger_impl_t * logger, iot_log_limiter_t * limiter, iot_loglevel_t level, uint64_t timestamp, const char * message, va_list args);
+static void iot_logger_limit_flush (iot_logger_impl_t * logger, iot_log_limiter_t * limiter);
+static void iot_logger_limiter_free (iot_log_limiter_t * limiter);
 
 iot_logger_t * iot_logger_default (void)
 {
@@ -69,15 +152,68 @@ iot_logger_t * iot_logger_default (void)
 }
 
 void iot_log__va_log (iot_logger_t * l, iot_loglevel_t level, const char* fmt, va_list args)
+{
+  iot_log__va_log_fields (l, level, NULL, fmt, args);
+}
+
+void iot_log__va_log_fields (iot_logger_t * l, iot_loglevel_t level, const iot_data_t * fields, const char* fmt, va_list args)
 {
   iot_logger_impl_t *logger = (iot_logger_impl_t*) l;
-  char str[1024];
-  vsnprintf (str, sizeof (str), fmt, args);
+  const iot_data_t * saved = iot_log_current_fields;
+  char str[IOT_LOG_MSG_MAX];
+  bool formatted = false;
   uint64_t ts = iot_time_usecs ();
+  iot_log_current_fields = fields;
   do
   {
-    if (logger->base.level >= level) (logger->impl) (&logger->base, level, ts, str, logger->ctx);
+    if (logger->base.level >= level)
+    {
+      va_list copy;
+      va_copy (copy, args);
+      iot_log_limiter_t * limiter = atomic_load (&logger->limiter);
+      bool ok = (limiter == NULL || atomic_load (&limiter->rate) == 0u || iot_logger_rate_limit (logger, limiter, level, ts, fmt, args));
+      if (ok && limiter && atomic_load (&limiter->suppress))
+      {
+        if (!formatted) // Repeat detection requires formatted message
+        {
+          vsnprintf (str, sizeof (str), fmt, copy);
+          formatted = true;
+        }
+        ok = iot_logger_repeat_limit (logger, limiter, level, ts, str, args);
+      }
+      if (ok)
+      {
+        if (logger->ring)
+        {
+          iot_logger_async_add (logger->ring, level, ts, fields, formatted ? str : NULL, fmt, copy);
+        }
+        else
+        {
+          if (!formatted)
+          {
+            vsnprintf (str, sizeof (str), fmt, copy);
+            formatted = true;
+          }
+          (logger->impl) (&logger->base, level, ts, str, logger->ctx);
+        }
+      }
+      va_end (copy);
+    }
   } while ((logger = logger->next));
+  iot_log_current_fields = saved;
+}
+
+void iot_log__log_fields (iot_logger_t * l, iot_loglevel_t level, const iot_data_t * fields, const char *fmt, ...)
+{
+  va_list args;
+  va_start (args, fmt);
+  iot_log__va_log_fields (l, level, fields, fmt, args);
+  va_end (args);
+}
+
+const iot_data_t * iot_logger_record_fields (void)
+{
+  return iot_log_current_fields;
 }
 
 void iot_log__log (iot_logger_t * l, iot_loglevel_t level, const char *fmt, ...)
@@ -105,6 +241,8 @@ iot_logger_t * iot_logger_alloc_custom (const char * name, iot_loglevel_t level,
   logger->next = (iot_logger_impl_t*) next;
   logger->ctx = ctx;
   logger->freectx = freectx;
+  logger->out.size = IOT_LOG_MSG_MAX;
+  logger->out.str = malloc (IOT_LOG_MSG_MAX);
   iot_component_init (&logger->base.component, IOT_LOGGER_FACTORY, (iot_component_start_fn_t) iot_logger_start, (iot_component_stop_fn_t) iot_logger_stop);
   if (start) iot_logger_start (&logger->base);
   return &logger->base;
@@ -120,9 +258,12 @@ void iot_logger_free (iot_logger_t * logger)
   iot_logger_impl_t * impl = (iot_logger_impl_t*) logger;
   if (impl && (impl != &iot_logger_dfl) && iot_component_dec_ref (&logger->component))
   {
+    iot_logger_async_stop (impl);
+    iot_logger_limiter_free (atomic_load (&impl->limiter));
     free (impl->name);
     iot_logger_free ((iot_logger_t*) impl->next);
     if (impl->freectx) (impl->freectx) (impl->ctx);
+    free (impl->out.str);
     iot_component_fini (&logger->component);
     free (logger);
   }
@@ -150,13 +291,103 @@ void iot_logger_stop (iot_logger_t * logger)
   logger->level = IOT_LOG_NONE;
 }
 
-static inline size_t iot_logger_format_log (iot_logger_impl_t * logger, iot_loglevel_t level, uint64_t timestamp, const char * message)
+void iot_logger_set_format (iot_logger_t * logger, iot_log_format_t format)
+{
+  assert (logger);
+  ((iot_logger_impl_t*) logger)->format = format;
+}
+
+static void iot_logger_printf (iot_string_holder_t * out, const char * fmt, ...) __attribute__ ((format (printf, 2, 3)));
+
+static void iot_logger_printf (iot_string_holder_t * out, const char * fmt, ...)
+{
+  va_list args;
+  size_t used = out->size - out->free - 1u;
+  va_start (args, fmt);
+  int len = vsnprintf (out->str + used, out->free + 1u, fmt, args);
+  va_end (args);
+  if (len > 0 && (size_t) len > out->free)
+  {
+    iot_data_holder_realloc (out, (size_t) len);
+    va_start (args, fmt);
+    vsnprintf (out->str + used, out->free + 1u, fmt, args);
+    va_end (args);
+  }
+  if (len > 0) out->free -= (size_t) len;
+}
+
+static bool iot_logger_json_reserved (const char * key)
+{
+  static const char * reserved[] = { "thread", "timestamp", "logger", "level", "message" };
+  for (size_t i = 0; i < sizeof (reserved) / sizeof (reserved[0]); i++)
+  {
+    if (strcmp (key, reserved[i]) == 0) return true;
+  }
+  return false;
+}
+
+/* Formats a log record into the logger output buffer, either as text or as a JSON object
+ * (one per line) with the structured logging fields merged in. Fields with non string keys,
+ * or whose key is that of a record member, are omitted from JSON records. Returns the formatted length.
+ */
+static size_t iot_logger_format_log (iot_logger_impl_t * logger, iot_loglevel_t level, uint64_t timestamp, const char * message)
 {
+  iot_string_holder_t * out = &logger->out;
+  const iot_data_t * fields = iot_log_current_fields;
   char tname[IOT_PRCTL_NAME_MAX] = { 0 };
+  if (logger->record)
+  {
+    strcpy (tname, logger->record->tname);
+  }
 #ifdef IOT_HAS_PRCTL
-  prctl (PR_GET_NAME, tname);
+  else
+  {
+    prctl (PR_GET_NAME, tname);
+  }
 #endif
-  return (size_t) snprintf (logger->buff, sizeof (logger->buff), "[%s:%" PRIu64 ":%s:%s] %s\n", tname, timestamp, logger->name, iot_log_levels[level], message);
+  if (out->str == NULL) // Default logger
+  {
+    out->size = IOT_LOG_MSG_MAX;
+    out->str = malloc (IOT_LOG_MSG_MAX);
+  }
+  out->free = out->size - 1u;
+  out->str[0] = '\0';
+  if (logger->format == IOT_LOG_FORMAT_JSON)
+  {
+    iot_logger_printf (out, "{\"thread\":\"");
+    iot_data_strcat_escape (out, tname, true);
+    iot_logger_printf (out, "\",\"timestamp\":%" PRIu64 ",\"logger\":\"", timestamp);
+    iot_data_strcat_escape (out, logger->name ? logger->name : "", true);
+    iot_logger_printf (out, "\",\"level\":\"%s\",\"message\":\"", iot_log_levels[level]);
+    iot_data_strcat_escape (out, message, true);
+    iot_data_strcat_escape (out, "\"", false);
+    if (fields && iot_data_type (fields) == IOT_DATA_MAP)
+    {
+      iot_data_map_iter_t iter;
+      iot_data_map_iter (fields, &iter);
+      while (iot_data_map_iter_next (&iter)) // Merge fields into record object
+      {
+        const iot_data_t * key = iot_data_map_iter_key (&iter);
+        if (iot_data_type (key) != IOT_DATA_STRING || iot_logger_json_reserved (iot_data_string (key))) continue;
+        iot_data_strcat_escape (out, ",", false);
+        iot_data_dump_json (out, key);
+        iot_data_strcat_escape (out, ":", false);
+        iot_data_dump_json (out, iot_data_map_iter_value (&iter));
+      }
+    }
+    iot_data_strcat_escape (out, "}", false);
+  }
+  else
+  {
+    iot_logger_printf (out, "[%s:%" PRIu64 ":%s:%s] %s", tname, timestamp, logger->name, iot_log_levels[level], message);
+    if (fields)
+    {
+      iot_data_strcat_escape (out, " ", false);
+      iot_data_dump_json (out, fields);
+    }
+  }
+  iot_data_strcat_escape (out, "\n", false);
+  return out->size - out->free - 1u;
 }
 
 static inline void iot_logger_log_to_fd (iot_logger_impl_t * logger, FILE * fd, iot_loglevel_t level, uint64_t timestamp, const char *message)
@@ -165,9 +396,9 @@ static inline void iot_logger_log_to_fd (iot_logger_impl_t * logger, FILE * fd,
   if (iot_logger_format_log (logger, level, timestamp, message))
   {
 #ifdef _AZURESPHERE_
-    Log_Debug ("%s", logger->buff);
+    Log_Debug ("%s", logger->out.str);
 #else
-    fprintf (fd, "%s", logger->buff);
+    fputs (logger->out.str, fd);
 #endif
   }
   iot_component_unlock (&logger->base.component);
@@ -180,6 +411,684 @@ static void iot_log_console (iot_logger_t * logger, iot_loglevel_t level, uint64
   iot_logger_log_to_fd (impl, (impl->no_stderr || level > IOT_LOG_WARN) ? stdout : stderr, level, timestamp, message);
 }
 
+/********* Asynchronous Logging *********/
+
+/* Records are claimed and published by logging threads using per slot sequence numbers (bounded MPSC ring),
+ * so the only cost on the logging thread is capturing the message. A single writer thread per logger drains
+ * the ring in batches, calling the logger implementation function for each record.
+ *
+ * Where possible the format string pointer and raw arguments are captured rather than the formatted message,
+ * deferring the cost of formatting to the writer thread. Integers are widened to intmax_t, strings are copied
+ * and each conversion is formatted individually when the record is written. Formats that can't be deferred
+ * (positional arguments, %n, %m, wide characters, long double or captured arguments exceeding the record size)
+ * are formatted by the logging thread.
+ */
+
+typedef struct iot_log_spec_t
+{
+  const char * seg;                   // Flags, width and precision
+  size_t seg_len;                     // Length of flags, width and precision
+  uint32_t stars;                     // Number of '*' width or precision arguments
+  int prec;                           // Precision if specified as digits, otherwise -1
+  bool prec_star;                     // Whether precision is specified as a '*' argument
+  char length;                        // Length modifier: 'H' (hh), 'h', 'l', 'q' (ll), 'j', 'z', 't', 'L' or 0
+  char conv;                          // Conversion specifier
+} iot_log_spec_t;
+
+static const char * iot_log_spec_parse (const char * fmt, iot_log_spec_t * spec)
+{
+  spec->seg = fmt;
+  spec->stars = 0u;
+  spec->prec = -1;
+  spec->prec_star = false;
+  spec->length = 0;
+  while (*fmt && strchr ("-+ #0'", *fmt)) fmt++;
+  if (*fmt == '*')
+  {
+    spec->stars++;
+    fmt++;
+  }
+  while (isdigit ((unsigned char) *fmt)) fmt++;
+  if (*fmt == '.')
+  {
+    fmt++;
+    if (*fmt == '*')
+    {
+      spec->stars++;
+      spec->prec_star = true;
+      fmt++;
+    }
+    else
+    {
+      spec->prec = 0;
+      while (isdigit ((unsigned char) *fmt)) spec->prec = spec->prec * 10 + (*fmt++ - '0');
+    }
+  }
+  spec->seg_len = (size_t) (fmt - spec->seg);
+  switch (*fmt)
+  {
+    case 'h': spec->length = (fmt[1] == 'h') ? 'H' : 'h'; fmt += (fmt[1] == 'h') ? 2 : 1; break;
+    case 'l': spec->length = (fmt[1] == 'l') ? 'q' : 'l'; fmt += (fmt[1] == 'l') ? 2 : 1; break;
+    case 'q': case 'j': case 'z': case 't': case 'L': spec->length = (*fmt == 'q') ? 'q' : *fmt; fmt++; break;
+    default: break;
+  }
+  spec->conv = *fmt;
+  return *fmt ? (fmt + 1) : NULL;
+}
+
+static inline bool iot_log_store (uint8_t * buff, size_t size, size_t * used, const void * val, size_t len)
+{
+  if ((*used + len) > size) return false;
+  memcpy (buff + *used, val, len);
+  *used += len;
+  return true;
+}
+
+static inline uintmax_t iot_log_int_arg (char length, bool sgn, va_list * args)
+{
+  switch (length)
+  {
+    case 'H': return sgn ? (uintmax_t) (signed char) va_arg (*args, int) : (unsigned char) va_arg (*args, unsigned);
+    case 'h': return sgn ? (uintmax_t) (short) va_arg (*args, int) : (unsigned short) va_arg (*args, unsigned);
+    case 'l': return sgn ? (uintmax_t) va_arg (*args, long) : va_arg (*args, unsigned long);
+    case 'q': return sgn ? (uintmax_t) va_arg (*args, long long) : va_arg (*args, unsigned long long);
+    case 'j': return sgn ? (uintmax_t) va_arg (*args, intmax_t) : va_arg (*args, uintmax_t);
+    case 'z': return sgn ? (uintmax_t) (intmax_t) (ssize_t) va_arg (*args, size_t) : va_arg (*args, size_t);
+    case 't': return (uintmax_t) va_arg (*args, ptrdiff_t);
+    default: break;
+  }
+  return sgn ? (uintmax_t) va_arg (*args, int) : va_arg (*args, unsigned);
+}
+
+static bool iot_log_capture (uint8_t * buff, size_t size, const char * fmt, va_list args)
+{
+  size_t used = 0u;
+  va_list ap;
+  va_copy (ap, args);
+  while ((fmt = strchr (fmt, '%')))
+  {
+    iot_log_spec_t spec;
+    bool ok = true;
+    if (fmt[1] == '%')
+    {
+      fmt += 2;
+      continue;
+    }
+    fmt = iot_log_spec_parse (fmt + 1, &spec);
+    if (fmt == NULL || spec.seg_len > 32u) goto fail;
+    int prec = spec.prec;
+    for (uint32_t i = 0; i < spec.stars; i++)
+    {
+      int val = va_arg (ap, int);
+      if (!iot_log_store (buff, size, &used, &val, sizeof (val))) goto fail;
+      if (spec.prec_star) prec = val; // Precision is always the last '*' argument
+    }
+    switch (spec.conv)
+    {
+      case 'd': case 'i': case 'u': case 'o': case 'x': case 'X':
+      {
+        if (spec.length == 'L') goto fail;
+        uintmax_t val = iot_log_int_arg (spec.length, spec.conv == 'd' || spec.conv == 'i', &ap);
+        ok = iot_log_store (buff, size, &used, &val, sizeof (val));
+        break;
+      }
+      case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+      {
+        if (spec.length == 'L') goto fail;
+        double val = va_arg (ap, double);
+        ok = iot_log_store (buff, size, &used, &val, sizeof (val));
+        break;
+      }
+      case 'c':
+      {
+        if (spec.length) goto fail;
+        int val = va_arg (ap, int);
+        ok = iot_log_store (buff, size, &used, &val, sizeof (val));
+        break;
+      }
+      case 'p':
+      {
+        void * val = va_arg (ap, void*);
+        ok = iot_log_store (buff, size, &used, &val, sizeof (val));
+        break;
+      }
+      case 's':
+      {
+        if (spec.length) goto fail;
+        const char * str = va_arg (ap, const char*);
+        if (str == NULL) str = "(null)";
+        size_t len = (prec < 0) ? strlen (str) : strnlen (str, (size_t) prec);
+        ok = iot_log_store (buff, size, &used, str, len) && iot_log_store (buff, size, &used, "", 1u);
+        break;
+      }
+      default: goto fail;
+    }
+    if (!ok) goto fail;
+  }
+  va_end (ap);
+  return true;
+
+fail:
+  va_end (ap);
+  return false;
+}
+
+static void iot_log_deferred_format (char * out, size_t size, const char * fmt, const uint8_t * buff)
+{
+  size_t len = 0u;
+  char sfmt[64];
+  while (*fmt && len < (size - 1u))
+  {
+    size_t run = strcspn (fmt, "%");
+    if (run)
+    {
+      if (run > (size - 1u - len)) run = size - 1u - len;
+      memcpy (out + len, fmt, run);
+      len += run;
+      fmt += run;
+      continue;
+    }
+    if (fmt[1] == '%')
+    {
+      out[len++] = '%';
+      fmt += 2;
+      continue;
+    }
+    iot_log_spec_t spec;
+    fmt = iot_log_spec_parse (fmt + 1, &spec);
+    size_t flen = 0u;
+    sfmt[flen++] = '%';
+    for (size_t i = 0; i < spec.seg_len; i++)
+    {
+      if (spec.seg[i] == '*')
+      {
+        int val;
+        memcpy (&val, buff, sizeof (val));
+        buff += sizeof (val);
+        flen += (size_t) snprintf (sfmt + flen, sizeof (sfmt) - flen, "%d", val);
+      }
+      else
+      {
+        sfmt[flen++] = spec.seg[i];
+      }
+    }
+    int n = 0;
+    char * dest = out + len;
+    size_t avail = size - len;
+    switch (spec.conv)
+    {
+      case 'd': case 'i': case 'u': case 'o': case 'x': case 'X':
+      {
+        uintmax_t val;
+        memcpy (&val, buff, sizeof (val));
+        buff += sizeof (val);
+        sfmt[flen++] = 'j';
+        sfmt[flen++] = spec.conv;
+        sfmt[flen] = '\0';
+        n = (spec.conv == 'd' || spec.conv == 'i') ? snprintf (dest, avail, sfmt, (intmax_t) val) : snprintf (dest, avail, sfmt, val);
+        break;
+      }
+      case 'c':
+      {
+        int val;
+        memcpy (&val, buff, sizeof (val));
+        buff += sizeof (val);
+        sfmt[flen++] = 'c';
+        sfmt[flen] = '\0';
+        n = snprintf (dest, avail, sfmt, val);
+        break;
+      }
+      case 'p':
+      {
+        void * val;
+        memcpy (&val, buff, sizeof (val));
+        buff += sizeof (val);
+        sfmt[flen++] = 'p';
+        sfmt[flen] = '\0';
+        n = snprintf (dest, avail, sfmt, val);
+        break;
+      }
+      case 's':
+      {
+        const char * str = (const char*) buff;
+        buff += strlen (str) + 1u;
+        sfmt[flen++] = 's';
+        sfmt[flen] = '\0';
+        n = snprintf (dest, avail, sfmt, str);
+        break;
+      }
+      default: // Floating point
+      {
+        double val;
+        memcpy (&val, buff, sizeof (val));
+        buff += sizeof (val);
+        sfmt[flen++] = spec.conv;
+        sfmt[flen] = '\0';
+        n = snprintf (dest, avail, sfmt, val);
+        break;
+      }
+    }
+    if (n > 0) len = ((size_t) n < avail) ? (len + (size_t) n) : (size - 1u);
+  }
+  out[len] = '\0';
+}
+
+static inline void iot_logger_async_deadline (struct timespec * ts, uint64_t ns)
+{
+  ns += iot_time_nsecs ();
+  ts->tv_sec = (time_t) (ns / 1000000000u);
+  ts->tv_nsec = (long) (ns % 1000000000u);
+}
+
+static inline bool iot_logger_async_pending (const iot_log_ring_t * ring)
+{
+  return atomic_load (&ring->records[ring->tail & ring->mask].seq) == (ring->tail + 1u);
+}
+
+static void iot_logger_async_add (iot_log_ring_t * ring, iot_loglevel_t level, uint64_t timestamp, const iot_data_t * fields, const char * message, const char * fmt, va_list args)
+{
+  iot_log_record_t * rec;
+  uint_fast32_t pos = atomic_load (&ring->head);
+  while (true)
+  {
+    rec = &ring->records[pos & ring->mask];
+    int_fast32_t diff = (int_fast32_t) (atomic_load (&rec->seq) - pos);
+    if (diff == 0)
+    {
+      if (atomic_compare_exchange_weak (&ring->head, &pos, pos + 1u)) break;
+    }
+    else if (diff < 0) // Ring full
+    {
+      if (ring->overflow == IOT_LOG_OVERFLOW_DROP)
+      {
+        atomic_fetch_add (&ring->dropped, 1u);
+        return;
+      }
+      struct timespec ts;
+      iot_logger_async_deadline (&ts, IOT_LOG_ASYNC_BLOCK_NS);
+      pthread_mutex_lock (&ring->mutex);
+      atomic_fetch_add (&ring->waiting, 1u);
+      if (atomic_load (&rec->seq) != pos) pthread_cond_timedwait (&ring->removed, &ring->mutex, &ts); // Recheck once waiting is visible to writer
+      atomic_fetch_sub (&ring->waiting, 1u);
+      pthread_mutex_unlock (&ring->mutex);
+      pos = atomic_load (&ring->head);
+    }
+    else
+    {
+      pos = atomic_load (&ring->head);
+    }
+  }
+  rec->level = level;
+  rec->timestamp = timestamp;
+  rec->tname[0] = '\0';
+#ifdef IOT_HAS_PRCTL
+  prctl (PR_GET_NAME, rec->tname);
+#endif
+  rec->deferred = false;
+  rec->fields = fields ? iot_data_add_ref (fields) : NULL;
+  size_t flen = message ? 0u : strlen (fmt) + 1u;
+  if (message)
+  {
+    strncpy (rec->message, message, sizeof (rec->message) - 1u);
+    rec->message[sizeof (rec->message) - 1u] = '\0';
+  }
+  else if (flen < sizeof (rec->message) && iot_log_capture ((uint8_t*) rec->message + flen, sizeof (rec->message) - flen, fmt, args))
+  {
+    memcpy (rec->message, fmt, flen); // Format string copied as it need not outlive the log call
+    rec->deferred = true;
+  }
+  else
+  {
+    vsnprintf (rec->message, sizeof (rec->message), fmt, args);
+  }
+  atomic_store (&rec->seq, pos + 1u);
+  if (atomic_load (&ring->sleeping))
+  {
+    pthread_mutex_lock (&ring->mutex);
+    pthread_cond_signal (&ring->added);
+    pthread_mutex_unlock (&ring->mutex);
+  }
+}
+
+static void * iot_logger_async_thread (void * arg)
+{
+  iot_logger_impl_t * logger = (iot_logger_impl_t*) arg;
+  iot_log_ring_t * ring = logger->ring;
+  struct timespec ts;
+#ifdef IOT_HAS_PRCTL
+  prctl (PR_SET_NAME, "iot-logger");
+#endif
+  while (true)
+  {
+    uint32_t count = 0u;
+    while (iot_logger_async_pending (ring))
+    {
+      iot_log_record_t * rec = &ring->records[ring->tail & ring->mask];
+      const char * message = rec->message;
+      if (rec->deferred)
+      {
+        iot_log_deferred_format (ring->buff, sizeof (ring->buff), rec->message, (const uint8_t*) rec->message + strlen (rec->message) + 1u);
+        message = ring->buff;
+      }
+      logger->record = rec;
+      iot_log_current_fields = rec->fields;
+      (logger->impl) (&logger->base, rec->level, rec->timestamp, message, logger->ctx);
+      iot_data_free (rec->fields);
+      atomic_store (&rec->seq, ring->tail + ring->mask + 1u);
+      ring->tail++;
+      count++;
+    }
+    logger->record = NULL;
+    iot_log_current_fields = NULL;
+    if (count && atomic_load (&ring->waiting))
+    {
+      pthread_mutex_lock (&ring->mutex);
+      pthread_cond_broadcast (&ring->removed);
+      pthread_mutex_unlock (&ring->mutex);
+    }
+    if (count == 0u)
+    {
+      bool running;
+      pthread_mutex_lock (&ring->mutex);
+      atomic_store (&ring->sleeping, true);
+      running = ring->running;
+      if (running && !iot_logger_async_pending (ring))
+      {
+        iot_logger_async_deadline (&ts, IOT_LOG_ASYNC_IDLE_NS);
+        pthread_cond_timedwait (&ring->added, &ring->mutex, &ts);
+      }
+      atomic_store (&ring->sleeping, false);
+      pthread_mutex_unlock (&ring->mutex);
+      iot_log_limiter_t * limiter = atomic_load (&logger->limiter);
+      if (limiter) iot_logger_limit_flush (logger, limiter);
+      if (logger->idle) (logger->idle) (&logger->base, logger->ctx);
+      if (!running) break;
+    }
+  }
+  return NULL;
+}
+
+static void iot_logger_ring_free (iot_log_ring_t * ring)
+{
+  pthread_cond_destroy (&ring->added);
+  pthread_cond_destroy (&ring->removed);
+  pthread_mutex_destroy (&ring->mutex);
+  free (ring->records);
+  free (ring);
+}
+
+static void iot_logger_async_stop (iot_logger_impl_t * logger)
+{
+  iot_log_ring_t * ring = logger->ring;
+  if (ring)
+  {
+    pthread_mutex_lock (&ring->mutex);
+    ring->running = false;
+    pthread_cond_broadcast (&ring->added);
+    pthread_mutex_unlock (&ring->mutex);
+    pthread_join (ring->writer, NULL); // Writer drains ring before exiting
+    logger->ring = NULL;
+    iot_logger_ring_free (ring);
+  }
+}
+
+void iot_logger_set_async (iot_logger_t * logger, uint32_t size, iot_log_overflow_t overflow)
+{
+  assert (logger);
+  iot_logger_impl_t * impl = (iot_logger_impl_t*) logger;
+  iot_logger_async_stop (impl);
+  if (size)
+  {
+    uint32_t slots = 1u;
+    if (size > IOT_LOG_ASYNC_MAX) size = IOT_LOG_ASYNC_MAX;
+    while (slots < size) slots <<= 1;
+    iot_log_ring_t * ring = calloc (1, sizeof (*ring));
+    if (ring) ring->records = malloc (slots * sizeof (iot_log_record_t));
+    if (ring == NULL || ring->records == NULL) // Remain synchronous
+    {
+      free (ring);
+      return;
+    }
+    for (uint32_t i = 0; i < slots; i++) atomic_store (&ring->records[i].seq, i);
+    ring->mask = slots - 1u;
+    ring->overflow = overflow;
+    ring->running = true;
+    iot_mutex_init (&ring->mutex);
+    pthread_cond_init (&ring->added, NULL);
+    pthread_cond_init (&ring->removed, NULL);
+    impl->ring = ring;
+    if (pthread_create (&ring->writer, NULL, iot_logger_async_thread, impl) != 0) // Joinable, unlike iot_thread_create
+    {
+      impl->ring = NULL;
+      iot_logger_ring_free (ring);
+    }
+  }
+}
+
+uint64_t iot_logger_dropped (const iot_logger_t * logger)
+{
+  assert (logger);
+  const iot_log_ring_t * ring = ((const iot_logger_impl_t*) logger)->ring;
+  return ring ? atomic_load (&ring->dropped) : 0u;
+}
+
+/********* Rate Limiting and Repeat Suppression *********/
+
+/* Rate limiting is per call site, identified by the format string address, so records are dropped
+ * before being formatted. Call sites are held in an open addressed table, the least recently active
+ * of the probed sites being evicted if none is free. Repeat suppression compares a hash of each
+ * formatted message with that of the last message logged. Counts of dropped and repeated records are
+ * logged when the call site next logs after the interval expires, when a different message is logged
+ * or when a call site is evicted. The writer thread of an asynchronous logger also logs them when idle
+ * once the interval has expired.
+ */
+
+static void iot_logger_log_summary (iot_logger_impl_t * logger, iot_loglevel_t level, uint64_t timestamp, const char * message, va_list args)
+{
+  const iot_data_t * saved = iot_log_current_fields;
+  iot_log_current_fields = NULL;
+  if (logger->ring)
+  {
+    iot_logger_async_add (logger->ring, level, timestamp, NULL, message, NULL, args);
+  }
+  else
+  {
+    (logger->impl) (&logger->base, level, timestamp, message, logger->ctx);
+  }
+  iot_log_current_fields = saved;
+}
+
+static inline void iot_logger_dropped_format (char * summary, const iot_log_site_t * site)
+{
+  snprintf (summary, IOT_LOG_MSG_MAX, "Rate limit dropped %" PRIu32 " messages: %s", site->dropped, site->name);
+}
+
+static inline void iot_logger_repeated_format (char * summary, uint32_t repeats)
+{
+  snprintf (summary, IOT_LOG_MSG_MAX, "Last message repeated %" PRIu32 " times", repeats);
+}
+
+static bool iot_logger_rate_limit (iot_logger_impl_t * logger, iot_log_limiter_t * limiter, iot_loglevel_t level, uint64_t timestamp, const char * fmt, va_list args)
+{
+  char summary[IOT_LOG_MSG_MAX];
+  iot_log_site_t expired = { .dropped = 0u }; // Site interval ended, with dropped records to be logged
+  iot_log_site_t * site = NULL;
+  iot_log_site_t * oldest = NULL;
+  uint32_t hash = (uint32_t) ((uintptr_t) fmt >> 3);
+  bool ok = true;
+
+  pthread_mutex_lock (&limiter->mutex);
+  for (uint32_t i = 0; i < IOT_LOG_LIMIT_PROBES; i++)
+  {
+    iot_log_site_t * probe = &limiter->sites[(hash + i) % IOT_LOG_LIMIT_SITES];
+    if (probe->fmt == fmt || probe->fmt == NULL)
+    {
+      site = probe;
+      break;
+    }
+    if (oldest == NULL || probe->start < oldest->start) oldest = probe;
+  }
+  if (site == NULL) // Evict least recently active site
+  {
+    site = oldest;
+    expired = *site;
+    site->fmt = NULL;
+  }
+  if (site->fmt != fmt || (timestamp - site->start) >= limiter->interval)
+  {
+    if (site->fmt == fmt)
+    {
+      expired = *site;
+    }
+    else // Format string copied as the caller's may not outlive the log call
+    {
+      strncpy (site->name, fmt, sizeof (site->name) - 1u);
+      site->name[sizeof (site->name) - 1u] = '\0';
+    }
+    site->fmt = fmt;
+    site->level = level;
+    site->start = timestamp;
+    site->count = 0u;
+    site->dropped = 0u;
+  }
+  if (site->count < limiter->rate || limiter->rate == 0u)
+  {
+    site->count++;
+  }
+  else
+  {
+    site->dropped++;
+    ok = false;
+  }
+  pthread_mutex_unlock (&limiter->mutex);
+
+  if (expired.dropped)
+  {
+    iot_logger_dropped_format (summary, &expired);
+    iot_logger_log_summary (logger, expired.level, timestamp, summary, args);
+  }
+  return ok;
+}
+
+static bool iot_logger_repeat_limit (iot_logger_impl_t * logger, iot_log_limiter_t * limiter, iot_loglevel_t level, uint64_t timestamp, const char * message, va_list args)
+{
+  char summary[IOT_LOG_MSG_MAX];
+  uint32_t hash = iot_hash (message);
+  uint32_t repeats = 0u;
+  iot_loglevel_t repeat_level = level;
+  bool ok = true;
+
+  pthread_mutex_lock (&limiter->mutex);
+  if (hash == limiter->hash && level == limiter->level && (timestamp - limiter->last) < limiter->interval)
+  {
+    limiter->repeats++;
+    ok = false;
+  }
+  else
+  {
+    repeats = limiter->repeats;
+    repeat_level = limiter->level;
+    limiter->repeats = 0u;
+    limiter->hash = hash;
+    limiter->level = level;
+    limiter->last = timestamp;
+  }
+  pthread_mutex_unlock (&limiter->mutex);
+
+  if (repeats)
+  {
+    iot_logger_repeated_format (summary, repeats);
+    iot_logger_log_summary (logger, repeat_level, timestamp, summary, args);
+  }
+  return ok;
+}
+
+/* Logs counts for intervals that have expired without further logging. Called by the asynchronous writer thread
+ * when idle. Each count is taken under the limiter mutex and logged once it is released.
+ */
+static void iot_logger_limit_flush (iot_logger_impl_t * logger, iot_log_limiter_t * limiter)
+{
+  char summary[IOT_LOG_MSG_MAX];
+  uint64_t now = iot_time_usecs ();
+  uint32_t repeats = 0u;
+  iot_loglevel_t repeat_level = IOT_LOG_NONE;
+  iot_log_site_t expired;
+  uint32_t i = 0u;
+
+  pthread_mutex_lock (&limiter->mutex);
+  if (limiter->repeats && (now - limiter->last) >= limiter->interval)
+  {
+    repeats = limiter->repeats;
+    repeat_level = limiter->level;
+    limiter->repeats = 0u;
+  }
+  pthread_mutex_unlock (&limiter->mutex);
+  if (repeats)
+  {
+    iot_logger_repeated_format (summary, repeats);
+    (logger->impl) (&logger->base, repeat_level, now, summary, logger->ctx);
+  }
+  do
+  {
+    expired.dropped = 0u;
+    pthread_mutex_lock (&limiter->mutex);
+    for (; i < IOT_LOG_LIMIT_SITES && expired.dropped == 0u; i++)
+    {
+      iot_log_site_t * site = &limiter->sites[i];
+      if (site->dropped && (now - site->start) >= limiter->interval)
+      {
+        expired = *site;
+        site->dropped = 0u;
+      }
+    }
+    pthread_mutex_unlock (&limiter->mutex);
+    if (expired.dropped)
+    {
+      iot_logger_dropped_format (summary, &expired);
+      (logger->impl) (&logger->base, expired.level, now, summary, logger->ctx);
+    }
+  } while (expired.dropped);
+}
+
+static void iot_logger_limiter_free (iot_log_limiter_t * limiter)
+{
+  if (limiter)
+  {
+    pthread_mutex_destroy (&limiter->mutex);
+    free (limiter);
+  }
+}
+
+/* The limiter is reconfigured in place, rather than replaced, as logging threads and the asynchronous writer
+ * thread may be using it. Pending counts are discarded.
+ */
+void iot_logger_set_limits (iot_logger_t * logger, uint32_t rate, uint32_t interval, bool suppress)
+{
+  assert (logger);
+  iot_logger_impl_t * impl = (iot_logger_impl_t*) logger;
+  iot_component_lock (&logger->component);
+  iot_log_limiter_t * limiter = atomic_load (&impl->limiter);
+  if (limiter == NULL && (rate || suppress))
+  {
+    limiter = calloc (1, sizeof (*limiter)); // Disabled until configured
+    iot_mutex_init (&limiter->mutex);
+    atomic_store (&impl->limiter, limiter);
+  }
+  if (limiter)
+  {
+    pthread_mutex_lock (&limiter->mutex);
+    limiter->hash = 0u;
+    limiter->last = 0u;
+    limiter->repeats = 0u;
+    memset (limiter->sites, 0, sizeof (limiter->sites));
+    limiter->interval = (uint64_t) (interval ? interval : IOT_LOG_LIMIT_INTERVAL) * 1000u;
+    atomic_store (&limiter->rate, rate);
+    atomic_store (&limiter->suppress, suppress);
+    pthread_mutex_unlock (&limiter->mutex);
+  }
+  iot_component_unlock (&logger->component);
+}
+
 /********* Standard Logger Implementations: UDP *********/
 
 typedef struct iot_logger_udp_ctx_t
@@ -196,7 +1105,7 @@ static void iot_log_udp (iot_logger_t * logger, iot_loglevel_t level, uint64_t t
   if (impl->sock != -1)
   {
     size_t len = iot_logger_format_log (logimpl, level, timestamp, message);
-    if (len > 0) sendto (impl->sock, logimpl->buff, len, 0, (struct sockaddr *) &impl->addr, sizeof (struct sockaddr_in));
+    if (len > 0) sendto (impl->sock, logimpl->out.str, len, 0, (struct sockaddr *) &impl->addr, sizeof (struct sockaddr_in));
   }
   iot_component_unlock (&logger->component);
 }
@@ -230,23 +1139,181 @@ iot_logger_t * iot_logger_alloc_udp (const char * name, iot_loglevel_t level, bo
 
 #if defined (IOT_HAS_FILE) && !defined (_AZURESPHERE_)
 
-static void iot_log_file (iot_logger_t * logger, iot_loglevel_t level, uint64_t timestamp, const char * message, const void *ctx)
+/* File logger with optional size and time based rotation. On rotation the file is renamed with
+ * a ".1" suffix, previously rotated files are shifted up and files beyond the retained count removed.
+ * Rotated files can be compressed by a gzip process, which runs concurrently with logging. Rotation
+ * is deferred while a previous file is being compressed, and a file left uncompressed (if gzip could
+ * not be run) is shifted up with the compressed files. Buffered records are flushed periodically as
+ * records are logged, and by the writer thread of an asynchronous logger when idle. Records queued by an
+ * asynchronous logger may be stamped before the file was opened or last flushed, so are not treated as
+ * overdue for rotation or flushing.
+ */
+
+#define IOT_LOG_COMPRESS_EXT ".gz"
+
+typedef struct iot_logger_file_ctx_t
 {
-  if (ctx) iot_logger_log_to_fd ((iot_logger_impl_t*) logger, (FILE *)ctx, level, timestamp, message);
+  FILE * fd;                          // Log file
+  char * path;                        // Log file path
+  char * buff;                        // Write buffer
+  iot_logger_file_config_t config;    // File logger configuration
+  uint64_t size;                      // Current log file size
+  uint64_t opened;                    // Time (usecs) log file opened
+  uint64_t flushed;                   // Time (usecs) log file last flushed
+  bool unflushed;                     // Whether records have been written since the last flush
+  pid_t compressor;                   // Compression process, zero if none running
+} iot_logger_file_ctx_t;
+
+static void iot_logger_file_open (iot_logger_file_ctx_t * ctx)
+{
+  ctx->fd = fopen (ctx->path, "a");
+  ctx->size = 0u;
+  ctx->opened = ctx->flushed = iot_time_usecs ();
+  ctx->unflushed = false;
+  if (ctx->fd)
+  {
+    if (ctx->buff) setvbuf (ctx->fd, ctx->buff, _IOFBF, ctx->config.buffer_size);
+    if (fseek (ctx->fd, 0, SEEK_END) == 0)
+    {
+      long pos = ftell (ctx->fd);
+      if (pos > 0) ctx->size = (uint64_t) pos;
+    }
+  }
 }
 
-static void iot_logger_file_ctx_free (void *ctx)
+static void iot_logger_file_close (iot_logger_file_ctx_t * ctx)
 {
-  if (ctx)
+  if (ctx->fd)
   {
-    fclose (ctx);
+    fflush (ctx->fd);
+    if (ctx->config.fsync != IOT_LOG_FSYNC_NONE) fsync (fileno (ctx->fd));
+    fclose (ctx->fd);
+    ctx->fd = NULL;
   }
 }
 
+/* Reaps a completed compression process, optionally waiting for it. Returns whether none is running */
+static bool iot_logger_file_reap (iot_logger_file_ctx_t * ctx, bool wait)
+{
+  if (ctx->compressor > 0 && waitpid (ctx->compressor, NULL, wait ? 0 : WNOHANG) == 0) return false;
+  ctx->compressor = 0;
+  return true;
+}
+
+static char * iot_logger_file_name (const char * path, uint32_t index, const char * ext)
+{
+  size_t len = strlen (path) + strlen (ext) + 12u;
+  char * name = malloc (len);
+  snprintf (name, len, "%s.%" PRIu32 "%s", path, index, ext);
+  return name;
+}
+
+static void iot_logger_file_shift (iot_logger_file_ctx_t * ctx, const char * ext)
+{
+  char * to = iot_logger_file_name (ctx->path, ctx->config.max_files, ext);
+  remove (to);
+  for (uint32_t i = ctx->config.max_files - 1u; i > 0u; i--)
+  {
+    char * from = iot_logger_file_name (ctx->path, i, ext);
+    rename (from, to);
+    free (to);
+    to = from;
+  }
+  free (to);
+}
+
+static void iot_logger_file_rotate (iot_logger_file_ctx_t * ctx)
+{
+  iot_logger_file_close (ctx);
+  if (ctx->config.max_files)
+  {
+    iot_logger_file_shift (ctx, "");
+    if (ctx->config.compress) iot_logger_file_shift (ctx, IOT_LOG_COMPRESS_EXT);
+    char * to = iot_logger_file_name (ctx->path, 1u, "");
+    if (rename (ctx->path, to) == 0 && ctx->config.compress)
+    {
+      char * argv[] = { "gzip", "-f", to, NULL };
+      if (posix_spawnp (&ctx->compressor, argv[0], NULL, NULL, argv, environ) != 0) ctx->compressor = 0;
+    }
+    free (to);
+  }
+  else
+  {
+    remove (ctx->path);
+  }
+  iot_logger_file_open (ctx);
+}
+
+static void iot_logger_file_flush (iot_logger_file_ctx_t * file, uint64_t timestamp)
+{
+  if (file->unflushed && timestamp > file->flushed && (timestamp - file->flushed) >= (file->config.flush_interval * 1000ull))
+  {
+    fflush (file->fd);
+    if (file->config.fsync == IOT_LOG_FSYNC_FLUSH) fsync (fileno (file->fd));
+    file->flushed = timestamp;
+    file->unflushed = false;
+  }
+}
+
+static void iot_log_file_idle (iot_logger_t * logger, void * ctx)
+{
+  iot_logger_file_ctx_t * file = (iot_logger_file_ctx_t*) ctx;
+  iot_component_lock (&logger->component);
+  if (file->fd && file->config.flush_interval) iot_logger_file_flush (file, iot_time_usecs ());
+  iot_component_unlock (&logger->component);
+}
+
+static void iot_log_file (iot_logger_t * logger, iot_loglevel_t level, uint64_t timestamp, const char * message, const void *ctx)
+{
+  iot_logger_impl_t * logimpl = (iot_logger_impl_t*) logger;
+  iot_logger_file_ctx_t * file = (iot_logger_file_ctx_t*) ctx;
+  iot_component_lock (&logger->component);
+  size_t len = iot_logger_format_log (logimpl, level, timestamp, message);
+  if (file->fd && len)
+  {
+    const iot_logger_file_config_t * config = &file->config;
+    if (((config->max_size && file->size && ((file->size + len) > config->max_size)) ||
+      (config->interval && timestamp > file->opened && ((timestamp - file->opened) >= (config->interval * 1000000ull)))) &&
+      iot_logger_file_reap (file, false)) // Deferred while previous rotated file being compressed
+    {
+      iot_logger_file_rotate (file);
+    }
+    if (file->fd && fwrite (logimpl->out.str, 1u, len, file->fd) == len)
+    {
+      file->size += len;
+      file->unflushed = true;
+      if (config->flush_interval) iot_logger_file_flush (file, timestamp);
+    }
+  }
+  iot_component_unlock (&logger->component);
+}
+
+static void iot_logger_file_ctx_free (void *ctx)
+{
+  iot_logger_file_ctx_t * file = (iot_logger_file_ctx_t*) ctx;
+  iot_logger_file_close (file);
+  iot_logger_file_reap (file, true);
+  free (file->buff);
+  free (file->path);
+  free (file);
+}
+
+iot_logger_t * iot_logger_alloc_file_with_config (const char * name, iot_loglevel_t level, bool self_start, iot_logger_t * next, const char *pathname, const iot_logger_file_config_t * config)
+{
+  assert (pathname);
+  iot_logger_file_ctx_t * ctx = calloc (1, sizeof (*ctx));
+  if (config) ctx->config = *config;
+  ctx->path = strdup (pathname);
+  if (ctx->config.buffer_size) ctx->buff = malloc (ctx->config.buffer_size);
+  iot_logger_file_open (ctx);
+  iot_logger_t * logger = iot_logger_alloc_custom (name, level, self_start, next, iot_log_file, ctx, iot_logger_file_ctx_free);
+  ((iot_logger_impl_t*) logger)->idle = iot_log_file_idle;
+  return logger;
+}
+
 iot_logger_t * iot_logger_alloc_file (const char * name, iot_loglevel_t level, bool self_start, iot_logger_t * next, const char *pathname)
 {
-  FILE *fd = fopen (pathname, "a");
-  return iot_logger_alloc_custom (name, level, self_start, next, iot_log_file, fd, iot_logger_file_ctx_free);
+  return iot_logger_alloc_file_with_config (name, level, self_start, next, pathname, NULL);
 }
 
 #endif
@@ -301,7 +1368,20 @@ static iot_component_t * iot_logger_config (iot_container_t * cont, const iot_da
 #if defined (IOT_HAS_FILE) && !defined (_AZURESPHERE_)
   if (to && strncmp (to, "file:", 5) == 0 && strlen (to) > 5)
   {
-    result = iot_logger_alloc_file (name, level, start, next, to + 5);
+    const char * sync = iot_data_string_map_get_string (map, "Sync");
+    iot_logger_file_config_t config =
+    {
+      .max_size = iot_data_string_map_get_ui64 (map, "RotateSize", 0u),
+      .interval = (uint32_t) iot_data_string_map_get_ui64 (map, "RotateInterval", 0u),
+      .max_files = (uint32_t) iot_data_string_map_get_ui64 (map, "RotateCount", IOT_LOG_ROTATE_COUNT),
+      .buffer_size = (uint32_t) iot_data_string_map_get_ui64 (map, "BufferSize", 0u),
+      .flush_interval = (uint32_t) iot_data_string_map_get_ui64 (map, "FlushInterval", 0u),
+      .compress = iot_data_string_map_get_bool (map, "Compress", false),
+      .fsync = IOT_LOG_FSYNC_NONE
+    };
+    if (sync && strcasecmp (sync, "Rotate") == 0) config.fsync = IOT_LOG_FSYNC_ROTATE;
+    if (sync && strcasecmp (sync, "Flush") == 0) config.fsync = IOT_LOG_FSYNC_FLUSH;
+    result = iot_logger_alloc_file_with_config (name, level, start, next, to + 5, &config);
   }
   else
 #endif
@@ -328,6 +1408,17 @@ static iot_component_t * iot_logger_config (iot_container_t * cont, const iot_da
       ((iot_logger_impl_t *)result)->no_stderr = iot_data_string_map_get_bool (map, "NoStderr", false);
     }
   }
+  uint32_t rate = (uint32_t) iot_data_string_map_get_ui64 (map, "RateLimit", 0u);
+  bool suppress = iot_data_string_map_get_bool (map, "SuppressRepeats", false);
+  iot_logger_set_limits (result, rate, (uint32_t) iot_data_string_map_get_ui64 (map, "RateInterval", IOT_LOG_LIMIT_INTERVAL), suppress);
+  const char * format = iot_data_string_map_get_string (map, "Format");
+  if (format && strcasecmp (format, "JSON") == 0) iot_logger_set_format (result, IOT_LOG_FORMAT_JSON);
+  if (iot_data_string_map_get_bool (map, "Async", false))
+  {
+    const char * overflow = iot_data_string_map_get_string (map, "Overflow");
+    uint32_t size = (uint32_t) iot_data_string_map_get_ui64 (map, "QueueSize", IOT_LOG_ASYNC_SIZE);
+    iot_logger_set_async (result, size, (overflow && strcasecmp (overflow, "Block") == 0) ? IOT_LOG_OVERFLOW_BLOCK : IOT_LOG_OVERFLOW_DROP);
+  }
   return (iot_component_t*) result;
 }
 
@@ -0,0 +1,185 @@
+#include "iot/iot.h"
+#include "iot/json.h"
+
+/* Benchmark of iot_data_from_json against the previous three pass decoder: token count pre-scan,
+ * tokenization with iot_json_parse and building iot_data values from the token array.
+ *
+ * Usage: jsondecode_test <json file> [iterations]
+ */
+
+static iot_data_t * token_value (iot_json_tok_t ** tokens, const char * json);
+
+static char * token_string (const char * json, const iot_json_tok_t * token)
+{
+  size_t len = (size_t) (token->end - token->start);
+  char * str = calloc (1u, len + 1u);
+  const char * src = json + token->start;
+  char * dst = str;
+  while (src < json + token->end)
+  {
+    if (*src == '\\' && token->type == IOT_JSON_STRING_ESC)
+    {
+      switch (*++src)
+      {
+        case 'b': *dst++ = '\b'; break;
+        case 'f': *dst++ = '\f'; break;
+        case 'r': *dst++ = '\r'; break;
+        case 'n': *dst++ = '\n'; break;
+        case 't': *dst++ = '\t'; break;
+        case 'u': src += 4; *dst++ = '?'; break;
+        default: *dst++ = *src;
+      }
+      src++;
+    }
+    else
+    {
+      *dst++ = *src++;
+    }
+  }
+  return str;
+}
+
+static iot_data_t * token_cached_string (iot_json_tok_t ** tokens, const char * json, iot_data_t * cache)
+{
+  iot_data_t * str = iot_data_alloc_string (token_string (json, *tokens), IOT_DATA_TAKE);
+  (*tokens)++;
+  const iot_data_t * cached = iot_data_map_get (cache, str);
+  if (cached)
+  {
+    iot_data_free (str);
+    str = (iot_data_t*) cached;
+  }
+  else
+  {
+    iot_data_map_add (cache, str, iot_data_add_ref (str));
+  }
+  return iot_data_add_ref (str);
+}
+
+static iot_data_t * token_primitive (iot_json_tok_t ** tokens, const char * json)
+{
+  iot_data_t * ret;
+  char * str = token_string (json, *tokens);
+  (*tokens)++;
+  switch (str[0])
+  {
+    case 't': case 'f': ret = iot_data_alloc_bool (str[0] == 't'); break;
+    case 'n': ret = iot_data_alloc_null (); break;
+    default:
+      if (strchr (str, '.') || strchr (str, 'e') || strchr (str, 'E')) ret = iot_data_alloc_f64 (strtod (str, NULL));
+      else ret = iot_data_alloc_i64 (strtoll (str, NULL, 10));
+      break;
+  }
+  free (str);
+  return ret;
+}
+
+static iot_data_t * token_value_cached (iot_json_tok_t ** tokens, const char * json, iot_data_t * cache)
+{
+  iot_data_t * data;
+  uint32_t elements = (*tokens)->size;
+  switch ((*tokens)->type)
+  {
+    case IOT_JSON_PRIMITIVE: data = token_primitive (tokens, json); break;
+    case IOT_JSON_OBJECT:
+      data = iot_data_alloc_map (IOT_DATA_STRING);
+      (*tokens)++;
+      while (elements--)
+      {
+        iot_data_t * key = token_cached_string (tokens, json, cache);
+        iot_data_map_add (data, key, token_value_cached (tokens, json, cache));
+      }
+      break;
+    case IOT_JSON_ARRAY:
+      data = iot_data_alloc_vector (elements);
+      (*tokens)++;
+      for (uint32_t i = 0; i < elements; i++) iot_data_vector_add (data, i, token_value_cached (tokens, json, cache));
+      break;
+    default: data = token_cached_string (tokens, json, cache); break;
+  }
+  return data;
+}
+
+static iot_data_t * token_value (iot_json_tok_t ** tokens, const char * json)
+{
+  iot_data_t * cache = iot_data_alloc_map (IOT_DATA_STRING);
+  iot_data_t * data = token_value_cached (tokens, json, cache);
+  iot_data_free (cache);
+  return data;
+}
+
+static iot_data_t * token_decode (const char * json)
+{
+  iot_data_t * data = NULL;
+  iot_json_parser parser;
+  uint32_t count = 1;
+  for (const char * ptr = json; *ptr; ptr++)
+  {
+    switch (*ptr)
+    {
+      case ',': case '{': count++; break;
+      case ':': case '[': count += 2; break;
+      default: break;
+    }
+  }
+  iot_json_tok_t * tokens = calloc (1, sizeof (*tokens) * count);
+  iot_json_tok_t * tptr = tokens;
+  iot_json_init (&parser);
+  int32_t used = iot_json_parse (&parser, json, strlen (json), tptr, count);
+  if (used > 0 && (uint32_t) used <= count) data = token_value (&tptr, json);
+  free (tokens);
+  return data;
+}
+
+static void round_trip (const char * json, bool ordered)
+{
+  iot_data_t * data = iot_data_from_json_with_ordering (json, ordered);
+  free (iot_data_to_json (data));
+  iot_data_free (data);
+}
+
+int main (int argc, char ** argv)
+{
+  if (argc < 2)
+  {
+    fprintf (stderr, "Usage: %s <json file> [iterations]\n", argv[0]);
+    return 1;
+  }
+  char * json = iot_store_read (argv[1]);
+  if (json == NULL)
+  {
+    fprintf (stderr, "Failed to read file: %s\n", argv[1]);
+    return 1;
+  }
+  uint32_t iterations = (argc > 2) ? (uint32_t) atoi (argv[2]) : 100u;
+  size_t len = strlen (json);
+
+  uint64_t start = iot_time_nsecs ();
+  for (uint32_t i = 0; i < iterations; i++) iot_data_free (token_decode (json));
+  uint64_t token_ns = (iot_time_nsecs () - start) / iterations;
+
+  start = iot_time_nsecs ();
+  for (uint32_t i = 0; i < iterations; i++) iot_data_free (iot_data_from_json (json));
+  uint64_t direct_ns = (iot_time_nsecs () - start) / iterations;
+
+  start = iot_time_nsecs ();
+  for (uint32_t i = 0; i < iterations; i++) iot_data_free (iot_data_from_json_in_situ (json, IOT_DATA_COPY, false));
+  uint64_t in_situ_ns = (iot_time_nsecs () - start) / iterations;
+
+  start = iot_time_nsecs ();
+  for (uint32_t i = 0; i < iterations; i++) round_trip (json, false);
+  uint64_t unordered_ns = (iot_time_nsecs () - start) / iterations;
+
+  start = iot_time_nsecs ();
+  for (uint32_t i = 0; i < iterations; i++) round_trip (json, true);
+  uint64_t ordered_ns = (iot_time_nsecs () - start) / iterations;
+
+  printf ("Input: %zu bytes, %" PRIu32 " iterations\n", len, iterations);
+  printf ("Token decoder:       %10" PRIu64 " ns/decode (%.1f MB/s)\n", token_ns, (double) len * 1000.0 / (double) token_ns);
+  printf ("Single pass decoder: %10" PRIu64 " ns/decode (%.1f MB/s)\n", direct_ns, (double) len * 1000.0 / (double) direct_ns);
+  printf ("In situ decoder:     %10" PRIu64 " ns/decode (%.1f MB/s)\n", in_situ_ns, (double) len * 1000.0 / (double) in_situ_ns);
+  printf ("Unordered round trip:%10" PRIu64 " ns\n", unordered_ns);
+  printf ("Ordered round trip:  %10" PRIu64 " ns\n", ordered_ns);
+  free (json);
+  return 0;
+}
@@ -46,8 +46,119 @@ static void test_rtrip1 (void)
   }
 }
 
+#define BASE64_LONG_LEN 300
+
+static void test_rtrip_long (void)
+{
+  uint8_t input[BASE64_LONG_LEN];
+  char encoded[BASE64_LONG_LEN * 2];
+  uint8_t decoded[BASE64_LONG_LEN];
+  size_t outlen;
+
+  srandom (11);
+  for (unsigned i = 0; i < BASE64_LONG_LEN; i++)
+  {
+    input[i] = (uint8_t) (random () % 256);
+  }
+
+  for (size_t size = 0; size <= BASE64_LONG_LEN; size++)
+  {
+    CU_ASSERT (iot_b64_encode (input, size, encoded, sizeof (encoded)))
+    CU_ASSERT (strlen (encoded) == iot_b64_encodesize (size) - 1)
+    outlen = size;
+    CU_ASSERT (iot_b64_decode (encoded, decoded, &outlen))
+    CU_ASSERT (size == outlen)
+    CU_ASSERT (memcmp (input, decoded, size) == 0)
+    if (size)
+    {
+      outlen = size - 1;
+      CU_ASSERT (! iot_b64_decode (encoded, decoded, &outlen)) // Output too small
+    }
+  }
+}
+
+static void test_decode_long (void)
+{
+  const char * text = "The quick brown fox jumps over the lazy dog. The quick brown fox jumps over the lazy dog.";
+  char encoded[256];
+  char wrapped[256];
+  char decoded[128];
+  size_t len = strlen (text);
+  size_t outlen = sizeof (decoded);
+
+  CU_ASSERT (iot_b64_encode (text, len, encoded, sizeof (encoded)))
+  CU_ASSERT (strcmp (encoded, "VGhlIHF1aWNrIGJyb3duIGZveCBqdW1wcyBvdmVyIHRoZSBsYXp5IGRvZy4gVGhlIHF1aWNrIGJyb3duIGZveCBqdW1wcyBvdmVyIHRoZSBsYXp5IGRvZy4=") == 0)
+
+  /* A line break part way through a bulk decoded block is skipped */
+
+  size_t elen = strlen (encoded);
+  memcpy (wrapped, encoded, 50);
+  wrapped[50] = '\n';
+  strcpy (wrapped + 51, encoded + 50);
+  CU_ASSERT (iot_b64_decode (wrapped, decoded, &outlen))
+  CU_ASSERT (outlen == len && memcmp (decoded, text, len) == 0)
+
+  /* Invalid symbols are detected anywhere */
+
+  for (size_t i = 0; i < elen - 1; i++)
+  {
+    strcpy (wrapped, encoded);
+    wrapped[i] = (i % 2) ? '*' : (char) 0xc3;
+    outlen = sizeof (decoded);
+    CU_ASSERT (! iot_b64_decode (wrapped, decoded, &outlen))
+  }
+}
+
+static void test_stream (void)
+{
+  uint8_t input[BASE64_LONG_LEN];
+  char encoded[BASE64_LONG_LEN * 2];
+  char chunked[BASE64_LONG_LEN * 2];
+  uint8_t decoded[BASE64_LONG_LEN];
+  iot_b64_encoder_t encoder;
+  iot_b64_decoder_t decoder;
+
+  srandom (13);
+  for (unsigned i = 0; i < BASE64_LONG_LEN; i++)
+  {
+    input[i] = (uint8_t) (random () % 256);
+  }
+  CU_ASSERT (iot_b64_encode (input, sizeof (input) - 1, encoded, sizeof (encoded)))
+
+  for (size_t chunk = 1; chunk <= 70; chunk++)
+  {
+    size_t len = 0;
+    iot_b64_encoder_init (&encoder);
+    for (size_t pos = 0; pos < sizeof (input) - 1; pos += chunk)
+    {
+      size_t n = (sizeof (input) - 1 - pos < chunk) ? sizeof (input) - 1 - pos : chunk;
+      len += iot_b64_encode_update (&encoder, input + pos, n, chunked + len);
+    }
+    len += iot_b64_encode_final (&encoder, chunked + len);
+    CU_ASSERT (len == strlen (encoded) && strncmp (chunked, encoded, len) == 0)
+
+    size_t outlen = 0;
+    bool ok = true;
+    iot_b64_decoder_init (&decoder);
+    for (size_t pos = 0; pos < len && ok; pos += chunk)
+    {
+      size_t n = (len - pos < chunk) ? len - pos : chunk;
+      size_t written = sizeof (decoded) - outlen;
+      ok = iot_b64_decode_update (&decoder, encoded + pos, n, decoded + outlen, &written);
+      outlen += written;
+    }
+    size_t written = sizeof (decoded) - outlen;
+    CU_ASSERT (ok && iot_b64_decode_final (&decoder, decoded + outlen, &written))
+    outlen += written;
+    CU_ASSERT (outlen == sizeof (input) - 1 && memcmp (decoded, input, outlen) == 0)
+  }
+}
+
 void cunit_base64_test_init (void)
 {
   CU_pSuite suite = CU_add_suite ("base64", suite_init, suite_clean);
   CU_add_test (suite, "test_rtrip1", test_rtrip1);
+  CU_add_test (suite, "test_rtrip_long", test_rtrip_long);
+  CU_add_test (suite, "test_decode_long", test_decode_long);
+  CU_add_test (suite, "test_stream", test_stream);
 }
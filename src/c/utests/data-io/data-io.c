@@ -8,9 +8,12 @@
 #include "iot/logger.h"
 #include "iot/config.h"
 #include "iot/data.h"
+#include "iot/file.h"
+#include "iot/json.h"
 #include "data-io.h"
 #include "CUnit.h"
 #include <float.h>
+#include <math.h>
 #include "limits.h"
 
 #define ARRAY_SIZE(x) sizeof(x) / sizeof(x[0])
@@ -68,6 +71,28 @@ static iot_data_t *test_sample_map2 (void)
   return map;
 }
 
+static iot_data_t *test_sample_composite (void)
+{
+  static const double doubles[] = { 0.0, -1.5e-300, 3.0 };
+  uint8_t bin[] = { 1u, 2u, 3u, 4u, 5u };
+  iot_data_t * map = test_sample_map1 ();
+  iot_data_t * vector = iot_data_alloc_vector (4u);
+  iot_data_t * list = iot_data_alloc_list ();
+  iot_data_vector_add (vector, 0u, test_sample_map2 ());
+  iot_data_vector_add (vector, 1u, iot_data_alloc_f32 (0.0f));
+  iot_data_vector_add (vector, 2u, iot_data_alloc_f64 (-2.5e10));
+  iot_data_vector_add (vector, 3u, iot_data_alloc_binary (bin, sizeof (bin), IOT_DATA_COPY));
+  iot_data_list_tail_push (list, iot_data_alloc_string ("quote \" back \\ \x01", IOT_DATA_REF));
+  iot_data_list_tail_push (list, iot_data_alloc_i64 (INT64_MIN));
+  iot_data_list_tail_push (list, iot_data_alloc_ui64 (UINT64_MAX));
+  iot_data_list_tail_push (list, iot_data_alloc_vector (0u));
+  iot_data_string_map_add (map, "Vector", vector);
+  iot_data_string_map_add (map, "List", list);
+  iot_data_string_map_add (map, "Doubles", iot_data_alloc_array ((void*) doubles, 3u, IOT_DATA_FLOAT64, IOT_DATA_REF));
+  iot_data_string_map_add (map, "Empty", iot_data_alloc_map (IOT_DATA_STRING));
+  return map;
+}
+
 static void test_data_to_json (void)
 {
   char * json;
@@ -331,6 +356,678 @@ static void test_data_from_json3 (void)
   free (new_json);
 }
 
+static void test_data_from_json4 (void)
+{
+  iot_data_t * data = iot_data_from_json (" { \"Euro\" : \"\\u20ac\", \"Clef\": \"\\ud834\\udd1e\", \"List\" : [ 1 , 2.5 , true, null , ] , } ");
+  CU_ASSERT (iot_data_type (data) == IOT_DATA_MAP)
+  CU_ASSERT (strcmp (iot_data_string_map_get_string (data, "Euro"), "\xe2\x82\xac") == 0)
+  CU_ASSERT (strcmp (iot_data_string_map_get_string (data, "Clef"), "\xf0\x9d\x84\x9e") == 0)
+  const iot_data_t * list = iot_data_string_map_get_vector (data, "List");
+  CU_ASSERT (iot_data_vector_size (list) == 4u)
+  CU_ASSERT (iot_data_type (iot_data_vector_get (list, 1u)) == IOT_DATA_FLOAT64)
+  CU_ASSERT (iot_data_type (iot_data_vector_get (list, 3u)) == IOT_DATA_NULL)
+  iot_data_free (data);
+
+  static const char * invalid[] = { "{\"a\":1", "[1,2", "{\"a\" 1}", "\"unterminated", "{\"a\":\"\\x\"}", "[1}", "{\"a\":\"\\u12\"}", NULL };
+  for (const char ** json = invalid; *json; json++)
+  {
+    data = iot_data_from_json (*json);
+    CU_ASSERT (iot_data_type (data) == IOT_DATA_NULL)
+    iot_data_free (data);
+  }
+
+  char deep[2049];
+  memset (deep, '[', 1024);
+  memset (deep + 1024, ']', 1024);
+  deep[2048] = '\0';
+  data = iot_data_from_json (deep); // Exceeds maximum nesting depth
+  CU_ASSERT (iot_data_type (data) == IOT_DATA_NULL)
+  iot_data_free (data);
+}
+
+static void test_data_json_escape (void)
+{
+  static const char specials[] = { '"', '\\', '\n', '\t', '\x01', '\x1f' };
+  static const char * escapes[] = { "\\\"", "\\\\", "\\n", "\\t", "\\u0001", "\\u001f" };
+  char str[80];
+  char expected[96];
+  for (size_t len = 1; len < sizeof (str); len++) // Cover scalar, 16 and 32 byte blocks and tails
+  {
+    for (size_t pos = 0; pos < len; pos++)
+    {
+      for (size_t s = 0; s < sizeof (specials); s++)
+      {
+        memset (str, 'a', len);
+        str[len] = '\0';
+        str[pos] = specials[s];
+        snprintf (expected, sizeof (expected), "\"%.*s%s%s\"", (int) pos, str, escapes[s], str + pos + 1);
+        iot_data_t * data = iot_data_alloc_string (str, IOT_DATA_REF);
+        char * json = iot_data_to_json (data);
+        CU_ASSERT (strcmp (json, expected) == 0)
+        iot_data_t * decoded = iot_data_from_json (json);
+        CU_ASSERT (iot_data_equal (data, decoded))
+        iot_json_parser parser;
+        iot_json_init (&parser);
+        CU_ASSERT (iot_json_parse (&parser, json, strlen (json), NULL, 0) == 1)
+        iot_data_free (decoded);
+        iot_data_free (data);
+        free (json);
+      }
+    }
+  }
+}
+
+static void test_data_json_numbers (void)
+{
+  static const struct { double val; const char * json; } doubles[] =
+  {
+    { 0.0, "0.0" }, { -0.0, "-0.0" }, { 1.0, "1.0" }, { 0.1, "0.1" }, { -2.5, "-2.5" }, { 100.0, "100.0" }, { 1e21, "1e21" },
+    { 1.5e-7, "1.5e-7" }, { 0.001234, "0.001234" }, { 123.456, "123.456" }, { 5e-324, "5e-324" }, { DBL_MAX, "1.7976931348623157e308" }
+  };
+  for (size_t i = 0; i < ARRAY_SIZE (doubles); i++)
+  {
+    iot_data_t * data = iot_data_alloc_f64 (doubles[i].val);
+    char * json = iot_data_to_json (data);
+    CU_ASSERT (strcmp (json, doubles[i].json) == 0)
+    free (json);
+    iot_data_free (data);
+  }
+  iot_data_t * data = iot_data_alloc_f32 (0.1f);
+  char * json = iot_data_to_json (data);
+  CU_ASSERT (strcmp (json, "0.1") == 0)
+  free (json);
+  iot_data_free (data);
+  data = iot_data_alloc_i64 (INT64_MIN);
+  json = iot_data_to_json (data);
+  CU_ASSERT (strcmp (json, "-9223372036854775808") == 0)
+  free (json);
+  iot_data_free (data);
+  data = iot_data_alloc_ui64 (UINT64_MAX);
+  json = iot_data_to_json (data);
+  CU_ASSERT (strcmp (json, "18446744073709551615") == 0)
+  free (json);
+  iot_data_free (data);
+
+  uint64_t seed = 0x9e3779b97f4a7c15u;
+  for (uint32_t i = 0; i < 20000u; i++) // Round trip of random bit patterns
+  {
+    seed = seed * 6364136223846793005u + 1442695040888963407u;
+    double d;
+    float f;
+    uint32_t bits32 = (uint32_t) (seed >> 32);
+    memcpy (&d, &seed, sizeof (d));
+    memcpy (&f, &bits32, sizeof (f));
+    if (isfinite (d))
+    {
+      data = iot_data_alloc_f64 (d);
+      json = iot_data_to_json (data);
+      iot_data_t * decoded = iot_data_from_json (json);
+      CU_ASSERT (iot_data_f64 (decoded) == d)
+      iot_data_free (decoded);
+      decoded = iot_data_alloc_from_string (IOT_DATA_FLOAT64, json);
+      CU_ASSERT (iot_data_f64 (decoded) == d)
+      iot_data_free (decoded);
+      iot_data_free (data);
+      free (json);
+    }
+    if (isfinite (f))
+    {
+      data = iot_data_alloc_f32 (f);
+      json = iot_data_to_json (data);
+      iot_data_t * decoded = iot_data_alloc_from_string (IOT_DATA_FLOAT32, json);
+      CU_ASSERT (iot_data_f32 (decoded) == f)
+      iot_data_free (decoded);
+      iot_data_free (data);
+      free (json);
+    }
+  }
+
+  data = iot_data_alloc_from_string (IOT_DATA_INT32, " 42");
+  CU_ASSERT (iot_data_i32 (data) == 42)
+  iot_data_free (data);
+  data = iot_data_alloc_from_string (IOT_DATA_UINT8, "-1");
+  CU_ASSERT (iot_data_ui8 (data) == 255u)
+  iot_data_free (data);
+  data = iot_data_alloc_from_string (IOT_DATA_FLOAT64, "0.1");
+  CU_ASSERT (iot_data_f64 (data) == 0.1)
+  iot_data_free (data);
+  CU_ASSERT (iot_data_alloc_from_string (IOT_DATA_INT64, "abc") == NULL)
+  CU_ASSERT (iot_data_alloc_from_string (IOT_DATA_FLOAT32, "x1") == NULL)
+
+  data = iot_data_from_json ("[ -9223372036854775808, 18446744073709551615, 18446744073709551616, 2.5e3 ]");
+  CU_ASSERT (iot_data_vector_size (data) == 3u) // Out of range value dropped
+  CU_ASSERT (iot_data_i64 (iot_data_vector_get (data, 0u)) == INT64_MIN)
+  CU_ASSERT (iot_data_ui64 (iot_data_vector_get (data, 1u)) == UINT64_MAX)
+  CU_ASSERT (iot_data_f64 (iot_data_vector_get (data, 2u)) == 2500.0)
+  iot_data_free (data);
+}
+
+typedef struct test_sink_t
+{
+  char * buff;
+  size_t len;
+  uint32_t calls;
+} test_sink_t;
+
+static bool test_sink_fn (void * ctx, const char * buff, size_t len)
+{
+  test_sink_t * sink = ctx;
+  sink->buff = realloc (sink->buff, sink->len + len + 1);
+  memcpy (sink->buff + sink->len, buff, len);
+  sink->len += len;
+  sink->buff[sink->len] = '\0';
+  sink->calls++;
+  return true;
+}
+
+static bool test_sink_fail_fn (void * ctx, const char * buff, size_t len)
+{
+  (void) buff;
+  (void) len;
+  (*(uint32_t*) ctx)++;
+  return false;
+}
+
+static void test_data_to_json_sink (void)
+{
+  uint8_t bin[1000];
+  char str[300];
+  for (uint32_t i = 0; i < sizeof (bin); i++) bin[i] = (uint8_t) i;
+  for (uint32_t i = 0; i < sizeof (str) - 1; i++) str[i] = (i % 7) ? (char) ('a' + i % 26) : '\n';
+  str[sizeof (str) - 1] = '\0';
+  iot_data_t * map = iot_data_alloc_map (IOT_DATA_STRING);
+  iot_data_t * vec = iot_data_alloc_vector (100);
+  for (uint32_t i = 0; i < 100; i++) iot_data_vector_add (vec, i, iot_data_alloc_f64 (i * 1.5));
+  iot_data_string_map_add (map, "Binary", iot_data_alloc_binary (bin, sizeof (bin), IOT_DATA_REF));
+  iot_data_string_map_add (map, "String", iot_data_alloc_string (str, IOT_DATA_REF));
+  iot_data_string_map_add (map, "Vector", vec);
+  iot_data_string_map_add (map, "Array", iot_data_alloc_array (bin, sizeof (bin), IOT_DATA_UINT8, IOT_DATA_REF));
+  char * json = iot_data_to_json (map);
+
+  char buff[64];
+  test_sink_t sink = { 0 };
+  CU_ASSERT (iot_data_to_json_sink (map, test_sink_fn, &sink, buff, sizeof (buff)))
+  CU_ASSERT (sink.calls > 1u)
+  CU_ASSERT (sink.buff && strcmp (sink.buff, json) == 0)
+  free (sink.buff);
+
+  memset (&sink, 0, sizeof (sink));
+  CU_ASSERT (iot_data_to_json_sink (map, test_sink_fn, &sink, NULL, 0))
+  CU_ASSERT (sink.buff && strcmp (sink.buff, json) == 0)
+  free (sink.buff);
+
+  uint32_t calls = 0;
+  CU_ASSERT (! iot_data_to_json_sink (map, test_sink_fail_fn, &calls, buff, sizeof (buff)))
+  CU_ASSERT (calls == 1u) // No output after failure
+
+  FILE * fp = tmpfile ();
+  CU_ASSERT (iot_data_to_json_file (map, fp))
+  fflush (fp);
+  CU_ASSERT (iot_data_to_json_fd (map, fileno (fp)))
+  size_t len = strlen (json);
+  char * read = calloc (1, len * 2 + 1);
+  rewind (fp);
+  CU_ASSERT (fread (read, 1, len * 2, fp) == len * 2)
+  CU_ASSERT (strncmp (read, json, len) == 0)
+  CU_ASSERT (strcmp (read + len, json) == 0)
+  fclose (fp);
+  free (read);
+  free (json);
+  iot_data_free (map);
+}
+
+static void test_json_stream_fn (iot_data_t * data, void * arg)
+{
+  iot_data_t * list = arg;
+  iot_data_list_tail_push (list, data);
+}
+
+static void test_data_json_stream (void)
+{
+  static const char * ndjson =
+    "{\"id\":1,\"name\":\"a \\\"}\\\" b\",\"list\":[1,[2,3],{}]}\n"
+    "{\"id\":2,\"name\":\"\\u20ac{[\",\"nested\":{\"x\":null}}\r\n"
+    "  [true, false]\n\"text\"\n42\n";
+  static const char * values[] =
+  {
+    "{\"id\":1,\"name\":\"a \\\"}\\\" b\",\"list\":[1,[2,3],{}]}",
+    "{\"id\":2,\"name\":\"\\u20ac{[\",\"nested\":{\"x\":null}}",
+    "[true, false]", "\"text\"", "42"
+  };
+  size_t len = strlen (ndjson);
+  for (size_t chunk = 1; chunk <= len; chunk += (chunk < 20) ? 1 : 50)
+  {
+    iot_data_t * list = iot_data_alloc_list ();
+    iot_data_json_stream_t * stream = iot_data_json_stream_alloc (test_json_stream_fn, list, false);
+    for (size_t pos = 0; pos < len; pos += chunk)
+    {
+      CU_ASSERT (iot_data_json_stream_write (stream, ndjson + pos, (pos + chunk > len) ? len - pos : chunk))
+    }
+    CU_ASSERT (iot_data_json_stream_end (stream))
+    CU_ASSERT (iot_data_list_length (list) == ARRAY_SIZE (values))
+    for (size_t i = 0; i < ARRAY_SIZE (values); i++)
+    {
+      iot_data_t * expected = iot_data_from_json (values[i]);
+      iot_data_t * actual = iot_data_list_head_pop (list);
+      CU_ASSERT (iot_data_equal (expected, actual))
+      iot_data_free (actual);
+      iot_data_free (expected);
+    }
+    iot_data_json_stream_free (stream);
+    iot_data_free (list);
+  }
+
+  iot_data_t * list = iot_data_alloc_list ();
+  iot_data_json_stream_t * stream = iot_data_json_stream_alloc (test_json_stream_fn, list, false);
+  const char * invalid = "{\"a\" 1}\n{\"b\":2}\n{\"c\":";
+  CU_ASSERT (! iot_data_json_stream_write (stream, invalid, strlen (invalid))) // Invalid record skipped
+  CU_ASSERT (iot_data_list_length (list) == 1u)
+  CU_ASSERT (! iot_data_json_stream_end (stream)) // Incomplete record discarded
+  CU_ASSERT (iot_data_json_stream_write (stream, "7", 1))
+  CU_ASSERT (iot_data_json_stream_end (stream))
+  CU_ASSERT (iot_data_list_length (list) == 2u)
+  iot_data_json_stream_free (stream);
+  iot_data_free (list);
+}
+
+static void test_data_from_json_in_situ (void)
+{
+  static const char * json =
+    "{\"Short\":\"abc\",\"Long\":\"0123456789012345678901234567890123456789012345678901234567890123456789\","
+    "\"Escaped\":\"0123456789\\t0123456789\\n0123456789\\u20ac0123456789\\\"0123456789012345678901234567890\","
+    "\"List\":[\"0123456789012345678901234567890123456789012345678901234567890123456789\", 1.5, null, {\"x\":true}]}";
+  iot_data_t * expected = iot_data_from_json (json);
+
+  iot_data_t * data = iot_data_from_json_in_situ (strdup (json), IOT_DATA_TAKE, false);
+  CU_ASSERT (iot_data_equal (data, expected))
+  iot_data_t * copy = iot_data_copy (iot_data_string_map_get (data, "Long"));
+  iot_data_t * ref = iot_data_add_ref (iot_data_string_map_get (data, "Escaped"));
+  iot_data_free (data);
+  CU_ASSERT (iot_data_equal (copy, iot_data_string_map_get (expected, "Long")))
+  CU_ASSERT (iot_data_equal (ref, iot_data_string_map_get (expected, "Escaped"))) // Buffer retained by string
+  iot_data_free (copy);
+  iot_data_free (ref);
+
+  data = iot_data_from_json_in_situ ((char*) json, IOT_DATA_COPY, true);
+  CU_ASSERT (iot_data_equal (data, expected))
+  iot_data_free (data);
+
+  char * buff = strdup (json);
+  data = iot_data_from_json_in_situ (buff, IOT_DATA_REF, false);
+  CU_ASSERT (iot_data_equal (data, expected))
+  const char * str = iot_data_string_map_get_string (data, "Long");
+  CU_ASSERT (str > buff && str < buff + strlen (json)) // Zero copy
+  iot_data_free (data);
+  free (buff);
+
+  data = iot_data_from_json_in_situ (strdup ("{\"a\":"), IOT_DATA_TAKE, false);
+  CU_ASSERT (iot_data_type (data) == IOT_DATA_NULL)
+  iot_data_free (data);
+  iot_data_free (expected);
+}
+
+static void test_data_from_json_select (void)
+{
+  static const char * json =
+    "{\"deviceName\":\"Sensor\",\"origin\":123,\"ignored\":{\"a\":[1,{\"b\":\"}]\\\"\"}],\"c\":\"x\"},"
+    "\"readings\":[{\"value\":1.5,\"units\":\"C\"},{\"value\":\"high\",\"units\":\"%\"},{\"units\":\"K\"}],\"tags\":[\"t1\",\"t2\",\"t3\"]}";
+  iot_data_t * paths = iot_data_alloc_vector (3);
+  iot_data_t * path = iot_data_alloc_list ();
+  iot_data_list_tail_push (path, iot_data_alloc_string ("deviceName", IOT_DATA_REF));
+  iot_data_vector_add (paths, 0, path);
+  path = iot_data_alloc_list (); // readings[*].value
+  iot_data_list_tail_push (path, iot_data_alloc_string ("readings", IOT_DATA_REF));
+  iot_data_list_tail_push (path, iot_data_alloc_null ());
+  iot_data_list_tail_push (path, iot_data_alloc_string ("value", IOT_DATA_REF));
+  iot_data_vector_add (paths, 1, path);
+  path = iot_data_alloc_list (); // tags[1]
+  iot_data_list_tail_push (path, iot_data_alloc_string ("tags", IOT_DATA_REF));
+  iot_data_list_tail_push (path, iot_data_alloc_ui32 (1u));
+  iot_data_vector_add (paths, 2, path);
+
+  iot_data_t * data = iot_data_from_json_select (json, paths, false);
+  char * out = iot_data_to_json (data);
+  CU_ASSERT (strcmp (out, "{\"deviceName\":\"Sensor\",\"readings\":[{\"value\":1.5},{\"value\":\"high\"},{}],\"tags\":[null,\"t2\",null]}") == 0)
+  CU_ASSERT (iot_data_get_at (data, path) != NULL)
+  CU_ASSERT (strcmp (iot_data_string (iot_data_get_at (data, path)), "t2") == 0)
+  free (out);
+  iot_data_free (data);
+
+  data = iot_data_from_json_select ("{\"deviceName\":\"Sensor\",\"x\":[1,2", paths, false); // Invalid skipped text
+  CU_ASSERT (iot_data_type (data) == IOT_DATA_NULL)
+  iot_data_free (data);
+
+  iot_data_vector_add (paths, 0, iot_data_alloc_list ()); // Empty path selects everything
+  iot_data_t * all = iot_data_from_json (json);
+  data = iot_data_from_json_select (json, paths, false);
+  CU_ASSERT (iot_data_equal (data, all))
+  iot_data_free (data);
+  iot_data_free (all);
+  iot_data_free (paths);
+}
+static void test_data_from_json_lazy (void)
+{
+  static const char * json = "{\"device\":\"Sensor\",\"payload\":{ \"readings\" : [1, 2.5, {\"x\":\"}]\"}] },\"tags\":[\"t1\"],\"n\":3}";
+  iot_data_t * data = iot_data_from_json_lazy (json, 1u, true);
+  const iot_data_t * payload = iot_data_string_map_get (data, "payload");
+  CU_ASSERT (iot_data_is_lazy (payload))
+  CU_ASSERT (iot_data_is_lazy (iot_data_string_map_get (data, "tags")))
+  CU_ASSERT (! iot_data_is_lazy (iot_data_string_map_get (data, "n")))
+  CU_ASSERT (! iot_data_is_lazy (data))
+
+  char * out = iot_data_to_json (data); // Lazy values written verbatim
+  CU_ASSERT_STRING_EQUAL (out, json)
+  CU_ASSERT (iot_data_json_size (data) == strlen (json))
+  free (out);
+
+  const iot_data_t * value = iot_data_lazy_value (payload);
+  CU_ASSERT (iot_data_type (value) == IOT_DATA_MAP)
+  CU_ASSERT (iot_data_lazy_value (payload) == value) // Decoded once
+  CU_ASSERT (iot_data_lazy_value (value) == value)
+  CU_ASSERT (iot_data_vector_size (iot_data_string_map_get (value, "readings")) == 3u)
+
+  iot_data_t * all = iot_data_from_json_with_ordering (json, true); // Serialisation decodes lazy values
+  iot_data_t * bin = iot_data_serialise (data);
+  iot_data_t * copy = iot_data_deserialise (iot_data_address (bin), iot_data_array_size (bin));
+  CU_ASSERT (iot_data_equal (copy, all))
+  iot_data_free (copy);
+  iot_data_free (bin);
+  iot_data_free (data);
+
+  data = iot_data_from_json_lazy (json, 0u, true); // Zero depth decodes everything
+  CU_ASSERT (iot_data_equal (data, all))
+  iot_data_free (data);
+  iot_data_free (all);
+
+  data = iot_data_from_json_lazy ("{\"a\":{\"b\":}}", 1u, false); // Invalid lazy text decodes as null
+  CU_ASSERT (iot_data_type (iot_data_lazy_value (iot_data_string_map_get (data, "a"))) == IOT_DATA_NULL)
+  iot_data_free (data);
+  data = iot_data_from_json_lazy ("{\"a\":{\"b\":1}", 1u, false);
+  CU_ASSERT (iot_data_type (data) == IOT_DATA_NULL)
+  iot_data_free (data);
+}
+
+static void test_data_json_plan_check (const iot_data_json_plan_t * plan, const char * json, bool ordered)
+{
+  iot_data_t * data = iot_data_from_json_with_ordering (json, ordered);
+  char * expected = iot_data_to_json (data);
+  char * out = iot_data_to_json_with_plan (data, plan);
+  CU_ASSERT (strcmp (out, expected) == 0)
+  free (expected);
+  free (out);
+  iot_data_free (data);
+}
+
+static void test_data_json_plan (void)
+{
+  const char * json = "{\"device\":\"Sensor \\\"1\\\"\",\"origin\":1700000000,\"readings\":[{\"resource\":\"temp\",\"value\":21.5,\"valid\":true},{\"resource\":\"humidity\",\"value\":40.25,\"valid\":false}],\"tags\":null}";
+  iot_data_t * example = iot_data_from_json_with_ordering (json, true);
+  iot_data_json_plan_t * plan = iot_data_json_plan_alloc (example);
+  char * out = iot_data_to_json_with_plan (example, plan);
+  CU_ASSERT (strcmp (out, json) == 0)
+  free (out);
+  iot_data_free (example);
+
+  /* Matching shape, different values */
+  test_data_json_plan_check (plan, "{\"device\":\"Other\",\"origin\":1700000001,\"readings\":[],\"tags\":null}", true);
+  test_data_json_plan_check (plan, "{\"device\":\"\\t\",\"origin\":2,\"readings\":[{\"resource\":\"a\",\"value\":-1.5e300,\"valid\":true}],\"tags\":null}", true);
+  /* Mismatches fall back to generic output */
+  test_data_json_plan_check (plan, "{\"device\":\"Other\",\"origin\":1700000001,\"readings\":[],\"tags\":null}", false);
+  test_data_json_plan_check (plan, "{\"device\":\"Other\",\"origin\":-1,\"tags\":null}", true);
+  test_data_json_plan_check (plan, "{\"device\":\"Other\",\"origin\":1,\"readings\":[1,{\"value\":1.5},{\"resource\":\"x\",\"value\":\"high\",\"valid\":true}],\"extra\":null}", true);
+  test_data_json_plan_check (plan, "{\"origin\":\"now\",\"device\":[1,2],\"readings\":{\"a\":1},\"tags\":{}}", true);
+  test_data_json_plan_check (plan, "[1,2,3]", true);
+  iot_data_json_plan_free (plan);
+
+  /* Plans for scalars, non string keys and empty containers */
+  iot_data_t * map = iot_data_alloc_map (IOT_DATA_UINT32);
+  iot_data_map_add (map, iot_data_alloc_ui32 (2u), iot_data_alloc_map (IOT_DATA_STRING));
+  iot_data_map_add (map, iot_data_alloc_ui32 (1u), iot_data_alloc_vector (0u));
+  plan = iot_data_json_plan_alloc (map);
+  out = iot_data_to_json_with_plan (map, plan);
+  CU_ASSERT (strcmp (out, "{\"1\":[],\"2\":{}}") == 0)
+  free (out);
+  iot_data_map_add (map, iot_data_alloc_ui32 (1u), iot_data_alloc_string ("x", IOT_DATA_REF));
+  out = iot_data_to_json_with_plan (map, plan);
+  CU_ASSERT (strcmp (out, "{\"1\":\"x\",\"2\":{}}") == 0)
+  free (out);
+  iot_data_json_plan_free (plan);
+  plan = iot_data_json_plan_alloc (iot_data_alloc_null ());
+  out = iot_data_to_json_with_plan (map, plan);
+  CU_ASSERT (strcmp (out, "{\"1\":\"x\",\"2\":{}}") == 0)
+  free (out);
+  iot_data_json_plan_free (plan);
+  iot_data_json_plan_free (NULL);
+  iot_data_free (map);
+}
+
+static void test_data_to_json_buffer (void)
+{
+  iot_data_buffer_t * buffer = iot_data_buffer_alloc (16u);
+  iot_data_t * map = test_sample_map1 ();
+  char * json = iot_data_to_json (map);
+  const char * out = iot_data_to_json_buffer (map, buffer);
+  CU_ASSERT (strcmp (out, json) == 0)
+  CU_ASSERT (iot_data_buffer_length (buffer) == strlen (json))
+  CU_ASSERT ((const char*) iot_data_buffer_data (buffer) == out)
+  size_t capacity = iot_data_buffer_capacity (buffer);
+  CU_ASSERT (capacity > strlen (json))
+  iot_data_t * val = iot_data_alloc_i32 (-12);
+  out = iot_data_to_json_buffer (val, buffer);
+  CU_ASSERT (strcmp (out, "-12") == 0)
+  CU_ASSERT (iot_data_buffer_length (buffer) == 3u)
+  out = iot_data_to_json_buffer (map, buffer);
+  CU_ASSERT (strcmp (out, json) == 0)
+  CU_ASSERT (iot_data_buffer_capacity (buffer) == capacity) // Capacity retained
+  iot_data_free (val);
+  iot_data_free (map);
+  free (json);
+  iot_data_buffer_free (buffer);
+  iot_data_buffer_free (NULL);
+
+  buffer = iot_data_buffer_alloc (0u);
+  out = iot_data_to_json_buffer (iot_data_alloc_null (), buffer);
+  CU_ASSERT (strcmp (out, "null") == 0)
+  iot_data_buffer_free (buffer);
+}
+
+static void test_data_json_size (void)
+{
+  iot_data_t * data[] = { test_sample_map1 (), test_sample_map2 (), test_sample_composite (), iot_data_alloc_string ("", IOT_DATA_REF), iot_data_alloc_ui8 (7u) };
+  for (size_t i = 0; i < ARRAY_SIZE (data); i++)
+  {
+    char * json = iot_data_to_json (data[i]);
+    size_t size = iot_data_json_size (data[i]);
+    CU_ASSERT_EQUAL (size, strlen (json))
+    char * buff = malloc (size + 1u);
+    char * out = iot_data_to_json_with_buffer (data[i], buff, (uint32_t) size + 1u);
+    CU_ASSERT (out == buff) // Exactly sized buffer not grown
+    CU_ASSERT_STRING_EQUAL (out, json)
+    free (out);
+    free (json);
+    iot_data_free (data[i]);
+  }
+}
+
+static void test_data_serialise (void)
+{
+  bool flags[] = { true, false, true };
+  iot_data_t * data = test_sample_composite ();
+  iot_data_t * ordered = iot_data_alloc_ordered_map (IOT_DATA_STRING);
+  iot_data_t * typed = iot_data_alloc_typed_map (IOT_DATA_UINT16, IOT_DATA_STRING);
+  iot_data_t * vector = iot_data_alloc_typed_vector (3u, IOT_DATA_INT8);
+  iot_data_t * list = iot_data_alloc_typed_list (IOT_DATA_FLOAT32);
+  iot_data_t * value = iot_data_alloc_ui16 (300u);
+  iot_data_t * key = iot_data_alloc_string ("units", IOT_DATA_REF);
+  iot_data_string_map_add (ordered, "zulu", iot_data_alloc_i16 (-2));
+  iot_data_string_map_add (ordered, "alpha", iot_data_alloc_ui32 (3u));
+  iot_data_map_add (typed, iot_data_alloc_ui16 (1u), iot_data_alloc_string ("Name", IOT_DATA_REF));
+  iot_data_vector_add (vector, 0u, iot_data_alloc_i8 (-8));
+  iot_data_vector_add (vector, 2u, iot_data_alloc_i8 (8));
+  iot_data_list_tail_push (list, iot_data_alloc_f32 (1.5f));
+  iot_data_list_tail_push (list, iot_data_alloc_f32 (-2.5f));
+  iot_data_set_metadata (value, iot_data_alloc_string ("Celsius", IOT_DATA_REF), key);
+  iot_data_string_map_add (data, "Ordered", ordered);
+  iot_data_string_map_add (data, "Typed", typed);
+  iot_data_string_map_add (data, "TypedVector", vector);
+  iot_data_string_map_add (data, "TypedList", list);
+  iot_data_string_map_add (data, "Meta", value);
+  iot_data_string_map_add (data, "Flags", iot_data_alloc_array (flags, ARRAY_SIZE (flags), IOT_DATA_BOOL, IOT_DATA_REF));
+  iot_data_string_map_add (data, "Long", iot_data_alloc_string ("A string longer than sixty four characters, so not in the string table", IOT_DATA_REF));
+
+  iot_data_t * binary = iot_data_serialise (data);
+  CU_ASSERT_PTR_NOT_NULL_FATAL (binary)
+  iot_data_t * out = iot_data_deserialise (iot_data_address (binary), iot_data_array_size (binary));
+  CU_ASSERT_PTR_NOT_NULL_FATAL (out)
+  CU_ASSERT (iot_data_equal (out, data))
+  const iot_data_t * v = iot_data_string_map_get (out, "Ordered");
+  CU_ASSERT (iot_data_map_is_ordered (v))
+  char * json = iot_data_to_json (v);
+  CU_ASSERT_STRING_EQUAL (json, "{\"zulu\":-2,\"alpha\":3}")
+  free (json);
+  CU_ASSERT_EQUAL (iot_data_map_type (iot_data_string_map_get (out, "Typed")), IOT_DATA_STRING)
+  CU_ASSERT_EQUAL (iot_data_map_key_type (iot_data_string_map_get (out, "Typed")), IOT_DATA_UINT16)
+  v = iot_data_string_map_get (out, "TypedVector");
+  CU_ASSERT_EQUAL (iot_data_vector_type (v), IOT_DATA_INT8)
+  CU_ASSERT_PTR_NULL (iot_data_vector_get (v, 1u))
+  CU_ASSERT_EQUAL (iot_data_list_type (iot_data_string_map_get (out, "TypedList")), IOT_DATA_FLOAT32)
+  v = iot_data_string_map_get (out, "Meta");
+  CU_ASSERT_EQUAL (iot_data_type (v), IOT_DATA_UINT16)
+  CU_ASSERT_STRING_EQUAL (iot_data_string (iot_data_get_metadata (v, key)), "Celsius")
+  CU_ASSERT_EQUAL (iot_data_array_type (iot_data_string_map_get (out, "Flags")), IOT_DATA_BOOL)
+
+  /* Buffer output matches, and truncated or corrupted input is rejected */
+  iot_data_buffer_t * buffer = iot_data_buffer_alloc (16u);
+  const uint8_t * bytes = iot_data_serialise_buffer (data, buffer);
+  CU_ASSERT_EQUAL (iot_data_buffer_length (buffer), iot_data_array_size (binary))
+  CU_ASSERT (memcmp (bytes, iot_data_address (binary), iot_data_array_size (binary)) == 0)
+  for (uint32_t len = 0; len < iot_data_array_size (binary); len++)
+  {
+    iot_data_t * partial = iot_data_deserialise (bytes, len);
+    CU_ASSERT_PTR_NULL (partial)
+    iot_data_free (partial);
+  }
+  uint8_t * copy = malloc (iot_data_array_size (binary));
+  memcpy (copy, bytes, iot_data_array_size (binary));
+  copy[4] = 3u; // Unsupported version
+  CU_ASSERT_PTR_NULL (iot_data_deserialise (copy, iot_data_array_size (binary)))
+  copy[4] = 2u;
+  copy[0] = 'X';
+  CU_ASSERT_PTR_NULL (iot_data_deserialise (copy, iot_data_array_size (binary)))
+  free (copy);
+  iot_data_buffer_free (buffer);
+  iot_data_free (binary);
+  iot_data_free (out);
+  iot_data_free (data);
+  iot_data_free (key);
+
+  /* Repeated map keys are serialised once */
+  data = iot_data_alloc_vector (100u);
+  for (uint32_t i = 0; i < 100u; i++)
+  {
+    iot_data_t * map = iot_data_alloc_map (IOT_DATA_STRING);
+    iot_data_string_map_add (map, "temperature", iot_data_alloc_f32 (20.0f + (float) i));
+    iot_data_string_map_add (map, "humidity", iot_data_alloc_ui8 ((uint8_t) i));
+    iot_data_vector_add (data, i, map);
+  }
+  binary = iot_data_serialise (data);
+  CU_ASSERT (iot_data_array_size (binary) < 1600u)
+  out = iot_data_deserialise (iot_data_address (binary), iot_data_array_size (binary));
+  CU_ASSERT (iot_data_equal (out, data))
+  iot_data_free (out);
+  iot_data_free (binary);
+  iot_data_free (data);
+}
+
+#if defined (IOT_HAS_FILE) && !defined (_AZURESPHERE_)
+static void test_data_deserialise_file (void)
+{
+  const char * path = "/tmp/iot_test_data.bin";
+  const uint8_t v1[] = { 'I', 'O', 'T', 'D', 1u, IOT_DATA_MAP, IOT_DATA_STRING, IOT_DATA_MULTI, 2u, IOT_DATA_STRING, 2u, 'a', IOT_DATA_STRING, 1u, IOT_DATA_STRING, 4u, 'b', 'c', IOT_DATA_STRING, 3u };
+  iot_data_t * data = test_sample_composite ();
+  iot_data_string_map_add (data, "Description", iot_data_alloc_string ("A description long enough to be referenced in the mapped file", IOT_DATA_REF));
+  iot_data_t * binary = iot_data_serialise (data);
+  CU_ASSERT_FATAL (iot_file_write_binary (path, iot_data_address (binary), iot_data_array_size (binary)))
+  iot_data_t * out = iot_data_deserialise_file (path);
+  CU_ASSERT_PTR_NOT_NULL_FATAL (out)
+  CU_ASSERT (iot_data_equal (out, data))
+  iot_data_t * desc = iot_data_add_ref (iot_data_string_map_get (out, "Description"));
+  iot_data_free (out);
+  CU_ASSERT_STRING_EQUAL (iot_data_string (desc), "A description long enough to be referenced in the mapped file") // Mapping retained
+  iot_data_free (desc);
+  iot_data_free (binary);
+  iot_data_free (data);
+  iot_file_delete (path);
+  CU_ASSERT_PTR_NULL (iot_data_deserialise_file (path))
+
+  CU_ASSERT_PTR_NULL (iot_data_deserialise (v1, sizeof (v1))) // Only the current version is accepted
+}
+#endif
+
+static void test_data_ordered_map (void)
+{
+  const char * json = "{\"zulu\":1,\"alpha\":{\"yankee\":2,\"bravo\":3},\"mike\":[{\"quebec\":1,\"charlie\":2}]}";
+  iot_data_t * data = iot_data_from_json_with_ordering (json, true);
+  iot_data_t * unordered = iot_data_from_json (json);
+  CU_ASSERT (iot_data_map_is_ordered (data))
+  CU_ASSERT (! iot_data_map_is_ordered (unordered))
+  CU_ASSERT (iot_data_equal (data, unordered))
+  char * out = iot_data_to_json (data);
+  CU_ASSERT (strcmp (out, json) == 0)
+  free (out);
+  out = iot_data_to_json (unordered);
+  CU_ASSERT (strcmp (out, "{\"alpha\":{\"bravo\":3,\"yankee\":2},\"mike\":[{\"charlie\":2,\"quebec\":1}],\"zulu\":1}") == 0)
+  free (out);
+
+  iot_data_t * copy = iot_data_copy (data);
+  iot_data_t * shallow = iot_data_shallow_copy (data);
+  CU_ASSERT (iot_data_map_is_ordered (copy))
+  CU_ASSERT (iot_data_map_is_ordered (shallow))
+  out = iot_data_to_json (copy);
+  CU_ASSERT (strcmp (out, json) == 0)
+  free (out);
+  out = iot_data_to_json (shallow);
+  CU_ASSERT (strcmp (out, json) == 0)
+  free (out);
+
+  /* Replaced values retain position, removed keys are dropped and added keys appended */
+  iot_data_string_map_add (data, "zulu", iot_data_alloc_bool (true));
+  CU_ASSERT (iot_data_string_map_remove (data, "alpha"))
+  iot_data_string_map_add (data, "echo", iot_data_alloc_null ());
+  for (uint32_t i = 0; i < 100; i++)
+  {
+    char key[16];
+    snprintf (key, sizeof (key), "k%u", 99u - i);
+    iot_data_map_add (shallow, iot_data_alloc_string (key, IOT_DATA_COPY), iot_data_alloc_ui32 (i));
+  }
+  out = iot_data_to_json (data);
+  CU_ASSERT (strcmp (out, "{\"zulu\":true,\"mike\":[{\"quebec\":1,\"charlie\":2}],\"echo\":null}") == 0)
+  free (out);
+  CU_ASSERT (iot_data_map_size (shallow) == 103u)
+  out = iot_data_to_json (shallow);
+  CU_ASSERT (strncmp (out, "{\"zulu\":1,\"alpha\":", 18) == 0)
+  CU_ASSERT (strstr (out, "\"k99\":0,\"k98\":1,") != NULL)
+  CU_ASSERT (strcmp (out + strlen (out) - 8, "\"k0\":99}") == 0)
+  free (out);
+  iot_data_map_empty (shallow);
+  CU_ASSERT (iot_data_map_size (shallow) == 0u)
+  out = iot_data_to_json (shallow);
+  CU_ASSERT (strcmp (out, "{}") == 0)
+  free (out);
+
+  iot_data_free (shallow);
+  iot_data_free (copy);
+  iot_data_free (unordered);
+  iot_data_free (data);
+
+  /* Duplicate keys retain first position with last value */
+  data = iot_data_from_json_with_ordering ("{\"b\":1,\"a\":2,\"b\":3}", true);
+  out = iot_data_to_json (data);
+  CU_ASSERT (strcmp (out, "{\"b\":3,\"a\":2}") == 0)
+  free (out);
+  iot_data_free (data);
+}
+
 #ifdef IOT_HAS_XML
 static void test_data_from_xml (void)
 {
@@ -363,6 +1060,86 @@ static void test_data_from_xml (void)
   free (json);
   iot_data_free (xml);
 }
+
+static void test_xml_stream_cb (iot_data_t * data, void * arg)
+{
+  iot_data_list_tail_push ((iot_data_t*) arg, data);
+}
+
+static bool test_xml_stream_write (iot_data_xml_stream_t * stream, const char * xml, size_t chunk)
+{
+  bool ok = true;
+  for (size_t len = strlen (xml); len; )
+  {
+    size_t n = (len < chunk) ? len : chunk;
+    ok = iot_data_xml_stream_write (stream, xml, n) && ok;
+    xml += n;
+    len -= n;
+  }
+  return ok;
+}
+
+static void test_data_xml_stream (void)
+{
+  static const char * nodeset = "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+  "<UANodeSet xmlns=\"http://opcfoundation.org/UA/2011/03/UANodeSet.xsd\">\n"
+  "  <Aliases><Alias Alias=\"Boolean\">i=1</Alias></Aliases>\n"
+  "  <UAVariable NodeId=\"ns=1;i=1\" BrowseName=\"A\"><DisplayName>A &amp; B</DisplayName></UAVariable>\n"
+  "  <UAObject NodeId=\"ns=1;i=2\"/>\n"
+  "  <UAVariable NodeId=\"ns=1;i=3\" BrowseName=\"B\"/>\n"
+  "  <Other><UAVariable NodeId=\"nested\"/></Other>\n"
+  "</UANodeSet>\n";
+  iot_data_t * results = iot_data_alloc_list ();
+  iot_data_t * path = iot_data_alloc_list ();
+  iot_data_list_tail_push (path, iot_data_alloc_string ("UANodeSet", IOT_DATA_REF));
+  iot_data_list_tail_push (path, iot_data_alloc_string ("UAVariable", IOT_DATA_REF));
+  iot_data_xml_stream_t * stream = iot_data_xml_stream_alloc (test_xml_stream_cb, results, path);
+  CU_ASSERT (test_xml_stream_write (stream, nodeset, 7u))
+  CU_ASSERT (iot_data_xml_stream_end (stream))
+  CU_ASSERT_EQUAL_FATAL (iot_data_list_length (results), 2u)
+  iot_data_t * elem = iot_data_list_head_pop (results);
+  char * json = iot_data_to_json (elem);
+  CU_ASSERT_STRING_EQUAL (json, "{\"attributes\":{\"BrowseName\":\"A\",\"NodeId\":\"ns=1;i=1\"},\"children\":[{\"attributes\":{},\"content\":\"A & B\",\"name\":\"DisplayName\"}],\"name\":\"UAVariable\"}")
+  free (json);
+  iot_data_free (elem);
+  elem = iot_data_list_head_pop (results);
+  json = iot_data_to_json (elem);
+  CU_ASSERT_STRING_EQUAL (json, "{\"attributes\":{\"BrowseName\":\"B\",\"NodeId\":\"ns=1;i=3\"},\"name\":\"UAVariable\"}")
+  free (json);
+  iot_data_free (elem);
+
+  CU_ASSERT (test_xml_stream_write (stream, "<a><b></a>", 3u) == false) // Invalid, then reused
+  CU_ASSERT (iot_data_xml_stream_end (stream) == false)
+  CU_ASSERT (test_xml_stream_write (stream, "<UANodeSet><UAVariable/>", 5u))
+  CU_ASSERT (iot_data_xml_stream_end (stream) == false) // Truncated
+  CU_ASSERT (iot_data_list_length (results) == 1u)
+  iot_data_list_empty (results);
+  iot_data_xml_stream_free (stream);
+  iot_data_free (path);
+
+  path = iot_data_alloc_list (); // Any child of the root element
+  iot_data_list_tail_push (path, iot_data_alloc_null ());
+  iot_data_list_tail_push (path, iot_data_alloc_null ());
+  stream = iot_data_xml_stream_alloc (test_xml_stream_cb, results, path);
+  CU_ASSERT (test_xml_stream_write (stream, nodeset, 64u))
+  CU_ASSERT (iot_data_xml_stream_end (stream))
+  CU_ASSERT (iot_data_list_length (results) == 5u)
+  iot_data_list_empty (results);
+  iot_data_xml_stream_free (stream);
+  iot_data_free (path);
+
+  stream = iot_data_xml_stream_alloc (test_xml_stream_cb, results, NULL); // Root element, as iot_data_from_xml
+  CU_ASSERT (test_xml_stream_write (stream, nodeset, 1u))
+  CU_ASSERT (iot_data_xml_stream_end (stream))
+  CU_ASSERT_EQUAL_FATAL (iot_data_list_length (results), 1u)
+  iot_data_t * root = iot_data_from_xml (nodeset);
+  elem = iot_data_list_head_pop (results);
+  CU_ASSERT (iot_data_equal (root, elem))
+  iot_data_free (elem);
+  iot_data_free (root);
+  iot_data_xml_stream_free (stream);
+  iot_data_free (results);
+}
 #endif
 
 #ifdef IOT_HAS_CBOR
@@ -375,6 +1152,13 @@ static void test_data_to_cbor (void)
   {
     // printf ("CBOR: %s\n", iot_data_to_json (cbor));
     // printf ("CBOR hash: %u\n", iot_data_hash (cbor));
+    CU_ASSERT (iot_data_hash (cbor) == 2283992005U)
+  }
+  iot_data_free (cbor);
+  cbor = iot_data_to_cbor_with_typed_arrays (map, false);
+  CU_ASSERT (cbor != NULL)
+  if (cbor)
+  {
     CU_ASSERT (iot_data_hash (cbor) == 2529945693U)
   }
   iot_data_free (cbor);
@@ -432,6 +1216,61 @@ static void test_data_to_cbor (void)
   iot_data_free (cbor);
 }
 
+static void test_data_to_cbor_buffer (void)
+{
+  iot_data_buffer_t * buffer = iot_data_buffer_alloc (8u);
+  iot_data_t * map = test_sample_map1 ();
+  iot_data_t * cbor = iot_data_to_cbor (map);
+  for (uint32_t i = 0; i < 2; i++)
+  {
+    const uint8_t * out = iot_data_to_cbor_buffer (map, buffer);
+    CU_ASSERT (iot_data_buffer_length (buffer) == iot_data_array_length (cbor))
+    CU_ASSERT (memcmp (out, iot_data_address (cbor), iot_data_array_length (cbor)) == 0)
+  }
+  iot_data_free (cbor);
+  iot_data_free (map);
+  map = iot_data_alloc_ui64 (UINT64_MAX);
+  cbor = iot_data_to_cbor (map);
+  const uint8_t * out = iot_data_to_cbor_buffer (map, buffer);
+  CU_ASSERT (iot_data_buffer_length (buffer) == 9u)
+  CU_ASSERT (memcmp (out, iot_data_address (cbor), 9u) == 0)
+  iot_data_free (cbor);
+  iot_data_free (map);
+  iot_data_buffer_free (buffer);
+}
+
+
+static void test_data_cbor_size (void)
+{
+  iot_data_t * data[] = { test_sample_map1 (), test_sample_map2 (), test_sample_composite (), iot_data_alloc_f32 (0.0f), iot_data_alloc_f64 (1.0e-320) };
+  for (size_t i = 0; i < ARRAY_SIZE (data); i++)
+  {
+    iot_data_t * cbor = iot_data_to_cbor (data[i]);
+    iot_data_t * grown = iot_data_to_cbor_with_size (data[i], 1u);
+    CU_ASSERT_EQUAL (iot_data_cbor_size (data[i]), iot_data_array_size (cbor))
+    CU_ASSERT (iot_data_equal (cbor, grown))
+    iot_data_t * decoded = iot_data_from_iot_cbor (cbor);
+    CU_ASSERT_PTR_NOT_NULL (decoded)
+    iot_data_free (decoded);
+    iot_data_free (grown);
+    iot_data_free (cbor);
+  }
+  /* Floats are encoded at full width whatever their value */
+  iot_data_t * cbor = iot_data_to_cbor (data[3]);
+  const uint8_t zero_f32[] = { 0xfa, 0x00, 0x00, 0x00, 0x00 };
+  CU_ASSERT_EQUAL (iot_data_array_size (cbor), sizeof (zero_f32))
+  CU_ASSERT (memcmp (iot_data_address (cbor), zero_f32, sizeof (zero_f32)) == 0)
+  iot_data_t * decoded = iot_data_from_iot_cbor (cbor);
+  CU_ASSERT (iot_data_equal (decoded, data[3]))
+  iot_data_free (decoded);
+  iot_data_free (cbor);
+  cbor = iot_data_to_cbor (data[4]);
+  decoded = iot_data_from_iot_cbor (cbor);
+  CU_ASSERT (iot_data_equal (decoded, data[4]))
+  iot_data_free (decoded);
+  iot_data_free (cbor);
+  for (size_t i = 0; i < ARRAY_SIZE (data); i++) iot_data_free (data[i]);
+}
 
 static void test_cbor_to_data (void)
 {
@@ -655,6 +1494,403 @@ static void test_cbor_to_data (void)
   iot_data_free (expected_val);
 }
 
+static void test_cbor_decode_check (const uint8_t * cbor, uint32_t size, const char * json)
+{
+  iot_data_t * data = iot_data_from_cbor (cbor, size);
+  if (json)
+  {
+    CU_ASSERT_PTR_NOT_NULL_FATAL (data)
+    char * out = iot_data_to_json (data);
+    CU_ASSERT_STRING_EQUAL (out, json)
+    free (out);
+    iot_data_free (data);
+  }
+  else
+  {
+    CU_ASSERT_PTR_NULL (data)
+  }
+}
+
+static void test_cbor_decode (void)
+{
+  /* Examples from RFC 8949 appendix A */
+  const uint8_t half1[] = { 0xf9, 0x3c, 0x00 };
+  const uint8_t half2[] = { 0xf9, 0x7b, 0xff };
+  const uint8_t half3[] = { 0xf9, 0x00, 0x01 };
+  const uint8_t half4[] = { 0xf9, 0xc4, 0x00 };
+  const uint8_t undef[] = { 0xf7 };
+  const uint8_t istr[] = { 0x7f, 0x65, 's', 't', 'r', 'e', 'a', 0x64, 'm', 'i', 'n', 'g', 0xff };
+  const uint8_t ibin[] = { 0x5f, 0x42, 0x01, 0x02, 0x43, 0x03, 0x04, 0x05, 0xff };
+  const uint8_t iempty[] = { 0x5f, 0xff };
+  const uint8_t iarray[] = { 0x9f, 0x01, 0x82, 0x02, 0x03, 0x9f, 0x04, 0x05, 0xff, 0xff };
+  const uint8_t imap[] = { 0xbf, 0x61, 'a', 0x01, 0x61, 'b', 0x9f, 0x02, 0x03, 0xff, 0xff };
+  const uint8_t tagged[] = { 0xc1, 0x1a, 0x51, 0x4b, 0x67, 0xb0 };
+  const uint8_t nested[] = { 0xa2, 0x61, 'a', 0xa1, 0x61, 'b', 0x80, 0x61, 'c', 0x60 };
+  test_cbor_decode_check (half1, sizeof (half1), "1.0");
+  test_cbor_decode_check (half2, sizeof (half2), "65504.0");
+  test_cbor_decode_check (half3, sizeof (half3), "5.9604645e-8");
+  test_cbor_decode_check (half4, sizeof (half4), "-4.0");
+  test_cbor_decode_check (undef, sizeof (undef), "null");
+  test_cbor_decode_check (istr, sizeof (istr), "\"streaming\"");
+  test_cbor_decode_check (ibin, sizeof (ibin), "\"AQIDBAU=\"");
+  test_cbor_decode_check (iempty, sizeof (iempty), "\"\"");
+  test_cbor_decode_check (iarray, sizeof (iarray), "[1,[2,3],[4,5]]");
+  test_cbor_decode_check (imap, sizeof (imap), "{\"a\":1,\"b\":[2,3]}");
+  test_cbor_decode_check (tagged, sizeof (tagged), "1363896240");
+  test_cbor_decode_check (nested, sizeof (nested), "{\"a\":{\"b\":[]},\"c\":\"\"}");
+
+  /* Malformed input */
+  const uint8_t reserved[] = { 0x1c };
+  const uint8_t truncated[] = { 0x19, 0x01 };
+  const uint8_t short_str[] = { 0x62, 'a' };
+  const uint8_t no_break[] = { 0x9f, 0x01 };
+  const uint8_t lone_break[] = { 0xff };
+  const uint8_t indef_int[] = { 0x1f };
+  const uint8_t bad_chunk[] = { 0x5f, 0x61, 'a', 0xff };
+  const uint8_t simple[] = { 0xf8, 0x20 };
+  const uint8_t big_array[] = { 0x9b, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff };
+  const uint8_t short_map[] = { 0xa2, 0x01, 0x02, 0x03 };
+  test_cbor_decode_check (reserved, sizeof (reserved), NULL);
+  test_cbor_decode_check (truncated, sizeof (truncated), NULL);
+  test_cbor_decode_check (short_str, sizeof (short_str), NULL);
+  test_cbor_decode_check (no_break, sizeof (no_break), NULL);
+  test_cbor_decode_check (lone_break, sizeof (lone_break), NULL);
+  test_cbor_decode_check (indef_int, sizeof (indef_int), NULL);
+  test_cbor_decode_check (bad_chunk, sizeof (bad_chunk), NULL);
+  test_cbor_decode_check (simple, sizeof (simple), NULL);
+  test_cbor_decode_check (big_array, sizeof (big_array), NULL);
+  test_cbor_decode_check (short_map, sizeof (short_map), NULL);
+  test_cbor_decode_check (reserved, 0u, NULL);
+
+  uint8_t deep[1024];
+  memset (deep, 0x81, sizeof (deep));
+  test_cbor_decode_check (deep, sizeof (deep), NULL);
+}
+
+static void test_cbor_typed_array (void)
+{
+  int16_t i16[] = { -1, 2, -300, 4000 };
+  uint32_t u32[] = { 1u, 70000u, UINT32_MAX };
+  int64_t i64[] = { INT64_MIN, 0, INT64_MAX };
+  float f32[] = { 1.5f, -2.25f };
+  double f64[] = { 0.1, -1.0e300 };
+  uint8_t u8[] = { 1u, 2u, 3u };
+  bool flags[] = { true, false };
+  iot_data_t * arrays[] =
+  {
+    iot_data_alloc_array (i16, ARRAY_SIZE (i16), IOT_DATA_INT16, IOT_DATA_REF),
+    iot_data_alloc_array (u32, ARRAY_SIZE (u32), IOT_DATA_UINT32, IOT_DATA_REF),
+    iot_data_alloc_array (i64, ARRAY_SIZE (i64), IOT_DATA_INT64, IOT_DATA_REF),
+    iot_data_alloc_array (f32, ARRAY_SIZE (f32), IOT_DATA_FLOAT32, IOT_DATA_REF),
+    iot_data_alloc_array (f64, ARRAY_SIZE (f64), IOT_DATA_FLOAT64, IOT_DATA_REF),
+    iot_data_alloc_array (u8, ARRAY_SIZE (u8), IOT_DATA_UINT8, IOT_DATA_REF),
+    iot_data_alloc_array (NULL, 0u, IOT_DATA_INT32, IOT_DATA_REF)
+  };
+
+  /* Typed arrays round trip to arrays of the same type */
+  for (size_t i = 0; i < ARRAY_SIZE (arrays); i++)
+  {
+    iot_data_t * cbor = iot_data_to_cbor (arrays[i]);
+    iot_data_t * generic = iot_data_to_cbor_with_typed_arrays (arrays[i], false);
+    CU_ASSERT_EQUAL ((*(const uint8_t*) iot_data_address (cbor)) >> 5, 6u)
+    CU_ASSERT_EQUAL ((*(const uint8_t*) iot_data_address (generic)) >> 5, 4u)
+    iot_data_t * data = iot_data_from_iot_cbor (cbor);
+    CU_ASSERT_PTR_NOT_NULL_FATAL (data)
+    CU_ASSERT (iot_data_equal (data, arrays[i]))
+    iot_data_free (data);
+    data = iot_data_from_iot_cbor (generic);
+    CU_ASSERT_EQUAL (iot_data_type (data), IOT_DATA_VECTOR)
+    iot_data_free (data);
+    iot_data_free (generic);
+    iot_data_free (cbor);
+    iot_data_free (arrays[i]);
+  }
+
+  /* Bool arrays have no typed array representation */
+  iot_data_t * array = iot_data_alloc_array (flags, ARRAY_SIZE (flags), IOT_DATA_BOOL, IOT_DATA_REF);
+  iot_data_t * cbor = iot_data_to_cbor (array);
+  const uint8_t bool_expected[] = { 0x82, 0xf5, 0xf4 };
+  CU_ASSERT_EQUAL (iot_data_array_size (cbor), sizeof (bool_expected))
+  CU_ASSERT (memcmp (iot_data_address (cbor), bool_expected, sizeof (bool_expected)) == 0)
+  iot_data_free (cbor);
+  iot_data_free (array);
+
+  /* Both byte orders, clamped, float16, chunked and unsupported typed arrays */
+  const uint8_t be_u16[] = { 0xd8, 0x41, 0x44, 0x01, 0x02, 0x00, 0x03 };
+  const uint8_t le_u16[] = { 0xd8, 0x45, 0x44, 0x02, 0x01, 0x03, 0x00 };
+  const uint8_t be_i32[] = { 0xd8, 0x4a, 0x44, 0xff, 0xff, 0xff, 0xfe };
+  const uint8_t le_u64[] = { 0xd8, 0x47, 0x48, 0x01, 0, 0, 0, 0, 0, 0, 0 };
+  const uint8_t clamped[] = { 0xd8, 0x44, 0x42, 0x07, 0xff };
+  const uint8_t be_f16[] = { 0xd8, 0x50, 0x44, 0x3c, 0x00, 0xc4, 0x00 };
+  const uint8_t le_f32[] = { 0xd8, 0x55, 0x44, 0x00, 0x00, 0xc0, 0x3f };
+  const uint8_t be_f64[] = { 0xd8, 0x52, 0x48, 0x40, 0x09, 0x21, 0xfb, 0x54, 0x44, 0x2d, 0x18 };
+  const uint8_t chunked[] = { 0xd8, 0x41, 0x5f, 0x41, 0x01, 0x43, 0x02, 0x00, 0x03, 0xff };
+  const uint8_t f128[] = { 0xd8, 0x53, 0x40 };
+  const uint8_t not_bytes[] = { 0xd8, 0x41, 0x82, 0x01, 0x02 };
+  test_cbor_decode_check (be_u16, sizeof (be_u16), "[258,3]");
+  test_cbor_decode_check (le_u16, sizeof (le_u16), "[258,3]");
+  test_cbor_decode_check (be_i32, sizeof (be_i32), "[-2]");
+  test_cbor_decode_check (le_u64, sizeof (le_u64), "[1]");
+  test_cbor_decode_check (clamped, sizeof (clamped), "[7,255]");
+  test_cbor_decode_check (be_f16, sizeof (be_f16), "[1.0,-4.0]");
+  test_cbor_decode_check (le_f32, sizeof (le_f32), "[1.5]");
+  test_cbor_decode_check (be_f64, sizeof (be_f64), "[3.141592653589793]");
+  test_cbor_decode_check (chunked, sizeof (chunked), "[258,3]");
+  test_cbor_decode_check (f128, sizeof (f128), "\"\"");
+  test_cbor_decode_check (not_bytes, sizeof (not_bytes), "[1,2]");
+
+  /* Malformed typed arrays */
+  const uint8_t odd_length[] = { 0xd8, 0x41, 0x43, 0x01, 0x02, 0x03 };
+  const uint8_t short_bytes[] = { 0xd8, 0x42, 0x44, 0x01, 0x02 };
+  test_cbor_decode_check (odd_length, sizeof (odd_length), NULL);
+  test_cbor_decode_check (short_bytes, sizeof (short_bytes), NULL);
+}
+
+static void test_cbor_lazy (void)
+{
+  static const char * json = "{\"device\":\"Sensor\",\"payload\":{\"readings\":[1,-2.5,{\"x\":\"y\"}],\"raw\":\"AQID\"},\"tags\":[\"t1\"],\"n\":3}";
+  iot_data_t * src = iot_data_from_json (json);
+  iot_data_t * cbor = iot_data_to_cbor (src);
+  iot_data_t * data = iot_data_from_cbor_lazy (iot_data_address (cbor), iot_data_array_size (cbor), 1u);
+  CU_ASSERT_PTR_NOT_NULL_FATAL (data)
+  const iot_data_t * payload = iot_data_string_map_get (data, "payload");
+  CU_ASSERT (iot_data_is_lazy (payload))
+  CU_ASSERT (iot_data_is_lazy (iot_data_string_map_get (data, "tags")))
+  CU_ASSERT (! iot_data_is_lazy (iot_data_string_map_get (data, "n")))
+
+  iot_data_t * out = iot_data_to_cbor (data); // Lazy values written verbatim
+  CU_ASSERT (iot_data_cbor_size (data) == iot_data_array_size (cbor))
+  CU_ASSERT (iot_data_equal (out, cbor))
+  iot_data_free (out);
+
+  iot_data_t * all = iot_data_from_cbor (iot_data_address (cbor), iot_data_array_size (cbor));
+  char * str = iot_data_to_json (data); // Lazy values decoded for other encodings
+  char * expected = iot_data_to_json (all);
+  CU_ASSERT_STRING_EQUAL (str, expected)
+  CU_ASSERT (iot_data_json_size (data) == strlen (expected))
+  CU_ASSERT (iot_data_equal (iot_data_lazy_value (payload), iot_data_string_map_get (all, "payload")))
+  free (str);
+  free (expected);
+  iot_data_free (data);
+
+  data = iot_data_from_json_lazy (json, 1u, false); // JSON lazy values decoded for CBOR
+  out = iot_data_to_cbor (data);
+  CU_ASSERT (iot_data_cbor_size (data) == iot_data_array_size (cbor))
+  CU_ASSERT (iot_data_equal (out, cbor))
+  iot_data_free (out);
+  iot_data_free (data);
+
+  const uint8_t truncated[] = { 0xa1, 0x61, 0x61, 0x82, 0x01 }; // {"a":[1,
+  const uint8_t indefinite[] = { 0xa1, 0x61, 0x61, 0x81, 0x7f, 0x61, 0x62, 0x61, 0x63, 0xff }; // {"a":[(_ "b", "c")]}
+  CU_ASSERT_PTR_NULL (iot_data_from_cbor_lazy (truncated, sizeof (truncated), 1u))
+  data = iot_data_from_cbor_lazy (indefinite, sizeof (indefinite), 1u);
+  CU_ASSERT_PTR_NOT_NULL_FATAL (data)
+  str = iot_data_to_json (data);
+  CU_ASSERT_STRING_EQUAL (str, "{\"a\":[\"bc\"]}")
+  free (str);
+  iot_data_free (data);
+  iot_data_free (all);
+  iot_data_free (cbor);
+  iot_data_free (src);
+}
+
+static void test_cbor_stream_cb (iot_data_t * data, void * arg)
+{
+  iot_data_list_tail_push ((iot_data_t*) arg, data);
+}
+
+static void test_cbor_stream (void)
+{
+  char long_str[2000];
+  memset (long_str, 'x', sizeof (long_str) - 1u);
+  long_str[sizeof (long_str) - 1u] = '\0';
+  iot_data_t * values = iot_data_alloc_list ();
+  iot_data_list_tail_push (values, test_sample_map1 ());
+  iot_data_list_tail_push (values, iot_data_alloc_ui64 (UINT64_MAX));
+  iot_data_list_tail_push (values, iot_data_alloc_string (long_str, IOT_DATA_REF));
+  iot_data_list_tail_push (values, iot_data_alloc_bool (true));
+  iot_data_list_tail_push (values, test_sample_map2 ());
+
+  /* Concatenate CBOR of all values, with an indefinite length array */
+  iot_data_t * expected = iot_data_alloc_list ();
+  iot_data_buffer_t * buffer = iot_data_buffer_alloc (0u);
+  uint8_t * cbor = NULL;
+  size_t len = 0;
+  iot_data_list_iter_t iter;
+  iot_data_list_iter (values, &iter);
+  while (iot_data_list_iter_prev (&iter))
+  {
+    const uint8_t * out = iot_data_to_cbor_buffer (iot_data_list_iter_value (&iter), buffer);
+    cbor = realloc (cbor, len + iot_data_buffer_length (buffer));
+    memcpy (cbor + len, out, iot_data_buffer_length (buffer));
+    len += iot_data_buffer_length (buffer);
+    iot_data_list_tail_push (expected, iot_data_from_cbor (out, (uint32_t) iot_data_buffer_length (buffer)));
+  }
+  const uint8_t iarray[] = { 0x9f, 0x01, 0x9f, 0xff, 0xff };
+  cbor = realloc (cbor, len + sizeof (iarray));
+  memcpy (cbor + len, iarray, sizeof (iarray));
+  len += sizeof (iarray);
+  iot_data_buffer_free (buffer);
+
+  size_t chunks[] = { 1u, 7u, 100u, len };
+  for (uint32_t c = 0; c < ARRAY_SIZE (chunks); c++)
+  {
+    iot_data_t * results = iot_data_alloc_list ();
+    iot_data_cbor_stream_t * stream = iot_data_cbor_stream_alloc (test_cbor_stream_cb, results);
+    for (size_t i = 0; i < len; i += chunks[c])
+    {
+      CU_ASSERT (iot_data_cbor_stream_write (stream, cbor + i, (len - i < chunks[c]) ? len - i : chunks[c]))
+    }
+    CU_ASSERT (iot_data_cbor_stream_end (stream))
+    CU_ASSERT (iot_data_list_length (results) == iot_data_list_length (expected) + 1u)
+    iot_data_list_iter_t iter1;
+    iot_data_list_iter_t iter2;
+    iot_data_list_iter (expected, &iter1);
+    iot_data_list_iter (results, &iter2);
+    while (iot_data_list_iter_prev (&iter1) && iot_data_list_iter_prev (&iter2))
+    {
+      CU_ASSERT (iot_data_equal (iot_data_list_iter_value (&iter1), iot_data_list_iter_value (&iter2)))
+    }
+    iot_data_list_iter (results, &iter2);
+    iot_data_list_iter_next (&iter2); // Last value
+    char * json = iot_data_to_json (iot_data_list_iter_value (&iter2));
+    CU_ASSERT_STRING_EQUAL (json, "[1,[]]")
+    free (json);
+    iot_data_free (results);
+    iot_data_cbor_stream_free (stream);
+  }
+
+  /* Malformed and incomplete input */
+  iot_data_t * results = iot_data_alloc_list ();
+  iot_data_cbor_stream_t * stream = iot_data_cbor_stream_alloc (test_cbor_stream_cb, results);
+  const uint8_t bad[] = { 0x01, 0x1c, 0x02 };
+  const uint8_t partial[] = { 0x82, 0x01 };
+  CU_ASSERT (! iot_data_cbor_stream_write (stream, bad, sizeof (bad)))
+  CU_ASSERT (iot_data_list_length (results) == 1u)
+  CU_ASSERT (iot_data_cbor_stream_write (stream, partial, sizeof (partial)))
+  CU_ASSERT (! iot_data_cbor_stream_end (stream))
+  CU_ASSERT (iot_data_cbor_stream_write (stream, partial, sizeof (partial)))
+  CU_ASSERT (iot_data_cbor_stream_write (stream, partial + 1, 1u))
+  CU_ASSERT (iot_data_cbor_stream_end (stream))
+  CU_ASSERT (iot_data_list_length (results) == 2u)
+  iot_data_cbor_stream_free (stream);
+  iot_data_cbor_stream_free (NULL);
+  iot_data_free (results);
+  iot_data_free (expected);
+  iot_data_free (values);
+  free (cbor);
+}
+
+#endif
+
+#ifdef IOT_HAS_MSGPACK
+static void test_msgpack_check (iot_data_t * data, const uint8_t * expected, uint32_t size)
+{
+  iot_data_t * out = iot_data_to_msgpack (data);
+  CU_ASSERT_EQUAL (iot_data_array_size (out), size)
+  CU_ASSERT_EQUAL (iot_data_msgpack_size (data), size)
+  CU_ASSERT (memcmp (iot_data_address (out), expected, size) == 0)
+  iot_data_free (out);
+  iot_data_free (data);
+}
+
+static void test_data_to_msgpack (void)
+{
+  const uint8_t fixint[] = { 0x07 };
+  const uint8_t negfixint[] = { 0xfb };
+  const uint8_t i16[] = { 0xd1, 0xff, 0x38 };
+  const uint8_t u32[] = { 0xce, 0x00, 0x01, 0x11, 0x70 };
+  const uint8_t u64[] = { 0xcf, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff };
+  const uint8_t f64[] = { 0xcb, 0x3f, 0xf8, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+  const uint8_t str[] = { 0xa3, 0x61, 0x62, 0x63 };
+  const uint8_t map[] = { 0x82, 0xa1, 0x61, 0x92, 0x01, 0xc3, 0xa1, 0x62, 0xc0 };
+  const uint8_t array[] = { 0xd6, 0x13, 0x01, 0x00, 0xff, 0xff }; // Ext 16 + IOT_DATA_UINT16, little endian
+  const uint16_t elements[] = { 1u, UINT16_MAX };
+
+  test_msgpack_check (iot_data_alloc_ui32 (7u), fixint, sizeof (fixint));
+  test_msgpack_check (iot_data_alloc_i64 (-5), negfixint, sizeof (negfixint));
+  test_msgpack_check (iot_data_alloc_i32 (-200), i16, sizeof (i16));
+  test_msgpack_check (iot_data_alloc_ui32 (70000u), u32, sizeof (u32));
+  test_msgpack_check (iot_data_alloc_ui64 (UINT64_MAX), u64, sizeof (u64));
+  test_msgpack_check (iot_data_alloc_f64 (1.5), f64, sizeof (f64));
+  test_msgpack_check (iot_data_alloc_string ("abc", IOT_DATA_REF), str, sizeof (str));
+  test_msgpack_check (iot_data_from_json ("{\"a\":[1,true],\"b\":null}"), map, sizeof (map));
+  test_msgpack_check (iot_data_alloc_array ((void*) elements, 2u, IOT_DATA_UINT16, IOT_DATA_REF), array, sizeof (array));
+}
+
+static void test_msgpack_round_trip (void)
+{
+  iot_data_buffer_t * buffer = iot_data_buffer_alloc (8u);
+  char long_str[70000];
+  memset (long_str, 'x', sizeof (long_str) - 1u);
+  long_str[sizeof (long_str) - 1u] = '\0';
+  iot_data_t * data[] = { test_sample_map1 (), test_sample_map2 (), test_sample_composite (), iot_data_alloc_string (long_str, IOT_DATA_REF), iot_data_alloc_i64 (INT32_MIN) };
+  for (size_t i = 0; i < ARRAY_SIZE (data); i++)
+  {
+    iot_data_t * msgpack = iot_data_to_msgpack (data[i]);
+    CU_ASSERT_EQUAL (iot_data_msgpack_size (data[i]), iot_data_array_size (msgpack))
+    const uint8_t * out = iot_data_to_msgpack_buffer (data[i], buffer);
+    CU_ASSERT_EQUAL (iot_data_buffer_length (buffer), iot_data_array_size (msgpack))
+    CU_ASSERT (memcmp (out, iot_data_address (msgpack), iot_data_array_size (msgpack)) == 0)
+
+    iot_data_t * decoded = iot_data_from_iot_msgpack (msgpack);
+    CU_ASSERT_PTR_NOT_NULL_FATAL (decoded)
+    char * json = iot_data_to_json (decoded);
+    char * expected = iot_data_to_json (data[i]);
+    CU_ASSERT_STRING_EQUAL (json, expected)
+    free (json);
+    free (expected);
+    iot_data_free (decoded);
+    iot_data_free (msgpack);
+    iot_data_free (data[i]);
+  }
+  iot_data_buffer_free (buffer);
+
+  static const double doubles[] = { 0.0, -1.5e-300, 3.0 };
+  static const bool flags[] = { true, false, true };
+  iot_data_t * arrays[] =
+  {
+    iot_data_alloc_array ((void*) doubles, ARRAY_SIZE (doubles), IOT_DATA_FLOAT64, IOT_DATA_REF),
+    iot_data_alloc_array ((void*) flags, ARRAY_SIZE (flags), IOT_DATA_BOOL, IOT_DATA_REF),
+    iot_data_alloc_array (NULL, 0u, IOT_DATA_INT32, IOT_DATA_REF)
+  };
+  for (size_t i = 0; i < ARRAY_SIZE (arrays); i++) // Arrays decoded with element type
+  {
+    iot_data_t * msgpack = iot_data_to_msgpack (arrays[i]);
+    iot_data_t * decoded = iot_data_from_iot_msgpack (msgpack);
+    CU_ASSERT (iot_data_equal (decoded, arrays[i]))
+    iot_data_free (decoded);
+    iot_data_free (msgpack);
+    iot_data_free (arrays[i]);
+  }
+}
+
+static void test_msgpack_decode (void)
+{
+  const uint8_t truncated[] = { 0x92, 0x01 };
+  const uint8_t unused[] = { 0xc1 };
+  const uint8_t bad_array[] = { 0xd5, 0x14, 0x01, 0x02 }; // Ext 16 + IOT_DATA_INT32 with 2 bytes
+  const uint8_t short_str[] = { 0xd9, 0x05, 0x61 };
+  const uint8_t ext[] = { 0xd4, 0x01, 0xaa };
+  const uint8_t i64[] = { 0xd3, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+  const uint8_t f32[] = { 0xca, 0x3f, 0xc0, 0x00, 0x00 };
+  CU_ASSERT_PTR_NULL (iot_data_from_msgpack (truncated, sizeof (truncated)))
+  CU_ASSERT_PTR_NULL (iot_data_from_msgpack (unused, sizeof (unused)))
+  CU_ASSERT_PTR_NULL (iot_data_from_msgpack (bad_array, sizeof (bad_array)))
+  CU_ASSERT_PTR_NULL (iot_data_from_msgpack (short_str, sizeof (short_str)))
+  CU_ASSERT_PTR_NULL (iot_data_from_msgpack (NULL, 0u))
+
+  iot_data_t * data = iot_data_from_msgpack (ext, sizeof (ext)); // Other ext types decoded as binary
+  CU_ASSERT (iot_data_type (data) == IOT_DATA_BINARY)
+  CU_ASSERT (iot_data_array_size (data) == 1u && *(const uint8_t*) iot_data_address (data) == 0xaa)
+  iot_data_free (data);
+  data = iot_data_from_msgpack (i64, sizeof (i64));
+  CU_ASSERT (iot_data_type (data) == IOT_DATA_INT64 && iot_data_i64 (data) == INT64_MIN)
+  iot_data_free (data);
+  data = iot_data_from_msgpack (f32, sizeof (f32));
+  CU_ASSERT (iot_data_type (data) == IOT_DATA_FLOAT32 && iot_data_f32 (data) == 1.5f)
+  iot_data_free (data);
+}
 #endif
 
 #ifdef IOT_HAS_YAML
@@ -699,6 +1935,72 @@ static void test_data_from_yaml (void)
   free (json);
   iot_data_free (yaml);
 }
+
+static void test_data_yaml_alias (void)
+{
+  iot_data_t * ex;
+  const char * test_yaml = "base: &base { timeout: 10, retries: 3 }\n"
+    "first: *base\n"
+    "second:\n"
+    "  <<: *base\n"
+    "  retries: 5\n"
+    "list: [ &one 1, *one ]";
+  iot_data_t * yaml = iot_data_from_yaml (test_yaml, &ex);
+  CU_ASSERT (yaml != NULL && ex == NULL)
+  const iot_data_t * base = iot_data_string_map_get (yaml, "base");
+  CU_ASSERT (iot_data_string_map_get (yaml, "first") == base)
+  const iot_data_t * second = iot_data_string_map_get (yaml, "second");
+  CU_ASSERT (iot_data_string_map_get_i64 (second, "retries", 0) == 5)
+  CU_ASSERT (iot_data_string_map_get (second, "timeout") == iot_data_string_map_get (base, "timeout"))
+  CU_ASSERT (iot_data_string_map_get (second, "<<") == NULL)
+  const iot_data_t * list = iot_data_string_map_get (yaml, "list");
+  CU_ASSERT (iot_data_vector_get (list, 0) == iot_data_vector_get (list, 1))
+  iot_data_free (yaml);
+  yaml = iot_data_from_yaml ("a: *missing", &ex);
+  CU_ASSERT (yaml == NULL && ex != NULL)
+  iot_data_free (ex);
+}
+
+static void test_yaml_document_cb (iot_data_t * data, void * arg)
+{
+  iot_data_list_tail_push ((iot_data_t*) arg, data);
+}
+
+static void test_data_yaml_stream (void)
+{
+  iot_data_t * ex;
+  iot_data_t * docs = iot_data_alloc_list ();
+  const char * test_yaml = "---\nname: one\nref: &r 1\n---\nname: two\n---\n[ 1, 2 ]\n";
+  CU_ASSERT (iot_data_from_yaml_stream (test_yaml, test_yaml_document_cb, docs, &ex))
+  CU_ASSERT (ex == NULL)
+  CU_ASSERT (iot_data_list_length (docs) == 3)
+  iot_data_t * doc = iot_data_list_head_pop (docs);
+  CU_ASSERT (strcmp (iot_data_string_map_get_string (doc, "name"), "one") == 0)
+  iot_data_free (doc);
+  doc = iot_data_list_head_pop (docs);
+  CU_ASSERT (strcmp (iot_data_string_map_get_string (doc, "name"), "two") == 0)
+  iot_data_free (doc);
+  doc = iot_data_list_head_pop (docs);
+  CU_ASSERT (iot_data_type (doc) == IOT_DATA_VECTOR && iot_data_vector_size (doc) == 2)
+  iot_data_free (doc);
+
+  CU_ASSERT (! iot_data_from_yaml_stream ("---\na: 1\n---\nb: *r\n", test_yaml_document_cb, docs, &ex)) // Anchors are per document
+  CU_ASSERT (ex != NULL)
+  CU_ASSERT (iot_data_list_length (docs) == 1)
+  iot_data_free (ex);
+
+  FILE * fp = tmpfile ();
+  CU_ASSERT (fp != NULL)
+  if (fp)
+  {
+    fputs (test_yaml, fp);
+    rewind (fp);
+    CU_ASSERT (iot_data_from_yaml_file (fp, test_yaml_document_cb, docs, &ex))
+    CU_ASSERT (iot_data_list_length (docs) == 4)
+    fclose (fp);
+  }
+  iot_data_free (docs);
+}
 #endif
 
 void cunit_data_io_test_init (void)
@@ -709,14 +2011,44 @@ void cunit_data_io_test_init (void)
   CU_add_test (suite, "data_from_json", test_data_from_json);
   CU_add_test (suite, "data_from_json2", test_data_from_json2);
   CU_add_test (suite, "data_from_json3", test_data_from_json3);
+  CU_add_test (suite, "data_from_json4", test_data_from_json4);
+  CU_add_test (suite, "data_json_escape", test_data_json_escape);
+  CU_add_test (suite, "data_json_numbers", test_data_json_numbers);
+  CU_add_test (suite, "data_to_json_sink", test_data_to_json_sink);
+  CU_add_test (suite, "data_json_stream", test_data_json_stream);
+  CU_add_test (suite, "data_from_json_in_situ", test_data_from_json_in_situ);
+  CU_add_test (suite, "data_from_json_select", test_data_from_json_select);
+  CU_add_test (suite, "data_from_json_lazy", test_data_from_json_lazy);
+  CU_add_test (suite, "data_ordered_map", test_data_ordered_map);
+  CU_add_test (suite, "data_json_plan", test_data_json_plan);
+  CU_add_test (suite, "data_to_json_buffer", test_data_to_json_buffer);
+  CU_add_test (suite, "data_json_size", test_data_json_size);
+  CU_add_test (suite, "data_serialise", test_data_serialise);
+#if defined (IOT_HAS_FILE) && !defined (_AZURESPHERE_)
+  CU_add_test (suite, "data_deserialise_file", test_data_deserialise_file);
+#endif
 #ifdef IOT_HAS_XML
   CU_add_test (suite, "data_from_xml", test_data_from_xml);
+  CU_add_test (suite, "data_xml_stream", test_data_xml_stream);
 #endif
 #ifdef IOT_HAS_CBOR
   CU_add_test (suite, "data_to_cbor", test_data_to_cbor);
+  CU_add_test (suite, "data_to_cbor_buffer", test_data_to_cbor_buffer);
+  CU_add_test (suite, "data_cbor_size", test_data_cbor_size);
   CU_add_test (suite, "cbor_to_data", test_cbor_to_data);
+  CU_add_test (suite, "cbor_decode", test_cbor_decode);
+  CU_add_test (suite, "cbor_typed_array", test_cbor_typed_array);
+  CU_add_test (suite, "cbor_lazy", test_cbor_lazy);
+  CU_add_test (suite, "cbor_stream", test_cbor_stream);
+#endif
+#ifdef IOT_HAS_MSGPACK
+  CU_add_test (suite, "data_to_msgpack", test_data_to_msgpack);
+  CU_add_test (suite, "msgpack_round_trip", test_msgpack_round_trip);
+  CU_add_test (suite, "msgpack_decode", test_msgpack_decode);
 #endif
 #ifdef IOT_HAS_YAML
   CU_add_test (suite, "data_from_yaml", test_data_from_yaml);
+  CU_add_test (suite, "data_yaml_alias", test_data_yaml_alias);
+  CU_add_test (suite, "data_yaml_stream", test_data_yaml_stream);
 #endif
 }
@@ -7,6 +7,8 @@
 
 #include "logger.h"
 #include "CUnit.h"
+#include "iot/time.h"
+#include "iot/file.h"
 
 static int suite_init (void)
 {
@@ -107,6 +109,147 @@ static void cunit_logger_file (void)
   iot_logger_free (logger);
 }
 
+static void cunit_logger_file_rotate (void)
+{
+  const iot_logger_file_config_t config = { .max_size = 512u, .max_files = 2u, .buffer_size = 256u, .flush_interval = 10u, .fsync = IOT_LOG_FSYNC_ROTATE };
+  remove ("./rotate.log");
+  remove ("./rotate.log.1");
+  remove ("./rotate.log.2");
+  remove ("./rotate.log.3");
+  iot_logger_t * logger = iot_logger_alloc_file_with_config ("Rotate", IOT_LOG_INFO, true, NULL, "./rotate.log", &config);
+  for (uint32_t i = 0; i < 100u; i++) iot_log_info (logger, "Rotating file logger test message %" PRIu32, i);
+  iot_logger_free (logger);
+  CU_ASSERT (access ("./rotate.log", F_OK) == 0)
+  CU_ASSERT (access ("./rotate.log.1", F_OK) == 0)
+  CU_ASSERT (access ("./rotate.log.2", F_OK) == 0)
+  CU_ASSERT (access ("./rotate.log.3", F_OK) != 0)
+  FILE * fd = fopen ("./rotate.log.1", "r");
+  CU_ASSERT (fd != NULL)
+  if (fd)
+  {
+    fseek (fd, 0, SEEK_END);
+    CU_ASSERT (ftell (fd) > 0 && ftell (fd) <= 512)
+    fclose (fd);
+  }
+  remove ("./rotate.log");
+  remove ("./rotate.log.1");
+  remove ("./rotate.log.2");
+}
+
+static void cunit_logger_file_rotate_async (void)
+{
+  const iot_logger_file_config_t config = { .interval = 1u, .max_files = 5u, .buffer_size = 4096u, .flush_interval = 100u };
+  char name[32];
+  remove ("./rot.log");
+  for (uint32_t i = 1u; i <= 5u; i++)
+  {
+    snprintf (name, sizeof (name), "./rot.log.%" PRIu32, i);
+    remove (name);
+  }
+  iot_logger_t * logger = iot_logger_alloc_file_with_config ("RotateAsync", IOT_LOG_INFO, true, NULL, "./rot.log", &config);
+  iot_logger_set_async (logger, 256u, IOT_LOG_OVERFLOW_BLOCK);
+  uint64_t end = iot_time_msecs () + 1500u;
+  for (uint32_t i = 0; iot_time_msecs () < end; i++) iot_log_info (logger, "Async rotation test message %" PRIu32, i);
+  iot_logger_free (logger);
+  char * content = iot_file_read ("./rot.log.1");
+  CU_ASSERT (content != NULL)
+  if (content)
+  {
+    char * nl = strchr (content, '\n');
+    CU_ASSERT (nl && strchr (nl + 1, '\n')) // Queued records do not each rotate the file
+    free (content);
+  }
+  remove ("./rot.log");
+  for (uint32_t i = 1u; i <= 5u; i++)
+  {
+    snprintf (name, sizeof (name), "./rot.log.%" PRIu32, i);
+    remove (name);
+  }
+}
+
+static void cunit_logger_file_compress_fail (void)
+{
+  const iot_logger_file_config_t config = { .max_size = 256u, .max_files = 3u, .compress = true };
+  char * path = getenv ("PATH") ? strdup (getenv ("PATH")) : NULL;
+  remove ("./compress.log");
+  remove ("./compress.log.1");
+  remove ("./compress.log.2");
+  setenv ("PATH", "", 1); // gzip cannot be found, so rotated files remain uncompressed
+  iot_logger_t * logger = iot_logger_alloc_file_with_config ("Compress", IOT_LOG_INFO, true, NULL, "./compress.log", &config);
+  for (uint32_t i = 0; i < 12u; i++) iot_log_info (logger, "Compressing file logger test message %" PRIu32, i);
+  iot_logger_free (logger);
+  if (path)
+  {
+    setenv ("PATH", path, 1);
+    free (path);
+  }
+  CU_ASSERT (access ("./compress.log.1", F_OK) == 0)
+  CU_ASSERT (access ("./compress.log.2", F_OK) == 0) // Not overwritten by the next rotation
+  remove ("./compress.log");
+  remove ("./compress.log.1");
+  remove ("./compress.log.2");
+  remove ("./compress.log.3");
+}
+
+static void cunit_logger_file_idle_flush (void)
+{
+  const iot_logger_file_config_t config = { .buffer_size = 4096u, .flush_interval = 10u };
+  remove ("./flush.log");
+  iot_logger_t * logger = iot_logger_alloc_file_with_config ("Flush", IOT_LOG_INFO, true, NULL, "./flush.log", &config);
+  iot_logger_set_async (logger, 16u, IOT_LOG_OVERFLOW_BLOCK);
+  iot_log_info (logger, "Flushed when idle");
+  iot_wait_msecs (500u);
+  char * content = iot_file_read ("./flush.log"); // Logger not yet closed
+  CU_ASSERT (content && strstr (content, "Flushed when idle"))
+  free (content);
+  iot_logger_free (logger);
+  remove ("./flush.log");
+}
+
+static void cunit_logger_json_fields (void)
+{
+  remove ("./json.log");
+  iot_logger_t * logger = iot_logger_alloc_file ("Json", IOT_LOG_INFO, true, NULL, "./json.log");
+  iot_logger_set_format (logger, IOT_LOG_FORMAT_JSON);
+  iot_data_t * fields = iot_data_alloc_map (IOT_DATA_STRING);
+  iot_data_string_map_add (fields, "device", iot_data_alloc_string ("Sensor \"1\"", IOT_DATA_REF));
+  iot_data_string_map_add (fields, "reading", iot_data_alloc_i32 (42));
+  iot_data_string_map_add (fields, "message", iot_data_alloc_string ("Clash", IOT_DATA_REF)); // Record keys not overridden
+  iot_data_string_map_add (fields, "level", iot_data_alloc_i32 (0));
+  iot_data_string_map_add (fields, "timestamp", iot_data_alloc_i32 (0));
+  iot_log_fields (logger, IOT_LOG_INFO, fields, "Reading %d", 1);
+  iot_log_fields (logger, IOT_LOG_DEBUG, fields, "Not logged");
+  iot_data_free (fields);
+  iot_log_info (logger, "No fields");
+  iot_logger_free (logger);
+
+  char * json = iot_file_read ("./json.log");
+  CU_ASSERT (json != NULL)
+  char * line2 = json ? strchr (json, '\n') : NULL;
+  CU_ASSERT (line2 != NULL)
+  if (line2)
+  {
+    *line2++ = '\0';
+    iot_data_t * rec = iot_data_from_json (json);
+    CU_ASSERT (iot_data_type (rec) == IOT_DATA_MAP)
+    CU_ASSERT (strcmp (iot_data_string_map_get_string (rec, "message"), "Reading 1") == 0)
+    CU_ASSERT (strcmp (iot_data_string_map_get_string (rec, "logger"), "Json") == 0)
+    CU_ASSERT (strcmp (iot_data_string_map_get_string (rec, "level"), "Info") == 0)
+    CU_ASSERT (strcmp (iot_data_string_map_get_string (rec, "device"), "Sensor \"1\"") == 0)
+    CU_ASSERT (iot_data_string_map_get_i64 (rec, "reading", 0) == 42)
+    CU_ASSERT (iot_data_string_map_get_i64 (rec, "timestamp", 0) > 0)
+    CU_ASSERT (iot_data_map_size (rec) == 7u)
+    CU_ASSERT (json && strstr (json, "Clash") == NULL)
+    iot_data_free (rec);
+    rec = iot_data_from_json (line2);
+    CU_ASSERT (strcmp (iot_data_string_map_get_string (rec, "message"), "No fields") == 0)
+    CU_ASSERT (iot_data_map_size (rec) == 5u)
+    iot_data_free (rec);
+  }
+  free (json);
+  remove ("./json.log");
+}
+
 static void cunit_logger_udp (void)
 {
   iot_logger_t * logger = iot_logger_alloc_udp ("udp", IOT_LOG_WARN, false, NULL, "localhost", 22222);
@@ -186,6 +329,165 @@ static void cunit_logger_set_next (void)
   iot_logger_free (next);
 }
 
+static void cunit_logger_async (void)
+{
+  iot_logger_t * logger = iot_logger_alloc_custom ("Async", IOT_LOG_TRACE, true, NULL, cunit_custom_log_fn, NULL, NULL);
+  iot_logger_set_async (logger, 100u, IOT_LOG_OVERFLOW_BLOCK);
+  cunit_custom_log_count = 0u;
+  for (uint32_t i = 0; i < 100u; i++) cunit_test_logs (logger);
+  iot_logger_free (logger); // Waits for all queued records to be written
+  CU_ASSERT (cunit_custom_log_count == 500u)
+}
+
+static void cunit_logger_async_size (void)
+{
+  iot_logger_t * logger = iot_logger_alloc_custom ("AsyncSize", IOT_LOG_TRACE, true, NULL, cunit_custom_log_fn, NULL, NULL);
+  iot_logger_set_async (logger, UINT32_MAX, IOT_LOG_OVERFLOW_BLOCK); // Clamped to maximum size
+  cunit_custom_log_count = 0u;
+  cunit_test_logs (logger);
+  iot_logger_free (logger);
+  CU_ASSERT (cunit_custom_log_count == 5u)
+}
+
+static atomic_bool cunit_async_hold;
+
+static void cunit_async_hold_fn (iot_logger_t * logger, iot_loglevel_t level, uint64_t timestamp, const char * message, const void *ctx)
+{
+  while (atomic_load (&cunit_async_hold)) iot_wait_msecs (1u);
+  cunit_custom_log_fn (logger, level, timestamp, message, ctx);
+}
+
+static void cunit_logger_async_drop (void)
+{
+  iot_logger_t * logger = iot_logger_alloc_custom ("AsyncDrop", IOT_LOG_TRACE, true, NULL, cunit_async_hold_fn, NULL, NULL);
+  iot_logger_set_async (logger, 2u, IOT_LOG_OVERFLOW_DROP);
+  atomic_store (&cunit_async_hold, true);
+  cunit_custom_log_count = 0u;
+  for (uint32_t i = 0; i < 10u; i++) iot_log_info (logger, "Async drop %" PRIu32, i);
+  CU_ASSERT (iot_logger_dropped (logger) == 8u)
+  atomic_store (&cunit_async_hold, false);
+  iot_logger_free (logger);
+  CU_ASSERT (cunit_custom_log_count == 2u)
+}
+
+static char cunit_async_messages[4][IOT_LOG_MSG_MAX];
+
+static void cunit_async_save_fn (iot_logger_t * logger, iot_loglevel_t level, uint64_t timestamp, const char * message, const void *ctx)
+{
+  (void) logger;
+  (void) level;
+  (void) timestamp;
+  (void) ctx;
+  if (cunit_custom_log_count < 4u) strcpy (cunit_async_messages[cunit_custom_log_count], message);
+  cunit_custom_log_count++;
+}
+
+static void cunit_logger_async_format (void)
+{
+  char expected[4][IOT_LOG_MSG_MAX];
+  char str[16] = "transient";
+  const char * name = "threadpool";
+  iot_logger_t * logger = iot_logger_alloc_custom ("AsyncFormat", IOT_LOG_TRACE, true, NULL, cunit_async_save_fn, NULL, NULL);
+  iot_logger_set_async (logger, 4u, IOT_LOG_OVERFLOW_BLOCK);
+  cunit_custom_log_count = 0u;
+  snprintf (expected[0], IOT_LOG_MSG_MAX, "Thread %" PRIu16 " processing job %" PRIu32 " %d%%", (uint16_t) 7u, UINT32_MAX, -1);
+  iot_log_trace (logger, "Thread %" PRIu16 " processing job %" PRIu32 " %d%%", (uint16_t) 7u, UINT32_MAX, -1);
+  snprintf (expected[1], IOT_LOG_MSG_MAX, "[%-12s] [%*d] [%.*s] [%c] [%hhd] [%zu] [%lx]", name, 6, -42, 3, "abcdef", 'x', (signed char) -3, (size_t) 99u, 0xdeadbeefUL);
+  iot_log_debug (logger, "[%-12s] [%*d] [%.*s] [%c] [%hhd] [%zu] [%lx]", name, 6, -42, 3, "abcdef", 'x', (signed char) -3, (size_t) 99u, 0xdeadbeefUL);
+  snprintf (expected[2], IOT_LOG_MSG_MAX, "%5.2f %e %g %s %" PRId64, 3.14159, -1.5e-10, 0.25, str, INT64_MIN);
+  iot_log_info (logger, "%5.2f %e %g %s %" PRId64, 3.14159, -1.5e-10, 0.25, str, INT64_MIN);
+  strcpy (str, "overwritten"); // String arguments are captured when logged
+  snprintf (expected[3], IOT_LOG_MSG_MAX, "%Lf", (long double) 1.5); // Formatted by logging thread
+  iot_log_info (logger, "%Lf", (long double) 1.5);
+  iot_logger_free (logger);
+  CU_ASSERT (cunit_custom_log_count == 4u)
+  for (uint32_t i = 0; i < 4u; i++) CU_ASSERT (strcmp (expected[i], cunit_async_messages[i]) == 0)
+}
+
+static void cunit_async_hold_save_fn (iot_logger_t * logger, iot_loglevel_t level, uint64_t timestamp, const char * message, const void *ctx)
+{
+  while (atomic_load (&cunit_async_hold)) iot_wait_msecs (1u);
+  cunit_async_save_fn (logger, level, timestamp, message, ctx);
+}
+
+static void cunit_logger_async_fmt_copy (void)
+{
+  char fmt[32];
+  iot_logger_t * logger = iot_logger_alloc_custom ("AsyncFmt", IOT_LOG_TRACE, true, NULL, cunit_async_hold_save_fn, NULL, NULL);
+  iot_logger_set_async (logger, 4u, IOT_LOG_OVERFLOW_BLOCK);
+  atomic_store (&cunit_async_hold, true);
+  cunit_custom_log_count = 0u;
+  strcpy (fmt, "value %d from %s");
+  iot_log_info (logger, fmt, 42, "site");
+  memset (fmt, 'X', sizeof (fmt) - 1u); // Format buffer reused before the record is written
+  atomic_store (&cunit_async_hold, false);
+  iot_logger_free (logger);
+  CU_ASSERT (cunit_custom_log_count == 1u)
+  CU_ASSERT (strcmp (cunit_async_messages[0], "value 42 from site") == 0)
+}
+
+static void cunit_logger_limits (void)
+{
+  iot_logger_t * logger = iot_logger_alloc_custom ("Limits", IOT_LOG_TRACE, true, NULL, cunit_async_save_fn, NULL, NULL);
+  iot_logger_set_limits (logger, 0u, 60000u, true);
+  cunit_custom_log_count = 0u;
+  for (uint32_t i = 0; i < 10u; i++) iot_log_warn (logger, "Scheduled event dropped for schedule #%d", 1);
+  CU_ASSERT (cunit_custom_log_count == 1u)
+  iot_log_warn (logger, "Scheduled event dropped for schedule #%d", 2);
+  CU_ASSERT (cunit_custom_log_count == 3u)
+  CU_ASSERT (strcmp (cunit_async_messages[1], "Last message repeated 9 times") == 0)
+  CU_ASSERT (strcmp (cunit_async_messages[2], "Scheduled event dropped for schedule #2") == 0)
+
+  iot_logger_set_limits (logger, 3u, 60000u, false);
+  cunit_custom_log_count = 0u;
+  for (uint32_t i = 0; i < 10u; i++)
+  {
+    iot_log_warn (logger, "Rate limited %" PRIu32, i);
+    iot_log_info (logger, "Other call site %" PRIu32, i);
+  }
+  CU_ASSERT (cunit_custom_log_count == 6u)
+  iot_logger_set_limits (logger, 0u, 0u, false);
+  cunit_custom_log_count = 0u;
+  for (uint32_t i = 0; i < 10u; i++) iot_log_warn (logger, "Rate limited %" PRIu32, i);
+  CU_ASSERT (cunit_custom_log_count == 10u)
+
+  char fmt[32]; // Summary must not refer to a format string that has since changed
+  strcpy (fmt, "Transient format %d");
+  iot_logger_set_limits (logger, 1u, 10u, false);
+  cunit_custom_log_count = 0u;
+  for (int i = 0; i < 3; i++) iot_log_warn (logger, fmt, i);
+  strcpy (fmt, "Overwritten %d");
+  iot_wait_msecs (20u);
+  iot_log_warn (logger, fmt, 3);
+  CU_ASSERT (cunit_custom_log_count == 3u)
+  CU_ASSERT (strcmp (cunit_async_messages[1], "Rate limit dropped 2 messages: Transient format %d") == 0)
+  CU_ASSERT (strcmp (cunit_async_messages[2], "Overwritten 3") == 0)
+  iot_logger_free (logger);
+}
+
+static void cunit_logger_limits_idle (void)
+{
+  iot_logger_t * logger = iot_logger_alloc_custom ("LimitsIdle", IOT_LOG_TRACE, true, NULL, cunit_async_save_fn, NULL, NULL);
+  iot_logger_set_limits (logger, 0u, 50u, true);
+  iot_logger_set_async (logger, 16u, IOT_LOG_OVERFLOW_BLOCK);
+  cunit_custom_log_count = 0u;
+  for (uint32_t i = 0; i < 5u; i++) iot_log_warn (logger, "Idle summary %d", 1);
+  iot_wait_msecs (500u); // Summary logged by writer thread once interval expires
+  CU_ASSERT (cunit_custom_log_count == 2u)
+  CU_ASSERT (strcmp (cunit_async_messages[1], "Last message repeated 4 times") == 0)
+  iot_logger_free (logger);
+
+  logger = iot_logger_alloc_custom ("RateIdle", IOT_LOG_TRACE, true, NULL, cunit_async_save_fn, NULL, NULL);
+  iot_logger_set_limits (logger, 2u, 50u, false);
+  iot_logger_set_async (logger, 16u, IOT_LOG_OVERFLOW_BLOCK);
+  cunit_custom_log_count = 0u;
+  for (uint32_t i = 0; i < 5u; i++) iot_log_warn (logger, "Idle rate limited %" PRIu32, i);
+  iot_wait_msecs (500u);
+  CU_ASSERT (cunit_custom_log_count == 3u)
+  CU_ASSERT (strcmp (cunit_async_messages[2], "Rate limit dropped 3 messages: Idle rate limited %" PRIu32) == 0)
+  iot_logger_free (logger);
+}
+
 static void cunit_logger_level_name (void)
 {
   CU_ASSERT (strcmp ("", iot_logger_level_to_string (IOT_LOG_NONE)) == 0)
@@ -204,6 +506,11 @@ void cunit_logger_test_init (void)
   CU_add_test (suite, "logger_impl", cunit_logger_impl);
   CU_add_test (suite, "logger_sub", cunit_logger_sub);
   CU_add_test (suite, "logger_file", cunit_logger_file);
+  CU_add_test (suite, "logger_file_rotate", cunit_logger_file_rotate);
+  CU_add_test (suite, "logger_file_rotate_async", cunit_logger_file_rotate_async);
+  CU_add_test (suite, "logger_file_compress_fail", cunit_logger_file_compress_fail);
+  CU_add_test (suite, "logger_file_idle_flush", cunit_logger_file_idle_flush);
+  CU_add_test (suite, "logger_json_fields", cunit_logger_json_fields);
   CU_add_test (suite, "logger_udp", cunit_logger_udp);
   CU_add_test (suite, "logger_udp_broadcast", cunit_logger_udp_broadcast);
   CU_add_test (suite, "logger_null", cunit_logger_null);
@@ -213,4 +520,11 @@ void cunit_logger_test_init (void)
   CU_add_test (suite, "logger_format", cunit_logger_format);
   CU_add_test (suite, "logger_set_next", cunit_logger_set_next);
   CU_add_test (suite, "logger_level_name", cunit_logger_level_name);
+  CU_add_test (suite, "logger_async", cunit_logger_async);
+  CU_add_test (suite, "logger_async_size", cunit_logger_async_size);
+  CU_add_test (suite, "logger_async_drop", cunit_logger_async_drop);
+  CU_add_test (suite, "logger_async_format", cunit_logger_async_format);
+  CU_add_test (suite, "logger_async_fmt_copy", cunit_logger_async_fmt_copy);
+  CU_add_test (suite, "logger_limits", cunit_logger_limits);
+  CU_add_test (suite, "logger_limits_idle", cunit_logger_limits_idle);
 }